@@ -350,6 +350,24 @@ struct osip_naptr {
   struct osip_srv_record sipenum_record; /**< enum NAPTR result */
 };
 
+/**
+ * Structure for an entry in a timer wheel.
+ * @var osip_timer_entry_t
+ */
+typedef struct osip_timer_entry osip_timer_entry_t;
+
+/**
+ * Structure for an entry in a timer wheel.
+ * @struct osip_timer_entry
+ */
+struct osip_timer_entry {
+  osip_timer_entry_t *next; /**< (internal) next entry in slot */
+  osip_timer_entry_t *prev; /**< (internal) previous entry in slot */
+  unsigned long expire;     /**< (internal) expiration time (in ms) */
+  int slot;                 /**< (internal) slot index + 1 (0 if not scheduled) */
+  void *element;            /**< (internal) element attached to entry */
+};
+
 /**
  * Structure for transaction handling.
  * @var osip_transaction_t
@@ -399,6 +417,14 @@ struct osip_transaction {
   void *reserved4;            /**< User Defined Pointer. */
   void *reserved5;            /**< User Defined Pointer. */
   void *reserved6;            /**< User Defined Pointer. */
+
+  osip_timer_entry_t timer_entry; /**< (internal) entry in timer wheel */
+
+  struct osip_transaction *ready_next; /**< (internal) next transaction with pending events */
+  struct osip_transaction *ready_prev; /**< (internal) previous transaction with pending events */
+  int ready_state;                     /**< (internal) state in the list of transactions with pending events */
+  int ready_busy;                      /**< (internal) queued in or run by an executor */
+  int ready_free;                      /**< (internal) free delayed until the executor releases the transaction */
 };
 
 /**
@@ -537,6 +563,8 @@ struct ixt {
   int port;                   /**< destination port */
   int sock;                   /**< socket to use */
   int counter;                /**< start at 7 */
+
+  osip_timer_entry_t timer_entry; /**< (internal) entry in timer wheel */
 };
 
 /**
@@ -569,18 +597,33 @@ struct osip {
   osip_list_t osip_nict_transactions; /**< list of nict transactions */
   osip_list_t osip_nist_transactions; /**< list of nist transactions */
 
-  osip_list_t ixt_retransmissions; /**< list of ixt elements */
-
   osip_message_cb_t msg_callbacks[OSIP_MESSAGE_CALLBACK_COUNT];                      /**< message callbacks */
   osip_kill_transaction_cb_t kill_callbacks[OSIP_KILL_CALLBACK_COUNT];               /**< kill callbacks */
   osip_transport_error_cb_t tp_error_callbacks[OSIP_TRANSPORT_ERROR_CALLBACK_COUNT]; /**< transport error callback */
 
   int (*cb_send_message)(osip_transaction_t *, osip_message_t *, char *, int, int); /**< callback to send message */
 
-  void *osip_ict_hastable;  /**< htable of ict transactions */
-  void *osip_ist_hastable;  /**< htable of ist transactions */
-  void *osip_nict_hastable; /**< htable of nict transactions */
-  void *osip_nist_hastable; /**< htable of nist transactions */
+  void *osip_ict_hastable;  /**< (internal) index of ict transactions */
+  void *osip_ist_hastable;  /**< (internal) index of ist transactions */
+  void *osip_nict_hastable; /**< (internal) index of nict transactions */
+  void *osip_nist_hastable; /**< (internal) index of nist transactions */
+
+  void *osip_ict_timers;  /**< (internal) timer wheel of ict transactions */
+  void *osip_ist_timers;  /**< (internal) timer wheel of ist transactions */
+  void *osip_nict_timers; /**< (internal) timer wheel of nict transactions */
+  void *osip_nist_timers; /**< (internal) timer wheel of nist transactions */
+
+  void *osip_ict_ready;  /**< (internal) ict transactions with pending events */
+  void *osip_ist_ready;  /**< (internal) ist transactions with pending events */
+  void *osip_nict_ready; /**< (internal) nict transactions with pending events */
+  void *osip_nist_ready; /**< (internal) nist transactions with pending events */
+
+  void *osip_ixt_timers; /**< (internal) timer wheel of ixt elements */
+  void *osip_ixt_index;  /**< (internal) index of ixt elements by dialog and by Call-ID/CSeq */
+
+  osip_t **shards; /**< (internal) shards of a sharded osip_t */
+  int nb_shards;   /**< number of shards (0 when not sharded) */
+  osip_t *parent;  /**< (internal) osip_t owning this shard */
 };
 
 /**
@@ -625,6 +668,7 @@ struct osip_event {
   type_t type;         /**< Event Type */
   int transactionid;   /**< identifier of the related osip transaction */
   osip_message_t *sip; /**< SIP message (optional) */
+  void *fifo_link;     /**< (internal) link in a lock-free fifo */
 };
 
 /**
@@ -681,6 +725,8 @@ int osip_nict_set_destination(osip_nict_t *nict, char *destination, int port);
 
 /**
  * Add a SIP event in the fifo of a osip_transaction_t element.
+ * The transaction is then visited by the next osip_*_execute call
+ * (an event added with osip_fifo_add in transactionff is handled the same way).
  * @param transaction The element to work on.
  * @param evt The event to add.
  */
@@ -848,6 +894,84 @@ int osip_transaction_set_out_socket(osip_transaction_t *transaction, int sock);
  * @param osip the element to allocate.
  */
 int osip_init(osip_t **osip);
+/**
+ * Allocate an osip_t element split in several shards.
+ * Transactions and retransmissions are dispatched in the shards using a
+ * hash of the Call-ID: each shard has its own lists, indexes, timers and
+ * mutexes. The returned element can be used as a regular osip_t element,
+ * or each shard (see osip_get_shard) can be driven by its own thread
+ * with osip_*_execute and osip_timers_*_execute.
+ * Callbacks and application context set on the returned element are
+ * applied to all shards.
+ * @param osip the element to allocate.
+ * @param nb_shards the number of shards.
+ */
+int osip_init_sharded(osip_t **osip, int nb_shards);
+/**
+ * Get the number of shards of an osip_t element. (0 when not sharded)
+ * @param osip The element to work on.
+ */
+int osip_get_shard_count(osip_t *osip);
+/**
+ * Get a shard of an osip_t element.
+ * @param osip The element to work on.
+ * @param index The index of the shard.
+ */
+osip_t *osip_get_shard(osip_t *osip, int index);
+/**
+ * Get the shard in charge of a SIP message (based on its Call-ID).
+ * The osip_t element itself is returned when it is not sharded.
+ * @param osip The element to work on.
+ * @param sip The SIP message.
+ */
+osip_t *osip_select_shard(osip_t *osip, osip_message_t *sip);
+
+#ifndef OSIP_MONOTHREAD
+/**
+ * Structure for an executor: a pool of threads processing the events
+ * of transactions.
+ * @var osip_executor_t
+ */
+typedef struct osip_executor osip_executor_t;
+
+/**
+ * Allocate an executor and start its threads.
+ * Once started, events added with osip_transaction_add_event are
+ * processed by the threads of the executor: osip_*_execute must not
+ * be used anymore. Events of one transaction are never processed
+ * concurrently, while different transactions are processed in parallel.
+ * Each thread has its own queue and takes work from the queues of
+ * the other threads when its own queue is empty.
+ * Timers are still checked by the application with osip_timers_*_execute.
+ * Callbacks are called from the threads of the executor.
+ * A transaction freed while processed by the executor is released
+ * once processing is over.
+ * The executor must be freed before the osip_t element.
+ * @param executor The element to allocate.
+ * @param osip The element to work on.
+ * @param nb_workers The number of threads.
+ */
+int osip_executor_init(osip_executor_t **executor, osip_t *osip, int nb_workers);
+/**
+ * Stop the threads of an executor and free it.
+ * Pending events are kept in transactions: osip_*_execute can be
+ * used again.
+ * @param executor The element to free.
+ */
+void osip_executor_free(osip_executor_t *executor);
+/**
+ * Create sipevents from a batch of SIP message strings like
+ * osip_parse_batch, with the threads of the executor helping the
+ * calling thread. Returns once all messages are parsed.
+ * Returns the number of events created or a negative error code.
+ * @param executor The element to work on.
+ * @param bufs The SIP messages as strings.
+ * @param lengths The lengths of the SIP messages.
+ * @param count The number of SIP messages.
+ * @param events The resulting events (count elements).
+ */
+int osip_executor_parse_batch(osip_executor_t *executor, const char *const *bufs, const size_t *lengths, int count, osip_event_t **events);
+#endif
 /**
  * Free all resource in a osip_t element.
  * @param osip The element to release.
@@ -972,6 +1096,19 @@ osip_transaction_t *osip_create_transaction(osip_t *osip, osip_event_t *evt);
  * @param length The length of the buffer to parse.
  */
 osip_event_t *osip_parse(const char *buf, size_t length);
+/**
+ * Create sipevents from a batch of SIP message strings (ie: datagrams
+ * received with recvmmsg). One work buffer is used for the whole batch.
+ * Messages are parsed like with osip_parse() and osip_message_parse():
+ * the received message is not kept (see osip_message_parse_with_wire()).
+ * events[i] is set to NULL when bufs[i] cannot be parsed.
+ * Returns the number of events created or a negative error code.
+ * @param bufs The SIP messages as strings.
+ * @param lengths The lengths of the SIP messages.
+ * @param count The number of SIP messages.
+ * @param events The resulting events (count elements).
+ */
+int osip_parse_batch(const char *const *bufs, const size_t *lengths, int count, osip_event_t **events);
 
 /**
  * Send required retransmissions
@@ -1029,6 +1166,8 @@ void osip_event_free(osip_event_t *event);
 
 /**
  * Register the callback used to send SIP message.
+ * Retransmissions give the same (unmodified) message again: the callback
+ * can send it with osip_message_get_wire() to avoid building or copying it.
  * @param cf The osip element attached to the transaction.
  * @param cb The method we want to register.
  */
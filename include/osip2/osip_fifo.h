@@ -30,7 +30,7 @@
  * @brief oSIP fifo Routines
  *
  * This is a very simple implementation of a fifo.
- * <BR>There is not much to say about it...
+ * <BR>Elements are kept in a circular buffer which grows when needed.
  */
 
 /**
@@ -63,10 +63,21 @@ struct osip_fifo {
 #ifndef OSIP_MONOTHREAD
   struct osip_mutex *qislocked; /**< mutex for fifo */
   struct osip_sem *qisempty;    /**< semaphore for fifo */
+  int nb_waiters;               /**< nb of threads blocked in osip_fifo_get */
 #endif
-  osip_list_t queue;     /**< list of nodes containing elements */
+  void **elements;       /**< circular buffer of elements */
+  int size;              /**< size of the buffer (a power of 2) */
+  int first;             /**< position of the first element */
   int nb_elt;            /**< nb of elements */
   osip_fifo_state state; /**< state of the fifo */
+
+  int link_offset; /**< offset of the link in elements (-1 when not lock-free) */
+  void *head;      /**< (lock-free) link of the last element added */
+  void *tail;      /**< (lock-free) link of the next element to get */
+  void *stub;      /**< (lock-free) link used when the fifo is empty */
+
+  void (*notify)(void *arg); /**< (internal) called after an element is added */
+  void *notify_arg;          /**< (internal) argument of notify */
 };
 
 /**
@@ -79,6 +90,18 @@ struct osip_fifo {
  * @param ff The element to initialise.
  */
 void osip_fifo_init(osip_fifo_t *ff);
+/**
+ * Initialise a osip_fifo_t element in lock-free mode.
+ * Elements are linked without allocation using a void * member located
+ * at link_offset in each element: an element can only be in one such
+ * fifo at a time. Any thread may add elements, but only one thread at a
+ * time may get them. osip_fifo_insert is not available in this mode.
+ * When the library is built without lock-free support (--enable-lockfree),
+ * this is the same as osip_fifo_init.
+ * @param ff The element to initialise.
+ * @param link_offset The offset of the link member in elements.
+ */
+void osip_fifo_init_lockfree(osip_fifo_t *ff, int link_offset);
 /**
  * Free a fifo element.
  * @param ff The element to work on.
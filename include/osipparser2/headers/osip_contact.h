@@ -67,6 +67,14 @@ int osip_contact_parse(osip_contact_t *header, const char *hvalue);
  * @param dest A pointer on the new allocated string.
  */
 int osip_contact_to_str(const osip_contact_t *header, char **dest);
+/**
+ * Write a string representation of a Contact element in a buffer (see osip_message_to_buf).
+ * @param header The element to work on.
+ * @param buf The buffer to write to, or NULL to get the length.
+ * @param cap The size of buf.
+ * @param len The length of the string.
+ */
+int osip_contact_to_buf(const osip_contact_t *header, char *buf, size_t cap, size_t *len);
 #ifndef MINISIZE
 /**
  * Clone a Contact element.
@@ -75,6 +75,14 @@ int osip_content_type_parse(osip_content_type_t *header, const char *hvalue);
  * @param dest A pointer on the new allocated string.
  */
 int osip_content_type_to_str(const osip_content_type_t *header, char **dest);
+/**
+ * Write a string representation of a Content-Type element in a buffer (see osip_message_to_buf).
+ * @param header The element to work on.
+ * @param buf The buffer to write to, or NULL to get the length.
+ * @param cap The size of buf.
+ * @param len The length of the string.
+ */
+int osip_content_type_to_buf(const osip_content_type_t *header, char *buf, size_t cap, size_t *len);
 /**
  * Clone a Content-Type element.
  * @param header The element to work on.
@@ -82,6 +82,14 @@ void osip_header_free(osip_header_t *header);
  * @param dest A pointer on the new allocated buffer.
  */
 int osip_header_to_str(const osip_header_t *header, char **dest);
+/**
+ * Write a string representation of a header element in a buffer (see osip_message_to_buf).
+ * @param header The element to work on.
+ * @param buf The buffer to write to, or NULL to get the length.
+ * @param cap The size of buf.
+ * @param len The length of the string.
+ */
+int osip_header_to_buf(const osip_header_t *header, char *buf, size_t cap, size_t *len);
 /**
  * Get the token name a header element.
  * @param header The element to work on.
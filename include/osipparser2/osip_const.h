@@ -84,6 +84,34 @@
 #define WARNING "warning"
 #define WWW_AUTHENTICATE "www-authenticate"
 
+/* known headers for osip_message_parse_with_mask() */
+#define OSIP_HEADER_MASK_ACCEPT 0x00000001
+#define OSIP_HEADER_MASK_ACCEPT_ENCODING 0x00000002
+#define OSIP_HEADER_MASK_ACCEPT_LANGUAGE 0x00000004
+#define OSIP_HEADER_MASK_ALERT_INFO 0x00000008
+#define OSIP_HEADER_MASK_ALLOW 0x00000010
+#define OSIP_HEADER_MASK_AUTHENTICATION_INFO 0x00000020
+#define OSIP_HEADER_MASK_AUTHORIZATION 0x00000040
+#define OSIP_HEADER_MASK_CALL_ID 0x00000080
+#define OSIP_HEADER_MASK_CALL_INFO 0x00000100
+#define OSIP_HEADER_MASK_CONTACT 0x00000200
+#define OSIP_HEADER_MASK_CONTENT_ENCODING 0x00000400
+#define OSIP_HEADER_MASK_CONTENT_LENGTH 0x00000800
+#define OSIP_HEADER_MASK_CONTENT_TYPE 0x00001000
+#define OSIP_HEADER_MASK_CSEQ 0x00002000
+#define OSIP_HEADER_MASK_ERROR_INFO 0x00004000
+#define OSIP_HEADER_MASK_FROM 0x00008000
+#define OSIP_HEADER_MASK_MIME_VERSION 0x00010000
+#define OSIP_HEADER_MASK_PROXY_AUTHENTICATE 0x00020000
+#define OSIP_HEADER_MASK_PROXY_AUTHENTICATION_INFO 0x00040000
+#define OSIP_HEADER_MASK_PROXY_AUTHORIZATION 0x00080000
+#define OSIP_HEADER_MASK_RECORD_ROUTE 0x00100000
+#define OSIP_HEADER_MASK_ROUTE 0x00200000
+#define OSIP_HEADER_MASK_TO 0x00400000
+#define OSIP_HEADER_MASK_VIA 0x00800000
+#define OSIP_HEADER_MASK_WWW_AUTHENTICATE 0x01000000
+#define OSIP_HEADER_MASK_ALL 0xffffffff
+
 #define RESPONSE_CODES 51
 
 #define SIP_TRYING 100
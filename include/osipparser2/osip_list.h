@@ -28,7 +28,7 @@
  * @file osip_list.h
  * @brief oSIP list Routines
  *
- * This is a simple implementation of a linked list.
+ * This is a simple implementation of a list stored in an array.
  */
 
 /**
@@ -74,19 +74,28 @@ typedef struct osip_list_iterator osip_list_iterator_t;
  * @struct osip_list_iterator
  */
 struct osip_list_iterator {
-  __node_t *actual; /**< actual */
-  __node_t **prev;  /**< prev */
+  __node_t *actual; /**< not NULL while the iterator is valid */
+  __node_t **prev;  /**< unused */
   osip_list_t *li;  /**< li */
   int pos;          /**< pos */
 };
 
+/**
+ * Number of elements stored inside the osip_list_t structure.
+ */
+#define OSIP_LIST_INLINE_SIZE 4
+
 /**
  * Structure for referencing a list of elements.
+ * Elements are stored in an array: inside the structure for small
+ * lists and in an allocated array for larger ones.
  * @struct osip_list
  */
 struct osip_list {
-  int nb_elt;     /**< Number of element in the list */
-  __node_t *node; /**< Next node containing element  */
+  int nb_elt;                                   /**< Number of element in the list */
+  int size;                                     /**< (internal) size of the allocated array */
+  void **elements;                              /**< (internal) allocated array (NULL when inline_elements is used) */
+  void *inline_elements[OSIP_LIST_INLINE_SIZE]; /**< (internal) storage for small lists */
 };
 
 /**
@@ -106,6 +106,10 @@ struct osip_message {
   size_t message_length; /**< internal value */
 
   void *application_data; /**< can be used by upper layer*/
+
+  osip_list_t lazy_headers; /**< (internal) headers not parsed yet (see osip_message_parse_lazy) */
+  void *wire;               /**< (internal) received message (see osip_message_parse_with_wire) */
+  void *message_cache;      /**< (internal) shared copy of message (see osip_message_get_wire) */
 };
 
 #ifndef SIP_MESSAGE_MAX_LENGTH
@@ -146,8 +150,123 @@ int osip_message_parse(osip_message_t *sip, const char *buf, size_t length);
  * @param length The length of the buffer to parse.
  */
 int osip_message_parse_sipfrag(osip_message_t *sip, const char *buf, size_t length);
+/**
+ * Parse a osip_message_t element, leaving some headers unparsed.
+ * Headers used for routing and transaction matching (Via, Route,
+ * Record-Route, From, To, Call-ID, CSeq, Content-*) are parsed.
+ * Other known headers stored in lists (Contact, Authorization, Allow...)
+ * are parsed on first call to their accessor, osip_message_to_str(),
+ * osip_message_clone() or osip_message_parse_lazy_headers().
+ * Use osip_message_parse_lazy_headers() before accessing such lists directly.
+ * @param sip The resulting element.
+ * @param buf The buffer to parse.
+ * @param length The length of the buffer to parse.
+ */
+int osip_message_parse_lazy(osip_message_t *sip, const char *buf, size_t length);
+/**
+ * Parse all headers left unparsed by osip_message_parse_lazy().
+ * Invalid headers are removed and OSIP_SYNTAXERROR is returned.
+ * @param sip The element to work on.
+ */
+int osip_message_parse_lazy_headers(osip_message_t *sip);
+/**
+ * Parse a osip_message_t element, only decoding some known headers.
+ * Known headers outside the mask are stored as unknown headers (osip_header_t)
+ * and are available with osip_message_header_get_byname().
+ * Content-Length and Content-Type are always decoded to find the body.
+ * @param sip The resulting element.
+ * @param buf The buffer to parse.
+ * @param length The length of the buffer to parse.
+ * @param mask The headers to decode (OSIP_HEADER_MASK_* values).
+ */
+int osip_message_parse_with_mask(osip_message_t *sip, const char *buf, size_t length, unsigned int mask);
+/**
+ * Parse a osip_message_t element using a work buffer of the caller
+ * instead of allocating one. The work buffer can be reused for the next
+ * message once this call returns (it is allocated internally when smaller
+ * than length + 2 bytes).
+ * The message is parsed like with osip_message_parse(): the received
+ * message is not kept (see osip_message_parse_with_wire()).
+ * @param sip The resulting element.
+ * @param buf The buffer to parse.
+ * @param length The length of the buffer to parse.
+ * @param scratch The work buffer.
+ * @param scratch_size The size of the work buffer.
+ */
+int osip_message_parse_with_scratch(osip_message_t *sip, const char *buf, size_t length, char *scratch, size_t scratch_size);
+/**
+ * Parse a osip_message_t element and keep a copy of the received message:
+ * osip_message_to_iovec() then points to the received bytes of the headers
+ * left unchanged instead of writing them again.
+ * @param sip The resulting element.
+ * @param buf The buffer to parse.
+ * @param length The length of the buffer to parse.
+ * @param lazy Leave some headers unparsed, like osip_message_parse_lazy().
+ */
+int osip_message_parse_with_wire(osip_message_t *sip, const char *buf, size_t length, int lazy);
+
+/**
+ * Structure for a stream parser: it splits the bytes received on a
+ * stream transport (TCP, TLS...) into SIP messages using Content-Length.
+ * @var osip_stream_t
+ */
+typedef struct osip_stream osip_stream_t;
+
+/**
+ * Allocate a stream parser.
+ * At most max_size bytes are buffered: a message larger than max_size
+ * is reported as a syntax error.
+ * @param stream The element to allocate.
+ * @param max_size The size of the buffer (0 for SIP_MESSAGE_MAX_LENGTH).
+ */
+int osip_stream_init(osip_stream_t **stream, size_t max_size);
+/**
+ * Free a stream parser.
+ * @param stream The element to free.
+ */
+void osip_stream_free(osip_stream_t *stream);
+/**
+ * Append received bytes to a stream parser.
+ * Returns the number of bytes stored (less than length when the buffer
+ * is full: get the available messages and feed the remaining bytes again)
+ * or a negative error code.
+ * @param stream The element to work on.
+ * @param buf The received bytes.
+ * @param length The number of received bytes.
+ */
+int osip_stream_feed(osip_stream_t *stream, const char *buf, size_t length);
+/**
+ * Get the next complete message of a stream parser, without parsing it.
+ * The frame stays valid until the next call on the stream parser.
+ * Bytes already examined are never scanned again by later calls.
+ * Returns OSIP_NOTFOUND when more bytes are needed and OSIP_SYNTAXERROR
+ * when the stream cannot be framed anymore (the connection should be closed).
+ * @param stream The element to work on.
+ * @param frame The message (start line, headers and body).
+ * @param length The length of the message.
+ */
+int osip_stream_get_frame(osip_stream_t *stream, const char **frame, size_t *length);
+/**
+ * Get and parse the next complete message of a stream parser.
+ * Returns OSIP_NOTFOUND when more bytes are needed. When the message
+ * cannot be parsed, it is dropped and the parser error is returned.
+ * @param stream The element to work on.
+ * @param sip The new allocated message.
+ */
+int osip_stream_get_message(osip_stream_t *stream, osip_message_t **sip);
+/**
+ * Get the keep-alives (rfc5626) received between messages since the
+ * last call: a ping (CRLFCRLF) is expected to be answered with a pong (CRLF).
+ * @param stream The element to work on.
+ * @param pings The number of pings received.
+ * @param pongs The number of pongs received.
+ */
+int osip_stream_get_keepalive(osip_stream_t *stream, int *pings, int *pongs);
 /**
  * Get a string representation of a osip_message_t element.
+ * All headers are written again from the structures, even those left
+ * unchanged since parsing: see osip_message_to_iovec() to send the
+ * received bytes of unchanged headers.
  * NOTE: You need to release the sip buffer returned by this API when you
  * are done with the buffer. ie: osip_free(dest)
  * @param sip The element to work on.
@@ -155,6 +274,59 @@ int osip_message_parse_sipfrag(osip_message_t *sip, const char *buf, size_t leng
  * @param message_length The length of the returned buffer.
  */
 int osip_message_to_str(osip_message_t *sip, char **dest, size_t *message_length);
+/**
+ * Write the string representation of a osip_message_t element in a buffer.
+ * Unlike osip_message_to_str, the headers are written directly in buf and
+ * nothing is allocated. *len is the length of the message even when it
+ * does not fit: call it with a NULL buf to get the required size.
+ * Like osip_message_to_str, all headers are written from the structures.
+ * @param sip The element to work on.
+ * @param buf The buffer to write to (or NULL).
+ * @param cap The size of buf.
+ * @param len The length of the message, without the final NUL.
+ * @return OSIP_NOMEM when buf is too small.
+ */
+int osip_message_to_buf(osip_message_t *sip, char *buf, size_t cap, size_t *len);
+/**
+ * Get the string representation of a osip_message_t element without copy.
+ * A reference counted copy of the buffer kept by the message for
+ * osip_message_to_str is made once and shared with the callers until the
+ * message changes: a retransmission of an unmodified message costs no
+ * allocation. The buffer stays valid (and unchanged) after the message
+ * is modified or released, until osip_message_release_wire is called.
+ * @param sip The element to work on.
+ * @param wire The NUL terminated message (read only).
+ * @param length The length of the message.
+ */
+int osip_message_get_wire(osip_message_t *sip, const char **wire, size_t *length);
+/**
+ * Release a buffer returned by osip_message_get_wire.
+ * @param wire The buffer to release.
+ */
+void osip_message_release_wire(const char *wire);
+#if !defined(WIN32) && !defined(_WIN32_WCE)
+struct iovec;
+/**
+ * Get a message as a list of buffers for writev() or sendmsg().
+ * The bodies point to their content. The headers of a message parsed with
+ * osip_message_parse_with_wire() that are still stored in the message point
+ * to the received bytes: only the start line, the headers added since
+ * parsing and Content-Length are written in buf. For other messages, all
+ * headers are written in buf.
+ * A header modified in place, or released and replaced by a new one,
+ * must be reported with osip_message_force_update_header() (or with
+ * osip_message_force_update() to write all headers from the structure).
+ * (osip_message_fix_last_via_header() takes care of the Via it modifies).
+ * The buffers are valid until the message or buf is modified or released.
+ * @param sip The element to work on.
+ * @param iov The buffers to fill.
+ * @param iovcnt The number of elements of iov, set to the number of buffers used.
+ * @param buf The buffer for the headers written from the structure.
+ * @param cap The size of buf.
+ * @return OSIP_NOMEM when iov or buf is too small.
+ */
+int osip_message_to_iovec(osip_message_t *sip, struct iovec *iov, int *iovcnt, char *buf, size_t cap);
+#endif
 /**
  * Get a string representation of a message/sipfrag part
  * stored in an osip_message_t element.
@@ -171,6 +343,20 @@ int osip_message_to_str_sipfrag(osip_message_t *sip, char **dest, size_t *messag
  * @param dest The new allocated element cloned.
  */
 int osip_message_clone(const osip_message_t *sip, osip_message_t **dest);
+/**
+ * Clone a osip_message_t element parsed with osip_message_parse_with_wire().
+ * The clone shares the received message: osip_message_to_iovec() points
+ * to the received bytes of its headers left unchanged. Like for the
+ * original message, a header of the clone modified in place must be
+ * reported with osip_message_force_update_header().
+ * NOTE: the headers are still deep copied like with osip_message_clone(),
+ * so this costs slightly more than osip_message_clone(). To clone with
+ * fewer allocations, clone while an arena is current (see
+ * osip_arena_set_current()).
+ * @param sip The element to clone.
+ * @param dest The new allocated element cloned.
+ */
+int osip_message_clone_with_wire(const osip_message_t *sip, osip_message_t **dest);
 
 /**
  * Set the reason phrase. This is entirely free in SIP.
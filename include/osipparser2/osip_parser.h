@@ -97,10 +97,22 @@ int osip_message_get__property(const osip_message_t *sip);
 
 /**
  * Force a osip_message_t element to be rebuild on next osip_message_to_str() call.
+ * osip_message_to_iovec() also writes all headers again from the structure:
+ * use osip_message_force_update_header() when only some headers changed.
  * @param sip The element to work on.
  */
 int osip_message_force_update(osip_message_t *sip);
 
+/**
+ * Report a header modified in place (or removed) in a message parsed with
+ * osip_message_parse_with_wire(): osip_message_to_iovec() writes this
+ * header from the structure and keeps the received line of the others.
+ * osip_message_to_str() is also rebuilt, like after osip_message_force_update().
+ * @param sip The element to work on.
+ * @param header The header (osip_via_t, osip_header_t...) that changed.
+ */
+int osip_message_force_update_header(osip_message_t *sip, const void *header);
+
 /**
  * Get the usual reason phrase as defined in SIP for a specific status code.
  * @param status_code A status code.
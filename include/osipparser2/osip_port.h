@@ -73,6 +73,36 @@ extern osip_realloc_func_t *osip_realloc_func;
 extern osip_free_func_t *osip_free_func;
 
 void osip_set_allocators(osip_malloc_func_t *malloc_func, osip_realloc_func_t *realloc_func, osip_free_func_t *free_func);
+
+/* Arena (bump) allocation of messages.
+
+   osip_set_arena_allocators() installs allocators that wrap the current
+   ones (default or set with osip_set_allocators()). Like
+   osip_set_allocators(), it must be called before any other oSIP call.
+
+   While an arena is current for a thread, osip_malloc() allocates from
+   it and osip_free() of such memory does nothing: the memory is released
+   with the arena. A message created by osip_message_init() while an
+   arena is current holds a reference on it and osip_message_free()
+   drops it:
+
+     osip_arena_init(&arena, 0);
+     prev = osip_arena_set_current(arena);
+     osip_message_init(&sip);
+     osip_message_parse(sip, buf, length);
+     osip_arena_set_current(prev);
+     osip_arena_free(arena);
+     ...
+     osip_message_free(sip);   <- releases the whole arena
+
+   An arena must not be used by several threads at the same time.
+*/
+typedef struct osip_arena osip_arena_t;
+
+void osip_set_arena_allocators(void);
+int osip_arena_init(osip_arena_t **arena, size_t chunk_size);
+void osip_arena_free(osip_arena_t *arena);
+osip_arena_t *osip_arena_set_current(osip_arena_t *arena);
 #endif
 
 #ifdef DEBUG_MEM
@@ -171,6 +201,11 @@ void osip_free(void *);
 #define alloca _alloca
 #endif
 
+/* arena owning a block returned by osip_malloc() (NULL for the heap) */
+void *__osip_arena_get(const void *ptr);
+void __osip_arena_ref(void *arena);
+void __osip_arena_unref(void *arena);
+
 /**************************/
 /* RANDOM number support  */
 /**************************/
@@ -214,6 +214,14 @@ int osip_uri_parse_params(osip_uri_t *url, const char *buf);
  * @param dest The resulting new allocated buffer.
  */
 int osip_uri_to_str(const osip_uri_t *url, char **dest);
+/**
+ * Write a string representation of a url element in a buffer (see osip_message_to_buf).
+ * @param url The element to work on.
+ * @param buf The buffer to write to, or NULL to get the length.
+ * @param cap The size of buf.
+ * @param len The length of the string.
+ */
+int osip_uri_to_buf(const osip_uri_t *url, char *buf, size_t cap, size_t *len);
 /**
  * Clone a url element.
  * @param url The element to work on.
@@ -29,8 +29,15 @@
 
 typedef struct osip_statemachine osip_statemachine_t;
 
+/* dimensions of the dispatch table: states of dialogs are not used */
+#define OSIP_FSM_NB_STATES DIALOG_EARLY
+#define OSIP_FSM_NB_TYPES UNKNOWN_EVT
+
 struct osip_statemachine {
   struct _transition_t *transitions;
+  /* dispatch table built from transitions by fsm_load_statemachines */
+  void (*methods[OSIP_FSM_NB_STATES][OSIP_FSM_NB_TYPES])(void *, void *);
+  int loaded;
 };
 
 /**
@@ -56,6 +63,8 @@ struct _transition_t {
 };
 
 int fsm_callmethod(type_t type, state_t state, osip_statemachine_t *statemachine, void *sipevent, void *transaction);
+/* build the dispatch tables of ict, ist, nict and nist statemachines */
+void fsm_load_statemachines(void);
 
 /*!! THESE ARE FOR INTERNAL USE ONLY!! */
 /* These methods are the "exection method" for the finite */
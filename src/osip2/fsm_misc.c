@@ -22,6 +22,11 @@
 #include <osip2/osip.h>
 #include "fsm.h"
 
+extern osip_statemachine_t ict_fsm;
+extern osip_statemachine_t ist_fsm;
+extern osip_statemachine_t nict_fsm;
+extern osip_statemachine_t nist_fsm;
+
 static transition_t *fsm_findmethod(type_t type, state_t state, osip_statemachine_t *statemachine);
 
 /* find the transition for state and type in statemachine */
@@ -37,11 +42,48 @@ static transition_t *fsm_findmethod(type_t type, state_t state, osip_statemachin
   return NULL;
 }
 
+/* the first transition found for a state and type is kept, as with
+   fsm_findmethod */
+static void fsm_load_statemachine(osip_statemachine_t *statemachine) {
+  transition_t *transition;
+
+  if (statemachine->loaded != 0)
+    return;
+
+  for (transition = statemachine->transitions; transition != NULL; transition = transition->next) {
+    if ((int) transition->state < 0 || transition->state >= OSIP_FSM_NB_STATES || (int) transition->type < 0 || transition->type >= OSIP_FSM_NB_TYPES)
+      continue;
+
+    if (statemachine->methods[transition->state][transition->type] == NULL)
+      statemachine->methods[transition->state][transition->type] = transition->method;
+  }
+
+  statemachine->loaded = 1;
+}
+
+void fsm_load_statemachines(void) {
+  fsm_load_statemachine(&ict_fsm);
+  fsm_load_statemachine(&ist_fsm);
+  fsm_load_statemachine(&nict_fsm);
+  fsm_load_statemachine(&nist_fsm);
+}
+
 /* call the right execution method.          */
 /*   return -1 when event must be discarded  */
 int fsm_callmethod(type_t type, state_t state, osip_statemachine_t *statemachine, void *sipevent, void *transaction) {
   transition_t *transition;
 
+  if (statemachine->loaded != 0) {
+    if ((int) state < 0 || state >= OSIP_FSM_NB_STATES || (int) type < 0 || type >= OSIP_FSM_NB_TYPES)
+      return OSIP_UNDEFINED_ERROR;
+
+    if (statemachine->methods[state][type] == NULL)
+      return OSIP_UNDEFINED_ERROR; /* No transition found for this event */
+
+    statemachine->methods[state][type](transaction, sipevent);
+    return OSIP_SUCCESS;
+  }
+
   transition = fsm_findmethod(type, state, statemachine);
 
   if (transition == NULL) {
@@ -35,7 +35,7 @@ transition_t ict_transition[11] = {{ICT_PRE_CALLING, SND_REQINVITE, (void (*)(vo
                                    {ICT_COMPLETED, RCV_STATUS_3456XX, (void (*)(void *, void *)) & ict_retransmit_ack, &ict_transition[10], NULL},
                                    {ICT_COMPLETED, TIMEOUT_D, (void (*)(void *, void *)) & osip_ict_timeout_d_event, NULL, NULL}};
 
-osip_statemachine_t ict_fsm = {ict_transition};
+osip_statemachine_t ict_fsm = {ict_transition, {{NULL}}, 0};
 
 static void ict_handle_transport_error(osip_transaction_t *ict, int err) {
   __osip_transport_error_callback(OSIP_ICT_TRANSPORT_ERROR, ict, err);
@@ -103,6 +103,7 @@ void osip_ict_timeout_a_event(osip_transaction_t *ict, osip_event_t *evt) {
   ict->ict_context->timer_a_length = ict->ict_context->timer_a_length * 2;
   osip_gettimeofday(&ict->ict_context->timer_a_start, NULL);
   add_gettimeofday(&ict->ict_context->timer_a_start, ict->ict_context->timer_a_length);
+  __osip_transaction_update_timers(ict);
 
   /* retransmit REQUEST */
   i = osip->cb_send_message(ict, ict->orig_request, ict->ict_context->destination, ict->ict_context->port, ict->out_socket);
@@ -303,6 +304,9 @@ osip_message_t *ict_create_ack(osip_transaction_t *ict, osip_message_t *response
   }
 
   if (response->status_code != 401 && response->status_code != 407) {
+    /* headers of the original request may have been left unparsed */
+    osip_message_parse_lazy_headers(ict->orig_request);
+
     /* ack MUST contains the Authorization headers field from the original request */
     if (osip_list_size(&ict->orig_request->authorizations) > 0) {
       i = osip_list_clone(&ict->orig_request->authorizations, &ack->authorizations, (int (*)(void *, void **)) & osip_authorization_clone);
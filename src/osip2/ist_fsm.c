@@ -34,7 +34,7 @@ transition_t ist_transition[11] = {{IST_PRE_PROCEEDING, RCV_REQINVITE, (void (*)
                                    {IST_CONFIRMED, RCV_REQACK, (void (*)(void *, void *)) & ist_rcv_ack, &ist_transition[10], NULL},
                                    {IST_CONFIRMED, TIMEOUT_I, (void (*)(void *, void *)) & osip_ist_timeout_i_event, NULL, NULL}};
 
-osip_statemachine_t ist_fsm = {ist_transition};
+osip_statemachine_t ist_fsm = {ist_transition, {{NULL}}, 0};
 
 static void ist_handle_transport_error(osip_transaction_t *ist, int err) {
   __osip_transport_error_callback(OSIP_IST_TRANSPORT_ERROR, ist, err);
@@ -95,6 +95,7 @@ void osip_ist_timeout_g_event(osip_transaction_t *ist, osip_event_t *evt) {
 
   osip_gettimeofday(&ist->ist_context->timer_g_start, NULL);
   add_gettimeofday(&ist->ist_context->timer_g_start, ist->ist_context->timer_g_length);
+  __osip_transaction_update_timers(ist);
 
   i = __osip_transaction_snd_xxx(ist, ist->last_response);
 
@@ -30,7 +30,7 @@ transition_t nict_transition[12] = {
     {NICT_PROCEEDING, RCV_STATUS_1XX, (void (*)(void *, void *)) & nict_rcv_1xx, &nict_transition[9], NULL},         {NICT_PROCEEDING, RCV_STATUS_2XX, (void (*)(void *, void *)) & nict_rcv_23456xx, &nict_transition[10], NULL},
     {NICT_PROCEEDING, RCV_STATUS_3456XX, (void (*)(void *, void *)) & nict_rcv_23456xx, &nict_transition[11], NULL}, {NICT_COMPLETED, TIMEOUT_K, (void (*)(void *, void *)) & osip_nict_timeout_k_event, NULL, NULL}};
 
-osip_statemachine_t nict_fsm = {nict_transition};
+osip_statemachine_t nict_fsm = {nict_transition, {{NULL}}, 0};
 
 static void nict_handle_transport_error(osip_transaction_t *nict, int err) {
   __osip_transport_error_callback(OSIP_NICT_TRANSPORT_ERROR, nict, err);
@@ -146,6 +146,7 @@ void osip_nict_timeout_e_event(osip_transaction_t *nict, osip_event_t *evt) {
 
   osip_gettimeofday(&nict->nict_context->timer_e_start, NULL);
   add_gettimeofday(&nict->nict_context->timer_e_start, nict->nict_context->timer_e_length);
+  __osip_transaction_update_timers(nict);
 
   /* retransmit REQUEST */
   i = osip->cb_send_message(nict, nict->orig_request, nict->nict_context->destination, nict->nict_context->port, nict->out_socket);
@@ -29,7 +29,7 @@ transition_t nist_transition[10] = {
     {NIST_PROCEEDING, SND_STATUS_3456XX, (void (*)(void *, void *)) & nist_snd_23456xx, &nist_transition[7], NULL}, {NIST_PROCEEDING, RCV_REQUEST, (void (*)(void *, void *)) & nist_rcv_request, &nist_transition[8], NULL},
     {NIST_COMPLETED, TIMEOUT_J, (void (*)(void *, void *)) & osip_nist_timeout_j_event, &nist_transition[9], NULL}, {NIST_COMPLETED, RCV_REQUEST, (void (*)(void *, void *)) & nist_rcv_request, NULL, NULL}};
 
-osip_statemachine_t nist_fsm = {nist_transition};
+osip_statemachine_t nist_fsm = {nist_transition, {{NULL}}, 0};
 
 static void nist_handle_transport_error(osip_transaction_t *nist, int err) {
   __osip_transport_error_callback(OSIP_NIST_TRANSPORT_ERROR, nist, err);
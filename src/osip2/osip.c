@@ -25,9 +25,8 @@
 
 #include <osip2/osip_dialog.h>
 
-#if defined(HAVE_DICT_DICT_H)
-#include <dict/dict.h>
-#endif
+/* initial value of the hash keys of indexes */
+#define OSIP_INDEX_SEED 5381UL
 
 void osip_response_get_destination(osip_message_t *response, char **address, int *portnum) {
   osip_via_t *via;
@@ -117,11 +116,83 @@ int osip_id_mutex_unlock(osip_t *osip) {
 #endif
 }
 
+/* a sharded osip_t only dispatches the work to its shards */
+static int __osip_shards_execute(osip_t *osip, int (*execute)(osip_t *)) {
+  int res = OSIP_SUCCESS;
+  int i;
+
+  for (i = 0; i < osip->nb_shards; i++) {
+    int j = execute(osip->shards[i]);
+
+    if (j != OSIP_SUCCESS)
+      res = j;
+  }
+
+  return res;
+}
+
+static void __osip_shards_run(osip_t *osip, void (*run)(osip_t *)) {
+  int i;
+
+  for (i = 0; i < osip->nb_shards; i++)
+    run(osip->shards[i]);
+}
+
 /* these are for transactions that would need retransmission not handled by state machines */
+
+/* ixt elements are scheduled in a timer wheel and referenced in an index
+   with the address of their dialog and, for 2xx, with the Call-ID and
+   CSeq number matched by the ACK. */
+
+static unsigned long __osip_ixt_dialog_key(osip_dialog_t *dialog) {
+  return __osip_index_hash(OSIP_INDEX_SEED, "dialog") + (unsigned long) (size_t) dialog;
+}
+
+static unsigned long __osip_ixt_ack_key(osip_call_id_t *callid, osip_cseq_t *cseq) {
+  unsigned long key;
+
+  key = __osip_index_hash(OSIP_INDEX_SEED, "ixt");
+  key = __osip_index_hash(key, callid->number);
+  return __osip_index_hash(key, cseq->number);
+}
+
+static int __osip_ixt_has_ack_key(osip_message_t *sip) {
+  return (sip != NULL && sip->call_id != NULL && sip->call_id->number != NULL && sip->cseq != NULL && sip->cseq->number != NULL);
+}
+
+/* must be called with ixt_fastmutex */
+static void osip_remove_ixt(osip_t *osip, ixt_t *ixt) {
+  __osip_wheel_remove((osip_wheel_t *) osip->osip_ixt_timers, &ixt->timer_entry);
+  __osip_index_remove((osip_index_t *) osip->osip_ixt_index, __osip_ixt_dialog_key(ixt->dialog), ixt);
+
+  if (__osip_ixt_has_ack_key(ixt->msg2xx))
+    __osip_index_remove((osip_index_t *) osip->osip_ixt_index, __osip_ixt_ack_key(ixt->msg2xx->call_id, ixt->msg2xx->cseq), ixt);
+}
+
+static void ixt_free(ixt_t *ixt);
+
 static void osip_add_ixt(osip_t *osip, ixt_t *ixt) {
-  /* add in list osip_t->ixt */
+  int i;
+
   osip_ixt_lock(osip);
-  osip_list_add(&osip->ixt_retransmissions, (void *) ixt, 0);
+  i = __osip_index_add((osip_index_t *) osip->osip_ixt_index, __osip_ixt_dialog_key(ixt->dialog), ixt);
+
+  if (i == OSIP_SUCCESS && __osip_ixt_has_ack_key(ixt->msg2xx)) {
+    i = __osip_index_add((osip_index_t *) osip->osip_ixt_index, __osip_ixt_ack_key(ixt->msg2xx->call_id, ixt->msg2xx->cseq), ixt);
+
+    if (i != OSIP_SUCCESS)
+      __osip_index_remove((osip_index_t *) osip->osip_ixt_index, __osip_ixt_dialog_key(ixt->dialog), ixt);
+  }
+
+  if (i != OSIP_SUCCESS) {
+    osip_ixt_unlock(osip);
+    OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL, "cannot add retransmission context\n"));
+    ixt_free(ixt);
+    return;
+  }
+
+  ixt->timer_entry.element = ixt;
+  __osip_wheel_add((osip_wheel_t *) osip->osip_ixt_timers, &ixt->timer_entry, &ixt->start);
   osip_ixt_unlock(osip);
 }
 
@@ -143,6 +214,7 @@ static int ixt_init(ixt_t **ixt) {
   pixt->dest = NULL;
   pixt->port = 5060;
   pixt->sock = -1;
+  memset(&pixt->timer_entry, 0, sizeof(osip_timer_entry_t));
   return OSIP_SUCCESS;
 }
 
@@ -158,6 +230,8 @@ void osip_start_200ok_retransmissions(osip_t *osip, osip_dialog_t *dialog, osip_
   int i;
   ixt_t *ixt;
 
+  osip = osip_select_shard(osip, msg200ok);
+
   i = ixt_init(&ixt);
 
   if (i != 0)
@@ -174,6 +248,8 @@ void osip_start_ack_retransmissions(osip_t *osip, osip_dialog_t *dialog, osip_me
   int i;
   ixt_t *ixt;
 
+  osip = osip_select_shard(osip, ack);
+
   i = ixt_init(&ixt);
 
   if (i != 0)
@@ -190,22 +266,24 @@ void osip_start_ack_retransmissions(osip_t *osip, osip_dialog_t *dialog, osip_me
 /* we stop the 200ok when receiving the corresponding ack */
 struct osip_dialog *osip_stop_200ok_retransmissions(osip_t *osip, osip_message_t *ack) {
   osip_dialog_t *dialog = NULL;
-  int i;
   ixt_t *ixt;
+  unsigned long key;
+  int pos = -1;
 
-  if (ack == NULL || ack->cseq == NULL || ack->cseq->number == NULL)
+  if (!__osip_ixt_has_ack_key(ack))
     return NULL;
 
-  osip_ixt_lock(osip);
+  osip = osip_select_shard(osip, ack);
+  key = __osip_ixt_ack_key(ack->call_id, ack->cseq);
 
-  for (i = 0; !osip_list_eol(&osip->ixt_retransmissions, i); i++) {
-    ixt = (ixt_t *) osip_list_get(&osip->ixt_retransmissions, i);
+  osip_ixt_lock(osip);
 
+  while ((ixt = (ixt_t *) __osip_index_find((osip_index_t *) osip->osip_ixt_index, key, &pos)) != NULL) {
     if (ixt->msg2xx == NULL || ixt->msg2xx->cseq == NULL || ixt->msg2xx->cseq->number == NULL)
       continue;
 
     if (osip_dialog_match_as_uas(ixt->dialog, ack) == 0 && strcmp(ixt->msg2xx->cseq->number, ack->cseq->number) == 0) {
-      osip_list_remove(&osip->ixt_retransmissions, i);
+      osip_remove_ixt(osip, ixt);
       dialog = ixt->dialog;
       ixt_free(ixt);
       break;
@@ -221,16 +299,18 @@ struct osip_dialog *osip_stop_200ok_retransmissions(osip_t *osip, osip_message_t
 void osip_stop_retransmissions_from_dialog(osip_t *osip, osip_dialog_t *dialog) {
   int i;
   ixt_t *ixt;
+  unsigned long key = __osip_ixt_dialog_key(dialog);
+  int pos = -1;
 
-  osip_ixt_lock(osip);
+  for (i = 0; i < osip->nb_shards; i++)
+    osip_stop_retransmissions_from_dialog(osip->shards[i], dialog);
 
-  for (i = 0; !osip_list_eol(&osip->ixt_retransmissions, i); i++) {
-    ixt = (ixt_t *) osip_list_get(&osip->ixt_retransmissions, i);
+  osip_ixt_lock(osip);
 
+  while ((ixt = (ixt_t *) __osip_index_find((osip_index_t *) osip->osip_ixt_index, key, &pos)) != NULL) {
     if (ixt->dialog == dialog) {
-      osip_list_remove(&osip->ixt_retransmissions, i);
+      osip_remove_ixt(osip, ixt);
       ixt_free(ixt);
-      i--;
     }
   }
 
@@ -257,24 +337,37 @@ static void ixt_retransmit(osip_t *osip, ixt_t *ixt, struct timeval *current) {
 }
 
 void osip_retransmissions_execute(osip_t *osip) {
-  int i;
+  osip_timer_entry_t *entry;
   ixt_t *ixt;
   struct timeval current;
 
+  if (osip->nb_shards > 0) {
+    __osip_shards_run(osip, osip_retransmissions_execute);
+    return;
+  }
+
   osip_gettimeofday(&current, NULL);
 
   osip_ixt_lock(osip);
 
-  for (i = 0; !osip_list_eol(&osip->ixt_retransmissions, i); i++) {
-    ixt = (ixt_t *) osip_list_get(&osip->ixt_retransmissions, i);
+  /* only ixt elements with an expired timer are checked */
+  entry = __osip_wheel_expire((osip_wheel_t *) osip->osip_ixt_timers, &current);
+
+  while (entry != NULL) {
+    osip_timer_entry_t *next = entry->next;
+
+    ixt = (ixt_t *) entry->element;
     ixt_retransmit(osip, ixt, &current);
 
     if (ixt->counter == 0) {
       /* remove it */
-      osip_list_remove(&osip->ixt_retransmissions, i);
+      osip_remove_ixt(osip, ixt);
       ixt_free(ixt);
-      i--;
-    }
+
+    } else
+      __osip_wheel_add((osip_wheel_t *) osip->osip_ixt_timers, entry, &ixt->start);
+
+    entry = next;
   }
 
   osip_ixt_unlock(osip);
@@ -344,345 +437,854 @@ int osip_nist_unlock(osip_t *osip) {
 #endif
 }
 
-#if defined(HAVE_DICT_DICT_H)
-#define HSIZE 200
+/* Each transaction is referenced in the index of its list with up to
+   three keys:
+   - its transactionid, for outgoing events.
+   - its branch and CSeq method, for rfc3261 compliant matching. For
+     server transactions, the branch is only used when it contains the
+     magic cookie and ACK is stored in the same class as INVITE.
+   - its Call-ID, CSeq number and CSeq method class, for the rfc2543
+     backward compatibility matching of server transactions.
+   Candidates found in an index are always checked with the complete
+   matching rules. */
+
+static const char *__osip_method_class(const char *method) {
+  if (method != NULL && 0 == strcmp(method, "ACK"))
+    return "INVITE";
+
+  return method;
+}
+
+static unsigned long __osip_transactionid_key(int transactionid) {
+  return __osip_index_hash(OSIP_INDEX_SEED, "transactionid") + (unsigned long) transactionid;
+}
 
-unsigned s_hash(const unsigned char *p);
+static unsigned long __osip_branch_key(const char *branch, const char *method) {
+  unsigned long key;
 
-unsigned s_hash(const unsigned char *p) {
-  unsigned hash = 0;
+  key = __osip_index_hash(OSIP_INDEX_SEED, "branch");
+  key = __osip_index_hash(key, branch);
+  return __osip_index_hash(key, method);
+}
 
-  while (*p) {
-    hash *= 31;
-    hash ^= *p++;
-  }
+static unsigned long __osip_call_id_key(osip_call_id_t *callid, osip_cseq_t *cseq) {
+  unsigned long key;
 
-  return hash;
+  key = __osip_index_hash(OSIP_INDEX_SEED, "call-id");
+  key = __osip_index_hash(key, callid->number);
+  key = __osip_index_hash(key, cseq->number);
+  return __osip_index_hash(key, __osip_method_class(cseq->method));
 }
-#endif
 
-int __osip_add_ict(osip_t *osip, osip_transaction_t *ict) {
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_lock(osip->ict_fastmutex);
-#endif
-#if defined(HAVE_DICT_DICT_H)
-  {
-    osip_generic_param_t *b_request = NULL;
-    int rv = -99;
+static int __osip_transaction_index_keys(osip_transaction_t *tr, unsigned long *keys) {
+  osip_generic_param_t *b_request = NULL;
+  int nb_keys = 0;
 
-    osip_via_param_get_byname(ict->topvia, "branch", &b_request);
+  keys[nb_keys++] = __osip_transactionid_key(tr->transactionid);
 
-    if (b_request != NULL && b_request->gvalue != NULL)
-      rv = dict_insert((dict *) osip->osip_ict_hastable, b_request->gvalue, (void *) ict, FALSE);
+  if (tr->cseq == NULL || tr->cseq->method == NULL)
+    return nb_keys;
 
-    if (rv == 0) {
-      OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL, "New key inserted in ict hastable `%s'\n", b_request->gvalue));
+  osip_via_param_get_byname(tr->topvia, "branch", &b_request);
 
-    } else if (rv != -99) {
-      OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_WARNING, NULL, "already inserted `%s'\n", b_request->gvalue));
-    }
+  if (b_request != NULL && b_request->gvalue != NULL) {
+    if (tr->ctx_type == ICT || tr->ctx_type == NICT)
+      keys[nb_keys++] = __osip_branch_key(b_request->gvalue, tr->cseq->method);
+
+    else if (0 == strncmp(b_request->gvalue, "z9hG4bK", 7))
+      keys[nb_keys++] = __osip_branch_key(b_request->gvalue, __osip_method_class(tr->cseq->method));
   }
-#endif
-  osip_list_add(&osip->osip_ict_transactions, ict, -1);
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock(osip->ict_fastmutex);
-#endif
-  return OSIP_SUCCESS;
+
+  if ((tr->ctx_type == IST || tr->ctx_type == NIST) && tr->callid != NULL && tr->callid->number != NULL && tr->cseq->number != NULL)
+    keys[nb_keys++] = __osip_call_id_key(tr->callid, tr->cseq);
+
+  return nb_keys;
 }
 
-int __osip_add_ist(osip_t *osip, osip_transaction_t *ist) {
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_lock(osip->ist_fastmutex);
-#endif
-#if defined(HAVE_DICT_DICT_H)
-  {
-    osip_generic_param_t *b_request = NULL;
-    int rv = -99;
+static int __osip_transaction_index_add(osip_index_t *index, osip_transaction_t *tr) {
+  unsigned long keys[3];
+  int nb_keys;
+  int pos;
+  int i;
 
-    osip_via_param_get_byname(ist->topvia, "branch", &b_request);
+  if (index == NULL)
+    return OSIP_SUCCESS;
+
+  nb_keys = __osip_transaction_index_keys(tr, keys);
 
-    if (b_request != NULL && b_request->gvalue != NULL)
-      rv = dict_insert((dict *) osip->osip_ist_hastable, b_request->gvalue, (void *) ist, FALSE);
+  for (pos = 0; pos < nb_keys; pos++) {
+    i = __osip_index_add(index, keys[pos], tr);
 
-    if (rv == 0) {
-      OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL, "New key inserted in ist hastable `%s'\n", b_request->gvalue));
+    if (i != OSIP_SUCCESS) {
+      while (pos > 0) {
+        pos--;
+        __osip_index_remove(index, keys[pos], tr);
+      }
 
-    } else if (rv != -99) {
-      OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_WARNING, NULL, "already inserted `%s'\n", b_request->gvalue));
+      return i;
     }
   }
-#endif
-  osip_list_add(&osip->osip_ist_transactions, ist, -1);
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock(osip->ist_fastmutex);
-#endif
+
   return OSIP_SUCCESS;
 }
 
-int __osip_add_nict(osip_t *osip, osip_transaction_t *nict) {
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_lock(osip->nict_fastmutex);
-#endif
-#if defined(HAVE_DICT_DICT_H)
-  {
-    osip_generic_param_t *b_request = NULL;
-    int rv = -99;
-
-    osip_via_param_get_byname(nict->topvia, "branch", &b_request);
+static void __osip_transaction_index_remove(osip_index_t *index, osip_transaction_t *tr) {
+  unsigned long keys[3];
+  int nb_keys;
+  int pos;
 
-    if (b_request != NULL && b_request->gvalue != NULL)
-      rv = dict_insert((dict *) osip->osip_nict_hastable, b_request->gvalue, (void *) nict, FALSE);
+  if (index == NULL)
+    return;
 
-    if (rv == 0) {
-      OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL, "New key inserted in nict hastable `%s'\n", b_request->gvalue));
+  nb_keys = __osip_transaction_index_keys(tr, keys);
 
-    } else if (rv != -99) {
-      OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_WARNING, NULL, "already inserted `%s'\n", b_request->gvalue));
-    }
-  }
-#endif
-  osip_list_add(&osip->osip_nict_transactions, nict, -1);
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock(osip->nict_fastmutex);
-#endif
-  return OSIP_SUCCESS;
+  for (pos = 0; pos < nb_keys; pos++)
+    __osip_index_remove(index, keys[pos], tr);
 }
 
-int __osip_add_nist(osip_t *osip, osip_transaction_t *nist) {
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_lock(osip->nist_fastmutex);
-#endif
-#if defined(HAVE_DICT_DICT_H)
-  {
-    osip_generic_param_t *b_request = NULL;
-    int rv = -99;
-
-    osip_via_param_get_byname(nist->topvia, "branch", &b_request);
+/* return OSIP_SUCCESS when the lookup could be done with the index
+   (*transaction is NULL if no transaction match). Otherwise, the
+   caller must fall back to a complete search. */
+static int __osip_transaction_index_find(osip_index_t *index, osip_event_t *evt, osip_transaction_t **transaction) {
+  osip_generic_param_t *b_request = NULL;
+  osip_via_t *topvia;
+  osip_message_t *sip = evt->sip;
+  int pos;
 
-    if (b_request != NULL && b_request->gvalue != NULL)
-      rv = dict_insert((dict *) osip->osip_nist_hastable, b_request->gvalue, (void *) nist, FALSE);
+  *transaction = NULL;
 
-    if (rv == 0) {
-      OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL, "New key inserted in ict hastable `%s'\n", b_request->gvalue));
+  if (!EVT_IS_INCOMINGMSG(evt)) {
+    pos = -1;
 
-    } else if (rv != -99) {
-      OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_WARNING, NULL, "already inserted `%s'\n", b_request->gvalue));
+    while ((*transaction = (osip_transaction_t *) __osip_index_find(index, __osip_transactionid_key(evt->transactionid), &pos)) != NULL) {
+      if ((*transaction)->transactionid == evt->transactionid)
+        return OSIP_SUCCESS;
     }
+
+    return OSIP_SUCCESS;
   }
-#endif
-  osip_list_add(&osip->osip_nist_transactions, nist, -1);
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock(osip->nist_fastmutex);
-#endif
-  return OSIP_SUCCESS;
-}
 
-int osip_remove_transaction(osip_t *osip, osip_transaction_t *tr) {
-  int i = -1;
+  if (sip == NULL || sip->cseq == NULL || sip->cseq->method == NULL)
+    return OSIP_BADPARAMETER;
 
-  if (tr == NULL)
+  topvia = osip_list_get(&sip->vias, 0);
+
+  if (topvia == NULL)
     return OSIP_BADPARAMETER;
 
-  if (tr->ctx_type == ICT)
-    i = __osip_remove_ict_transaction(osip, tr);
+  osip_via_param_get_byname(topvia, "branch", &b_request);
 
-  else if (tr->ctx_type == IST)
-    i = __osip_remove_ist_transaction(osip, tr);
+  if (EVT_IS_INCOMINGRESP(evt)) {
+    if (b_request == NULL || b_request->gvalue == NULL)
+      return OSIP_SYNTAXERROR;
 
-  else if (tr->ctx_type == NICT)
-    i = __osip_remove_nict_transaction(osip, tr);
+    pos = -1;
 
-  else if (tr->ctx_type == NIST)
-    i = __osip_remove_nist_transaction(osip, tr);
+    while ((*transaction = (osip_transaction_t *) __osip_index_find(index, __osip_branch_key(b_request->gvalue, sip->cseq->method), &pos)) != NULL) {
+      if (0 == __osip_transaction_matching_response_osip_to_xict_17_1_3(*transaction, sip))
+        return OSIP_SUCCESS;
+    }
 
-  else
-    return OSIP_BADPARAMETER;
+    return OSIP_SUCCESS;
+  }
 
-  return i;
+  if (b_request != NULL && b_request->gvalue != NULL && 0 == strncmp(b_request->gvalue, "z9hG4bK", 7)) {
+    pos = -1;
+
+    while ((*transaction = (osip_transaction_t *) __osip_index_find(index, __osip_branch_key(b_request->gvalue, __osip_method_class(sip->cseq->method)), &pos)) != NULL) {
+      if (0 == __osip_transaction_matching_request_osip_to_xist_17_2_3(*transaction, sip))
+        return OSIP_SUCCESS;
+    }
+  }
+
+  if (sip->call_id == NULL || sip->call_id->number == NULL || sip->cseq->number == NULL)
+    return OSIP_SUCCESS; /* no transaction can match */
+
+  pos = -1;
+
+  while ((*transaction = (osip_transaction_t *) __osip_index_find(index, __osip_call_id_key(sip->call_id, sip->cseq), &pos)) != NULL) {
+    if (0 == __osip_transaction_matching_request_osip_to_xist_17_2_3(*transaction, sip))
+      return OSIP_SUCCESS;
+  }
+
+  return OSIP_SUCCESS;
 }
 
-int __osip_remove_ict_transaction(osip_t *osip, osip_transaction_t *ict) {
-  osip_list_iterator_t iterator;
-  osip_transaction_t *tmp;
+/* return the first timer to expire for the current state of a transaction */
+static int __osip_transaction_next_timer(osip_transaction_t *tr, struct timeval *next) {
+  struct timeval *timers[2] = {NULL, NULL};
+  int i;
 
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_lock(osip->ict_fastmutex);
-#endif
+  if (tr->ctx_type == ICT && tr->ict_context != NULL) {
+    if (tr->state == ICT_CALLING) {
+      timers[0] = &tr->ict_context->timer_a_start;
+      timers[1] = &tr->ict_context->timer_b_start;
 
-#if defined(HAVE_DICT_DICT_H)
-  {
-    osip_generic_param_t *b_request = NULL;
-    int rv;
+    } else if (tr->state == ICT_COMPLETED)
+      timers[0] = &tr->ict_context->timer_d_start;
 
-    osip_via_param_get_byname(ict->topvia, "branch", &b_request);
+  } else if (tr->ctx_type == IST && tr->ist_context != NULL) {
+    if (tr->state == IST_COMPLETED) {
+      timers[0] = &tr->ist_context->timer_g_start;
+      timers[1] = &tr->ist_context->timer_h_start;
 
-    if (b_request != NULL && b_request->gvalue != NULL) {
-      rv = dict_remove((dict *) osip->osip_ict_hastable, b_request->gvalue, TRUE);
+    } else if (tr->state == IST_CONFIRMED)
+      timers[0] = &tr->ist_context->timer_i_start;
 
-      if (rv == 0) {
-        OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL, "New key deleted in ict hastable `%s'\n", b_request->gvalue));
+  } else if (tr->ctx_type == NICT && tr->nict_context != NULL) {
+    if (tr->state == NICT_TRYING || tr->state == NICT_PROCEEDING) {
+      timers[0] = &tr->nict_context->timer_e_start;
+      timers[1] = &tr->nict_context->timer_f_start;
 
-      } else {
-        OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_WARNING, NULL, "key not removed `%s'\n", b_request->gvalue));
-      }
-    }
+    } else if (tr->state == NICT_COMPLETED)
+      timers[0] = &tr->nict_context->timer_k_start;
+
+  } else if (tr->ctx_type == NIST && tr->nist_context != NULL) {
+    if (tr->state == NIST_COMPLETED)
+      timers[0] = &tr->nist_context->timer_j_start;
   }
-#endif
 
-  tmp = (osip_transaction_t *) osip_list_get_first(&osip->osip_ict_transactions, &iterator);
+  next->tv_sec = -1;
 
-  while (osip_list_iterator_has_elem(iterator)) {
-    if (tmp->transactionid == ict->transactionid) {
-      osip_list_iterator_remove(&iterator);
-#ifndef OSIP_MONOTHREAD
-      osip_mutex_unlock(osip->ict_fastmutex);
-#endif
-      return OSIP_SUCCESS;
-    }
+  for (i = 0; i < 2; i++) {
+    if (timers[i] == NULL || timers[i]->tv_sec == -1)
+      continue;
 
-    tmp = (osip_transaction_t *) osip_list_get_next(&iterator);
+    if (next->tv_sec == -1 || osip_timercmp(timers[i], next, <))
+      *next = *timers[i];
   }
 
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock(osip->ict_fastmutex);
-#endif
-  return OSIP_UNDEFINED_ERROR;
+  return (next->tv_sec == -1) ? OSIP_UNDEFINED_ERROR : OSIP_SUCCESS;
 }
 
-int __osip_remove_ist_transaction(osip_t *osip, osip_transaction_t *ist) {
-  osip_list_iterator_t iterator;
-  osip_transaction_t *tmp;
+static void __osip_transaction_schedule_timers(osip_wheel_t *wheel, osip_transaction_t *tr) {
+  struct timeval next;
 
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_lock(osip->ist_fastmutex);
-#endif
+  if (__osip_transaction_next_timer(tr, &next) == OSIP_SUCCESS)
+    __osip_wheel_add(wheel, &tr->timer_entry, &next);
 
-#if defined(HAVE_DICT_DICT_H)
-  {
-    osip_generic_param_t *b_request = NULL;
-    int rv;
+  else
+    __osip_wheel_remove(wheel, &tr->timer_entry);
+}
 
-    osip_via_param_get_byname(ist->topvia, "branch", &b_request);
+void __osip_transaction_update_timers(osip_transaction_t *transaction) {
+  osip_t *osip = (osip_t *) transaction->config;
+  osip_wheel_t *wheel;
 
-    if (b_request != NULL && b_request->gvalue != NULL) {
-      rv = dict_remove((dict *) osip->osip_ist_hastable, b_request->gvalue, TRUE);
+#ifndef OSIP_MONOTHREAD
+  struct osip_mutex *mut;
+#endif
 
-      if (rv == 0) {
-        OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL, "New key deleted in ist hastable `%s'\n", b_request->gvalue));
+  if (osip == NULL)
+    return;
 
-      } else {
-        OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_WARNING, NULL, "key not removed `%s'\n", b_request->gvalue));
-      }
-    }
-  }
+  if (transaction->ctx_type == ICT) {
+    wheel = (osip_wheel_t *) osip->osip_ict_timers;
+#ifndef OSIP_MONOTHREAD
+    mut = osip->ict_fastmutex;
 #endif
 
-  tmp = (osip_transaction_t *) osip_list_get_first(&osip->osip_ist_transactions, &iterator);
+  } else if (transaction->ctx_type == IST) {
+    wheel = (osip_wheel_t *) osip->osip_ist_timers;
+#ifndef OSIP_MONOTHREAD
+    mut = osip->ist_fastmutex;
+#endif
 
-  while (osip_list_iterator_has_elem(iterator)) {
-    if (tmp->transactionid == ist->transactionid) {
-      osip_list_iterator_remove(&iterator);
+  } else if (transaction->ctx_type == NICT) {
+    wheel = (osip_wheel_t *) osip->osip_nict_timers;
 #ifndef OSIP_MONOTHREAD
-      osip_mutex_unlock(osip->ist_fastmutex);
+    mut = osip->nict_fastmutex;
 #endif
-      return OSIP_SUCCESS;
-    }
 
-    tmp = (osip_transaction_t *) osip_list_get_next(&iterator);
+  } else {
+    wheel = (osip_wheel_t *) osip->osip_nist_timers;
+#ifndef OSIP_MONOTHREAD
+    mut = osip->nist_fastmutex;
+#endif
   }
 
 #ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock(osip->ist_fastmutex);
+  osip_mutex_lock(mut);
 #endif
-  return OSIP_UNDEFINED_ERROR;
-}
 
-int __osip_remove_nict_transaction(osip_t *osip, osip_transaction_t *nict) {
-  osip_list_iterator_t iterator;
-  osip_transaction_t *tmp;
+  /* only transactions managed by osip_t are in the timer wheel */
+  if (transaction->timer_entry.element != NULL)
+    __osip_transaction_schedule_timers(wheel, transaction);
 
 #ifndef OSIP_MONOTHREAD
-  osip_mutex_lock(osip->nict_fastmutex);
+  osip_mutex_unlock(mut);
 #endif
+}
 
-#if defined(HAVE_DICT_DICT_H)
-  {
-    osip_generic_param_t *b_request = NULL;
-    int rv;
+/* Each kind of transaction has a list of transactions with pending
+   events: osip_*_execute only visit those transactions. A transaction
+   is added when an event is added in its fifo and is removed before its
+   events are processed.
+   When an executor is set, transactions with pending events are given
+   to the executor instead: ready_busy is set while the executor keeps
+   a reference on the transaction (in a queue of a thread or while its
+   events are processed) and the transaction is never in the list. */
 
-    osip_via_param_get_byname(nict->topvia, "branch", &b_request);
+int __osip_ready_init(osip_ready_t **ready) {
+  *ready = (osip_ready_t *) osip_malloc(sizeof(osip_ready_t));
 
-    if (b_request != NULL && b_request->gvalue != NULL) {
-      rv = dict_remove((dict *) osip->osip_nict_hastable, b_request->gvalue, TRUE);
+  if (*ready == NULL)
+    return OSIP_NOMEM;
 
-      if (rv == 0) {
-        OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL, "New key deleted in nict hastable `%s'\n", b_request->gvalue));
+  memset(*ready, 0, sizeof(osip_ready_t));
+#ifndef OSIP_MONOTHREAD
+  (*ready)->mutex = osip_mutex_init();
 
-      } else {
-        OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_WARNING, NULL, "key not removed `%s'\n", b_request->gvalue));
-      }
-    }
+  if ((*ready)->mutex == NULL) {
+    osip_free(*ready);
+    *ready = NULL;
+    return OSIP_NOMEM;
   }
-#endif
-
-  tmp = (osip_transaction_t *) osip_list_get_first(&osip->osip_nict_transactions, &iterator);
 
-  while (osip_list_iterator_has_elem(iterator)) {
-    if (tmp->transactionid == nict->transactionid) {
-      osip_list_iterator_remove(&iterator);
-#ifndef OSIP_MONOTHREAD
-      osip_mutex_unlock(osip->nict_fastmutex);
 #endif
-      return OSIP_SUCCESS;
-    }
+  return OSIP_SUCCESS;
+}
 
-    tmp = (osip_transaction_t *) osip_list_get_next(&iterator);
-  }
+void __osip_ready_free(osip_ready_t *ready) {
+  if (ready == NULL)
+    return;
 
 #ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock(osip->nict_fastmutex);
+  osip_mutex_destroy(ready->mutex);
 #endif
-  return OSIP_UNDEFINED_ERROR;
+  osip_free(ready);
 }
 
-int __osip_remove_nist_transaction(osip_t *osip, osip_transaction_t *nist) {
-  osip_list_iterator_t iterator;
-  osip_transaction_t *tmp;
+static osip_ready_t *__osip_transaction_ready(osip_transaction_t *transaction) {
+  osip_t *osip = (osip_t *) transaction->config;
 
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_lock(osip->nist_fastmutex);
-#endif
+  if (osip == NULL)
+    return NULL;
 
-#if defined(HAVE_DICT_DICT_H)
-  {
-    osip_generic_param_t *b_request = NULL;
-    int rv;
+  if (transaction->ctx_type == ICT)
+    return (osip_ready_t *) osip->osip_ict_ready;
 
-    osip_via_param_get_byname(nist->topvia, "branch", &b_request);
+  else if (transaction->ctx_type == IST)
+    return (osip_ready_t *) osip->osip_ist_ready;
 
-    if (b_request != NULL && b_request->gvalue != NULL) {
-      rv = dict_remove((dict *) osip->osip_nist_hastable, b_request->gvalue, TRUE);
+  else if (transaction->ctx_type == NICT)
+    return (osip_ready_t *) osip->osip_nict_ready;
 
-      if (rv == 0) {
-        OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL, "New key deleted in ict hastable `%s'\n", b_request->gvalue));
+  else if (transaction->ctx_type == NIST)
+    return (osip_ready_t *) osip->osip_nist_ready;
 
-      } else {
-        OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_WARNING, NULL, "key not removed `%s'\n", b_request->gvalue));
-      }
-    }
-  }
+  return NULL;
+}
+
+/* a transaction added in osip_t may receive events */
+static void __osip_ready_attach(osip_ready_t *ready, osip_transaction_t *transaction) {
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock(ready->mutex);
 #endif
 
-  tmp = (osip_transaction_t *) osip_list_get_first(&osip->osip_nist_transactions, &iterator);
+  if (transaction->ready_state == OSIP_READY_NONE)
+    transaction->ready_state = OSIP_READY_IDLE;
 
-  while (osip_list_iterator_has_elem(iterator)) {
-    if (tmp->transactionid == nist->transactionid) {
-      osip_list_iterator_remove(&iterator);
 #ifndef OSIP_MONOTHREAD
-      osip_mutex_unlock(osip->nist_fastmutex);
+  osip_mutex_unlock(ready->mutex);
 #endif
-      return OSIP_SUCCESS;
-    }
+
+  /* events added before the transaction was in osip_t */
+  if (osip_fifo_size(transaction->transactionff) > 0)
+    __osip_transaction_set_ready(transaction);
+}
+
+static void __osip_ready_append(osip_ready_t *ready, osip_transaction_t *transaction) {
+  transaction->ready_next = NULL;
+  transaction->ready_prev = ready->last;
+
+  if (ready->last != NULL)
+    ready->last->ready_next = transaction;
+
+  else
+    ready->first = transaction;
+
+  ready->last = transaction;
+  ready->nb_elt++;
+}
+
+static void __osip_ready_unlink(osip_ready_t *ready, osip_transaction_t *transaction) {
+  if (transaction->ready_prev != NULL)
+    transaction->ready_prev->ready_next = transaction->ready_next;
+
+  else
+    ready->first = transaction->ready_next;
+
+  if (transaction->ready_next != NULL)
+    transaction->ready_next->ready_prev = transaction->ready_prev;
+
+  else
+    ready->last = transaction->ready_prev;
+
+  transaction->ready_next = NULL;
+  transaction->ready_prev = NULL;
+  ready->nb_elt--;
+}
+
+/* a transaction removed from osip_t is not visited anymore */
+static void __osip_ready_detach(osip_ready_t *ready, osip_transaction_t *transaction) {
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock(ready->mutex);
+#endif
+
+  /* a transaction used by an executor is dropped by the executor */
+  if (transaction->ready_state == OSIP_READY_QUEUED && transaction->ready_busy == 0)
+    __osip_ready_unlink(ready, transaction);
+
+  transaction->ready_state = OSIP_READY_NONE;
+
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock(ready->mutex);
+#endif
+}
+
+static osip_transaction_t *__osip_ready_pop(osip_ready_t *ready) {
+  osip_transaction_t *transaction;
+
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock(ready->mutex);
+#endif
+
+  transaction = ready->first;
+
+  if (transaction != NULL) {
+    __osip_ready_unlink(ready, transaction);
+    transaction->ready_state = OSIP_READY_IDLE;
+  }
+
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock(ready->mutex);
+#endif
+  return transaction;
+}
+
+static int __osip_ready_size(osip_ready_t *ready) {
+  int i;
+
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock(ready->mutex);
+#endif
+
+  i = ready->nb_elt;
+
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock(ready->mutex);
+#endif
+  return i;
+}
+
+void __osip_transaction_set_ready(osip_transaction_t *transaction) {
+  osip_ready_t *ready = __osip_transaction_ready(transaction);
+
+  if (ready == NULL)
+    return;
+
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock(ready->mutex);
+#endif
+
+  if (transaction->ready_state == OSIP_READY_IDLE) {
+    transaction->ready_state = OSIP_READY_QUEUED;
+
+    /* when busy, the executor already has it */
+    if (transaction->ready_busy == 0) {
+#ifndef OSIP_MONOTHREAD
+
+      if (ready->executor != NULL) {
+        transaction->ready_busy = 1;
+        __osip_executor_push(ready->executor, transaction);
+
+      } else
+#endif
+        __osip_ready_append(ready, transaction);
+    }
+  }
+
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock(ready->mutex);
+#endif
+}
+
+int __osip_transaction_delay_free(osip_transaction_t *transaction) {
+  osip_ready_t *ready = __osip_transaction_ready(transaction);
+  int i = 0;
+
+  if (ready == NULL)
+    return 0;
+
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock(ready->mutex);
+#endif
+
+  if (transaction->ready_busy != 0) {
+    transaction->ready_free = 1;
+    i = 1;
+  }
+
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock(ready->mutex);
+#endif
+  return i;
+}
+
+#ifndef OSIP_MONOTHREAD
+
+void __osip_ready_set_executor(osip_ready_t *ready, osip_executor_t *executor) {
+  osip_transaction_t *transaction;
+
+  osip_mutex_lock(ready->mutex);
+  ready->executor = executor;
+
+  if (executor != NULL) {
+    while (ready->first != NULL) {
+      transaction = ready->first;
+      __osip_ready_unlink(ready, transaction);
+      transaction->ready_busy = 1;
+      __osip_executor_push(executor, transaction);
+    }
+  }
+
+  osip_mutex_unlock(ready->mutex);
+}
+
+/* the pending events are read with the mutex of the list so that an
+   event added after the last read always queues the transaction again */
+void __osip_transaction_run(osip_transaction_t *transaction) {
+  osip_ready_t *ready = __osip_transaction_ready(transaction);
+  osip_event_t *se;
+
+  if (ready == NULL)
+    return;
+
+  for (;;) {
+    osip_mutex_lock(ready->mutex);
+
+    if (transaction->ready_free != 0) {
+      transaction->ready_busy = 0;
+      osip_mutex_unlock(ready->mutex);
+      osip_transaction_free2(transaction);
+      return;
+    }
+
+    if (transaction->ready_state == OSIP_READY_QUEUED)
+      transaction->ready_state = OSIP_READY_RUNNING;
+
+    se = NULL;
+
+    if (transaction->ready_state == OSIP_READY_RUNNING)
+      se = (osip_event_t *) osip_fifo_tryget(transaction->transactionff);
+
+    if (se == NULL) {
+      /* no more event, or removed from osip_t */
+      if (transaction->ready_state == OSIP_READY_RUNNING)
+        transaction->ready_state = OSIP_READY_IDLE;
+
+      transaction->ready_busy = 0;
+      osip_mutex_unlock(ready->mutex);
+      return;
+    }
+
+    osip_mutex_unlock(ready->mutex);
+    osip_transaction_execute(transaction, se);
+  }
+}
+
+void __osip_transaction_unset_busy(osip_transaction_t *transaction) {
+  osip_ready_t *ready = __osip_transaction_ready(transaction);
+
+  if (ready == NULL)
+    return;
+
+  osip_mutex_lock(ready->mutex);
+  transaction->ready_busy = 0;
+
+  if (transaction->ready_free != 0) {
+    osip_mutex_unlock(ready->mutex);
+    osip_transaction_free2(transaction);
+    return;
+  }
+
+  if (transaction->ready_state == OSIP_READY_QUEUED) {
+    if (ready->executor != NULL) {
+      transaction->ready_busy = 1;
+      __osip_executor_push(ready->executor, transaction);
+
+    } else
+      __osip_ready_append(ready, transaction);
+  }
+
+  osip_mutex_unlock(ready->mutex);
+}
+
+#endif
+
+/* process the pending events of transactions. A transaction is removed
+   from the list before its events are read: if an event is added after,
+   the transaction is added again. Transactions added during this call
+   are processed at the next call. */
+static int __osip_ready_execute(osip_ready_t *ready) {
+  osip_transaction_t *transaction;
+  osip_event_t *se;
+  int len;
+
+  len = __osip_ready_size(ready);
+
+  while (len > 0) {
+    len--;
+    transaction = __osip_ready_pop(ready);
+
+    if (transaction == NULL)
+      break;
+
+    do {
+      se = (osip_event_t *) osip_fifo_tryget(transaction->transactionff);
+
+      if (se != NULL)
+        osip_transaction_execute(transaction, se);
+    } while (se != NULL);
+  }
+
+  return OSIP_SUCCESS;
+}
+
+int __osip_add_ict(osip_t *osip, osip_transaction_t *ict) {
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock(osip->ict_fastmutex);
+#endif
+  if (__osip_transaction_index_add((osip_index_t *) osip->osip_ict_hastable, ict) != OSIP_SUCCESS) {
+#ifndef OSIP_MONOTHREAD
+    osip_mutex_unlock(osip->ict_fastmutex);
+#endif
+    return OSIP_NOMEM;
+  }
+
+  osip_list_add(&osip->osip_ict_transactions, ict, -1);
+  ict->timer_entry.element = ict;
+  __osip_transaction_schedule_timers((osip_wheel_t *) osip->osip_ict_timers, ict);
+  __osip_ready_attach((osip_ready_t *) osip->osip_ict_ready, ict);
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock(osip->ict_fastmutex);
+#endif
+  return OSIP_SUCCESS;
+}
+
+int __osip_add_ist(osip_t *osip, osip_transaction_t *ist) {
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock(osip->ist_fastmutex);
+#endif
+  if (__osip_transaction_index_add((osip_index_t *) osip->osip_ist_hastable, ist) != OSIP_SUCCESS) {
+#ifndef OSIP_MONOTHREAD
+    osip_mutex_unlock(osip->ist_fastmutex);
+#endif
+    return OSIP_NOMEM;
+  }
+
+  osip_list_add(&osip->osip_ist_transactions, ist, -1);
+  ist->timer_entry.element = ist;
+  __osip_transaction_schedule_timers((osip_wheel_t *) osip->osip_ist_timers, ist);
+  __osip_ready_attach((osip_ready_t *) osip->osip_ist_ready, ist);
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock(osip->ist_fastmutex);
+#endif
+  return OSIP_SUCCESS;
+}
+
+int __osip_add_nict(osip_t *osip, osip_transaction_t *nict) {
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock(osip->nict_fastmutex);
+#endif
+  if (__osip_transaction_index_add((osip_index_t *) osip->osip_nict_hastable, nict) != OSIP_SUCCESS) {
+#ifndef OSIP_MONOTHREAD
+    osip_mutex_unlock(osip->nict_fastmutex);
+#endif
+    return OSIP_NOMEM;
+  }
+
+  osip_list_add(&osip->osip_nict_transactions, nict, -1);
+  nict->timer_entry.element = nict;
+  __osip_transaction_schedule_timers((osip_wheel_t *) osip->osip_nict_timers, nict);
+  __osip_ready_attach((osip_ready_t *) osip->osip_nict_ready, nict);
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock(osip->nict_fastmutex);
+#endif
+  return OSIP_SUCCESS;
+}
+
+int __osip_add_nist(osip_t *osip, osip_transaction_t *nist) {
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock(osip->nist_fastmutex);
+#endif
+  if (__osip_transaction_index_add((osip_index_t *) osip->osip_nist_hastable, nist) != OSIP_SUCCESS) {
+#ifndef OSIP_MONOTHREAD
+    osip_mutex_unlock(osip->nist_fastmutex);
+#endif
+    return OSIP_NOMEM;
+  }
+
+  osip_list_add(&osip->osip_nist_transactions, nist, -1);
+  nist->timer_entry.element = nist;
+  __osip_transaction_schedule_timers((osip_wheel_t *) osip->osip_nist_timers, nist);
+  __osip_ready_attach((osip_ready_t *) osip->osip_nist_ready, nist);
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock(osip->nist_fastmutex);
+#endif
+  return OSIP_SUCCESS;
+}
+
+int osip_remove_transaction(osip_t *osip, osip_transaction_t *tr) {
+  int i = -1;
+
+  if (tr == NULL)
+    return OSIP_BADPARAMETER;
+
+  if (tr->config != NULL && ((osip_t *) tr->config)->parent == osip)
+    osip = (osip_t *) tr->config; /* the transaction belongs to a shard */
+
+  if (tr->ctx_type == ICT)
+    i = __osip_remove_ict_transaction(osip, tr);
+
+  else if (tr->ctx_type == IST)
+    i = __osip_remove_ist_transaction(osip, tr);
+
+  else if (tr->ctx_type == NICT)
+    i = __osip_remove_nict_transaction(osip, tr);
+
+  else if (tr->ctx_type == NIST)
+    i = __osip_remove_nist_transaction(osip, tr);
+
+  else
+    return OSIP_BADPARAMETER;
+
+  return i;
+}
+
+int __osip_remove_ict_transaction(osip_t *osip, osip_transaction_t *ict) {
+  osip_list_iterator_t iterator;
+  osip_transaction_t *tmp;
+
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock(osip->ict_fastmutex);
+#endif
+
+  __osip_transaction_index_remove((osip_index_t *) osip->osip_ict_hastable, ict);
+  __osip_wheel_remove((osip_wheel_t *) osip->osip_ict_timers, &ict->timer_entry);
+  ict->timer_entry.element = NULL;
+  __osip_ready_detach((osip_ready_t *) osip->osip_ict_ready, ict);
+
+  tmp = (osip_transaction_t *) osip_list_get_first(&osip->osip_ict_transactions, &iterator);
+
+  while (osip_list_iterator_has_elem(iterator)) {
+    if (tmp->transactionid == ict->transactionid) {
+      osip_list_iterator_remove(&iterator);
+#ifndef OSIP_MONOTHREAD
+      osip_mutex_unlock(osip->ict_fastmutex);
+#endif
+      return OSIP_SUCCESS;
+    }
+
+    tmp = (osip_transaction_t *) osip_list_get_next(&iterator);
+  }
+
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock(osip->ict_fastmutex);
+#endif
+  return OSIP_UNDEFINED_ERROR;
+}
+
+int __osip_remove_ist_transaction(osip_t *osip, osip_transaction_t *ist) {
+  osip_list_iterator_t iterator;
+  osip_transaction_t *tmp;
+
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock(osip->ist_fastmutex);
+#endif
+
+  __osip_transaction_index_remove((osip_index_t *) osip->osip_ist_hastable, ist);
+  __osip_wheel_remove((osip_wheel_t *) osip->osip_ist_timers, &ist->timer_entry);
+  ist->timer_entry.element = NULL;
+  __osip_ready_detach((osip_ready_t *) osip->osip_ist_ready, ist);
+
+  tmp = (osip_transaction_t *) osip_list_get_first(&osip->osip_ist_transactions, &iterator);
+
+  while (osip_list_iterator_has_elem(iterator)) {
+    if (tmp->transactionid == ist->transactionid) {
+      osip_list_iterator_remove(&iterator);
+#ifndef OSIP_MONOTHREAD
+      osip_mutex_unlock(osip->ist_fastmutex);
+#endif
+      return OSIP_SUCCESS;
+    }
+
+    tmp = (osip_transaction_t *) osip_list_get_next(&iterator);
+  }
+
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock(osip->ist_fastmutex);
+#endif
+  return OSIP_UNDEFINED_ERROR;
+}
+
+int __osip_remove_nict_transaction(osip_t *osip, osip_transaction_t *nict) {
+  osip_list_iterator_t iterator;
+  osip_transaction_t *tmp;
+
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock(osip->nict_fastmutex);
+#endif
+
+  __osip_transaction_index_remove((osip_index_t *) osip->osip_nict_hastable, nict);
+  __osip_wheel_remove((osip_wheel_t *) osip->osip_nict_timers, &nict->timer_entry);
+  nict->timer_entry.element = NULL;
+  __osip_ready_detach((osip_ready_t *) osip->osip_nict_ready, nict);
+
+  tmp = (osip_transaction_t *) osip_list_get_first(&osip->osip_nict_transactions, &iterator);
+
+  while (osip_list_iterator_has_elem(iterator)) {
+    if (tmp->transactionid == nict->transactionid) {
+      osip_list_iterator_remove(&iterator);
+#ifndef OSIP_MONOTHREAD
+      osip_mutex_unlock(osip->nict_fastmutex);
+#endif
+      return OSIP_SUCCESS;
+    }
+
+    tmp = (osip_transaction_t *) osip_list_get_next(&iterator);
+  }
+
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_unlock(osip->nict_fastmutex);
+#endif
+  return OSIP_UNDEFINED_ERROR;
+}
+
+int __osip_remove_nist_transaction(osip_t *osip, osip_transaction_t *nist) {
+  osip_list_iterator_t iterator;
+  osip_transaction_t *tmp;
+
+#ifndef OSIP_MONOTHREAD
+  osip_mutex_lock(osip->nist_fastmutex);
+#endif
+
+  __osip_transaction_index_remove((osip_index_t *) osip->osip_nist_hastable, nist);
+  __osip_wheel_remove((osip_wheel_t *) osip->osip_nist_timers, &nist->timer_entry);
+  nist->timer_entry.element = NULL;
+  __osip_ready_detach((osip_ready_t *) osip->osip_nist_ready, nist);
+
+  tmp = (osip_transaction_t *) osip_list_get_first(&osip->osip_nist_transactions, &iterator);
+
+  while (osip_list_iterator_has_elem(iterator)) {
+    if (tmp->transactionid == nist->transactionid) {
+      osip_list_iterator_remove(&iterator);
+#ifndef OSIP_MONOTHREAD
+      osip_mutex_unlock(osip->nist_fastmutex);
+#endif
+      return OSIP_SUCCESS;
+    }
 
     tmp = (osip_transaction_t *) osip_list_get_next(&iterator);
   }
@@ -719,6 +1321,8 @@ osip_transaction_t *__osip_find_transaction(osip_t *osip, osip_event_t *evt, int
   if (evt == NULL || evt->sip == NULL || evt->sip->cseq == NULL)
     return NULL;
 
+  osip = osip_select_shard(osip, evt->sip);
+
   if (EVT_IS_INCOMINGMSG(evt)) {
     if (MSG_IS_REQUEST(evt->sip)) {
       if (0 == strcmp(evt->sip->cseq->method, "INVITE") || 0 == strcmp(evt->sip->cseq->method, "ACK")) {
@@ -867,6 +1471,7 @@ osip_transaction_t *osip_transaction_find(osip_list_t *transactions, osip_event_
   osip_list_iterator_t iterator;
   osip_transaction_t *transaction;
   osip_t *osip = NULL;
+  osip_index_t *index = NULL;
 
   transaction = (osip_transaction_t *) osip_list_get_first(transactions, &iterator);
 
@@ -876,40 +1481,23 @@ osip_transaction_t *osip_transaction_find(osip_list_t *transactions, osip_event_
   if (osip == NULL)
     return NULL;
 
-  if (EVT_IS_INCOMINGREQ(evt)) {
-#ifdef HAVE_DICT_DICT_H
-    /* search in hastable! */
-    osip_generic_param_t *b_request;
-    osip_via_t *topvia_request;
+  if (transactions == &osip->osip_ict_transactions)
+    index = (osip_index_t *) osip->osip_ict_hastable;
 
-    topvia_request = osip_list_get(&evt->sip->vias, 0);
-
-    if (topvia_request == NULL) {
-      OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL, "Remote UA is not compliant: missing a Via header!\n"));
-      return NULL;
-    }
+  else if (transactions == &osip->osip_ist_transactions)
+    index = (osip_index_t *) osip->osip_ist_hastable;
 
-    osip_via_param_get_byname(topvia_request, "branch", &b_request);
+  else if (transactions == &osip->osip_nict_transactions)
+    index = (osip_index_t *) osip->osip_nict_hastable;
 
-    if (b_request != NULL && b_request->gvalue != NULL) {
-      if (MSG_IS_INVITE(evt->sip) || MSG_IS_ACK(evt->sip)) {
-        transaction = (osip_transaction_t *) dict_search((dict *) osip->osip_ist_hastable, b_request->gvalue);
-        OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO2, NULL, "Find matching Via header for INVITE(ACK) REQUEST!\n"));
-
-        if (transaction != NULL)
-          return transaction;
-
-      } else {
-        transaction = (osip_transaction_t *) dict_search((dict *) osip->osip_nist_hastable, b_request->gvalue);
-        OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO2, NULL, "Find matching Via header for NON-INVITE REQUEST!\n"));
-
-        if (transaction != NULL)
-          return transaction;
-      }
-    }
+  else if (transactions == &osip->osip_nist_transactions)
+    index = (osip_index_t *) osip->osip_nist_hastable;
 
-#endif
+  /* search in hastable! */
+  if (index != NULL && __osip_transaction_index_find(index, evt, &transaction) == OSIP_SUCCESS)
+    return transaction;
 
+  if (EVT_IS_INCOMINGREQ(evt)) {
     transaction = (osip_transaction_t *) osip_list_get_first(transactions, &iterator);
 
     while (osip_list_iterator_has_elem(iterator)) {
@@ -920,39 +1508,6 @@ osip_transaction_t *osip_transaction_find(osip_list_t *transactions, osip_event_
     }
 
   } else if (EVT_IS_INCOMINGRESP(evt)) {
-#ifdef HAVE_DICT_DICT_H
-    /* search in hastable! */
-    osip_generic_param_t *b_request;
-    osip_via_t *topvia_request;
-
-    topvia_request = osip_list_get(&evt->sip->vias, 0);
-
-    if (topvia_request == NULL) {
-      OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL, "Remote UA is not compliant: missing a Via header!\n"));
-      return NULL;
-    }
-
-    osip_via_param_get_byname(topvia_request, "branch", &b_request);
-
-    if (b_request != NULL && b_request->gvalue != NULL) {
-      if (MSG_IS_RESPONSE_FOR(evt->sip, "INVITE")) {
-        transaction = (osip_transaction_t *) dict_search((dict *) osip->osip_ict_hastable, b_request->gvalue);
-        OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO2, NULL, "Find matching Via header for INVITE ANSWER!\n"));
-
-        if (transaction != NULL)
-          return transaction;
-
-      } else {
-        transaction = (osip_transaction_t *) dict_search((dict *) osip->osip_nict_hastable, b_request->gvalue);
-        OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO2, NULL, "Find matching Via header for NON-INVITE ANSWER!\n"));
-
-        if (transaction != NULL)
-          return transaction;
-      }
-    }
-
-#endif
-
     transaction = (osip_transaction_t *) osip_list_get_first(transactions, &iterator);
 
     while (osip_list_iterator_has_elem(iterator)) {
@@ -979,11 +1534,28 @@ osip_transaction_t *osip_transaction_find(osip_list_t *transactions, osip_event_
 
 int osip_init(osip_t **osip) {
   static int ref_count = 0;
+  osip_index_t *ict_index = NULL;
+  osip_index_t *ist_index = NULL;
+  osip_index_t *nict_index = NULL;
+  osip_index_t *nist_index = NULL;
+  osip_wheel_t *ict_timers = NULL;
+  osip_wheel_t *ist_timers = NULL;
+  osip_wheel_t *nict_timers = NULL;
+  osip_wheel_t *nist_timers = NULL;
+  osip_ready_t *ict_ready = NULL;
+  osip_ready_t *ist_ready = NULL;
+  osip_ready_t *nict_ready = NULL;
+  osip_ready_t *nist_ready = NULL;
+  osip_wheel_t *ixt_timers = NULL;
+  osip_index_t *ixt_index = NULL;
+  int i;
 
   if (ref_count == 0) {
     ref_count++;
     /* load the parser configuration */
     parser_init();
+    /* build the dispatch tables of transactions */
+    fsm_load_statemachines();
   }
 
   *osip = (osip_t *) osip_malloc(sizeof(osip_t));
@@ -1007,340 +1579,270 @@ int osip_init(osip_t **osip) {
   osip_list_init(&(*osip)->osip_ist_transactions);
   osip_list_init(&(*osip)->osip_nict_transactions);
   osip_list_init(&(*osip)->osip_nist_transactions);
-  osip_list_init(&(*osip)->ixt_retransmissions);
 
   (*osip)->transactionid = 1;
 
-#if defined(HAVE_DICT_DICT_H)
-  (*osip)->osip_ict_hastable = (dict *) hashtable_dict_new((dict_cmp_func) strcmp, (dict_hsh_func) s_hash, NULL, NULL, HSIZE);
-  (*osip)->osip_ist_hastable = (dict *) hashtable_dict_new((dict_cmp_func) strcmp, (dict_hsh_func) s_hash, NULL, NULL, HSIZE);
-  (*osip)->osip_nict_hastable = (dict *) hashtable_dict_new((dict_cmp_func) strcmp, (dict_hsh_func) s_hash, NULL, NULL, HSIZE);
-  (*osip)->osip_nist_hastable = (dict *) hashtable_dict_new((dict_cmp_func) strcmp, (dict_hsh_func) s_hash, NULL, NULL, HSIZE);
-#endif
+  i = __osip_index_init(&ict_index);
 
-  return OSIP_SUCCESS;
-}
-
-void osip_release(osip_t *osip) {
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_destroy(osip->ict_fastmutex);
-  osip_mutex_destroy(osip->ist_fastmutex);
-  osip_mutex_destroy(osip->nict_fastmutex);
-  osip_mutex_destroy(osip->nist_fastmutex);
+  if (i == OSIP_SUCCESS)
+    i = __osip_index_init(&ist_index);
 
-  osip_mutex_destroy(osip->ixt_fastmutex);
-  osip_mutex_destroy(osip->id_mutex);
-#endif
+  if (i == OSIP_SUCCESS)
+    i = __osip_index_init(&nict_index);
 
-  osip_free(osip);
-}
+  if (i == OSIP_SUCCESS)
+    i = __osip_index_init(&nist_index);
 
-void osip_set_application_context(osip_t *osip, void *pointer) {
-  osip->application_context = pointer;
-}
+  if (i == OSIP_SUCCESS)
+    i = __osip_wheel_init(&ict_timers);
 
-void *osip_get_application_context(osip_t *osip) {
-  if (osip == NULL)
-    return NULL;
-
-  return osip->application_context;
-}
-
-int osip_ict_execute(osip_t *osip) {
-  osip_transaction_t *transaction;
-  osip_event_t *se;
-  int more_event;
-  osip_list_iterator_t iterator;
-  void **array;
-  int len;
-  int index = 0;
-
-  /* list must be copied because osip_transaction_execute() may change it */
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_lock(osip->ict_fastmutex);
-#endif
-  len = osip_list_size(&osip->osip_ict_transactions);
-
-  if (0 >= len) {
-#ifndef OSIP_MONOTHREAD
-    osip_mutex_unlock(osip->ict_fastmutex);
-#endif
-    return OSIP_SUCCESS;
-  }
-
-  array = osip_malloc(sizeof(void *) * len);
-
-  if (array == NULL) {
-#ifndef OSIP_MONOTHREAD
-    osip_mutex_unlock(osip->ict_fastmutex);
-#endif
-    return OSIP_NOMEM; /* OSIP_SUCCESS; */
-  }
+  if (i == OSIP_SUCCESS)
+    i = __osip_wheel_init(&ist_timers);
 
-  transaction = (osip_transaction_t *) osip_list_get_first(&osip->osip_ict_transactions, &iterator);
+  if (i == OSIP_SUCCESS)
+    i = __osip_wheel_init(&nict_timers);
 
-  while (osip_list_iterator_has_elem(iterator)) {
-    array[index++] = transaction;
-    transaction = (osip_transaction_t *) osip_list_get_next(&iterator);
-  }
+  if (i == OSIP_SUCCESS)
+    i = __osip_wheel_init(&nist_timers);
 
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock(osip->ict_fastmutex);
-#endif
+  if (i == OSIP_SUCCESS)
+    i = __osip_ready_init(&ict_ready);
 
-  for (index = 0; index < len; ++index) {
-    transaction = (osip_transaction_t *) array[index];
-    more_event = 1;
+  if (i == OSIP_SUCCESS)
+    i = __osip_ready_init(&ist_ready);
 
-    do {
-      se = (osip_event_t *) osip_fifo_tryget(transaction->transactionff);
+  if (i == OSIP_SUCCESS)
+    i = __osip_ready_init(&nict_ready);
 
-      if (se == NULL) /* no more event for this transaction */
-        more_event = 0;
+  if (i == OSIP_SUCCESS)
+    i = __osip_ready_init(&nist_ready);
 
-      else
-        osip_transaction_execute(transaction, se);
-    } while (more_event == 1);
-  }
+  if (i == OSIP_SUCCESS)
+    i = __osip_wheel_init(&ixt_timers);
+
+  if (i == OSIP_SUCCESS)
+    i = __osip_index_init(&ixt_index);
+
+  (*osip)->osip_ict_hastable = ict_index;
+  (*osip)->osip_ist_hastable = ist_index;
+  (*osip)->osip_nict_hastable = nict_index;
+  (*osip)->osip_nist_hastable = nist_index;
+  (*osip)->osip_ict_timers = ict_timers;
+  (*osip)->osip_ist_timers = ist_timers;
+  (*osip)->osip_nict_timers = nict_timers;
+  (*osip)->osip_nist_timers = nist_timers;
+  (*osip)->osip_ict_ready = ict_ready;
+  (*osip)->osip_ist_ready = ist_ready;
+  (*osip)->osip_nict_ready = nict_ready;
+  (*osip)->osip_nist_ready = nist_ready;
+  (*osip)->osip_ixt_timers = ixt_timers;
+  (*osip)->osip_ixt_index = ixt_index;
 
-  osip_free(array);
+  if (i != OSIP_SUCCESS) {
+    osip_release(*osip);
+    *osip = NULL;
+    return i;
+  }
 
   return OSIP_SUCCESS;
 }
 
-int osip_ist_execute(osip_t *osip) {
-  osip_transaction_t *transaction;
-  osip_event_t *se;
-  int more_event;
-  osip_list_iterator_t iterator;
-  void **array;
-  int len;
-  int index = 0;
-
-  /* list must be copied because osip_transaction_execute() may change it */
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_lock(osip->ist_fastmutex);
-#endif
-  len = osip_list_size(&osip->osip_ist_transactions);
+void osip_release(osip_t *osip) {
+  int i;
 
-  if (0 >= len) {
-#ifndef OSIP_MONOTHREAD
-    osip_mutex_unlock(osip->ist_fastmutex);
-#endif
-    return OSIP_SUCCESS;
+  for (i = 0; i < osip->nb_shards; i++) {
+    if (osip->shards[i] != NULL)
+      osip_release(osip->shards[i]);
   }
 
-  array = osip_malloc(sizeof(void *) * len);
+  osip_free(osip->shards);
 
-  if (array == NULL) {
 #ifndef OSIP_MONOTHREAD
-    osip_mutex_unlock(osip->ist_fastmutex);
+  osip_mutex_destroy(osip->ict_fastmutex);
+  osip_mutex_destroy(osip->ist_fastmutex);
+  osip_mutex_destroy(osip->nict_fastmutex);
+  osip_mutex_destroy(osip->nist_fastmutex);
+
+  osip_mutex_destroy(osip->ixt_fastmutex);
+  osip_mutex_destroy(osip->id_mutex);
 #endif
-    return OSIP_NOMEM; /* OSIP_SUCCESS; */
-  }
 
-  transaction = (osip_transaction_t *) osip_list_get_first(&osip->osip_ist_transactions, &iterator);
+  __osip_index_free((osip_index_t *) osip->osip_ict_hastable);
+  __osip_index_free((osip_index_t *) osip->osip_ist_hastable);
+  __osip_index_free((osip_index_t *) osip->osip_nict_hastable);
+  __osip_index_free((osip_index_t *) osip->osip_nist_hastable);
+  __osip_wheel_free((osip_wheel_t *) osip->osip_ict_timers);
+  __osip_wheel_free((osip_wheel_t *) osip->osip_ist_timers);
+  __osip_wheel_free((osip_wheel_t *) osip->osip_nict_timers);
+  __osip_wheel_free((osip_wheel_t *) osip->osip_nist_timers);
+  __osip_ready_free((osip_ready_t *) osip->osip_ict_ready);
+  __osip_ready_free((osip_ready_t *) osip->osip_ist_ready);
+  __osip_ready_free((osip_ready_t *) osip->osip_nict_ready);
+  __osip_ready_free((osip_ready_t *) osip->osip_nist_ready);
+  __osip_wheel_free((osip_wheel_t *) osip->osip_ixt_timers);
+  __osip_index_free((osip_index_t *) osip->osip_ixt_index);
 
-  while (osip_list_iterator_has_elem(iterator)) {
-    array[index++] = transaction;
-    transaction = (osip_transaction_t *) osip_list_get_next(&iterator);
-  }
+  osip_free(osip);
+}
 
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock(osip->ist_fastmutex);
-#endif
+int osip_init_sharded(osip_t **osip, int nb_shards) {
+  int i;
 
-  for (index = 0; index < len; ++index) {
-    transaction = (osip_transaction_t *) array[index];
-    more_event = 1;
+  if (nb_shards <= 0)
+    return OSIP_BADPARAMETER;
 
-    do {
-      se = (osip_event_t *) osip_fifo_tryget(transaction->transactionff);
+  i = osip_init(osip);
 
-      if (se == NULL) /* no more event for this transaction */
-        more_event = 0;
+  if (i != OSIP_SUCCESS)
+    return i;
 
-      else
-        osip_transaction_execute(transaction, se);
-    } while (more_event == 1);
-  }
+  (*osip)->shards = (osip_t **) osip_malloc(sizeof(osip_t *) * nb_shards);
 
-  osip_free(array);
+  if ((*osip)->shards == NULL) {
+    osip_release(*osip);
+    *osip = NULL;
+    return OSIP_NOMEM;
+  }
 
-  return OSIP_SUCCESS;
-}
+  memset((*osip)->shards, 0, sizeof(osip_t *) * nb_shards);
+  (*osip)->nb_shards = nb_shards;
 
-int osip_nict_execute(osip_t *osip) {
-  osip_transaction_t *transaction;
-  osip_event_t *se;
-  int more_event;
-  osip_list_iterator_t iterator;
-  void **array;
-  int len;
-  int index = 0;
+  for (i = 0; i < nb_shards; i++) {
+    int j = osip_init(&(*osip)->shards[i]);
 
-  /* list must be copied because osip_transaction_execute() may change it */
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_lock(osip->nict_fastmutex);
-#endif
-  len = osip_list_size(&osip->osip_nict_transactions);
+    if (j != OSIP_SUCCESS) {
+      osip_release(*osip);
+      *osip = NULL;
+      return j;
+    }
 
-  if (0 >= len) {
-#ifndef OSIP_MONOTHREAD
-    osip_mutex_unlock(osip->nict_fastmutex);
-#endif
-    return OSIP_SUCCESS;
+    (*osip)->shards[i]->parent = *osip;
   }
 
-  array = osip_malloc(sizeof(void *) * len);
+  return OSIP_SUCCESS;
+}
 
-  if (array == NULL) {
-#ifndef OSIP_MONOTHREAD
-    osip_mutex_unlock(osip->nict_fastmutex);
-#endif
-    return OSIP_NOMEM; /* OSIP_SUCCESS; */
-  }
+int osip_get_shard_count(osip_t *osip) {
+  if (osip == NULL)
+    return 0;
 
-  transaction = (osip_transaction_t *) osip_list_get_first(&osip->osip_nict_transactions, &iterator);
+  return osip->nb_shards;
+}
 
-  while (osip_list_iterator_has_elem(iterator)) {
-    array[index++] = transaction;
-    transaction = (osip_transaction_t *) osip_list_get_next(&iterator);
-  }
+osip_t *osip_get_shard(osip_t *osip, int index) {
+  if (osip == NULL || index < 0 || index >= osip->nb_shards)
+    return NULL;
 
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock(osip->nict_fastmutex);
-#endif
+  return osip->shards[index];
+}
 
-  for (index = 0; index < len; ++index) {
-    transaction = (osip_transaction_t *) array[index];
-    more_event = 1;
+osip_t *osip_select_shard(osip_t *osip, osip_message_t *sip) {
+  unsigned long hash;
 
-    do {
-      se = (osip_event_t *) osip_fifo_tryget(transaction->transactionff);
+  if (osip->nb_shards == 0)
+    return osip;
 
-      if (se == NULL) /* no more event for this transaction */
-        more_event = 0;
+  /* all transactions of a call are kept in the same shard */
+  hash = OSIP_INDEX_SEED;
 
-      else
-        osip_transaction_execute(transaction, se);
-    } while (more_event == 1);
+  if (sip != NULL && sip->call_id != NULL) {
+    hash = __osip_index_hash(hash, sip->call_id->number);
+    hash = __osip_index_hash(hash, sip->call_id->host);
   }
 
-  osip_free(array);
+  /* mix the bits: the modulo would only use the last characters */
+  hash ^= hash >> 15;
+  hash *= 2654435761UL;
+  hash ^= hash >> 13;
 
-  return OSIP_SUCCESS;
+  return osip->shards[hash % (unsigned long) osip->nb_shards];
 }
 
-int osip_nist_execute(osip_t *osip) {
-  osip_transaction_t *transaction;
-  osip_event_t *se;
-  int more_event;
-  osip_list_iterator_t iterator;
-  void **array;
-  int len;
-  int index = 0;
-
-  /* list must be copied because osip_transaction_execute() may change it */
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_lock(osip->nist_fastmutex);
-#endif
-  len = osip_list_size(&osip->osip_nist_transactions);
+void osip_set_application_context(osip_t *osip, void *pointer) {
+  int i;
 
-  if (0 >= len) {
-#ifndef OSIP_MONOTHREAD
-    osip_mutex_unlock(osip->nist_fastmutex);
-#endif
-    return OSIP_SUCCESS;
-  }
+  osip->application_context = pointer;
 
-  array = osip_malloc(sizeof(void *) * len);
+  for (i = 0; i < osip->nb_shards; i++)
+    osip_set_application_context(osip->shards[i], pointer);
+}
 
-  if (array == NULL) {
-#ifndef OSIP_MONOTHREAD
-    osip_mutex_unlock(osip->nist_fastmutex);
-#endif
-    return OSIP_NOMEM; /* OSIP_SUCCESS; */
-  }
+void *osip_get_application_context(osip_t *osip) {
+  if (osip == NULL)
+    return NULL;
 
-  transaction = (osip_transaction_t *) osip_list_get_first(&osip->osip_nist_transactions, &iterator);
+  return osip->application_context;
+}
 
-  while (osip_list_iterator_has_elem(iterator)) {
-    array[index++] = transaction;
-    transaction = (osip_transaction_t *) osip_list_get_next(&iterator);
-  }
+int osip_ict_execute(osip_t *osip) {
+  if (osip->nb_shards > 0)
+    return __osip_shards_execute(osip, osip_ict_execute);
 
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock(osip->nist_fastmutex);
-#endif
+  /* only transactions with pending events are visited */
+  return __osip_ready_execute((osip_ready_t *) osip->osip_ict_ready);
+}
 
-  for (index = 0; index < len; ++index) {
-    transaction = (osip_transaction_t *) array[index];
-    more_event = 1;
+int osip_ist_execute(osip_t *osip) {
+  if (osip->nb_shards > 0)
+    return __osip_shards_execute(osip, osip_ist_execute);
 
-    do {
-      se = (osip_event_t *) osip_fifo_tryget(transaction->transactionff);
+  /* only transactions with pending events are visited */
+  return __osip_ready_execute((osip_ready_t *) osip->osip_ist_ready);
+}
 
-      if (se == NULL) /* no more event for this transaction */
-        more_event = 0;
+int osip_nict_execute(osip_t *osip) {
+  if (osip->nb_shards > 0)
+    return __osip_shards_execute(osip, osip_nict_execute);
 
-      else
-        osip_transaction_execute(transaction, se);
-    } while (more_event == 1);
-  }
+  /* only transactions with pending events are visited */
+  return __osip_ready_execute((osip_ready_t *) osip->osip_nict_ready);
+}
 
-  osip_free(array);
+int osip_nist_execute(osip_t *osip) {
+  if (osip->nb_shards > 0)
+    return __osip_shards_execute(osip, osip_nist_execute);
 
-  return OSIP_SUCCESS;
+  /* only transactions with pending events are visited */
+  return __osip_ready_execute((osip_ready_t *) osip->osip_nist_ready);
 }
 
 void osip_timers_gettimeout(osip_t *osip, struct timeval *lower_tv) {
   struct timeval now;
-  osip_transaction_t *tr;
-  osip_list_iterator_t iterator;
+  struct timeval next;
 
-  osip_gettimeofday(&now, NULL);
-  lower_tv->tv_sec = now.tv_sec + 3600 * 24 * 365; /* wake up evry year :-) */
-  lower_tv->tv_usec = now.tv_usec;
+  if (osip->nb_shards > 0) {
+    int i;
 
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_lock(osip->ict_fastmutex);
-#endif
-  /* handle ict timers */
-  tr = (osip_transaction_t *) osip_list_get_first(&osip->osip_ict_transactions, &iterator);
+    /* values returned by each shard are already relative to now */
+    lower_tv->tv_sec = 3600 * 24 * 365;
+    lower_tv->tv_usec = 0;
 
-  while (osip_list_iterator_has_elem(iterator)) {
-    if (1 <= osip_fifo_size(tr->transactionff)) {
-      OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO4, NULL, "1 Pending event already in transaction !\n"));
-      lower_tv->tv_sec = 0;
-      lower_tv->tv_usec = 0;
-#ifndef OSIP_MONOTHREAD
-      osip_mutex_unlock(osip->ict_fastmutex);
-#endif
-      return;
+    for (i = 0; i < osip->nb_shards; i++) {
+      osip_timers_gettimeout(osip->shards[i], &next);
+      min_timercmp(lower_tv, &next);
+    }
 
-    } else {
-      if (tr->state == ICT_CALLING)
-        min_timercmp(lower_tv, &tr->ict_context->timer_b_start);
+    return;
+  }
 
-      if (tr->state == ICT_CALLING)
-        min_timercmp(lower_tv, &tr->ict_context->timer_a_start);
+  osip_gettimeofday(&now, NULL);
+  lower_tv->tv_sec = now.tv_sec + 3600 * 24 * 365; /* wake up evry year :-) */
+  lower_tv->tv_usec = now.tv_usec;
 
-      if (tr->state == ICT_COMPLETED)
-        min_timercmp(lower_tv, &tr->ict_context->timer_d_start);
+  if (__osip_ready_size((osip_ready_t *) osip->osip_ict_ready) > 0) {
+    OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO4, NULL, "1 Pending event already in transaction !\n"));
+    lower_tv->tv_sec = 0;
+    lower_tv->tv_usec = 0;
+    return;
+  }
 
-      if (osip_timercmp(&now, lower_tv, >=)) {
-        lower_tv->tv_sec = 0;
-        lower_tv->tv_usec = 0;
+  /* the timer wheels give the next expiration of each kind of transaction */
 #ifndef OSIP_MONOTHREAD
-        osip_mutex_unlock(osip->ict_fastmutex);
+  osip_mutex_lock(osip->ict_fastmutex);
 #endif
-        return;
-      }
-    }
 
-    tr = (osip_transaction_t *) osip_list_get_next(&iterator);
-  }
+  if (__osip_wheel_next((osip_wheel_t *) osip->osip_ict_timers, &now, &next) == OSIP_SUCCESS)
+    min_timercmp(lower_tv, &next);
 
 #ifndef OSIP_MONOTHREAD
   osip_mutex_unlock(osip->ict_fastmutex);
@@ -1349,30 +1851,9 @@ void osip_timers_gettimeout(osip_t *osip, struct timeval *lower_tv) {
 #ifndef OSIP_MONOTHREAD
   osip_mutex_lock(osip->ist_fastmutex);
 #endif
-  /* handle ist timers */
-  tr = (osip_transaction_t *) osip_list_get_first(&osip->osip_ist_transactions, &iterator);
-
-  while (osip_list_iterator_has_elem(iterator)) {
-    if (tr->state == IST_CONFIRMED)
-      min_timercmp(lower_tv, &tr->ist_context->timer_i_start);
-
-    if (tr->state == IST_COMPLETED)
-      min_timercmp(lower_tv, &tr->ist_context->timer_h_start);
-
-    if (tr->state == IST_COMPLETED)
-      min_timercmp(lower_tv, &tr->ist_context->timer_g_start);
-
-    if (osip_timercmp(&now, lower_tv, >=)) {
-      lower_tv->tv_sec = 0;
-      lower_tv->tv_usec = 0;
-#ifndef OSIP_MONOTHREAD
-      osip_mutex_unlock(osip->ist_fastmutex);
-#endif
-      return;
-    }
 
-    tr = (osip_transaction_t *) osip_list_get_next(&iterator);
-  }
+  if (__osip_wheel_next((osip_wheel_t *) osip->osip_ist_timers, &now, &next) == OSIP_SUCCESS)
+    min_timercmp(lower_tv, &next);
 
 #ifndef OSIP_MONOTHREAD
   osip_mutex_unlock(osip->ist_fastmutex);
@@ -1381,30 +1862,9 @@ void osip_timers_gettimeout(osip_t *osip, struct timeval *lower_tv) {
 #ifndef OSIP_MONOTHREAD
   osip_mutex_lock(osip->nict_fastmutex);
 #endif
-  /* handle nict timers */
-  tr = (osip_transaction_t *) osip_list_get_first(&osip->osip_nict_transactions, &iterator);
-
-  while (osip_list_iterator_has_elem(iterator)) {
-    if (tr->state == NICT_COMPLETED)
-      min_timercmp(lower_tv, &tr->nict_context->timer_k_start);
-
-    if (tr->state == NICT_PROCEEDING || tr->state == NICT_TRYING)
-      min_timercmp(lower_tv, &tr->nict_context->timer_f_start);
-
-    if (tr->state == NICT_PROCEEDING || tr->state == NICT_TRYING)
-      min_timercmp(lower_tv, &tr->nict_context->timer_e_start);
-
-    if (osip_timercmp(&now, lower_tv, >=)) {
-      lower_tv->tv_sec = 0;
-      lower_tv->tv_usec = 0;
-#ifndef OSIP_MONOTHREAD
-      osip_mutex_unlock(osip->nict_fastmutex);
-#endif
-      return;
-    }
 
-    tr = (osip_transaction_t *) osip_list_get_next(&iterator);
-  }
+  if (__osip_wheel_next((osip_wheel_t *) osip->osip_nict_timers, &now, &next) == OSIP_SUCCESS)
+    min_timercmp(lower_tv, &next);
 
 #ifndef OSIP_MONOTHREAD
   osip_mutex_unlock(osip->nict_fastmutex);
@@ -1413,55 +1873,36 @@ void osip_timers_gettimeout(osip_t *osip, struct timeval *lower_tv) {
 #ifndef OSIP_MONOTHREAD
   osip_mutex_lock(osip->nist_fastmutex);
 #endif
-  /* handle nist timers */
-  tr = (osip_transaction_t *) osip_list_get_first(&osip->osip_nist_transactions, &iterator);
 
-  while (osip_list_iterator_has_elem(iterator)) {
-    if (tr->state == NIST_COMPLETED)
-      min_timercmp(lower_tv, &tr->nist_context->timer_j_start);
+  if (__osip_wheel_next((osip_wheel_t *) osip->osip_nist_timers, &now, &next) == OSIP_SUCCESS)
+    min_timercmp(lower_tv, &next);
 
-    if (osip_timercmp(&now, lower_tv, >=)) {
-      lower_tv->tv_sec = 0;
-      lower_tv->tv_usec = 0;
 #ifndef OSIP_MONOTHREAD
-      osip_mutex_unlock(osip->nist_fastmutex);
+  osip_mutex_unlock(osip->nist_fastmutex);
 #endif
-      return;
-    }
 
-    tr = (osip_transaction_t *) osip_list_get_next(&iterator);
+  if (osip_timercmp(&now, lower_tv, >=)) {
+    lower_tv->tv_sec = 0;
+    lower_tv->tv_usec = 0;
+    return;
   }
 
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock(osip->nist_fastmutex);
-#endif
-
 #ifndef OSIP_MONOTHREAD
   osip_mutex_lock(osip->ixt_fastmutex);
 #endif
-  {
-    ixt_t *ixt;
-
-    ixt = (ixt_t *) osip_list_get_first(&osip->ixt_retransmissions, &iterator);
 
-    while (osip_list_iterator_has_elem(iterator)) {
-      min_timercmp(lower_tv, &ixt->start);
+  if (__osip_wheel_next((osip_wheel_t *) osip->osip_ixt_timers, &now, &next) == OSIP_SUCCESS)
+    min_timercmp(lower_tv, &next);
 
-      if (osip_timercmp(&now, lower_tv, >=)) {
-        lower_tv->tv_sec = 0;
-        lower_tv->tv_usec = 0;
 #ifndef OSIP_MONOTHREAD
-        osip_mutex_unlock(osip->ixt_fastmutex);
+  osip_mutex_unlock(osip->ixt_fastmutex);
 #endif
-        return;
-      }
 
-      ixt = (ixt_t *) osip_list_get_next(&iterator);
-    }
+  if (osip_timercmp(&now, lower_tv, >=)) {
+    lower_tv->tv_sec = 0;
+    lower_tv->tv_usec = 0;
+    return;
   }
-#ifndef OSIP_MONOTHREAD
-  osip_mutex_unlock(osip->ixt_fastmutex);
-#endif
 
   lower_tv->tv_sec = lower_tv->tv_sec - now.tv_sec;
   lower_tv->tv_usec = lower_tv->tv_usec - now.tv_usec;
@@ -1487,17 +1928,27 @@ void osip_timers_gettimeout(osip_t *osip, struct timeval *lower_tv) {
 
 void osip_timers_ict_execute(osip_t *osip) {
   osip_transaction_t *tr;
-  osip_list_iterator_t iterator;
+  osip_timer_entry_t *entry;
+  struct timeval now;
+
+  if (osip->nb_shards > 0) {
+    __osip_shards_run(osip, osip_timers_ict_execute);
+    return;
+  }
 
 #ifndef OSIP_MONOTHREAD
   osip_mutex_lock(osip->ict_fastmutex);
 #endif
-  /* handle ict timers */
-  tr = (osip_transaction_t *) osip_list_get_first(&osip->osip_ict_transactions, &iterator);
+  /* handle ict timers: only transactions with an expired timer are checked */
+  osip_gettimeofday(&now, NULL);
+  entry = __osip_wheel_expire((osip_wheel_t *) osip->osip_ict_timers, &now);
 
-  while (osip_list_iterator_has_elem(iterator)) {
+  while (entry != NULL) {
+    osip_timer_entry_t *next = entry->next;
     osip_event_t *evt;
 
+    tr = (osip_transaction_t *) entry->element;
+
     if (1 <= osip_fifo_size(tr->transactionff)) {
       OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO4, NULL, "1 Pending event already in transaction !\n"));
 
@@ -1505,24 +1956,26 @@ void osip_timers_ict_execute(osip_t *osip) {
       evt = __osip_ict_need_timer_b_event(tr->ict_context, tr->state, tr->transactionid);
 
       if (evt != NULL)
-        osip_fifo_add(tr->transactionff, evt);
+        osip_transaction_add_event(tr, evt);
 
       else {
         evt = __osip_ict_need_timer_a_event(tr->ict_context, tr->state, tr->transactionid);
 
         if (evt != NULL)
-          osip_fifo_add(tr->transactionff, evt);
+          osip_transaction_add_event(tr, evt);
 
         else {
           evt = __osip_ict_need_timer_d_event(tr->ict_context, tr->state, tr->transactionid);
 
           if (evt != NULL)
-            osip_fifo_add(tr->transactionff, evt);
+            osip_transaction_add_event(tr, evt);
         }
       }
     }
 
-    tr = (osip_transaction_t *) osip_list_get_next(&iterator);
+    /* timer is kept until the event is processed */
+    __osip_transaction_schedule_timers((osip_wheel_t *) osip->osip_ict_timers, tr);
+    entry = next;
   }
 
 #ifndef OSIP_MONOTHREAD
@@ -1532,37 +1985,49 @@ void osip_timers_ict_execute(osip_t *osip) {
 
 void osip_timers_ist_execute(osip_t *osip) {
   osip_transaction_t *tr;
-  osip_list_iterator_t iterator;
+  osip_timer_entry_t *entry;
+  struct timeval now;
+
+  if (osip->nb_shards > 0) {
+    __osip_shards_run(osip, osip_timers_ist_execute);
+    return;
+  }
 
 #ifndef OSIP_MONOTHREAD
   osip_mutex_lock(osip->ist_fastmutex);
 #endif
-  /* handle ist timers */
-  tr = (osip_transaction_t *) osip_list_get_first(&osip->osip_ist_transactions, &iterator);
+  /* handle ist timers: only transactions with an expired timer are checked */
+  osip_gettimeofday(&now, NULL);
+  entry = __osip_wheel_expire((osip_wheel_t *) osip->osip_ist_timers, &now);
 
-  while (osip_list_iterator_has_elem(iterator)) {
+  while (entry != NULL) {
+    osip_timer_entry_t *next = entry->next;
     osip_event_t *evt;
 
+    tr = (osip_transaction_t *) entry->element;
+
     evt = __osip_ist_need_timer_i_event(tr->ist_context, tr->state, tr->transactionid);
 
     if (evt != NULL)
-      osip_fifo_add(tr->transactionff, evt);
+      osip_transaction_add_event(tr, evt);
 
     else {
       evt = __osip_ist_need_timer_h_event(tr->ist_context, tr->state, tr->transactionid);
 
       if (evt != NULL)
-        osip_fifo_add(tr->transactionff, evt);
+        osip_transaction_add_event(tr, evt);
 
       else {
         evt = __osip_ist_need_timer_g_event(tr->ist_context, tr->state, tr->transactionid);
 
         if (evt != NULL)
-          osip_fifo_add(tr->transactionff, evt);
+          osip_transaction_add_event(tr, evt);
       }
     }
 
-    tr = (osip_transaction_t *) osip_list_get_next(&iterator);
+    /* timer is kept until the event is processed */
+    __osip_transaction_schedule_timers((osip_wheel_t *) osip->osip_ist_timers, tr);
+    entry = next;
   }
 
 #ifndef OSIP_MONOTHREAD
@@ -1572,37 +2037,49 @@ void osip_timers_ist_execute(osip_t *osip) {
 
 void osip_timers_nict_execute(osip_t *osip) {
   osip_transaction_t *tr;
-  osip_list_iterator_t iterator;
+  osip_timer_entry_t *entry;
+  struct timeval now;
+
+  if (osip->nb_shards > 0) {
+    __osip_shards_run(osip, osip_timers_nict_execute);
+    return;
+  }
 
 #ifndef OSIP_MONOTHREAD
   osip_mutex_lock(osip->nict_fastmutex);
 #endif
-  /* handle nict timers */
-  tr = (osip_transaction_t *) osip_list_get_first(&osip->osip_nict_transactions, &iterator);
+  /* handle nict timers: only transactions with an expired timer are checked */
+  osip_gettimeofday(&now, NULL);
+  entry = __osip_wheel_expire((osip_wheel_t *) osip->osip_nict_timers, &now);
 
-  while (osip_list_iterator_has_elem(iterator)) {
+  while (entry != NULL) {
+    osip_timer_entry_t *next = entry->next;
     osip_event_t *evt;
 
+    tr = (osip_transaction_t *) entry->element;
+
     evt = __osip_nict_need_timer_k_event(tr->nict_context, tr->state, tr->transactionid);
 
     if (evt != NULL)
-      osip_fifo_add(tr->transactionff, evt);
+      osip_transaction_add_event(tr, evt);
 
     else {
       evt = __osip_nict_need_timer_f_event(tr->nict_context, tr->state, tr->transactionid);
 
       if (evt != NULL)
-        osip_fifo_add(tr->transactionff, evt);
+        osip_transaction_add_event(tr, evt);
 
       else {
         evt = __osip_nict_need_timer_e_event(tr->nict_context, tr->state, tr->transactionid);
 
         if (evt != NULL)
-          osip_fifo_add(tr->transactionff, evt);
+          osip_transaction_add_event(tr, evt);
       }
     }
 
-    tr = (osip_transaction_t *) osip_list_get_next(&iterator);
+    /* timer is kept until the event is processed */
+    __osip_transaction_schedule_timers((osip_wheel_t *) osip->osip_nict_timers, tr);
+    entry = next;
   }
 
 #ifndef OSIP_MONOTHREAD
@@ -1612,23 +2089,35 @@ void osip_timers_nict_execute(osip_t *osip) {
 
 void osip_timers_nist_execute(osip_t *osip) {
   osip_transaction_t *tr;
-  osip_list_iterator_t iterator;
+  osip_timer_entry_t *entry;
+  struct timeval now;
+
+  if (osip->nb_shards > 0) {
+    __osip_shards_run(osip, osip_timers_nist_execute);
+    return;
+  }
 
 #ifndef OSIP_MONOTHREAD
   osip_mutex_lock(osip->nist_fastmutex);
 #endif
-  /* handle nist timers */
-  tr = (osip_transaction_t *) osip_list_get_first(&osip->osip_nist_transactions, &iterator);
+  /* handle nist timers: only transactions with an expired timer are checked */
+  osip_gettimeofday(&now, NULL);
+  entry = __osip_wheel_expire((osip_wheel_t *) osip->osip_nist_timers, &now);
 
-  while (osip_list_iterator_has_elem(iterator)) {
+  while (entry != NULL) {
+    osip_timer_entry_t *next = entry->next;
     osip_event_t *evt;
 
+    tr = (osip_transaction_t *) entry->element;
+
     evt = __osip_nist_need_timer_j_event(tr->nist_context, tr->state, tr->transactionid);
 
     if (evt != NULL)
-      osip_fifo_add(tr->transactionff, evt);
+      osip_transaction_add_event(tr, evt);
 
-    tr = (osip_transaction_t *) osip_list_get_next(&iterator);
+    /* timer is kept until the event is processed */
+    __osip_transaction_schedule_timers((osip_wheel_t *) osip->osip_nist_timers, tr);
+    entry = next;
   }
 
 #ifndef OSIP_MONOTHREAD
@@ -1637,7 +2126,12 @@ void osip_timers_nist_execute(osip_t *osip) {
 }
 
 void osip_set_cb_send_message(osip_t *cf, int (*cb)(osip_transaction_t *, osip_message_t *, char *, int, int)) {
+  int i;
+
   cf->cb_send_message = cb;
+
+  for (i = 0; i < cf->nb_shards; i++)
+    osip_set_cb_send_message(cf->shards[i], cb);
 }
 
 void __osip_message_callback(int type, osip_transaction_t *tr, osip_message_t *msg) {
@@ -1685,6 +2179,8 @@ void __osip_transport_error_callback(int type, osip_transaction_t *tr, int error
 }
 
 int osip_set_message_callback(osip_t *config, int type, osip_message_cb_t cb) {
+  int i;
+
   if (type >= OSIP_MESSAGE_CALLBACK_COUNT) {
     OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL, "invalid callback type %d\n", type));
     return OSIP_BADPARAMETER;
@@ -1692,25 +2188,40 @@ int osip_set_message_callback(osip_t *config, int type, osip_message_cb_t cb) {
 
   config->msg_callbacks[type] = cb;
 
+  for (i = 0; i < config->nb_shards; i++)
+    config->shards[i]->msg_callbacks[type] = cb;
+
   return OSIP_SUCCESS;
 }
 
 int osip_set_kill_transaction_callback(osip_t *config, int type, osip_kill_transaction_cb_t cb) {
+  int i;
+
   if (type >= OSIP_KILL_CALLBACK_COUNT) {
     OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL, "invalid callback type %d\n", type));
     return OSIP_BADPARAMETER;
   }
 
   config->kill_callbacks[type] = cb;
+
+  for (i = 0; i < config->nb_shards; i++)
+    config->shards[i]->kill_callbacks[type] = cb;
+
   return OSIP_SUCCESS;
 }
 
 int osip_set_transport_error_callback(osip_t *config, int type, osip_transport_error_cb_t cb) {
+  int i;
+
   if (type >= OSIP_TRANSPORT_ERROR_CALLBACK_COUNT) {
     OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL, "invalid callback type %d\n", type));
     return OSIP_BADPARAMETER;
   }
 
   config->tp_error_callbacks[type] = cb;
+
+  for (i = 0; i < config->nb_shards; i++)
+    config->shards[i]->tp_error_callbacks[type] = cb;
+
   return OSIP_SUCCESS;
 }
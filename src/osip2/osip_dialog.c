@@ -40,7 +40,7 @@ int osip_dialog_update_route_set_as_uas(osip_dialog_t *dialog, osip_message_t *i
   if (invite == NULL)
     return OSIP_BADPARAMETER;
 
-  if (osip_list_eol(&invite->contacts, 0)) {
+  if (osip_message_get_contact(invite, 0, &contact) < 0) {
     OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_WARNING, NULL, "missing a contact in invite!\n"));
 
   } else {
@@ -49,7 +49,6 @@ int osip_dialog_update_route_set_as_uas(osip_dialog_t *dialog, osip_message_t *i
     }
 
     dialog->remote_contact_uri = NULL;
-    contact = osip_list_get(&invite->contacts, 0);
     i = osip_contact_clone(contact, &(dialog->remote_contact_uri));
 
     if (i != 0)
@@ -81,7 +80,7 @@ int osip_dialog_update_route_set_as_uac(osip_dialog_t *dialog, osip_message_t *r
   if (response == NULL)
     return OSIP_BADPARAMETER;
 
-  if (osip_list_eol(&response->contacts, 0)) { /* no contact header in response? */
+  if (osip_message_get_contact(response, 0, &contact) < 0) { /* no contact header in response? */
     OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_WARNING, NULL, "missing a contact in response!\n"));
 
   } else {
@@ -92,7 +91,6 @@ int osip_dialog_update_route_set_as_uac(osip_dialog_t *dialog, osip_message_t *r
     }
 
     dialog->remote_contact_uri = NULL;
-    contact = osip_list_get(&response->contacts, 0);
     i = osip_contact_clone(contact, &(dialog->remote_contact_uri));
 
     if (i != 0)
@@ -430,8 +428,7 @@ static int __osip_dialog_init(osip_dialog_t **dialog, osip_message_t *invite, os
   {
     osip_contact_t *contact;
 
-    if (!osip_list_eol(&remote_msg->contacts, 0)) {
-      contact = osip_list_get(&remote_msg->contacts, 0);
+    if (osip_message_get_contact(remote_msg, 0, &contact) >= 0) {
       i = osip_contact_clone(contact, &((*dialog)->remote_contact_uri));
 
       if (i != 0) {
@@ -24,8 +24,9 @@
 
 /* Create a sipevent according to the SIP message buf. */
 /* INPUT : char *buf | message as a string.            */
+/* INPUT : char *scratch | work buffer (or NULL).      */
 /* return NULL  if message cannot be parsed            */
-osip_event_t *osip_parse(const char *buf, size_t length) {
+osip_event_t *__osip_parse(const char *buf, size_t length, char *scratch, size_t scratch_size) {
   int i;
   osip_event_t *se = __osip_event_new(UNKNOWN_EVT, 0);
 
@@ -40,7 +41,7 @@ osip_event_t *osip_parse(const char *buf, size_t length) {
     return NULL;
   }
 
-  if (osip_message_parse(se->sip, buf, length) != 0) {
+  if (osip_message_parse_with_scratch(se->sip, buf, length, scratch, scratch_size) != 0) {
     OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL, "could not parse message\n"));
     osip_message_free(se->sip);
     osip_free(se);
@@ -64,6 +65,42 @@ osip_event_t *osip_parse(const char *buf, size_t length) {
   }
 }
 
+osip_event_t *osip_parse(const char *buf, size_t length) {
+  return __osip_parse(buf, length, NULL, 0);
+}
+
+/* parse bufs[first..last[ with one work buffer */
+int __osip_parse_batch(const char *const *bufs, const size_t *lengths, int first, int last, osip_event_t **events) {
+  char *scratch;
+  size_t scratch_size = 0;
+  int nb = 0;
+  int i;
+
+  for (i = first; i < last; i++) {
+    if (lengths[i] + 2 > scratch_size)
+      scratch_size = lengths[i] + 2;
+  }
+
+  scratch = (char *) osip_malloc(scratch_size);
+
+  for (i = first; i < last; i++) {
+    events[i] = __osip_parse(bufs[i], lengths[i], scratch, (scratch != NULL) ? scratch_size : 0);
+
+    if (events[i] != NULL)
+      nb++;
+  }
+
+  osip_free(scratch);
+  return nb;
+}
+
+int osip_parse_batch(const char *const *bufs, const size_t *lengths, int count, osip_event_t **events) {
+  if (bufs == NULL || lengths == NULL || events == NULL || count < 0)
+    return OSIP_BADPARAMETER;
+
+  return __osip_parse_batch(bufs, lengths, 0, count, events);
+}
+
 /* allocates an event from retransmitter.             */
 /* USED ONLY BY THE STACK.                            */
 /* INPUT : int transactionid | id of the transaction. */
@@ -0,0 +1,415 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <osip2/internal.h>
+
+#ifndef OSIP_MONOTHREAD
+
+#include <osip2/osip.h>
+#include <osip2/osip_mt.h>
+
+#include "xixt.h"
+
+/* Each thread of the executor has its own queue of transactions with
+   pending events. Transactions are queued in the queue of a thread
+   selected by transactionid, so that the same transaction usually
+   runs on the same thread. A thread takes transactions from the head
+   of its own queue and, when it is empty, from the tail of the queues
+   of the other threads.
+
+   A transaction is in at most one queue (ready_busy is set until its
+   events are processed), so that its events are never processed
+   concurrently. The links of the queues are the ready_* members of
+   transactions, which are not used by the list of osip_t while the
+   transaction is busy.
+
+   The semaphore is posted once per queued transaction: a thread
+   looks in all queues after each wake up, so that no transaction is
+   left behind when another thread takes it first.
+
+   osip_executor_parse_batch() publishes a batch of messages to parse:
+   the calling thread and the woken threads claim slices of it until
+   all messages are claimed, before looking at their queues. */
+
+typedef struct osip_worker osip_worker_t;
+
+struct osip_worker {
+  osip_executor_t *executor;
+  struct osip_thread *thread;
+  struct osip_mutex *mutex;
+  osip_transaction_t *first;
+  osip_transaction_t *last;
+  int index;
+};
+
+typedef struct osip_batch osip_batch_t;
+
+struct osip_batch {
+  const char *const *bufs;
+  const size_t *lengths;
+  osip_event_t **events;
+  int count;
+  int slice; /* number of messages claimed at once */
+  int next;  /* first message not claimed yet */
+  int left;  /* number of messages not parsed yet */
+  int nb;    /* number of events created */
+  struct osip_sem *done;
+};
+
+struct osip_executor {
+  osip_t *osip;
+  osip_worker_t *workers;
+  int nb_workers;
+  struct osip_sem *sem;
+  struct osip_mutex *mutex;
+  int stop;
+  osip_batch_t *batch; /* batch being parsed (protected by mutex) */
+};
+
+static void __osip_worker_push(osip_worker_t *worker, osip_transaction_t *transaction) {
+  osip_mutex_lock(worker->mutex);
+  transaction->ready_next = NULL;
+  transaction->ready_prev = worker->last;
+
+  if (worker->last != NULL)
+    worker->last->ready_next = transaction;
+
+  else
+    worker->first = transaction;
+
+  worker->last = transaction;
+  osip_mutex_unlock(worker->mutex);
+}
+
+/* the owner of the queue takes the oldest transaction */
+static osip_transaction_t *__osip_worker_pop(osip_worker_t *worker) {
+  osip_transaction_t *transaction;
+
+  osip_mutex_lock(worker->mutex);
+  transaction = worker->first;
+
+  if (transaction != NULL) {
+    worker->first = transaction->ready_next;
+
+    if (worker->first != NULL)
+      worker->first->ready_prev = NULL;
+
+    else
+      worker->last = NULL;
+
+    transaction->ready_next = NULL;
+  }
+
+  osip_mutex_unlock(worker->mutex);
+  return transaction;
+}
+
+/* other threads take the newest transaction */
+static osip_transaction_t *__osip_worker_steal(osip_worker_t *worker) {
+  osip_transaction_t *transaction;
+
+  osip_mutex_lock(worker->mutex);
+  transaction = worker->last;
+
+  if (transaction != NULL) {
+    worker->last = transaction->ready_prev;
+
+    if (worker->last != NULL)
+      worker->last->ready_next = NULL;
+
+    else
+      worker->first = NULL;
+
+    transaction->ready_prev = NULL;
+  }
+
+  osip_mutex_unlock(worker->mutex);
+  return transaction;
+}
+
+static osip_transaction_t *__osip_worker_take(osip_worker_t *worker) {
+  osip_executor_t *executor = worker->executor;
+  osip_transaction_t *transaction;
+  int i;
+
+  transaction = __osip_worker_pop(worker);
+
+  for (i = 1; transaction == NULL && i < executor->nb_workers; i++)
+    transaction = __osip_worker_steal(&executor->workers[(worker->index + i) % executor->nb_workers]);
+
+  return transaction;
+}
+
+/* parse slices of the current batch until all of them are claimed */
+static void __osip_executor_run_batch(osip_executor_t *executor) {
+  osip_batch_t *batch;
+  int first;
+  int last;
+  int nb;
+
+  for (;;) {
+    osip_mutex_lock(executor->mutex);
+    batch = executor->batch;
+
+    if (batch == NULL || batch->next >= batch->count) {
+      osip_mutex_unlock(executor->mutex);
+      return;
+    }
+
+    first = batch->next;
+    last = (batch->count - first > batch->slice) ? first + batch->slice : batch->count;
+    batch->next = last;
+    osip_mutex_unlock(executor->mutex);
+
+    nb = __osip_parse_batch(batch->bufs, batch->lengths, first, last, batch->events);
+
+    osip_mutex_lock(executor->mutex);
+    batch->nb += nb;
+    batch->left -= last - first;
+
+    if (batch->left == 0)
+      osip_sem_post(batch->done);
+
+    osip_mutex_unlock(executor->mutex);
+  }
+}
+
+static void *__osip_worker_thread(void *arg) {
+  osip_worker_t *worker = (osip_worker_t *) arg;
+  osip_executor_t *executor = worker->executor;
+  osip_transaction_t *transaction;
+  int stop;
+
+  for (;;) {
+    osip_sem_wait(executor->sem);
+
+    osip_mutex_lock(executor->mutex);
+    stop = executor->stop;
+    osip_mutex_unlock(executor->mutex);
+
+    if (stop != 0)
+      break;
+
+    __osip_executor_run_batch(executor);
+
+    transaction = __osip_worker_take(worker);
+
+    while (transaction != NULL) {
+      __osip_transaction_run(transaction);
+      transaction = __osip_worker_take(worker);
+    }
+  }
+
+  return NULL;
+}
+
+void __osip_executor_push(osip_executor_t *executor, osip_transaction_t *transaction) {
+  __osip_worker_push(&executor->workers[(unsigned int) transaction->transactionid % executor->nb_workers], transaction);
+  osip_sem_post(executor->sem);
+}
+
+static void __osip_executor_attach(osip_t *osip, osip_executor_t *executor) {
+  int i;
+
+  if (osip->nb_shards > 0) {
+    for (i = 0; i < osip->nb_shards; i++)
+      __osip_executor_attach(osip->shards[i], executor);
+
+    return;
+  }
+
+  __osip_ready_set_executor((osip_ready_t *) osip->osip_ict_ready, executor);
+  __osip_ready_set_executor((osip_ready_t *) osip->osip_ist_ready, executor);
+  __osip_ready_set_executor((osip_ready_t *) osip->osip_nict_ready, executor);
+  __osip_ready_set_executor((osip_ready_t *) osip->osip_nist_ready, executor);
+}
+
+static void __osip_executor_release(osip_executor_t *executor) {
+  int i;
+
+  for (i = 0; i < executor->nb_workers; i++) {
+    if (executor->workers[i].mutex != NULL)
+      osip_mutex_destroy(executor->workers[i].mutex);
+  }
+
+  if (executor->sem != NULL)
+    osip_sem_destroy(executor->sem);
+
+  if (executor->mutex != NULL)
+    osip_mutex_destroy(executor->mutex);
+
+  osip_free(executor->workers);
+  osip_free(executor);
+}
+
+static void __osip_executor_stop(osip_executor_t *executor) {
+  int i;
+
+  osip_mutex_lock(executor->mutex);
+  executor->stop = 1;
+  osip_mutex_unlock(executor->mutex);
+
+  for (i = 0; i < executor->nb_workers; i++)
+    osip_sem_post(executor->sem);
+
+  for (i = 0; i < executor->nb_workers; i++) {
+    if (executor->workers[i].thread != NULL) {
+      osip_thread_join(executor->workers[i].thread);
+      osip_free(executor->workers[i].thread);
+      executor->workers[i].thread = NULL;
+    }
+  }
+}
+
+int osip_executor_init(osip_executor_t **executor, osip_t *osip, int nb_workers) {
+  osip_executor_t *ex;
+  int i;
+
+  *executor = NULL;
+
+  if (osip == NULL || nb_workers <= 0)
+    return OSIP_BADPARAMETER;
+
+  ex = (osip_executor_t *) osip_malloc(sizeof(osip_executor_t));
+
+  if (ex == NULL)
+    return OSIP_NOMEM;
+
+  memset(ex, 0, sizeof(osip_executor_t));
+  ex->osip = osip;
+
+  ex->workers = (osip_worker_t *) osip_malloc(sizeof(osip_worker_t) * nb_workers);
+
+  if (ex->workers == NULL) {
+    osip_free(ex);
+    return OSIP_NOMEM;
+  }
+
+  memset(ex->workers, 0, sizeof(osip_worker_t) * nb_workers);
+  ex->nb_workers = nb_workers;
+  ex->sem = osip_sem_init(0);
+  ex->mutex = osip_mutex_init();
+
+  if (ex->sem == NULL || ex->mutex == NULL) {
+    __osip_executor_release(ex);
+    return OSIP_NOMEM;
+  }
+
+  for (i = 0; i < nb_workers; i++) {
+    ex->workers[i].executor = ex;
+    ex->workers[i].index = i;
+    ex->workers[i].mutex = osip_mutex_init();
+
+    if (ex->workers[i].mutex == NULL) {
+      __osip_executor_release(ex);
+      return OSIP_NOMEM;
+    }
+  }
+
+  for (i = 0; i < nb_workers; i++) {
+    ex->workers[i].thread = osip_thread_create(20000, __osip_worker_thread, &ex->workers[i]);
+
+    if (ex->workers[i].thread == NULL) {
+      OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL, "cannot start thread of executor\n"));
+      __osip_executor_stop(ex);
+      __osip_executor_release(ex);
+      return OSIP_UNDEFINED_ERROR;
+    }
+  }
+
+  __osip_executor_attach(osip, ex);
+
+  *executor = ex;
+  return OSIP_SUCCESS;
+}
+
+void osip_executor_free(osip_executor_t *executor) {
+  osip_transaction_t *transaction;
+  int i;
+
+  if (executor == NULL)
+    return;
+
+  __osip_executor_stop(executor);
+
+  /* transactions left in the queues go back in the lists of osip_t */
+  __osip_executor_attach(executor->osip, NULL);
+
+  for (i = 0; i < executor->nb_workers; i++) {
+    transaction = __osip_worker_pop(&executor->workers[i]);
+
+    while (transaction != NULL) {
+      __osip_transaction_unset_busy(transaction);
+      transaction = __osip_worker_pop(&executor->workers[i]);
+    }
+  }
+
+  __osip_executor_release(executor);
+}
+
+int osip_executor_parse_batch(osip_executor_t *executor, const char *const *bufs, const size_t *lengths, int count, osip_event_t **events) {
+  osip_batch_t batch;
+  int i;
+
+  if (executor == NULL || bufs == NULL || lengths == NULL || events == NULL || count < 0)
+    return OSIP_BADPARAMETER;
+
+  memset(&batch, 0, sizeof(osip_batch_t));
+  batch.bufs = bufs;
+  batch.lengths = lengths;
+  batch.events = events;
+  batch.count = count;
+  batch.left = count;
+  /* about two slices per thread: enough to balance, few work buffers */
+  batch.slice = (count + 2 * (executor->nb_workers + 1) - 1) / (2 * (executor->nb_workers + 1));
+
+  if (batch.slice == 0)
+    return 0;
+
+  batch.done = osip_sem_init(0);
+
+  if (batch.done == NULL)
+    return osip_parse_batch(bufs, lengths, count, events);
+
+  osip_mutex_lock(executor->mutex);
+
+  if (executor->batch != NULL) { /* another thread is parsing a batch */
+    osip_mutex_unlock(executor->mutex);
+    osip_sem_destroy(batch.done);
+    return osip_parse_batch(bufs, lengths, count, events);
+  }
+
+  executor->batch = &batch;
+  osip_mutex_unlock(executor->mutex);
+
+  for (i = 1; i < (count + batch.slice - 1) / batch.slice && i <= executor->nb_workers; i++)
+    osip_sem_post(executor->sem);
+
+  __osip_executor_run_batch(executor);
+  osip_sem_wait(batch.done);
+
+  osip_mutex_lock(executor->mutex);
+  executor->batch = NULL;
+  osip_mutex_unlock(executor->mutex);
+
+  osip_sem_destroy(batch.done);
+  return batch.nb;
+}
+
+#endif
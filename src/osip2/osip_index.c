@@ -0,0 +1,206 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <osip2/internal.h>
+#include <osip2/osip.h>
+
+#include "xixt.h"
+
+/* open addressing table with linear probing: several elements may share
+   the same key, the caller is responsible for checking each candidate. */
+
+#define OSIP_INDEX_MIN_SIZE 64
+
+typedef struct osip_index_slot osip_index_slot_t;
+
+struct osip_index_slot {
+  unsigned long key;
+  void *element;
+};
+
+struct osip_index {
+  osip_index_slot_t *slots;
+  int size;       /* always a power of 2 */
+  int nb_elt;     /* slots in use */
+  int nb_deleted; /* tombstones */
+};
+
+/* marker for a deleted slot: probing must continue after it */
+static int osip_index_deleted;
+#define OSIP_INDEX_DELETED ((void *) &osip_index_deleted)
+
+static int __osip_index_home(osip_index_t *index, unsigned long key) {
+  key ^= key >> 15;
+  key *= 2654435761UL;
+  key ^= key >> 13;
+  return (int) (key & (unsigned long) (index->size - 1));
+}
+
+static int __osip_index_resize(osip_index_t *index, int size) {
+  osip_index_slot_t *old_slots = index->slots;
+  int old_size = index->size;
+  int i;
+
+  index->slots = (osip_index_slot_t *) osip_malloc(sizeof(osip_index_slot_t) * size);
+
+  if (index->slots == NULL) {
+    index->slots = old_slots;
+    return OSIP_NOMEM;
+  }
+
+  memset(index->slots, 0, sizeof(osip_index_slot_t) * size);
+  index->size = size;
+  index->nb_elt = 0;
+  index->nb_deleted = 0;
+
+  for (i = 0; i < old_size; i++) {
+    if (old_slots[i].element != NULL && old_slots[i].element != OSIP_INDEX_DELETED) {
+      int pos = __osip_index_home(index, old_slots[i].key);
+
+      while (index->slots[pos].element != NULL)
+        pos = (pos + 1) & (size - 1);
+
+      index->slots[pos] = old_slots[i];
+      index->nb_elt++;
+    }
+  }
+
+  osip_free(old_slots);
+  return OSIP_SUCCESS;
+}
+
+int __osip_index_init(osip_index_t **index) {
+  *index = (osip_index_t *) osip_malloc(sizeof(osip_index_t));
+
+  if (*index == NULL)
+    return OSIP_NOMEM;
+
+  (*index)->slots = (osip_index_slot_t *) osip_malloc(sizeof(osip_index_slot_t) * OSIP_INDEX_MIN_SIZE);
+
+  if ((*index)->slots == NULL) {
+    osip_free(*index);
+    *index = NULL;
+    return OSIP_NOMEM;
+  }
+
+  memset((*index)->slots, 0, sizeof(osip_index_slot_t) * OSIP_INDEX_MIN_SIZE);
+  (*index)->size = OSIP_INDEX_MIN_SIZE;
+  (*index)->nb_elt = 0;
+  (*index)->nb_deleted = 0;
+  return OSIP_SUCCESS;
+}
+
+void __osip_index_free(osip_index_t *index) {
+  if (index == NULL)
+    return;
+
+  osip_free(index->slots);
+  osip_free(index);
+}
+
+int __osip_index_add(osip_index_t *index, unsigned long key, void *element) {
+  int pos;
+
+  if (index == NULL || element == NULL)
+    return OSIP_BADPARAMETER;
+
+  /* keep the load (including tombstones) under 1/2 */
+  if ((index->nb_elt + index->nb_deleted + 1) * 2 > index->size) {
+    int size = index->size;
+
+    if ((index->nb_elt + 1) * 4 > size)
+      size = size * 2;
+
+    if (__osip_index_resize(index, size) != OSIP_SUCCESS && index->nb_elt + index->nb_deleted + 1 >= index->size)
+      return OSIP_NOMEM;
+  }
+
+  pos = __osip_index_home(index, key);
+
+  while (index->slots[pos].element != NULL && index->slots[pos].element != OSIP_INDEX_DELETED)
+    pos = (pos + 1) & (index->size - 1);
+
+  if (index->slots[pos].element == OSIP_INDEX_DELETED)
+    index->nb_deleted--;
+
+  index->slots[pos].key = key;
+  index->slots[pos].element = element;
+  index->nb_elt++;
+  return OSIP_SUCCESS;
+}
+
+int __osip_index_remove(osip_index_t *index, unsigned long key, void *element) {
+  int pos;
+  int count;
+
+  if (index == NULL || element == NULL)
+    return OSIP_BADPARAMETER;
+
+  pos = __osip_index_home(index, key);
+
+  for (count = 0; count < index->size && index->slots[pos].element != NULL; count++) {
+    if (index->slots[pos].element == element && index->slots[pos].key == key) {
+      index->slots[pos].element = OSIP_INDEX_DELETED;
+      index->nb_elt--;
+      index->nb_deleted++;
+      return OSIP_SUCCESS;
+    }
+
+    pos = (pos + 1) & (index->size - 1);
+  }
+
+  return OSIP_UNDEFINED_ERROR;
+}
+
+void *__osip_index_find(osip_index_t *index, unsigned long key, int *pos) {
+  int count;
+  int i;
+
+  if (index == NULL)
+    return NULL;
+
+  if (*pos < 0)
+    i = __osip_index_home(index, key);
+
+  else
+    i = (*pos + 1) & (index->size - 1);
+
+  for (count = 0; count < index->size && index->slots[i].element != NULL; count++) {
+    if (index->slots[i].element != OSIP_INDEX_DELETED && index->slots[i].key == key) {
+      *pos = i;
+      return index->slots[i].element;
+    }
+
+    i = (i + 1) & (index->size - 1);
+  }
+
+  *pos = index->size;
+  return NULL;
+}
+
+unsigned long __osip_index_hash(unsigned long hash, const char *str) {
+  /* same function as osip_hash(), but can be chained over several strings */
+  if (str == NULL)
+    return hash * 33;
+
+  while (*str != '\0')
+    hash = ((hash << 5) + hash) + (unsigned char) *str++;
+
+  return ((hash << 5) + hash) + '\n';
+}
@@ -20,6 +20,8 @@
 #include <osip2/internal.h>
 #include <osip2/osip.h>
 
+#include <stddef.h>
+
 #include "fsm.h"
 #include "xixt.h"
 
@@ -112,6 +114,11 @@ static int __osip_transaction_set_cseq(osip_transaction_t *transaction, osip_cse
   return i;
 }
 
+/* called by transactionff after an event is added */
+static void __osip_transaction_notify(void *arg) {
+  __osip_transaction_set_ready((osip_transaction_t *) arg);
+}
+
 int osip_transaction_init(osip_transaction_t **transaction, osip_fsm_type_t ctx_type, osip_t *osip, osip_message_t *request) {
   osip_via_t *topvia;
 
@@ -128,6 +135,8 @@ int osip_transaction_init(osip_transaction_t **transaction, osip_fsm_type_t ctx_
   if (request->call_id->number == NULL)
     return OSIP_BADPARAMETER;
 
+  osip = osip_select_shard(osip, request);
+
   *transaction = (osip_transaction_t *) osip_malloc(sizeof(osip_transaction_t));
 
   if (*transaction == NULL)
@@ -137,9 +146,17 @@ int osip_transaction_init(osip_transaction_t **transaction, osip_fsm_type_t ctx_
 
   (*transaction)->birth_time = osip_getsystemtime(NULL);
 
-  osip_id_mutex_lock(osip);
-  (*transaction)->transactionid = osip->transactionid++;
-  osip_id_mutex_unlock(osip);
+  /* transactionid must be unique among all shards */
+  if (osip->parent != NULL) {
+    osip_id_mutex_lock(osip->parent);
+    (*transaction)->transactionid = osip->parent->transactionid++;
+    osip_id_mutex_unlock(osip->parent);
+
+  } else {
+    osip_id_mutex_lock(osip);
+    (*transaction)->transactionid = osip->transactionid++;
+    osip_id_mutex_unlock(osip);
+  }
   OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO2, NULL, "allocating transaction resource %i %s\n", (*transaction)->transactionid, request->call_id->number));
 
   /* those lines must be called before "osip_transaction_free" */
@@ -213,7 +230,16 @@ int osip_transaction_init(osip_transaction_t **transaction, osip_fsm_type_t ctx_
     return OSIP_NOMEM;
   }
 
+#ifdef OSIP_LOCKFREE_FIFO
+  /* events are only read by the thread calling osip_*_execute */
+  osip_fifo_init_lockfree((*transaction)->transactionff, (int) offsetof(osip_event_t, fifo_link));
+#else
   osip_fifo_init((*transaction)->transactionff);
+#endif
+
+  /* events added in the fifo, even with osip_fifo_add, queue the transaction */
+  (*transaction)->transactionff->notify = &__osip_transaction_notify;
+  (*transaction)->transactionff->notify_arg = *transaction;
 
   if (ctx_type == ICT) {
     (*transaction)->state = ICT_PRE_CALLING;
@@ -225,7 +251,13 @@ int osip_transaction_init(osip_transaction_t **transaction, osip_fsm_type_t ctx_
       return i;
     }
 
-    __osip_add_ict(osip, *transaction);
+    i = __osip_add_ict(osip, *transaction);
+
+    if (i != 0) {
+      osip_transaction_free2(*transaction);
+      *transaction = NULL;
+      return i;
+    }
 
   } else if (ctx_type == IST) {
     (*transaction)->state = IST_PRE_PROCEEDING;
@@ -237,7 +269,13 @@ int osip_transaction_init(osip_transaction_t **transaction, osip_fsm_type_t ctx_
       return i;
     }
 
-    __osip_add_ist(osip, *transaction);
+    i = __osip_add_ist(osip, *transaction);
+
+    if (i != 0) {
+      osip_transaction_free2(*transaction);
+      *transaction = NULL;
+      return i;
+    }
 
   } else if (ctx_type == NICT) {
     (*transaction)->state = NICT_PRE_TRYING;
@@ -249,7 +287,13 @@ int osip_transaction_init(osip_transaction_t **transaction, osip_fsm_type_t ctx_
       return i;
     }
 
-    __osip_add_nict(osip, *transaction);
+    i = __osip_add_nict(osip, *transaction);
+
+    if (i != 0) {
+      osip_transaction_free2(*transaction);
+      *transaction = NULL;
+      return i;
+    }
 
   } else {
     (*transaction)->state = NIST_PRE_TRYING;
@@ -261,7 +305,13 @@ int osip_transaction_init(osip_transaction_t **transaction, osip_fsm_type_t ctx_
       return i;
     }
 
-    __osip_add_nist(osip, *transaction);
+    i = __osip_add_nist(osip, *transaction);
+
+    if (i != 0) {
+      osip_transaction_free2(*transaction);
+      *transaction = NULL;
+      return i;
+    }
   }
 
   return OSIP_SUCCESS;
@@ -304,6 +354,10 @@ int osip_transaction_free2(osip_transaction_t *transaction) {
   if (transaction == NULL)
     return OSIP_BADPARAMETER;
 
+  /* still used by an executor: it will be freed by the executor */
+  if (__osip_transaction_delay_free(transaction) != 0)
+    return OSIP_SUCCESS;
+
   if (transaction->orig_request != NULL && transaction->orig_request->call_id != NULL && transaction->orig_request->call_id->number != NULL) {
     OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO2, NULL, "free transaction resource %i %s\n", transaction->transactionid, transaction->orig_request->call_id->number));
   }
@@ -356,6 +410,7 @@ int osip_transaction_add_event(osip_transaction_t *transaction, osip_event_t *ev
     return OSIP_BADPARAMETER;
 
   evt->transactionid = transaction->transactionid;
+  /* the fifo queues the transaction once the event is added: see osip_*_execute */
   osip_fifo_add(transaction->transactionff, evt);
   return OSIP_SUCCESS;
 }
@@ -556,6 +611,7 @@ int __osip_transaction_set_state(osip_transaction_t *transaction, state_t state)
     return OSIP_BADPARAMETER;
 
   transaction->state = state;
+  __osip_transaction_update_timers(transaction);
   return OSIP_SUCCESS;
 }
 
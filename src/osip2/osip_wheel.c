@@ -0,0 +1,300 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <osip2/internal.h>
+#include <osip2/osip.h>
+
+#include "xixt.h"
+
+/* Hierarchical timer wheel with a resolution of 1ms.
+
+   level 0 contains entries expiring in the next 64ms (one slot per ms),
+   level 1 in the next 4s (64ms per slot), level 2 in the next 4mn and
+   level 3 in the next 4h30. Entries of a higher level are moved to the
+   lower levels when the wheel reaches their slot.
+
+   Ticks are stored in unsigned long and compared with a signed
+   difference so that wrapping is not an issue. */
+
+#define OSIP_WHEEL_BITS 6
+#define OSIP_WHEEL_SIZE (1 << OSIP_WHEEL_BITS)
+#define OSIP_WHEEL_MASK (OSIP_WHEEL_SIZE - 1)
+#define OSIP_WHEEL_LEVELS 4
+#define OSIP_WHEEL_MAX_DELTA ((1L << (OSIP_WHEEL_BITS * OSIP_WHEEL_LEVELS)) - 1)
+
+struct osip_wheel {
+  osip_timer_entry_t *slots[OSIP_WHEEL_LEVELS * OSIP_WHEEL_SIZE];
+  int nb_entries[OSIP_WHEEL_LEVELS];
+  int nb_total;
+  unsigned long current; /* next tick to process */
+};
+
+static unsigned long __osip_wheel_tick(struct timeval *tv, int round_up) {
+  unsigned long tick = (unsigned long) tv->tv_sec * 1000 + (unsigned long) tv->tv_usec / 1000;
+
+  /* a timer must not be reported before it really expires */
+  if (round_up && tv->tv_usec % 1000 != 0)
+    tick++;
+
+  return tick;
+}
+
+static void __osip_wheel_place(osip_wheel_t *wheel, osip_timer_entry_t *entry) {
+  long delta = (long) (entry->expire - wheel->current);
+  unsigned long pos = entry->expire;
+  int level = 0;
+  int index;
+
+  if (delta < 0) {
+    /* already expired: handle it with the next tick */
+    delta = 0;
+    pos = wheel->current;
+  }
+
+  if (delta > OSIP_WHEEL_MAX_DELTA) {
+    /* will be placed again when reaching this slot */
+    delta = OSIP_WHEEL_MAX_DELTA;
+    pos = wheel->current + OSIP_WHEEL_MAX_DELTA;
+  }
+
+  while (level < OSIP_WHEEL_LEVELS - 1 && delta >= (1L << (OSIP_WHEEL_BITS * (level + 1))))
+    level++;
+
+  index = level * OSIP_WHEEL_SIZE + (int) ((pos >> (OSIP_WHEEL_BITS * level)) & OSIP_WHEEL_MASK);
+
+  entry->prev = NULL;
+  entry->next = wheel->slots[index];
+
+  if (entry->next != NULL)
+    entry->next->prev = entry;
+
+  wheel->slots[index] = entry;
+  entry->slot = index + 1;
+  wheel->nb_entries[level]++;
+  wheel->nb_total++;
+}
+
+/* detach all entries of a slot */
+static osip_timer_entry_t *__osip_wheel_take(osip_wheel_t *wheel, int level, int slot) {
+  int index = level * OSIP_WHEEL_SIZE + slot;
+  osip_timer_entry_t *entries = wheel->slots[index];
+  osip_timer_entry_t *entry;
+
+  wheel->slots[index] = NULL;
+
+  for (entry = entries; entry != NULL; entry = entry->next) {
+    entry->slot = 0;
+    wheel->nb_entries[level]--;
+    wheel->nb_total--;
+  }
+
+  return entries;
+}
+
+static void __osip_wheel_cascade(osip_wheel_t *wheel) {
+  int level;
+
+  for (level = 1; level < OSIP_WHEEL_LEVELS; level++) {
+    int slot = (int) ((wheel->current >> (OSIP_WHEEL_BITS * level)) & OSIP_WHEEL_MASK);
+    osip_timer_entry_t *entry;
+
+    if (wheel->nb_entries[level] > 0) {
+      entry = __osip_wheel_take(wheel, level, slot);
+
+      while (entry != NULL) {
+        osip_timer_entry_t *next = entry->next;
+
+        __osip_wheel_place(wheel, entry);
+        entry = next;
+      }
+    }
+
+    if (slot != 0)
+      break;
+  }
+}
+
+int __osip_wheel_init(osip_wheel_t **wheel) {
+  struct timeval now;
+
+  *wheel = (osip_wheel_t *) osip_malloc(sizeof(osip_wheel_t));
+
+  if (*wheel == NULL)
+    return OSIP_NOMEM;
+
+  memset(*wheel, 0, sizeof(osip_wheel_t));
+
+  osip_gettimeofday(&now, NULL);
+  (*wheel)->current = __osip_wheel_tick(&now, 0);
+  return OSIP_SUCCESS;
+}
+
+void __osip_wheel_free(osip_wheel_t *wheel) {
+  osip_free(wheel);
+}
+
+void __osip_wheel_add(osip_wheel_t *wheel, osip_timer_entry_t *entry, struct timeval *expire) {
+  __osip_wheel_remove(wheel, entry);
+
+  if (wheel->nb_total == 0) {
+    struct timeval now;
+
+    /* nothing to process in between: avoid walking an idle period */
+    osip_gettimeofday(&now, NULL);
+    wheel->current = __osip_wheel_tick(&now, 0);
+  }
+
+  entry->expire = __osip_wheel_tick(expire, 1);
+  __osip_wheel_place(wheel, entry);
+}
+
+void __osip_wheel_remove(osip_wheel_t *wheel, osip_timer_entry_t *entry) {
+  int level;
+
+  if (entry->slot == 0)
+    return;
+
+  if (entry->prev != NULL)
+    entry->prev->next = entry->next;
+
+  else
+    wheel->slots[entry->slot - 1] = entry->next;
+
+  if (entry->next != NULL)
+    entry->next->prev = entry->prev;
+
+  level = (entry->slot - 1) / OSIP_WHEEL_SIZE;
+  wheel->nb_entries[level]--;
+  wheel->nb_total--;
+
+  entry->next = NULL;
+  entry->prev = NULL;
+  entry->slot = 0;
+}
+
+osip_timer_entry_t *__osip_wheel_expire(osip_wheel_t *wheel, struct timeval *now) {
+  unsigned long tick = __osip_wheel_tick(now, 0);
+  osip_timer_entry_t *expired = NULL;
+
+  while ((long) (tick - wheel->current) >= 0) {
+    int slot = (int) (wheel->current & OSIP_WHEEL_MASK);
+    osip_timer_entry_t *entry;
+
+    if (wheel->nb_total == 0) {
+      wheel->current = tick + 1;
+      break;
+    }
+
+    if (slot == 0)
+      __osip_wheel_cascade(wheel);
+
+    entry = __osip_wheel_take(wheel, 0, slot);
+
+    while (entry != NULL) {
+      osip_timer_entry_t *next = entry->next;
+
+      entry->prev = NULL;
+      entry->next = expired;
+      expired = entry;
+      entry = next;
+    }
+
+    wheel->current++;
+
+    if (wheel->nb_entries[0] == 0 && (wheel->current & OSIP_WHEEL_MASK) != 0) {
+      /* nothing can expire before the next cascade */
+      unsigned long next_cascade = (wheel->current | OSIP_WHEEL_MASK) + 1;
+
+      if ((long) (tick - next_cascade) < 0) {
+        wheel->current = tick + 1;
+        break;
+      }
+
+      wheel->current = next_cascade;
+    }
+  }
+
+  return expired;
+}
+
+int __osip_wheel_next(osip_wheel_t *wheel, struct timeval *now, struct timeval *next) {
+  unsigned long tick = 0;
+  int found = 0;
+  int level;
+  int last;
+  int i;
+
+  if (wheel->nb_total == 0)
+    return OSIP_UNDEFINED_ERROR;
+
+  /* entries of level 0 are all in the 64 ticks following current */
+  if (wheel->nb_entries[0] > 0) {
+    for (i = 0; i < OSIP_WHEEL_SIZE; i++) {
+      if (wheel->slots[(wheel->current + i) & OSIP_WHEEL_MASK] != NULL) {
+        tick = wheel->current + i;
+        found = 1;
+        break;
+      }
+    }
+  }
+
+  /* for higher levels, the start of the first used slot is a lower bound:
+     the exact value is known once the entries are moved to level 0 */
+  for (level = 1; level < OSIP_WHEEL_LEVELS; level++) {
+    int shift = OSIP_WHEEL_BITS * level;
+
+    if (wheel->nb_entries[level] == 0)
+      continue;
+
+    /* the slot of current contains the entries of the next round, unless
+       current is the start of this slot and was not processed yet */
+    if ((wheel->current & ((1UL << shift) - 1)) == 0) {
+      i = 0;
+      last = OSIP_WHEEL_SIZE - 1;
+
+    } else {
+      i = 1;
+      last = OSIP_WHEEL_SIZE;
+    }
+
+    for (; i <= last; i++) {
+      unsigned long block = (wheel->current >> shift) + i;
+
+      if (wheel->slots[level * OSIP_WHEEL_SIZE + (int) (block & OSIP_WHEEL_MASK)] != NULL) {
+        if (!found || (long) ((block << shift) - tick) < 0)
+          tick = block << shift;
+
+        found = 1;
+        break;
+      }
+    }
+  }
+
+  if (!found)
+    return OSIP_UNDEFINED_ERROR;
+
+  /* convert back using a delay: ticks may have wrapped */
+  next->tv_sec = now->tv_sec;
+  next->tv_usec = now->tv_usec - now->tv_usec % 1000;
+
+  if ((long) (tick - __osip_wheel_tick(now, 0)) > 0)
+    add_gettimeofday(next, (int) (tick - __osip_wheel_tick(now, 0)));
+
+  return OSIP_SUCCESS;
+}
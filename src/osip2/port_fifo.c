@@ -22,6 +22,172 @@
 #include <osipparser2/osip_port.h>
 #include <osip2/osip_fifo.h>
 
+#define OSIP_FIFO_MIN_SIZE 8
+
+#if defined(OSIP_LOCKFREE_FIFO) && !defined(OSIP_MONOTHREAD)
+#if defined(__ATOMIC_SEQ_CST)
+#define osip_atomic_load(ptr) __atomic_load_n((ptr), __ATOMIC_SEQ_CST)
+#define osip_atomic_store(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_SEQ_CST)
+#define osip_atomic_xchg(ptr, val) __atomic_exchange_n((ptr), (val), __ATOMIC_SEQ_CST)
+#define osip_atomic_add(ptr, val) __atomic_add_fetch((ptr), (val), __ATOMIC_SEQ_CST)
+#elif defined(_MSC_VER)
+#include <windows.h>
+#define osip_atomic_load(ptr) (MemoryBarrier(), *(ptr))
+#define osip_atomic_store(ptr, val) (void) InterlockedExchangePointer((PVOID volatile *) (ptr), (val))
+#define osip_atomic_xchg(ptr, val) InterlockedExchangePointer((PVOID volatile *) (ptr), (val))
+#define osip_atomic_add(ptr, val) (InterlockedExchangeAdd((LONG volatile *) (ptr), (val)) + (val))
+#else
+/* no atomic operations: the lock-free mode is not available */
+#undef OSIP_LOCKFREE_FIFO
+#endif
+#endif
+
+#ifdef OSIP_LOCKFREE_FIFO
+
+/* Lock-free mode: intrusive multi-producer/single-consumer queue
+   (Dmitry Vyukov). head is the link of the last element added, tail the
+   link of the next element to get. The stub link is added back when
+   the last element is taken so that tail never becomes NULL. nb_elt is
+   increased before an element is added and decreased after it is taken.
+
+   A thread blocked in osip_fifo_get registers itself in nb_waiters before
+   checking the queue again, and writers check nb_waiters after adding
+   their element: one of them always sees the other. */
+
+#define OSIP_FIFO_ELEMENT(ff, link) ((void *) ((char *) (link) - (ff)->link_offset))
+
+static void __osip_fifo_push(osip_fifo_t *ff, void **link) {
+  void **prev;
+
+  osip_atomic_store(link, NULL);
+  prev = (void **) osip_atomic_xchg(&ff->head, (void *) link);
+  /* between the exchange and this store, the reader can't go after prev */
+  osip_atomic_store(prev, (void *) link);
+}
+
+static void *__osip_fifo_pop_lockfree(osip_fifo_t *ff) {
+  void **tail = (void **) ff->tail;
+  void **next = (void **) osip_atomic_load(tail);
+
+  if (tail == &ff->stub) {
+    if (next == NULL)
+      return NULL;
+
+    ff->tail = next;
+    tail = next;
+    next = (void **) osip_atomic_load(tail);
+  }
+
+  if (next == NULL) {
+    if (tail != (void **) osip_atomic_load(&ff->head))
+      return NULL; /* an element is being added */
+
+    __osip_fifo_push(ff, &ff->stub);
+    next = (void **) osip_atomic_load(tail);
+
+    if (next == NULL)
+      return NULL;
+  }
+
+  ff->tail = next;
+  osip_atomic_add(&ff->nb_elt, -1);
+  return OSIP_FIFO_ELEMENT(ff, tail);
+}
+
+static void __osip_fifo_wakeup_lockfree(osip_fifo_t *ff) {
+  if (osip_atomic_load(&ff->nb_waiters) <= 0)
+    return;
+
+  osip_mutex_lock(ff->qislocked);
+
+  if (ff->nb_waiters > 0) {
+    osip_atomic_add(&ff->nb_waiters, -1);
+    osip_sem_post(ff->qisempty);
+  }
+
+  osip_mutex_unlock(ff->qislocked);
+}
+
+static void *__osip_fifo_get_lockfree(osip_fifo_t *ff) {
+  void *el;
+
+  for (;;) {
+    el = __osip_fifo_pop_lockfree(ff);
+
+    if (el != NULL)
+      return el;
+
+    osip_mutex_lock(ff->qislocked);
+    osip_atomic_add(&ff->nb_waiters, 1);
+    osip_mutex_unlock(ff->qislocked);
+
+    el = __osip_fifo_pop_lockfree(ff);
+
+    if (el != NULL) {
+      osip_mutex_lock(ff->qislocked);
+
+      if (ff->nb_waiters > 0) {
+        osip_atomic_add(&ff->nb_waiters, -1);
+        osip_mutex_unlock(ff->qislocked);
+
+      } else {
+        /* a writer has already posted the semaphore for us */
+        osip_mutex_unlock(ff->qislocked);
+        osip_sem_wait(ff->qisempty);
+      }
+
+      return el;
+    }
+
+    if (osip_sem_wait(ff->qisempty) != 0)
+      return NULL;
+  }
+}
+
+#endif
+
+/* make room for one more element. */
+static int __osip_fifo_grow(osip_fifo_t *ff) {
+  void **elements;
+  int size;
+  int i;
+
+  if (ff->nb_elt < ff->size)
+    return OSIP_SUCCESS;
+
+  size = (ff->size == 0) ? OSIP_FIFO_MIN_SIZE : ff->size * 2;
+  elements = (void **) osip_malloc(sizeof(void *) * size);
+
+  if (elements == NULL)
+    return OSIP_NOMEM;
+
+  /* elements are moved at the beginning of the new buffer */
+  for (i = 0; i < ff->nb_elt; i++)
+    elements[i] = ff->elements[(ff->first + i) & (ff->size - 1)];
+
+  osip_free(ff->elements);
+  ff->elements = elements;
+  ff->size = size;
+  ff->first = 0;
+  return OSIP_SUCCESS;
+}
+
+static void *__osip_fifo_pop(osip_fifo_t *ff) {
+  void *el;
+
+  el = ff->elements[ff->first];
+  ff->first = (ff->first + 1) & (ff->size - 1);
+  ff->nb_elt--;
+
+  if (ff->nb_elt <= 0)
+    ff->state = osip_empty;
+
+  else
+    ff->state = osip_ok;
+
+  return el;
+}
+
 /* always use this method to initiate osip_fifo_t.
  */
 void osip_fifo_init(osip_fifo_t *ff) {
@@ -29,50 +195,143 @@ void osip_fifo_init(osip_fifo_t *ff) {
   ff->qislocked = osip_mutex_init();
   /*INIT SEMA TO BLOCK ON GET() WHEN QUEUE IS EMPTY */
   ff->qisempty = osip_sem_init(0);
+  ff->nb_waiters = 0;
 #endif
-  osip_list_init(&ff->queue);
-  /* ff->nb_elt = 0; */
+  /* the buffer is allocated with the first element */
+  ff->elements = NULL;
+  ff->size = 0;
+  ff->first = 0;
+  ff->nb_elt = 0;
   ff->state = osip_empty;
+
+  ff->link_offset = -1;
+  ff->head = NULL;
+  ff->tail = NULL;
+  ff->stub = NULL;
+
+  ff->notify = NULL;
+  ff->notify_arg = NULL;
+}
+
+void osip_fifo_init_lockfree(osip_fifo_t *ff, int link_offset) {
+  osip_fifo_init(ff);
+
+#ifdef OSIP_LOCKFREE_FIFO
+
+  if (link_offset >= 0) {
+    ff->link_offset = link_offset;
+    ff->head = &ff->stub;
+    ff->tail = &ff->stub;
+  }
+
+#else
+  (void) link_offset;
+#endif
 }
 
 int osip_fifo_add(osip_fifo_t *ff, void *el) {
+#ifdef OSIP_LOCKFREE_FIFO
+
+  if (ff->link_offset >= 0) {
+    osip_atomic_add(&ff->nb_elt, 1);
+    __osip_fifo_push(ff, (void **) ((char *) el + ff->link_offset));
+    __osip_fifo_wakeup_lockfree(ff);
+
+    if (ff->notify != NULL)
+      ff->notify(ff->notify_arg);
+
+    return OSIP_SUCCESS;
+  }
+
+#endif
+
 #ifndef OSIP_MONOTHREAD
   osip_mutex_lock(ff->qislocked);
 #endif
 
-  osip_list_add(&ff->queue, el, -1); /* insert at end of queue */
+  if (__osip_fifo_grow(ff) != OSIP_SUCCESS) {
+#ifndef OSIP_MONOTHREAD
+    osip_mutex_unlock(ff->qislocked);
+#endif
+    return OSIP_NOMEM;
+  }
+
+  ff->elements[(ff->first + ff->nb_elt) & (ff->size - 1)] = el; /* insert at end of queue */
+  ff->nb_elt++;
   ff->state = osip_ok;
 
 #ifndef OSIP_MONOTHREAD
-  osip_sem_post(ff->qisempty);
+
+  /* only wake up a thread blocked in osip_fifo_get */
+  if (ff->nb_waiters > 0) {
+    ff->nb_waiters--;
+    osip_sem_post(ff->qisempty);
+  }
+
   osip_mutex_unlock(ff->qislocked);
 #endif
+
+  /* called without the mutex of the fifo */
+  if (ff->notify != NULL)
+    ff->notify(ff->notify_arg);
+
   return OSIP_SUCCESS;
 }
 
 int osip_fifo_insert(osip_fifo_t *ff, void *el) {
+  if (ff->link_offset >= 0) {
+    OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_BUG, NULL, "osip_fifo_insert is not available in lock-free mode.\n"));
+    return OSIP_UNDEFINED_ERROR;
+  }
+
 #ifndef OSIP_MONOTHREAD
   osip_mutex_lock(ff->qislocked);
 #endif
 
-  osip_list_add(&ff->queue, el, 0); /* insert at end of queue */
+  if (__osip_fifo_grow(ff) != OSIP_SUCCESS) {
+#ifndef OSIP_MONOTHREAD
+    osip_mutex_unlock(ff->qislocked);
+#endif
+    return OSIP_NOMEM;
+  }
+
+  ff->first = (ff->first - 1) & (ff->size - 1);
+  ff->elements[ff->first] = el; /* insert at beginning of queue */
+  ff->nb_elt++;
   ff->state = osip_ok;
 
 #ifndef OSIP_MONOTHREAD
-  osip_sem_post(ff->qisempty);
+
+  if (ff->nb_waiters > 0) {
+    ff->nb_waiters--;
+    osip_sem_post(ff->qisempty);
+  }
+
   osip_mutex_unlock(ff->qislocked);
 #endif
+
+  /* called without the mutex of the fifo */
+  if (ff->notify != NULL)
+    ff->notify(ff->notify_arg);
+
   return OSIP_SUCCESS;
 }
 
 int osip_fifo_size(osip_fifo_t *ff) {
   int i;
 
+#ifdef OSIP_LOCKFREE_FIFO
+
+  if (ff->link_offset >= 0)
+    return osip_atomic_load(&ff->nb_elt);
+
+#endif
+
 #ifndef OSIP_MONOTHREAD
   osip_mutex_lock(ff->qislocked);
 #endif
 
-  i = osip_list_size(&ff->queue);
+  i = ff->nb_elt;
 #ifndef OSIP_MONOTHREAD
   osip_mutex_unlock(ff->qislocked);
 #endif
@@ -82,34 +341,39 @@ int osip_fifo_size(osip_fifo_t *ff) {
 void *osip_fifo_get(osip_fifo_t *ff) {
   void *el = NULL;
 
-#ifndef OSIP_MONOTHREAD
-  int i = osip_sem_wait(ff->qisempty);
+#ifdef OSIP_LOCKFREE_FIFO
 
-  if (i != 0)
-    return NULL;
+  if (ff->link_offset >= 0)
+    return __osip_fifo_get_lockfree(ff);
 
-  osip_mutex_lock(ff->qislocked);
 #endif
 
-  if (ff->state != osip_empty) {
-    el = osip_list_get(&ff->queue, 0);
-    osip_list_remove(&ff->queue, 0);
-    /* ff->nb_elt--; */
-
-  } else {
-    OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL, "no element in fifo.\n"));
 #ifndef OSIP_MONOTHREAD
+  osip_mutex_lock(ff->qislocked);
+
+  while (ff->nb_elt <= 0) {
+    int i;
+
+    /* the semaphore is posted once for each waiter */
+    ff->nb_waiters++;
     osip_mutex_unlock(ff->qislocked);
-#endif
-    return OSIP_SUCCESS; /* pile vide */
+
+    i = osip_sem_wait(ff->qisempty);
+
+    osip_mutex_lock(ff->qislocked);
+
+    if (i != 0) {
+      osip_mutex_unlock(ff->qislocked);
+      return NULL;
+    }
   }
+#endif
 
-  /* if (ff->nb_elt <= 0) */
-  if (osip_list_size(&ff->queue) <= 0)
-    ff->state = osip_empty;
+  if (ff->nb_elt > 0)
+    el = __osip_fifo_pop(ff);
 
   else
-    ff->state = osip_ok;
+    OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL, "no element in fifo.\n"));
 
 #ifndef OSIP_MONOTHREAD
   osip_mutex_unlock(ff->qislocked);
@@ -120,42 +384,19 @@ void *osip_fifo_get(osip_fifo_t *ff) {
 void *osip_fifo_tryget(osip_fifo_t *ff) {
   void *el = NULL;
 
-#ifndef OSIP_MONOTHREAD
+#ifdef OSIP_LOCKFREE_FIFO
 
-  if (0 != osip_sem_trywait(ff->qisempty)) { /* no elements... */
-    return NULL;
-  }
-
-  osip_mutex_lock(ff->qislocked);
-#else
-
-  if (ff->state == osip_empty)
-    return NULL;
+  if (ff->link_offset >= 0)
+    return __osip_fifo_pop_lockfree(ff);
 
 #endif
 
-  if (ff->state != osip_empty) {
-    el = osip_list_get(&ff->queue, 0);
-    osip_list_remove(&ff->queue, 0);
-    /* ff->nb_elt--; */
-  }
-
 #ifndef OSIP_MONOTHREAD
-
-  else { /* this case MUST never happen... */
-    OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO4, NULL, "no element in fifo.\n"));
-    osip_mutex_unlock(ff->qislocked);
-    return OSIP_SUCCESS;
-  }
-
+  osip_mutex_lock(ff->qislocked);
 #endif
 
-  /* if (ff->nb_elt <= 0) */
-  if (osip_list_size(&ff->queue) <= 0)
-    ff->state = osip_empty;
-
-  else
-    ff->state = osip_ok;
+  if (ff->nb_elt > 0)
+    el = __osip_fifo_pop(ff);
 
 #ifndef OSIP_MONOTHREAD
   osip_mutex_unlock(ff->qislocked);
@@ -172,5 +413,6 @@ void osip_fifo_free(osip_fifo_t *ff) {
   /* seems that pthread_mutex_destroy does not free space by itself */
   osip_sem_destroy(ff->qisempty);
 #endif
+  osip_free(ff->elements);
   osip_free(ff);
 }
@@ -294,6 +294,203 @@ int __osip_remove_nict_transaction(osip_t *osip, osip_transaction_t *nict);
  */
 int __osip_remove_nist_transaction(osip_t *osip, osip_transaction_t *nist);
 
+/**
+ * Structure for an index of elements referenced by a hash key.
+ * Several elements may share the same key.
+ * NOTE: THIS IS AN INTERNAL STRUCTURE ONLY
+ */
+typedef struct osip_index osip_index_t;
+
+/**
+ * Allocate an index.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param index The element to allocate.
+ */
+int __osip_index_init(osip_index_t **index);
+/**
+ * Free all resource in an index. (elements are not freed)
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param index The element to free.
+ */
+void __osip_index_free(osip_index_t *index);
+/**
+ * Add an element in an index.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param index The element to work on.
+ * @param key The hash key.
+ * @param element The element to reference.
+ */
+int __osip_index_add(osip_index_t *index, unsigned long key, void *element);
+/**
+ * Remove an element from an index.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param index The element to work on.
+ * @param key The hash key used when the element was added.
+ * @param element The element to remove.
+ */
+int __osip_index_remove(osip_index_t *index, unsigned long key, void *element);
+/**
+ * Get the next element referenced by a key. (NULL when there is no more)
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param index The element to work on.
+ * @param key The hash key.
+ * @param pos The position of the last element found. (must be -1 for the first call)
+ */
+void *__osip_index_find(osip_index_t *index, unsigned long key, int *pos);
+/**
+ * Compute a hash key over a string.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param hash The value computed over the previous strings. (or 5381)
+ * @param str The string to hash. (may be NULL)
+ */
+unsigned long __osip_index_hash(unsigned long hash, const char *str);
+
+/**
+ * Structure for a timer wheel.
+ * NOTE: THIS IS AN INTERNAL STRUCTURE ONLY
+ */
+typedef struct osip_wheel osip_wheel_t;
+
+/**
+ * Allocate a timer wheel.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param wheel The element to allocate.
+ */
+int __osip_wheel_init(osip_wheel_t **wheel);
+/**
+ * Free all resource in a timer wheel. (entries are not freed)
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param wheel The element to free.
+ */
+void __osip_wheel_free(osip_wheel_t *wheel);
+/**
+ * Schedule (or schedule again) an entry in a timer wheel.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param wheel The element to work on.
+ * @param entry The entry to schedule.
+ * @param expire The expiration time.
+ */
+void __osip_wheel_add(osip_wheel_t *wheel, osip_timer_entry_t *entry, struct timeval *expire);
+/**
+ * Remove an entry from a timer wheel. (nothing is done if not scheduled)
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param wheel The element to work on.
+ * @param entry The entry to remove.
+ */
+void __osip_wheel_remove(osip_wheel_t *wheel, osip_timer_entry_t *entry);
+/**
+ * Remove and return the entries expired at a given time.
+ * The entries are linked with their next field.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param wheel The element to work on.
+ * @param now The current time.
+ */
+osip_timer_entry_t *__osip_wheel_expire(osip_wheel_t *wheel, struct timeval *now);
+/**
+ * Get the time of the next expiration in a timer wheel. The value may be
+ * slightly earlier than the real expiration for entries far in the future.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param wheel The element to work on.
+ * @param now The current time.
+ * @param next The time of the next expiration.
+ */
+int __osip_wheel_next(osip_wheel_t *wheel, struct timeval *now, struct timeval *next);
+
+/**
+ * Structure for the list of transactions with pending events.
+ * @var osip_ready_t
+ */
+typedef struct osip_ready osip_ready_t;
+
+/**
+ * Structure for the list of transactions with pending events.
+ * When an executor is set, transactions with pending events are given
+ * to the executor instead.
+ */
+struct osip_ready {
+  osip_transaction_t *first; /**< first transaction with pending events */
+  osip_transaction_t *last;  /**< last transaction with pending events */
+  int nb_elt;                /**< number of transactions in the list */
+#ifndef OSIP_MONOTHREAD
+  osip_executor_t *executor; /**< executor processing the events */
+  struct osip_mutex *mutex;  /**< mutex for the list and the ready_* members of transactions */
+#endif
+};
+
+/* values of ready_state in osip_transaction_t */
+#define OSIP_READY_NONE 0    /* not managed by an osip_t */
+#define OSIP_READY_IDLE 1    /* no pending event */
+#define OSIP_READY_QUEUED 2  /* in the list of transactions with pending events */
+#define OSIP_READY_RUNNING 3 /* events processed by an executor */
+
+/**
+ * Allocate a list of transactions with pending events.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param ready The element to allocate.
+ */
+int __osip_ready_init(osip_ready_t **ready);
+/**
+ * Free a list of transactions with pending events. (transactions are not freed)
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param ready The element to free.
+ */
+void __osip_ready_free(osip_ready_t *ready);
+/**
+ * Add a transaction in the list of transactions with pending events
+ * of its osip_t. (nothing is done if already there)
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param transaction The element to work on.
+ */
+void __osip_transaction_set_ready(osip_transaction_t *transaction);
+/**
+ * Check if the release of a transaction must be delayed because it
+ * is used by an executor. The executor will free it.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param transaction The element to work on.
+ */
+int __osip_transaction_delay_free(osip_transaction_t *transaction);
+
+#ifndef OSIP_MONOTHREAD
+/**
+ * Set (or remove when NULL) the executor of a list of transactions
+ * with pending events. Transactions already in the list are given to
+ * the executor.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param ready The element to work on.
+ * @param executor The executor.
+ */
+void __osip_ready_set_executor(osip_ready_t *ready, osip_executor_t *executor);
+/**
+ * Process the pending events of a transaction taken by an executor.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param transaction The element to work on.
+ */
+void __osip_transaction_run(osip_transaction_t *transaction);
+/**
+ * Give back a transaction left in an executor once the executor is
+ * removed: it goes back in the list of transactions with pending events.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param transaction The element to work on.
+ */
+void __osip_transaction_unset_busy(osip_transaction_t *transaction);
+/**
+ * Queue a transaction with pending events in an executor.
+ * (called with the mutex of the list of the transaction)
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param executor The element to work on.
+ * @param transaction The transaction.
+ */
+void __osip_executor_push(osip_executor_t *executor, osip_transaction_t *transaction);
+#endif
+
+/**
+ * Update the position of a transaction in the timer wheel of its
+ * osip_t after a timer was started or after a change of state.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param transaction The element to work on.
+ */
+void __osip_transaction_update_timers(osip_transaction_t *transaction);
+
 /**
  * Allocate a sipevent.
  * NOTE: THIS IS AN INTERNAL METHOD ONLY
@@ -301,6 +498,25 @@ int __osip_remove_nist_transaction(osip_t *osip, osip_transaction_t *nist);
  * @param transactionid The transaction id for this event.
  */
 osip_event_t *__osip_event_new(type_t type, int transactionid);
+/**
+ * Create a sipevent from a SIP message string, parsed in a work buffer.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param buf The SIP message as a string.
+ * @param length The length of the buffer to parse.
+ * @param scratch The work buffer (or NULL).
+ * @param scratch_size The size of the work buffer.
+ */
+osip_event_t *__osip_parse(const char *buf, size_t length, char *scratch, size_t scratch_size);
+/**
+ * Create the sipevents of bufs[first] to bufs[last - 1] with one work buffer.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param bufs The SIP messages.
+ * @param lengths The lengths of the SIP messages.
+ * @param first The first message to parse.
+ * @param last The end of the messages to parse.
+ * @param events The resulting events (NULL when a message cannot be parsed).
+ */
+int __osip_parse_batch(const char *const *bufs, const size_t *lengths, int first, int last, osip_event_t **events);
 
 /**
  * Allocate a sipevent (we know this message is an OUTGOING SIP message).
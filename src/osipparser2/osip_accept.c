@@ -22,6 +22,7 @@
 #include <osipparser2/osip_port.h>
 #include <osipparser2/osip_message.h>
 #include <osipparser2/osip_parser.h>
+#include "parser.h"
 
 #ifndef MINISIZE
 
@@ -56,6 +57,9 @@ int osip_message_get_accept(const osip_message_t *sip, int pos, osip_accept_t **
 
   *dest = NULL;
 
+  if (!osip_list_eol(&sip->lazy_headers, 0))
+    __osip_message_parse_lazy_headers((osip_message_t *) sip, &osip_message_set_accept);
+
   if (osip_list_size(&sip->accepts) <= pos)
     return OSIP_UNDEFINED_ERROR; /* does not exist */
 
@@ -67,76 +71,21 @@ int osip_message_get_accept(const osip_message_t *sip, int pos, osip_accept_t **
 /* returns the content_type header as a string.  */
 /* INPUT : osip_content_type_t *content_type | content_type header.   */
 /* returns null on error. */
-int osip_accept_to_str(const osip_accept_t *accept, char **dest) {
-  char *buf;
-  char *tmp;
-  size_t len = 0;
-
-  *dest = NULL;
-
+int __osip_accept_write(const osip_accept_t *accept, __osip_writer_t *w) {
   if (accept == NULL)
     return OSIP_BADPARAMETER;
 
-  if (accept->type != NULL)
-    len += strlen(accept->type);
-
-  if (accept->subtype != NULL)
-    len += strlen(accept->subtype);
-
-  if (len == 0) {
+  if ((accept->type == NULL || accept->type[0] == '\0') && (accept->subtype == NULL || accept->subtype[0] == '\0')) {
     /* Empty header ! */
-    buf = (char *) osip_malloc(2);
-
-    if (buf == NULL)
-      return OSIP_NOMEM;
-
-    buf[0] = ' ';
-    buf[1] = '\0';
-    *dest = buf;
+    __osip_writer_putc(w, ' ');
     return OSIP_SUCCESS;
   }
 
-  /* try to guess a long enough length */
-  len += 4 /* for '/', ' ', ';' and '\0' */
-         + 10 * osip_list_size(&accept->gen_params);
-
-  buf = (char *) osip_malloc(len);
-
-  if (buf == NULL)
-    return OSIP_NOMEM;
-
-  tmp = buf;
-
-  sprintf(tmp, "%s/%s", accept->type, accept->subtype);
-
-  tmp = tmp + strlen(tmp);
-  {
-    osip_list_iterator_t it;
-    osip_generic_param_t *u_param = (osip_generic_param_t *) osip_list_get_first(&accept->gen_params, &it);
-
-    while (u_param != OSIP_SUCCESS) {
-      size_t tmp_len;
-
-      if (u_param->gvalue == NULL) {
-        osip_free(buf);
-        return OSIP_SYNTAXERROR;
-      }
-
-      tmp_len = strlen(buf) + 4 + strlen(u_param->gname) + strlen(u_param->gvalue) + 1;
-
-      if (len < tmp_len) {
-        buf = osip_realloc(buf, tmp_len);
-        len = tmp_len;
-        tmp = buf + strlen(buf);
-      }
+  return __osip_content_type_write(accept, w);
+}
 
-      snprintf(tmp, len - (tmp - buf), "; %s=%s", u_param->gname, u_param->gvalue);
-      tmp = tmp + strlen(tmp);
-      u_param = (osip_generic_param_t *) osip_list_get_next(&it);
-    }
-  }
-  *dest = buf;
-  return OSIP_SUCCESS;
+int osip_accept_to_str(const osip_accept_t *accept, char **dest) {
+  return __osip_writer_to_str(accept, (int (*)(const void *, __osip_writer_t *)) & __osip_accept_write, dest, NULL);
 }
 
 #endif
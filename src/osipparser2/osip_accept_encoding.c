@@ -58,6 +58,9 @@ int osip_message_get_accept_encoding(const osip_message_t *sip, int pos, osip_ac
 
   *dest = NULL;
 
+  if (!osip_list_eol(&sip->lazy_headers, 0))
+    __osip_message_parse_lazy_headers((osip_message_t *) sip, &osip_message_set_accept_encoding);
+
   if (osip_list_size(&sip->accept_encodings) <= pos)
     return OSIP_UNDEFINED_ERROR; /* does not exist */
 
@@ -110,53 +113,19 @@ int osip_accept_encoding_parse(osip_accept_encoding_t *accept_encoding, const ch
 /* returns the accept_encoding header as a string.  */
 /* INPUT : osip_accept_encoding_t *accept_encoding | accept_encoding header.   */
 /* returns null on error. */
-int osip_accept_encoding_to_str(const osip_accept_encoding_t *accept_encoding, char **dest) {
-  char *buf;
-  char *tmp;
-  size_t len;
-
-  *dest = NULL;
-
+int __osip_accept_encoding_write(const osip_accept_encoding_t *accept_encoding, __osip_writer_t *w) {
   if ((accept_encoding == NULL) || (accept_encoding->element == NULL))
     return OSIP_BADPARAMETER;
 
-  len = strlen(accept_encoding->element) + 2;
-  buf = (char *) osip_malloc(len);
-
-  if (buf == NULL)
-    return OSIP_NOMEM;
-
-  sprintf(buf, "%s", accept_encoding->element);
-  {
-    size_t plen;
-    osip_list_iterator_t it;
-    osip_generic_param_t *u_param = (osip_generic_param_t *) osip_list_get_first(&accept_encoding->gen_params, &it);
-
-    while (u_param != OSIP_SUCCESS) {
-      if (u_param->gvalue == NULL)
-        plen = strlen(u_param->gname) + 2;
-
-      else
-        plen = strlen(u_param->gname) + strlen(u_param->gvalue) + 3;
-
-      len = len + plen;
-      buf = (char *) osip_realloc(buf, len);
-      tmp = buf;
-      tmp = tmp + strlen(tmp);
-
-      if (u_param->gvalue == NULL)
-        snprintf(tmp, len - (tmp - buf), ";%s", u_param->gname);
-
-      else
-        snprintf(tmp, len - (tmp - buf), ";%s=%s", u_param->gname, u_param->gvalue);
-
-      u_param = (osip_generic_param_t *) osip_list_get_next(&it);
-    }
-  }
-  *dest = buf;
+  __osip_writer_puts(w, accept_encoding->element);
+  __osip_writer_gen_params(w, &accept_encoding->gen_params);
   return OSIP_SUCCESS;
 }
 
+int osip_accept_encoding_to_str(const osip_accept_encoding_t *accept_encoding, char **dest) {
+  return __osip_writer_to_str(accept_encoding, (int (*)(const void *, __osip_writer_t *)) & __osip_accept_encoding_write, dest, NULL);
+}
+
 /* deallocates a osip_accept_encoding_t structure.  */
 /* INPUT : osip_accept_encoding_t *accept_encoding | accept_encoding. */
 void osip_accept_encoding_free(osip_accept_encoding_t *accept_encoding) {
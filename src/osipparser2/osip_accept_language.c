@@ -55,6 +55,9 @@ int osip_message_get_accept_language(const osip_message_t *sip, int pos, osip_ac
 
   *dest = NULL;
 
+  if (!osip_list_eol(&sip->lazy_headers, 0))
+    __osip_message_parse_lazy_headers((osip_message_t *) sip, &osip_message_set_accept_language);
+
   if (osip_list_size(&sip->accept_languages) <= pos)
     return OSIP_UNDEFINED_ERROR; /* does not exist */
 
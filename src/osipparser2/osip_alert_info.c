@@ -55,6 +55,9 @@ int osip_message_get_alert_info(const osip_message_t *sip, int pos, osip_alert_i
 
   *dest = NULL;
 
+  if (!osip_list_eol(&sip->lazy_headers, 0))
+    __osip_message_parse_lazy_headers((osip_message_t *) sip, &osip_message_set_alert_info);
+
   if (osip_list_size(&sip->alert_infos) <= pos)
     return OSIP_UNDEFINED_ERROR; /* does not exist */
 
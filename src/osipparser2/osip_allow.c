@@ -55,6 +55,9 @@ int osip_message_get_allow(const osip_message_t *sip, int pos, osip_allow_t **de
 
   *dest = NULL;
 
+  if (!osip_list_eol(&sip->lazy_headers, 0))
+    __osip_message_parse_lazy_headers((osip_message_t *) sip, &osip_message_set_allow);
+
   if (osip_list_size(&sip->allows) <= pos)
     return OSIP_UNDEFINED_ERROR; /* does not exist */
 
@@ -267,6 +267,9 @@ int osip_message_get_authentication_info(const osip_message_t *sip, int pos, osi
 
   *dest = NULL;
 
+  if (!osip_list_eol(&sip->lazy_headers, 0))
+    __osip_message_parse_lazy_headers((osip_message_t *) sip, &osip_message_set_authentication_info);
+
   if (osip_list_size(&sip->authentication_infos) <= pos)
     return OSIP_UNDEFINED_ERROR; /* does not exist */
 
@@ -344,6 +344,9 @@ int osip_message_get_authorization(const osip_message_t *sip, int pos, osip_auth
 
   *dest = NULL;
 
+  if (!osip_list_eol(&sip->lazy_headers, 0))
+    __osip_message_parse_lazy_headers((osip_message_t *) sip, &osip_message_set_authorization);
+
   if (osip_list_size(&sip->authorizations) <= pos)
     return OSIP_UNDEFINED_ERROR; /* does not exist */
 
@@ -369,18 +369,9 @@ int osip_body_parse_mime(osip_body_t *body, const char *start_of_body, size_t le
 /* returns the body as a string.          */
 /* INPUT : osip_body_t *body | body.  */
 /* returns null on error. */
-int osip_body_to_str(const osip_body_t *body, char **dest, size_t *str_length) {
-  char *tmp_body;
-  char *tmp;
-  char *ptr;
+/* everything but the content of the body */
+int __osip_body_write_headers(const osip_body_t *body, __osip_writer_t *w) {
   int i;
-  size_t length;
-
-  if (dest)
-    *dest = NULL;
-
-  if (str_length)
-    *str_length = 0;
 
   if (body == NULL)
     return OSIP_BADPARAMETER;
@@ -394,35 +385,14 @@ int osip_body_to_str(const osip_body_t *body, char **dest, size_t *str_length) {
   if (body->length <= 0)
     return OSIP_BADPARAMETER;
 
-  length = 15 + body->length + (osip_list_size(body->headers) * 40);
-  tmp_body = (char *) osip_malloc(length);
-
-  if (tmp_body == NULL)
-    return OSIP_NOMEM;
-
-  ptr = tmp_body; /* save the initial address of the string */
-
   if (body->content_type != NULL) {
-    tmp_body = osip_strn_append(tmp_body, "content-type: ", 14);
-    i = osip_content_type_to_str(body->content_type, &tmp);
+    __osip_writer_append(w, "content-type: ", 14);
+    i = __osip_content_type_write(body->content_type, w);
 
-    if (i != 0) {
-      osip_free(ptr);
+    if (i != 0)
       return i;
-    }
-
-    if (length < tmp_body - ptr + strlen(tmp) + 4) {
-      size_t len;
 
-      len = tmp_body - ptr;
-      length = length + strlen(tmp) + 4;
-      ptr = osip_realloc(ptr, length);
-      tmp_body = ptr + len;
-    }
-
-    tmp_body = osip_str_append(tmp_body, tmp);
-    osip_free(tmp);
-    tmp_body = osip_strn_append(tmp_body, OSIP_CRLF, 2);
+    __osip_writer_append(w, OSIP_CRLF, 2);
   }
 
   {
@@ -430,59 +400,50 @@ int osip_body_to_str(const osip_body_t *body, char **dest, size_t *str_length) {
     osip_header_t *header = (osip_header_t *) osip_list_get_first(body->headers, &it);
 
     while (header != OSIP_SUCCESS) {
-      i = osip_header_to_str(header, &tmp);
+      i = __osip_header_write(header, w);
 
-      if (i != 0) {
-        osip_free(ptr);
+      if (i != 0)
         return i;
-      }
-
-      if (length < tmp_body - ptr + strlen(tmp) + 4) {
-        size_t len;
-
-        len = tmp_body - ptr;
-        length = length + strlen(tmp) + 4;
-        ptr = osip_realloc(ptr, length);
-        tmp_body = ptr + len;
-      }
 
-      tmp_body = osip_str_append(tmp_body, tmp);
-      osip_free(tmp);
-      tmp_body = osip_strn_append(tmp_body, OSIP_CRLF, 2);
+      __osip_writer_append(w, OSIP_CRLF, 2);
       header = (osip_header_t *) osip_list_get_next(&it);
     }
   }
 
-  if ((osip_list_size(body->headers) > 0) || (body->content_type != NULL)) {
-    if (length < (size_t)(tmp_body - ptr + 3)) {
-      size_t len;
+  if ((osip_list_size(body->headers) > 0) || (body->content_type != NULL))
+    __osip_writer_append(w, OSIP_CRLF, 2);
 
-      len = tmp_body - ptr;
-      length = length + 3 + body->length; /* add body->length, to avoid calling realloc often */
-      ptr = osip_realloc(ptr, length);
-      tmp_body = ptr + len;
-    }
+  return OSIP_SUCCESS;
+}
 
-    tmp_body = osip_strn_append(tmp_body, OSIP_CRLF, 2);
-  }
+int __osip_body_write(const osip_body_t *body, __osip_writer_t *w) {
+  int i;
 
-  if (length < tmp_body - ptr + body->length + 4) {
-    size_t len;
+  i = __osip_body_write_headers(body, w);
 
-    len = tmp_body - ptr;
-    length = length + body->length + 4;
-    ptr = osip_realloc(ptr, length);
-    tmp_body = ptr + len;
-  }
+  if (i != 0)
+    return i;
 
-  memcpy(tmp_body, body->body, body->length);
-  tmp_body = tmp_body + body->length;
+  __osip_writer_append(w, body->body, body->length);
+  return OSIP_SUCCESS;
+}
 
-  /* end of this body */
-  if (str_length != NULL)
-    *str_length = tmp_body - ptr;
+int osip_body_to_str(const osip_body_t *body, char **dest, size_t *str_length) {
+  char *tmp;
+  int i;
+
+  if (dest)
+    *dest = NULL;
+
+  if (str_length)
+    *str_length = 0;
+
+  i = __osip_writer_to_str(body, (int (*)(const void *, __osip_writer_t *)) & __osip_body_write, &tmp, str_length);
+
+  if (i != 0)
+    return i;
 
-  *dest = ptr;
+  *dest = tmp;
   return OSIP_SUCCESS;
 }
 
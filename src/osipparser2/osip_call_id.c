@@ -22,6 +22,7 @@
 #include <osipparser2/osip_port.h>
 #include <osipparser2/osip_message.h>
 #include <osipparser2/osip_parser.h>
+#include "parser.h"
 
 /* fills the call_id of message.                    */
 /* INPUT : const char *hvalue | value of header.    */
@@ -132,32 +133,28 @@ int osip_call_id_parse(osip_call_id_t *callid, const char *hvalue) {
 /* returns the call_id as a string.          */
 /* INPUT : osip_call_id_t *call_id | call_id.  */
 /* returns null on error. */
-int osip_call_id_to_str(const osip_call_id_t *callid, char **dest) {
-  *dest = NULL;
-
+int __osip_call_id_write(const osip_call_id_t *callid, __osip_writer_t *w) {
   if ((callid == NULL) || (callid->number == NULL))
     return OSIP_BADPARAMETER;
 
-  if (callid->host == NULL) {
-    *dest = (char *) osip_malloc(strlen(callid->number) + 1);
-
-    if (*dest == NULL)
-      return OSIP_NOMEM;
-
-    sprintf(*dest, "%s", callid->number);
-
-  } else {
-    *dest = (char *) osip_malloc(strlen(callid->number) + strlen(callid->host) + 2);
+  __osip_writer_puts(w, callid->number);
 
-    if (*dest == NULL)
-      return OSIP_NOMEM;
-
-    sprintf(*dest, "%s@%s", callid->number, callid->host);
+  if (callid->host != NULL) {
+    __osip_writer_putc(w, '@');
+    __osip_writer_puts(w, callid->host);
   }
 
   return OSIP_SUCCESS;
 }
 
+int osip_call_id_to_str(const osip_call_id_t *callid, char **dest) {
+  return __osip_writer_to_str(callid, (int (*)(const void *, __osip_writer_t *)) & __osip_call_id_write, dest, NULL);
+}
+
+int osip_call_id_to_buf(const osip_call_id_t *callid, char *buf, size_t cap, size_t *len) {
+  return __osip_writer_to_buf(callid, (int (*)(const void *, __osip_writer_t *)) & __osip_call_id_write, buf, cap, len);
+}
+
 char *osip_call_id_get_number(osip_call_id_t *callid) {
   if (callid == NULL)
     return NULL;
@@ -53,6 +53,9 @@ int osip_message_get_call_info(const osip_message_t *sip, int pos, osip_call_inf
 
   *dest = NULL;
 
+  if (!osip_list_eol(&sip->lazy_headers, 0))
+    __osip_message_parse_lazy_headers((osip_message_t *) sip, &osip_message_set_call_info);
+
   if (osip_list_size(&sip->call_infos) <= pos)
     return OSIP_UNDEFINED_ERROR; /* does not exist */
 
@@ -115,56 +118,19 @@ int osip_call_info_parse(osip_call_info_t *call_info, const char *hvalue) {
 /* returns the call_info header as a string.  */
 /* INPUT : osip_call_info_t *call_info | call_info header.   */
 /* returns null on error. */
-int osip_call_info_to_str(const osip_call_info_t *call_info, char **dest) {
-  char *buf;
-  char *tmp;
-  size_t len;
-  size_t plen;
-
-  *dest = NULL;
-
+int __osip_call_info_write(const osip_call_info_t *call_info, __osip_writer_t *w) {
   if ((call_info == NULL) || (call_info->element == NULL))
     return OSIP_BADPARAMETER;
 
-  len = strlen(call_info->element) + 2;
-  buf = (char *) osip_malloc(len);
-
-  if (buf == NULL)
-    return OSIP_NOMEM;
-
-  *dest = buf;
-
-  sprintf(buf, "%s", call_info->element);
-
-  {
-    osip_list_iterator_t it;
-    osip_generic_param_t *u_param = (osip_generic_param_t *) osip_list_get_first(&call_info->gen_params, &it);
-
-    while (u_param != OSIP_SUCCESS) {
-      if (u_param->gvalue == NULL)
-        plen = strlen(u_param->gname) + 2;
-
-      else
-        plen = strlen(u_param->gname) + strlen(u_param->gvalue) + 3;
-
-      len = len + plen;
-      buf = (char *) osip_realloc(buf, len);
-      tmp = buf;
-      tmp = tmp + strlen(tmp);
-
-      if (u_param->gvalue == NULL)
-        sprintf(tmp, ";%s", u_param->gname);
-
-      else
-        sprintf(tmp, ";%s=%s", u_param->gname, u_param->gvalue);
-
-      u_param = (osip_generic_param_t *) osip_list_get_next(&it);
-    }
-  }
-  *dest = buf;
+  __osip_writer_puts(w, call_info->element);
+  __osip_writer_gen_params(w, &call_info->gen_params);
   return OSIP_SUCCESS;
 }
 
+int osip_call_info_to_str(const osip_call_info_t *call_info, char **dest) {
+  return __osip_writer_to_str(call_info, (int (*)(const void *, __osip_writer_t *)) & __osip_call_info_write, dest, NULL);
+}
+
 /* deallocates a osip_call_info_t structure.  */
 /* INPUT : osip_call_info_t *call_info | call_info. */
 void osip_call_info_free(osip_call_info_t *call_info) {
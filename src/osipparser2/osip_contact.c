@@ -22,6 +22,7 @@
 #include <osipparser2/osip_port.h>
 #include <osipparser2/osip_message.h>
 #include <osipparser2/osip_parser.h>
+#include "parser.h"
 
 /* adds the contact header to message.              */
 /* INPUT : const char *hvalue | value of header.    */
@@ -90,6 +91,9 @@ int osip_message_get_contact(const osip_message_t *sip, int pos, osip_contact_t
   if (sip == NULL)
     return OSIP_BADPARAMETER;
 
+  if (!osip_list_eol(&sip->lazy_headers, 0))
+    __osip_message_parse_lazy_headers((osip_message_t *) sip, &osip_message_set_contact);
+
   if (osip_list_size(&sip->contacts) <= pos)
     return OSIP_UNDEFINED_ERROR; /* does not exist */
 
@@ -101,22 +105,24 @@ int osip_message_get_contact(const osip_message_t *sip, int pos, osip_contact_t
 /* returns the contact header as a string.*/
 /* INPUT : osip_contact_t *contact | contact.  */
 /* returns null on error. */
-int osip_contact_to_str(const osip_contact_t *contact, char **dest) {
+int __osip_contact_write(const osip_contact_t *contact, __osip_writer_t *w) {
   if (contact == NULL)
     return OSIP_BADPARAMETER;
 
-  if (contact->displayname != NULL) {
-    if (strncmp(contact->displayname, "*", 1) == 0) {
-      *dest = osip_strdup("*");
+  if (contact->displayname != NULL && strncmp(contact->displayname, "*", 1) == 0) {
+    __osip_writer_putc(w, '*');
+    return OSIP_SUCCESS;
+  }
 
-      if (*dest == NULL)
-        return OSIP_NOMEM;
+  return __osip_from_write((osip_from_t *) contact, w);
+}
 
-      return OSIP_SUCCESS;
-    }
-  }
+int osip_contact_to_str(const osip_contact_t *contact, char **dest) {
+  return __osip_writer_to_str(contact, (int (*)(const void *, __osip_writer_t *)) & __osip_contact_write, dest, NULL);
+}
 
-  return osip_from_to_str((osip_from_t *) contact, dest);
+int osip_contact_to_buf(const osip_contact_t *contact, char *buf, size_t cap, size_t *len) {
+  return __osip_writer_to_buf(contact, (int (*)(const void *, __osip_writer_t *)) & __osip_contact_write, buf, cap, len);
 }
 
 #ifndef MINISIZE
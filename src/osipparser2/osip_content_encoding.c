@@ -58,6 +58,9 @@ int osip_message_get_content_encoding(const osip_message_t *sip, int pos, osip_c
 
   *dest = NULL;
 
+  if (!osip_list_eol(&sip->lazy_headers, 0))
+    __osip_message_parse_lazy_headers((osip_message_t *) sip, &osip_message_set_content_encoding);
+
   if (osip_list_size(&sip->content_encodings) <= pos)
     return OSIP_UNDEFINED_ERROR; /* does not exist */
 
@@ -22,6 +22,7 @@
 #include <osipparser2/osip_port.h>
 #include <osipparser2/osip_message.h>
 #include <osipparser2/osip_parser.h>
+#include "parser.h"
 
 int osip_content_length_init(osip_content_length_t **cl) {
   *cl = (osip_content_length_t *) osip_malloc(sizeof(osip_content_length_t));
@@ -95,18 +96,18 @@ osip_content_length_t *osip_message_get_content_length(const osip_message_t *sip
 /* returns the content_length header as a string.          */
 /* INPUT : osip_content_length_t *content_length | content_length header.  */
 /* returns null on error. */
-int osip_content_length_to_str(const osip_content_length_t *cl, char **dest) {
-  if (cl == NULL)
+int __osip_content_length_write(const osip_content_length_t *cl, __osip_writer_t *w) {
+  if ((cl == NULL) || (cl->value == NULL))
     return OSIP_BADPARAMETER;
 
-  *dest = osip_strdup(cl->value);
-
-  if (*dest == NULL)
-    return OSIP_NOMEM;
-
+  __osip_writer_puts(w, cl->value);
   return OSIP_SUCCESS;
 }
 
+int osip_content_length_to_str(const osip_content_length_t *cl, char **dest) {
+  return __osip_writer_to_str(cl, (int (*)(const void *, __osip_writer_t *)) & __osip_content_length_write, dest, NULL);
+}
+
 /* deallocates a osip_content_length_t strcture.  */
 /* INPUT : osip_content_length_t *content_length | content_length header. */
 void osip_content_length_free(osip_content_length_t *content_length) {
@@ -141,59 +141,41 @@ int osip_content_type_parse(osip_content_type_t *content_type, const char *hvalu
 /* returns the content_type header as a string.  */
 /* INPUT : osip_content_type_t *content_type | content_type header.   */
 /* returns null on error. */
-int osip_content_type_to_str(const osip_content_type_t *content_type, char **dest) {
-  char *buf;
-  char *tmp;
-  size_t len;
-
-  *dest = NULL;
-
+int __osip_content_type_write(const osip_content_type_t *content_type, __osip_writer_t *w) {
   if ((content_type == NULL) || (content_type->type == NULL) || (content_type->subtype == NULL))
     return OSIP_BADPARAMETER;
 
-  /* try to guess a long enough length */
-  len = strlen(content_type->type) + strlen(content_type->subtype) + 4 /* for '/', ' ', ';' and '\0' */
-        + 10 * osip_list_size(&content_type->gen_params);
-
-  buf = (char *) osip_malloc(len);
+  __osip_writer_puts(w, content_type->type);
+  __osip_writer_putc(w, '/');
+  __osip_writer_puts(w, content_type->subtype);
 
-  if (buf == NULL)
-    return OSIP_NOMEM;
-
-  tmp = buf;
-
-  sprintf(tmp, "%s/%s", content_type->type, content_type->subtype);
-
-  tmp = tmp + strlen(tmp);
   {
     osip_list_iterator_t it;
     osip_generic_param_t *u_param = (osip_generic_param_t *) osip_list_get_first(&content_type->gen_params, &it);
 
     while (u_param != OSIP_SUCCESS) {
-      size_t tmp_len;
-
-      if (u_param->gvalue == NULL) {
-        osip_free(buf);
+      if (u_param->gvalue == NULL)
         return OSIP_SYNTAXERROR;
-      }
-
-      tmp_len = strlen(buf) + 4 + strlen(u_param->gname) + strlen(u_param->gvalue) + 1;
 
-      if (len < tmp_len) {
-        buf = osip_realloc(buf, tmp_len);
-        len = tmp_len;
-        tmp = buf + strlen(buf);
-      }
-
-      snprintf(tmp, len - (tmp - buf), "; %s=%s", u_param->gname, u_param->gvalue);
-      tmp = tmp + strlen(tmp);
+      __osip_writer_append(w, "; ", 2);
+      __osip_writer_puts(w, u_param->gname);
+      __osip_writer_putc(w, '=');
+      __osip_writer_puts(w, u_param->gvalue);
       u_param = (osip_generic_param_t *) osip_list_get_next(&it);
     }
   }
-  *dest = buf;
+
   return OSIP_SUCCESS;
 }
 
+int osip_content_type_to_str(const osip_content_type_t *content_type, char **dest) {
+  return __osip_writer_to_str(content_type, (int (*)(const void *, __osip_writer_t *)) & __osip_content_type_write, dest, NULL);
+}
+
+int osip_content_type_to_buf(const osip_content_type_t *content_type, char *buf, size_t cap, size_t *len) {
+  return __osip_writer_to_buf(content_type, (int (*)(const void *, __osip_writer_t *)) & __osip_content_type_write, buf, cap, len);
+}
+
 /* deallocates a osip_content_type_t structure.  */
 /* INPUT : osip_content_type_t *content_type | content_type. */
 void osip_content_type_free(osip_content_type_t *content_type) {
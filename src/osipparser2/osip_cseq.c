@@ -22,6 +22,7 @@
 #include <osipparser2/osip_port.h>
 #include <osipparser2/osip_message.h>
 #include <osipparser2/osip_parser.h>
+#include "parser.h"
 
 int osip_cseq_init(osip_cseq_t **cseq) {
   *cseq = (osip_cseq_t *) osip_malloc(sizeof(osip_cseq_t));
@@ -136,22 +137,22 @@ void osip_cseq_set_method(osip_cseq_t *cseq, char *method) {
 /* returns the cseq header as a string.          */
 /* INPUT : osip_cseq_t *cseq | cseq header.  */
 /* returns null on error. */
-int osip_cseq_to_str(const osip_cseq_t *cseq, char **dest) {
-  size_t len;
-
-  *dest = NULL;
-
+int __osip_cseq_write(const osip_cseq_t *cseq, __osip_writer_t *w) {
   if ((cseq == NULL) || (cseq->number == NULL) || (cseq->method == NULL))
     return OSIP_BADPARAMETER;
 
-  len = strlen(cseq->method) + strlen(cseq->number) + 2;
-  *dest = (char *) osip_malloc(len);
+  __osip_writer_puts(w, cseq->number);
+  __osip_writer_putc(w, ' ');
+  __osip_writer_puts(w, cseq->method);
+  return OSIP_SUCCESS;
+}
 
-  if (*dest == NULL)
-    return OSIP_NOMEM;
+int osip_cseq_to_str(const osip_cseq_t *cseq, char **dest) {
+  return __osip_writer_to_str(cseq, (int (*)(const void *, __osip_writer_t *)) & __osip_cseq_write, dest, NULL);
+}
 
-  snprintf(*dest, len, "%s %s", cseq->number, cseq->method);
-  return OSIP_SUCCESS;
+int osip_cseq_to_buf(const osip_cseq_t *cseq, char *buf, size_t cap, size_t *len) {
+  return __osip_writer_to_buf(cseq, (int (*)(const void *, __osip_writer_t *)) & __osip_cseq_write, buf, cap, len);
 }
 
 /* deallocates a osip_cseq_t structure.  */
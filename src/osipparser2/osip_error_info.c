@@ -55,6 +55,9 @@ int osip_message_get_error_info(const osip_message_t *sip, int pos, osip_error_i
 
   *dest = NULL;
 
+  if (!osip_list_eol(&sip->lazy_headers, 0))
+    __osip_message_parse_lazy_headers((osip_message_t *) sip, &osip_message_set_error_info);
+
   if (osip_list_size(&sip->error_infos) <= pos)
     return OSIP_UNDEFINED_ERROR; /* does not exist */
 
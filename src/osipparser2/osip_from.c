@@ -320,75 +320,37 @@ int osip_from_parse(osip_from_t *from, const char *hvalue) {
 /* returns the from header as a string.  */
 /* INPUT : osip_from_t *from | from header.   */
 /* returns -1 on error. */
-int osip_from_to_str(const osip_from_t *from, char **dest) {
-  char *url;
-  char *buf;
+int __osip_from_write(const osip_from_t *from, __osip_writer_t *w) {
   int i;
-  size_t len;
-
-  *dest = NULL;
 
   if ((from == NULL) || (from->url == NULL))
     return OSIP_BADPARAMETER;
 
-  i = osip_uri_to_str(from->url, &url);
-
-  if (i != 0)
-    return i;
-
-  if (from->displayname == NULL)
-    len = strlen(url) + 5;
-
-  else
-    len = strlen(url) + strlen(from->displayname) + 5;
-
-  buf = (char *) osip_malloc(len);
-
-  if (buf == NULL) {
-    osip_free(url);
-    return OSIP_NOMEM;
+  /* from rfc2543bis-04: for authentication related issue!
+     "The To and From header fields always include the < and >
+     delimiters even if the display-name is empty." */
+  if (from->displayname != NULL) {
+    __osip_writer_puts(w, from->displayname);
+    __osip_writer_putc(w, ' ');
   }
 
-  if (from->displayname != NULL)
-    sprintf(buf, "%s <%s>", from->displayname, url);
+  __osip_writer_putc(w, '<');
+  i = __osip_uri_write(from->url, w);
 
-  else
-    /* from rfc2543bis-04: for authentication related issue!
-       "The To and From header fields always include the < and >
-       delimiters even if the display-name is empty." */
-    sprintf(buf, "<%s>", url);
-
-  osip_free(url);
-
-  {
-    size_t plen;
-    char *tmp;
-    osip_list_iterator_t it;
-    osip_generic_param_t *u_param = (osip_generic_param_t *) osip_list_get_first(&from->gen_params, &it);
-
-    while (u_param != OSIP_SUCCESS) {
-      if (u_param->gvalue == NULL)
-        plen = strlen(u_param->gname) + 2;
-
-      else
-        plen = strlen(u_param->gname) + strlen(u_param->gvalue) + 3;
-
-      len = len + plen;
-      buf = (char *) osip_realloc(buf, len);
-      tmp = buf;
-      tmp = tmp + strlen(tmp);
+  if (i != 0)
+    return i;
 
-      if (u_param->gvalue == NULL)
-        snprintf(tmp, len - (tmp - buf), ";%s", u_param->gname);
+  __osip_writer_putc(w, '>');
+  __osip_writer_gen_params(w, &from->gen_params);
+  return OSIP_SUCCESS;
+}
 
-      else
-        snprintf(tmp, len - (tmp - buf), ";%s=%s", u_param->gname, u_param->gvalue);
+int osip_from_to_str(const osip_from_t *from, char **dest) {
+  return __osip_writer_to_str(from, (int (*)(const void *, __osip_writer_t *)) & __osip_from_write, dest, NULL);
+}
 
-      u_param = (osip_generic_param_t *) osip_list_get_next(&it);
-    }
-  }
-  *dest = buf;
-  return OSIP_SUCCESS;
+int osip_from_to_buf(const osip_from_t *from, char *buf, size_t cap, size_t *len) {
+  return __osip_writer_to_buf(from, (int (*)(const void *, __osip_writer_t *)) & __osip_from_write, buf, cap, len);
 }
 
 char *osip_from_get_displayname(osip_from_t *from) {
@@ -22,6 +22,7 @@
 #include <osipparser2/osip_port.h>
 #include <osipparser2/osip_message.h>
 #include <osipparser2/osip_parser.h>
+#include "parser.h"
 
 /* Add a header to a SIP message.                           */
 /* INPUT :  char *hname | pointer to a header name.         */
@@ -233,35 +234,30 @@ void osip_header_free(osip_header_t *header) {
 /* returns the header as a string.    */
 /* INPUT : osip_header_t *header | header. */
 /* returns null on error. */
-int osip_header_to_str(const osip_header_t *header, char **dest) {
-  size_t len, hlen;
-
-  *dest = NULL;
+int __osip_header_write(const osip_header_t *header, __osip_writer_t *w) {
+  size_t start = w->len;
 
   if ((header == NULL) || (header->hname == NULL))
     return OSIP_BADPARAMETER;
 
-  len = 0;
-  hlen = strlen(header->hname);
+  __osip_writer_puts(w, header->hname);
+  __osip_writer_append(w, ": ", 2);
 
   if (header->hvalue != NULL)
-    len = strlen(header->hvalue);
-
-  *dest = (char *) osip_malloc(hlen + len + 3);
-
-  if (*dest == NULL)
-    return OSIP_NOMEM;
+    __osip_writer_puts(w, header->hvalue);
 
-  if (header->hvalue != NULL)
-    snprintf(*dest, hlen + len + 3, "%s: %s", header->hname, header->hvalue);
+  if (start < w->cap && w->buf[start] >= 'a' && w->buf[start] <= 'z')
+    w->buf[start] = (w->buf[start] - 32);
 
-  else
-    snprintf(*dest, hlen + len + 3, "%s: ", header->hname);
+  return OSIP_SUCCESS;
+}
 
-  if (*dest[0] >= 'a' && *dest[0] <= 'z')
-    *dest[0] = (*dest[0] - 32);
+int osip_header_to_str(const osip_header_t *header, char **dest) {
+  return __osip_writer_to_str(header, (int (*)(const void *, __osip_writer_t *)) & __osip_header_write, dest, NULL);
+}
 
-  return OSIP_SUCCESS;
+int osip_header_to_buf(const osip_header_t *header, char *buf, size_t cap, size_t *len) {
+  return __osip_writer_to_buf(header, (int (*)(const void *, __osip_writer_t *)) & __osip_header_write, buf, cap, len);
 }
 
 char *osip_header_get_name(const osip_header_t *header) {
@@ -22,6 +22,57 @@
 #include <osipparser2/osip_port.h>
 #include <osipparser2/osip_list.h>
 
+/* Elements are stored in an array: the first OSIP_LIST_INLINE_SIZE
+   elements fit in the osip_list_t structure, larger lists use an array
+   allocated with osip_malloc and doubled when full. The array is
+   released when the list becomes empty so that an empty list never
+   holds memory.
+
+   Iterators only use their position: actual is kept not NULL while
+   the iterator is valid for osip_list_iterator_has_elem(). */
+
+#define OSIP_LIST_MIN_SIZE 8
+
+static __node_t osip_list_iterator_node;
+
+#define osip_list_elements(li) ((li)->elements != NULL ? (li)->elements : (void **) (li)->inline_elements)
+
+static int __osip_list_grow(osip_list_t *li) {
+  void **elements;
+  int size;
+
+  if (li->elements == NULL) {
+    size = OSIP_LIST_MIN_SIZE;
+    elements = (void **) osip_malloc(sizeof(void *) * size);
+
+    if (elements == NULL)
+      return OSIP_NOMEM;
+
+    memcpy(elements, li->inline_elements, sizeof(void *) * li->nb_elt);
+
+  } else {
+    size = li->size * 2;
+    elements = (void **) osip_realloc(li->elements, sizeof(void *) * size);
+
+    if (elements == NULL)
+      return OSIP_NOMEM;
+  }
+
+  li->elements = elements;
+  li->size = size;
+  return OSIP_SUCCESS;
+}
+
+/* go back to the inline storage once empty */
+static void __osip_list_reset(osip_list_t *li) {
+  if (li->elements != NULL)
+    osip_free(li->elements);
+
+  li->elements = NULL;
+  li->size = 0;
+  li->nb_elt = 0;
+}
+
 int osip_list_init(osip_list_t *li) {
   if (li == NULL)
     return OSIP_BADPARAMETER;
@@ -49,31 +100,42 @@ int osip_list_clone(const osip_list_t *src, osip_list_t *dst, int (*clone_func)(
 }
 
 void osip_list_special_free(osip_list_t *li, void (*free_func)(void *)) {
-  void *element;
+  void *inline_elements[OSIP_LIST_INLINE_SIZE];
+  void **elements;
+  int nb_elt;
+  int pos;
 
-  if (li == NULL)
+  if (li == NULL || li->nb_elt <= 0)
     return;
 
-  while (!osip_list_eol(li, 0)) {
-    element = (void *) osip_list_get(li, 0);
-    osip_list_remove(li, 0);
+  /* the list is emptied before elements are released */
+  nb_elt = li->nb_elt;
+  elements = li->elements;
 
-    if (free_func != NULL)
-      free_func(element);
+  if (elements == NULL) {
+    memcpy(inline_elements, li->inline_elements, sizeof(void *) * nb_elt);
+    elements = inline_elements;
   }
-}
-
-void osip_list_ofchar_free(osip_list_t *li) {
-  char *chain;
 
-  if (li == NULL)
-    return;
+  li->elements = NULL;
+  li->size = 0;
+  li->nb_elt = 0;
 
-  while (!osip_list_eol(li, 0)) {
-    chain = (char *) osip_list_get(li, 0);
-    osip_list_remove(li, 0);
-    osip_free(chain);
+  if (free_func != NULL) {
+    for (pos = 0; pos < nb_elt; pos++)
+      free_func(elements[pos]);
   }
+
+  if (elements != inline_elements)
+    osip_free(elements);
+}
+
+static void __osip_list_free_char(void *chain) {
+  osip_free(chain);
+}
+
+void osip_list_ofchar_free(osip_list_t *li) {
+  osip_list_special_free(li, __osip_list_free_char);
 }
 
 int osip_list_size(const osip_list_t *li) {
@@ -95,90 +157,29 @@ int osip_list_eol(const osip_list_t *li, int i) {
 
 /* index starts from 0; */
 int osip_list_add(osip_list_t *li, void *el, int pos) {
-  __node_t *ntmp;
-  int i = 0;
+  void **elements;
+  int size;
 
   if (li == NULL)
     return OSIP_BADPARAMETER;
 
-  if (li->nb_elt == 0) {
-    li->node = (__node_t *) osip_malloc(sizeof(__node_t));
-
-    if (li->node == NULL)
-      return OSIP_NOMEM;
+  size = (li->elements != NULL) ? li->size : OSIP_LIST_INLINE_SIZE;
 
-    li->node->element = el;
-    li->node->next = NULL;
-    li->nb_elt++;
-    return li->nb_elt;
-  }
+  if (li->nb_elt >= size && __osip_list_grow(li) != OSIP_SUCCESS)
+    return OSIP_NOMEM; /* leave the list unchanged */
 
-  if (pos == -1 || pos >= li->nb_elt) { /* insert at the end  */
+  if (pos < 0 || pos >= li->nb_elt) /* insert at the end  */
     pos = li->nb_elt;
-  }
-
-  ntmp = li->node; /* exist because nb_elt>0  */
-
-  if (pos == 0) { /* pos = 0 insert before first elt  */
-    li->node = (__node_t *) osip_malloc(sizeof(__node_t));
-
-    if (li->node == NULL) {
-      /* leave the list unchanged */
-      li->node = ntmp;
-      return OSIP_NOMEM;
-    }
-
-    li->node->element = el;
-    li->node->next = ntmp;
-    li->nb_elt++;
-    return li->nb_elt;
-  }
-
-  while (pos > i + 1) {
-    i++;
-    /* when pos>i next node exist  */
-    ntmp = ntmp->next;
-  }
-
-  /* if pos==nb_elt next node does not exist  */
-  if (pos == li->nb_elt) {
-    ntmp->next = osip_malloc(sizeof(__node_t));
-
-    if (ntmp->next == NULL)
-      return OSIP_NOMEM; /* leave the list unchanged */
-
-    ntmp = ntmp->next;
-    ntmp->element = el;
-    ntmp->next = NULL;
-    li->nb_elt++;
-    return li->nb_elt;
-  }
-
-  /* here pos==i so next node is where we want to insert new node */
-  {
-    __node_t *nextnode = ntmp->next;
-
-    ntmp->next = osip_malloc(sizeof(__node_t));
 
-    if (ntmp->next == NULL) {
-      /* leave the list unchanged */
-      ntmp->next = nextnode;
-      return OSIP_NOMEM;
-    }
-
-    ntmp = ntmp->next;
-    ntmp->element = el;
-    ntmp->next = nextnode;
-    li->nb_elt++;
-  }
+  elements = osip_list_elements(li);
+  memmove(elements + pos + 1, elements + pos, sizeof(void *) * (li->nb_elt - pos));
+  elements[pos] = el;
+  li->nb_elt++;
   return li->nb_elt;
 }
 
 /* index starts from 0 */
 void *osip_list_get(const osip_list_t *li, int pos) {
-  __node_t *ntmp;
-  int i = 0;
-
   if (li == NULL)
     return NULL;
 
@@ -186,14 +187,7 @@ void *osip_list_get(const osip_list_t *li, int pos) {
     /* element does not exist */
     return NULL;
 
-  ntmp = li->node; /* exist because nb_elt>0 */
-
-  while (pos > i) {
-    i++;
-    ntmp = ntmp->next;
-  }
-
-  return ntmp->element;
+  return osip_list_elements(li)[pos];
 }
 
 /* added by bennewit@cs.tu-berlin.de */
@@ -203,12 +197,12 @@ void *osip_list_get_first(const osip_list_t *li, osip_list_iterator_t *iterator)
     return OSIP_SUCCESS;
   }
 
-  iterator->actual = li->node;
-  iterator->prev = (__node_t **) &li->node;
+  iterator->actual = &osip_list_iterator_node;
+  iterator->prev = NULL;
   iterator->li = (osip_list_t *) li;
   iterator->pos = 0;
 
-  return li->node->element;
+  return osip_list_elements(li)[0];
 }
 
 /* added by bennewit@cs.tu-berlin.de */
@@ -217,12 +211,10 @@ void *osip_list_get_next(osip_list_iterator_t *iterator) {
     return OSIP_SUCCESS;
   }
 
-  iterator->prev = &(iterator->actual->next);
-  iterator->actual = iterator->actual->next;
   ++(iterator->pos);
 
   if (osip_list_iterator_has_elem(*iterator)) {
-    return iterator->actual->element;
+    return osip_list_elements(iterator->li)[iterator->pos];
   }
 
   iterator->actual = 0;
@@ -231,17 +223,12 @@ void *osip_list_get_next(osip_list_iterator_t *iterator) {
 
 /* added by bennewit@cs.tu-berlin.de */
 void *osip_list_iterator_remove(osip_list_iterator_t *iterator) {
-  if (osip_list_iterator_has_elem(*iterator)) {
-    --(iterator->li->nb_elt);
-
-    *(iterator->prev) = iterator->actual->next;
-
-    osip_free(iterator->actual);
-    iterator->actual = *(iterator->prev);
-  }
+  if (osip_list_iterator_has_elem(*iterator))
+    osip_list_remove(iterator->li, iterator->pos);
 
+  /* the iterator now points to the next element */
   if (osip_list_iterator_has_elem(*iterator)) {
-    return iterator->actual->element;
+    return osip_list_elements(iterator->li)[iterator->pos];
   }
 
   return OSIP_SUCCESS;
@@ -249,8 +236,7 @@ void *osip_list_iterator_remove(osip_list_iterator_t *iterator) {
 
 /* return -1 if failed */
 int osip_list_remove(osip_list_t *li, int pos) {
-  __node_t *ntmp;
-  int i = 0;
+  void **elements;
 
   if (li == NULL)
     return OSIP_BADPARAMETER;
@@ -259,28 +245,13 @@ int osip_list_remove(osip_list_t *li, int pos) {
     /* element does not exist */
     return OSIP_UNDEFINED_ERROR;
 
-  ntmp = li->node; /* exist because nb_elt>0 */
-
-  if (pos == 0) { /* special case  */
-    li->node = ntmp->next;
-    li->nb_elt--;
-    osip_free(ntmp);
-    return li->nb_elt;
+  if (li->nb_elt == 1) {
+    __osip_list_reset(li);
+    return 0;
   }
 
-  while (pos > i + 1) {
-    i++;
-    ntmp = ntmp->next;
-  }
-
-  /* insert new node */
-  {
-    __node_t *remnode;
-
-    remnode = ntmp->next;
-    ntmp->next = (ntmp->next)->next;
-    osip_free(remnode);
-    li->nb_elt--;
-  }
+  elements = osip_list_elements(li);
+  memmove(elements + pos, elements + pos + 1, sizeof(void *) * (li->nb_elt - pos - 1));
+  li->nb_elt--;
   return li->nb_elt;
 }
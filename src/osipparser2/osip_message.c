@@ -21,6 +21,7 @@
 
 #include <osipparser2/osip_port.h>
 #include <osipparser2/osip_message.h>
+#include "parser.h"
 
 /* enable logging of memory accesses */
 
@@ -34,6 +35,10 @@ int osip_message_init(osip_message_t **sip) {
 
   memset(*sip, 0, sizeof(osip_message_t));
 
+  /* a message allocated in an arena keeps it alive */
+  if (__osip_arena_get(*sip) != NULL)
+    __osip_arena_ref(__osip_arena_get(*sip));
+
 #ifndef MINISIZE
   osip_list_init(&(*sip)->accepts);
   osip_list_init(&(*sip)->accept_encodings);
@@ -79,6 +84,8 @@ int osip_message_init(osip_message_t **sip) {
   (*sip)->message_length = 0;
 
   (*sip)->application_data = NULL;
+
+  osip_list_init(&(*sip)->lazy_headers);
   return OSIP_SUCCESS; /* ok */
 }
 
@@ -103,6 +110,8 @@ void osip_message_set_uri(osip_message_t *sip, osip_uri_t *url) {
 }
 
 void osip_message_free(osip_message_t *sip) {
+  void *arena;
+
   if (sip == NULL)
     return;
 
@@ -162,8 +171,16 @@ void osip_message_free(osip_message_t *sip) {
   osip_list_special_free(&sip->www_authenticates, (void (*)(void *)) & osip_www_authenticate_free);
   osip_list_special_free(&sip->headers, (void (*)(void *)) & osip_header_free);
   osip_list_special_free(&sip->bodies, (void (*)(void *)) & osip_body_free);
+  osip_list_special_free(&sip->lazy_headers, (void (*)(void *)) & osip_header_free);
   osip_free(sip->message);
+  __osip_message_cache_unref(sip->message_cache);
+  __osip_wire_free(sip);
+
+  arena = __osip_arena_get(sip);
   osip_free(sip);
+
+  if (arena != NULL)
+    __osip_arena_unref(arena);
 }
 
 int osip_message_clone(const osip_message_t *sip, osip_message_t **dest) {
@@ -175,6 +192,9 @@ int osip_message_clone(const osip_message_t *sip, osip_message_t **dest) {
   if (sip == NULL)
     return OSIP_BADPARAMETER;
 
+  if (!osip_list_eol(&sip->lazy_headers, 0))
+    __osip_message_parse_lazy_headers((osip_message_t *) sip, NULL);
+
   i = osip_message_init(&copy);
 
   if (i != 0)
@@ -431,6 +451,19 @@ int osip_message_clone(const osip_message_t *sip, osip_message_t **dest) {
   return OSIP_SUCCESS;
 }
 
+int osip_message_clone_with_wire(const osip_message_t *sip, osip_message_t **dest) {
+  int i;
+
+  i = osip_message_clone(sip, dest);
+
+  if (i != 0)
+    return i;
+
+  /* the clone sends its unchanged headers as they were received */
+  __osip_wire_clone((osip_message_t *) sip, *dest);
+  return OSIP_SUCCESS;
+}
+
 int osip_message_get_knownheaderlist(osip_list_t *header_list, int pos, void **dest) {
   *dest = NULL;
 
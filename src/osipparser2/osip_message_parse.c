@@ -23,9 +23,22 @@
 #include <osipparser2/osip_parser.h>
 #include "parser.h"
 
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#endif
+
+/* how a message is parsed */
+typedef struct {
+  int lazy;          /* keep headers unparsed: see osip_message_parse_lazy */
+  unsigned int mask; /* headers to parse, others are stored as unknown headers */
+  char *scratch;     /* work buffer provided by the caller (or NULL) */
+  size_t scratch_size;
+  int wire; /* keep the received message: see osip_message_to_iovec */
+} msg_parse_config_t;
+
 static void osip_util_replace_all_lws(char *sip_message);
-static int osip_message_set__header(osip_message_t *sip, const char *hname, const char *hvalue);
-static int msg_headers_parse(osip_message_t *sip, const char *start_of_header, const char **body);
+static int osip_message_set__header(osip_message_t *sip, const char *hname, const char *hvalue, int my_index, const msg_parse_config_t *cfg, size_t start, size_t end);
+static int msg_headers_parse(osip_message_t *sip, const char *beg, char *start_of_header, const char **body, const msg_parse_config_t *cfg);
 static int msg_osip_body_parse(osip_message_t *sip, const char *start_of_buf, const char **next_body, size_t length);
 
 static int __osip_message_startline_parsereq(osip_message_t *dest, const char *buf, const char **headers) {
@@ -300,6 +313,38 @@ int __osip_find_next_occurence(const char *str, const char *buf, const char **in
   return OSIP_SYNTAXERROR;
 }
 
+/* Return the first CR, LF or '\0' found from p.
+   With SSE2, 16 bytes are tested at once. Loads are aligned so that
+   they never cross a page: bytes read after the '\0' are ignored. */
+#if defined(__SSE2__) && defined(__GNUC__)
+__attribute__((no_sanitize_address)) static const char *msg_find_eol(const char *p) {
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i lf = _mm_set1_epi8('\n');
+  const __m128i nul = _mm_setzero_si128();
+  const char *a = (const char *) ((size_t) p & ~(size_t) 15);
+  __m128i v = _mm_load_si128((const __m128i *) a);
+  unsigned int mask;
+
+  mask = (unsigned int) _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)), _mm_cmpeq_epi8(v, nul)));
+  mask &= ~0U << (p - a); /* bytes before p */
+
+  while (mask == 0) {
+    a += 16;
+    v = _mm_load_si128((const __m128i *) a);
+    mask = (unsigned int) _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)), _mm_cmpeq_epi8(v, nul)));
+  }
+
+  return a + __builtin_ctz(mask);
+}
+#else
+static const char *msg_find_eol(const char *p) {
+  while ('\r' != *p && '\n' != *p && '\0' != *p)
+    p++;
+
+  return p;
+}
+#endif
+
 /* This method replace all LWS with SP located before the
    initial CRLFCRLF found or the end of the string.
 */
@@ -315,6 +360,9 @@ static void osip_util_replace_all_lws(char *sip_message) {
   tmp = sip_message;
 
   for (; tmp[0] != '\0'; tmp++) {
+    /* a LWS (or the end of headers) always starts on a CR or LF */
+    tmp = (char *) msg_find_eol(tmp);
+
     if (('\0' == tmp[0]) || ('\0' == tmp[1]) || ('\0' == tmp[2]) || ('\0' == tmp[3]))
       return;
 
@@ -344,14 +392,11 @@ int __osip_find_next_crlf(const char *start_of_header, const char **end_of_heade
 
   *end_of_header = NULL; /* AMD fix */
 
-  while (('\r' != *soh) && ('\n' != *soh)) {
-    if (*soh)
-      soh++;
+  soh = msg_find_eol(soh);
 
-    else {
-      OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL, "Final CRLF is missing\n"));
-      return OSIP_SYNTAXERROR;
-    }
+  if ('\0' == *soh) {
+    OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL, "Final CRLF is missing\n"));
+    return OSIP_SYNTAXERROR;
   }
 
   if (('\r' == soh[0]) && ('\n' == soh[1]))
@@ -411,73 +456,103 @@ int __osip_find_next_crlfcrlf(const char *start_of_part, const char **end_of_par
   }
 }
 
-static int osip_message_set__header(osip_message_t *sip, const char *hname, const char *hvalue) {
-  int my_index;
+/* keep a known header unparsed: see osip_message_parse_lazy */
+static int msg_headers_set_lazy(osip_message_t *sip, const char *hname, const char *hvalue) {
+  osip_header_t *h;
+  int i;
+
+  i = osip_header_init(&h);
+
+  if (i != 0)
+    return i;
+
+  h->hname = osip_strdup(hname);
+  h->hvalue = (hvalue != NULL) ? osip_strdup(hvalue) : NULL;
+
+  if (h->hname == NULL || (hvalue != NULL && h->hvalue == NULL)) {
+    osip_header_free(h);
+    return OSIP_NOMEM;
+  }
+
+  osip_list_add(&sip->lazy_headers, h, -1);
+  return OSIP_SUCCESS;
+}
+
+/* my_index is the pconfig index of hname (or -1 for an unknown header).
+   [start, end) is the line of the header in the received message
+   when it holds this header only (end is 0 otherwise) */
+static int osip_message_set__header(osip_message_t *sip, const char *hname, const char *hvalue, int my_index, const msg_parse_config_t *cfg, size_t start, size_t end) {
+  __osip_wire_mark_t mark;
+  int known;
+  int wire;
+  int ret;
 
   if (hname == NULL)
     return OSIP_SYNTAXERROR;
 
   /* some headers are analysed completely      */
   /* this method is used for selective parsing */
-  my_index = __osip_message_is_known_header(hname);
+  if (my_index >= 0 && !__osip_message_is_in_mask(my_index, cfg->mask))
+    my_index = -1; /* keep it as an unknown header */
 
-  if (my_index >= 0) { /* ok */
-    int ret;
+  if (my_index >= 0 && cfg->lazy && __osip_message_is_lazy_header(my_index))
+    known = WIRE_LAZY_HEADERS;
 
-    ret = __osip_message_call_method(my_index, sip, hvalue);
+  else if (my_index >= 0)
+    known = __osip_message_get_known_header(my_index);
 
-    if (ret != 0)
-      return ret;
+  else
+    known = WIRE_UNKNOWN_HEADERS;
 
-    return OSIP_SUCCESS;
-  }
+  wire = (end > start && __osip_wire_mark(sip, known, &mark) == OSIP_SUCCESS);
+
+  if (known == WIRE_LAZY_HEADERS)
+    ret = msg_headers_set_lazy(sip, hname, hvalue);
+
+  else if (my_index >= 0) /* ok */
+    ret = __osip_message_call_method(my_index, sip, hvalue);
 
   /* unknownheader */
-  if (osip_message_set_header(sip, hname, hvalue) != 0) {
+  else if (osip_message_set_header(sip, hname, hvalue) != 0) {
     OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_WARNING, NULL, "Could not set unknown header\n"));
     return OSIP_SUCCESS;
-  }
+
+  } else
+    ret = OSIP_SUCCESS;
+
+  if (ret != 0)
+    return ret;
+
+  /* remember where the header is: see osip_message_to_iovec */
+  if (wire)
+    __osip_wire_add(sip, &mark, start, end);
 
   return OSIP_SUCCESS;
 }
 
-int osip_message_set_multiple_header(osip_message_t *sip, char *hname, char *hvalue) {
+/* terminate the slice [beg, end) of a writable buffer and return
+   it without leading and trailing spaces (like osip_clrncpy, in place) */
+static char *msg_slice_clr(char *beg, char *end) {
+  while (beg < end && (' ' == *beg || '\t' == *beg || '\r' == *beg || '\n' == *beg))
+    beg++;
+
+  while (end > beg && (' ' == end[-1] || '\t' == end[-1] || '\r' == end[-1] || '\n' == end[-1]))
+    end--;
+
+  *end = '\0';
+  return beg;
+}
+
+/* split hvalue on COMMA (outside quotes and URIs) and store each value.
+   hvalue is modified: values are terminated in place. */
+static int msg_headers_split(osip_message_t *sip, const char *hname, char *hvalue, int my_index, const msg_parse_config_t *cfg) {
   int i;
   char *ptr, *p;       /* current location of the search */
-  char *comma;         /* This is the separator we are elooking for */
   char *beg;           /* beg of a header */
   char *end;           /* end of a header */
   int inquotes, inuri; /* state for inside/outside of double-qoutes or URI */
 
-  /* Find header based upon lowercase comparison */
-  osip_tolower(hname);
-
-  if (hvalue == NULL) {
-    i = osip_message_set__header(sip, hname, hvalue);
-
-    if (i != 0)
-      return i;
-
-    return OSIP_SUCCESS;
-  }
-
   ptr = hvalue;
-  comma = strchr(ptr, ',');
-
-  /* if there is a COMMA, we check if the header is allowed on multiple line from an internal
-     list: those headers are defined in rfc to support the following format.
-     header  =  "header-name" HCOLON header-value *(COMMA header-value)
-     We cannot guess for any other headers and thus, we will handle other headers as one header.
-   */
-  if (comma == NULL || __osip_message_is_header_comma_separated(hname) != OSIP_SUCCESS) {
-    i = osip_message_set__header(sip, hname, hvalue);
-
-    if (i != 0)
-      return i;
-
-    return OSIP_SUCCESS;
-  }
-
   beg = hvalue;
   inquotes = 0;
   inuri = 0;
@@ -532,7 +607,7 @@ int osip_message_set_multiple_header(osip_message_t *sip, char *hname, char *hva
     // fall through
     case ',':
       if (!inquotes && !inuri) {
-        char *avalue;
+        int last = (*ptr == '\0');
 
         if (beg[0] == '\0')
           return OSIP_SUCCESS; /* empty header */
@@ -544,20 +619,17 @@ int osip_message_set_multiple_header(osip_message_t *sip, char *hname, char *hva
           break; /* skip empty header */
         }
 
-        avalue = (char *) osip_malloc(end - beg + 1);
-
-        if (avalue == NULL)
-          return OSIP_NOMEM;
-
-        osip_clrncpy(avalue, beg, end - beg);
         /* really store the header in the sip structure */
-        i = osip_message_set__header(sip, hname, avalue);
-        osip_free(avalue);
+        i = osip_message_set__header(sip, hname, msg_slice_clr(beg, end), my_index, cfg, 0, 0);
 
         if (i != 0)
           return i;
 
+        if (last)
+          return OSIP_SUCCESS;
+
         beg = end + 1;
+        break;
       }
 
       if (*ptr == '\0')
@@ -571,12 +643,56 @@ int osip_message_set_multiple_header(osip_message_t *sip, char *hname, char *hva
   }
 }
 
-/* set all headers */
-static int msg_headers_parse(osip_message_t *sip, const char *start_of_header, const char **body) {
-  const char *colon_index; /* index of ':' */
+/* hvalue MAY contains multiple value. In this case, they   */
+/* are separated by commas. But, a comma may be part of a   */
+/* quoted-string ("here, and there" is an example where the */
+/* comma is not a separator!) */
+static int msg_headers_set(osip_message_t *sip, char *hname, char *hvalue, int writable, const msg_parse_config_t *cfg, size_t start, size_t end) {
+  char *copy;
+  int my_index;
+  int comma;
+  int i;
+
+  /* one case insensitive look-up gives both the index and the comma flag */
+  my_index = __osip_message_lookup_header(hname, &comma);
+
+  if (my_index < 0)
+    osip_tolower(hname); /* unknown headers are stored lowercase */
+
+  /* if there is a COMMA, we check if the header is allowed on multiple line from an internal
+     list: those headers are defined in rfc to support the following format.
+     header  =  "header-name" HCOLON header-value *(COMMA header-value)
+     We cannot guess for any other headers and thus, we will handle other headers as one header.
+   */
+  if (hvalue == NULL || !comma || strchr(hvalue, ',') == NULL)
+    return osip_message_set__header(sip, hname, hvalue, my_index, cfg, start, end);
+
+  if (writable)
+    return msg_headers_split(sip, hname, hvalue, my_index, cfg);
+
+  copy = osip_strdup(hvalue);
+
+  if (copy == NULL)
+    return OSIP_NOMEM;
+
+  i = msg_headers_split(sip, hname, copy, my_index, cfg);
+  osip_free(copy);
+  return i;
+}
+
+int osip_message_set_multiple_header(osip_message_t *sip, char *hname, char *hvalue) {
+  msg_parse_config_t cfg = {0, OSIP_HEADER_MASK_ALL, NULL, 0, 0};
+
+  return msg_headers_set(sip, hname, hvalue, 0, &cfg, 0, 0);
+}
+
+/* set all headers: beg is the beginning of the message */
+static int msg_headers_parse(osip_message_t *sip, const char *beg, char *start_of_header, const char **body, const msg_parse_config_t *cfg) {
+  char *colon_index; /* index of ':' */
   char *hname;
   char *hvalue;
   const char *end_of_header;
+  int crlf;
   int i;
 
   for (;;) {
@@ -600,8 +716,8 @@ static int msg_headers_parse(osip_message_t *sip, const char *start_of_header, c
       return OSIP_SUCCESS; /* end of header found        */
     }
 
-    /* find the header name */
-    colon_index = strchr(start_of_header, ':');
+    /* find the header name (only in this line) */
+    colon_index = (end_of_header != NULL) ? (char *) memchr(start_of_header, ':', end_of_header - start_of_header) : NULL;
 
     if (colon_index == NULL) {
       OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL, "End of header Not found\n"));
@@ -616,48 +732,34 @@ static int msg_headers_parse(osip_message_t *sip, const char *start_of_header, c
       return OSIP_SYNTAXERROR;
     }
 
-    hname = (char *) osip_malloc(colon_index - start_of_header + 1);
-
-    if (hname == NULL)
-      return OSIP_NOMEM;
-
-    osip_clrncpy(hname, start_of_header, colon_index - start_of_header);
+    /* only lines ending with CRLF can be sent again as they are */
+    crlf = (end_of_header[-2] == '\r' && end_of_header[-1] == '\n');
 
+    /* name and value are terminated in place: the buffer is a private copy of the message */
     {
-      const char *end;
+      char *end;
 
       /* END of header is (end_of_header-2) if header separation is CRLF */
       /* END of header is (end_of_header-1) if header separation is CR or LF */
       if ((end_of_header[-2] == '\r') || (end_of_header[-2] == '\n'))
-        end = end_of_header - 2;
+        end = (char *) end_of_header - 2;
 
       else
-        end = end_of_header - 1;
+        end = (char *) end_of_header - 1;
 
       if ((end) -colon_index < 2)
         hvalue = NULL; /* some headers (subject) can be empty */
-      else {
-        hvalue = (char *) osip_malloc((end) -colon_index + 1);
-
-        if (hvalue == NULL) {
-          osip_free(hname);
-          return OSIP_NOMEM;
-        }
-
-        osip_clrncpy(hvalue, colon_index + 1, (end) -colon_index - 1);
-      }
+      else
+        hvalue = msg_slice_clr(colon_index + 1, end);
     }
 
-    /* hvalue MAY contains multiple value. In this case, they   */
-    /* are separated by commas. But, a comma may be part of a   */
-    /* quoted-string ("here, and there" is an example where the */
-    /* comma is not a separator!) */
-    i = osip_message_set_multiple_header(sip, hname, hvalue);
+    hname = msg_slice_clr(start_of_header, colon_index);
 
-    osip_free(hname);
+    if (crlf)
+      i = msg_headers_set(sip, hname, hvalue, 1, cfg, start_of_header - beg, end_of_header - beg);
 
-    if (hvalue != NULL)
-      osip_free(hvalue);
+    else
+      i = msg_headers_set(sip, hname, hvalue, 1, cfg, 0, 0);
 
     if (i != 0) {
       OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL, "End of header Not found\n"));
@@ -665,7 +767,7 @@ static int msg_headers_parse(osip_message_t *sip, const char *start_of_header, c
     }
 
     /* continue on the next header */
-    start_of_header = end_of_header;
+    start_of_header = (char *) end_of_header;
   }
 
   /* Unreachable code
@@ -860,17 +962,23 @@ static int msg_osip_body_parse(osip_message_t *sip, const char *start_of_buf, co
 }
 
 /* osip_message_t *sip is filled while analysing buf */
-static int _osip_message_parse(osip_message_t *sip, const char *buf, size_t length, int sipfrag) {
+static int _osip_message_parse(osip_message_t *sip, const char *buf, size_t length, int sipfrag, const msg_parse_config_t *cfg) {
   int i;
   const char *next_header_index;
   char *tmp;
   char *beg;
+  char *allocated = NULL;
 
-  tmp = osip_malloc(length + 2);
+  if (cfg->scratch != NULL && cfg->scratch_size >= length + 2) {
+    tmp = cfg->scratch;
 
-  if (tmp == NULL) {
-    OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL, "Could not allocate memory.\n"));
-    return OSIP_NOMEM;
+  } else {
+    tmp = allocated = osip_malloc(length + 2);
+
+    if (tmp == NULL) {
+      OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL, "Could not allocate memory.\n"));
+      return OSIP_NOMEM;
+    }
   }
 
   beg = tmp;
@@ -884,18 +992,23 @@ static int _osip_message_parse(osip_message_t *sip, const char *buf, size_t leng
 
   if (i != 0 && !sipfrag) {
     OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL, "Could not parse start line of message.\n"));
-    osip_free(beg);
+    osip_free(allocated);
     return i;
   }
 
   tmp = (char *) next_header_index;
 
+  if (cfg->wire && __osip_wire_init(sip, buf, length) != OSIP_SUCCESS) {
+    osip_free(allocated);
+    return OSIP_NOMEM;
+  }
+
   /* parse headers */
-  i = msg_headers_parse(sip, tmp, &next_header_index);
+  i = msg_headers_parse(sip, beg, tmp, &next_header_index, cfg);
 
   if (i != 0) {
     OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL, "error in msg_headers_parse()\n"));
-    osip_free(beg);
+    osip_free(allocated);
     return i;
   }
 
@@ -917,12 +1030,12 @@ static int _osip_message_parse(osip_message_t *sip, const char *buf, size_t leng
     if (sip->content_length == NULL)
       osip_message_set_content_length(sip, "0");
 
-    osip_free(beg);
+    osip_free(allocated);
     return OSIP_SUCCESS; /* no body found */
   }
 
   i = msg_osip_body_parse(sip, tmp, &next_header_index, length - (tmp - beg));
-  osip_free(beg);
+  osip_free(allocated);
 
   if (i != 0) {
     OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL, "error in msg_osip_body_parse()\n"));
@@ -937,11 +1050,47 @@ static int _osip_message_parse(osip_message_t *sip, const char *buf, size_t leng
 }
 
 int osip_message_parse(osip_message_t *sip, const char *buf, size_t length) {
-  return _osip_message_parse(sip, buf, length, 0);
+  msg_parse_config_t cfg = {0, OSIP_HEADER_MASK_ALL, NULL, 0, 0};
+
+  return _osip_message_parse(sip, buf, length, 0, &cfg);
 }
 
 int osip_message_parse_sipfrag(osip_message_t *sip, const char *buf, size_t length) {
-  return _osip_message_parse(sip, buf, length, 1);
+  msg_parse_config_t cfg = {0, OSIP_HEADER_MASK_ALL, NULL, 0, 0};
+
+  return _osip_message_parse(sip, buf, length, 1, &cfg);
+}
+
+int osip_message_parse_lazy(osip_message_t *sip, const char *buf, size_t length) {
+  msg_parse_config_t cfg = {1, OSIP_HEADER_MASK_ALL, NULL, 0, 0};
+
+  return _osip_message_parse(sip, buf, length, 0, &cfg);
+}
+
+int osip_message_parse_with_mask(osip_message_t *sip, const char *buf, size_t length, unsigned int mask) {
+  /* needed to find the body */
+  msg_parse_config_t cfg = {0, mask | OSIP_HEADER_MASK_CONTENT_LENGTH | OSIP_HEADER_MASK_CONTENT_TYPE, NULL, 0, 0};
+
+  return _osip_message_parse(sip, buf, length, 0, &cfg);
+}
+
+int osip_message_parse_with_scratch(osip_message_t *sip, const char *buf, size_t length, char *scratch, size_t scratch_size) {
+  msg_parse_config_t cfg = {0, OSIP_HEADER_MASK_ALL, scratch, scratch_size, 0};
+
+  return _osip_message_parse(sip, buf, length, 0, &cfg);
+}
+
+int osip_message_parse_with_wire(osip_message_t *sip, const char *buf, size_t length, int lazy) {
+  msg_parse_config_t cfg = {lazy, OSIP_HEADER_MASK_ALL, NULL, 0, 1};
+
+  return _osip_message_parse(sip, buf, length, 0, &cfg);
+}
+
+int osip_message_parse_lazy_headers(osip_message_t *sip) {
+  if (sip == NULL)
+    return OSIP_BADPARAMETER;
+
+  return __osip_message_parse_lazy_headers(sip, NULL);
 }
 
 /* This method just add a received parameter in the Via
@@ -963,6 +1112,9 @@ int osip_message_fix_last_via_header(osip_message_t *request, const char *ip_add
     /* Hey, we could build it? */
     return OSIP_BADPARAMETER;
 
+  /* the received Via is not sent again as it is */
+  __osip_wire_forget(request, via);
+
   osip_via_param_get_byname(via, "rport", &rport);
 
   if (rport != NULL) {
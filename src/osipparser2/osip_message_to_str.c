@@ -19,102 +19,202 @@
 
 #include <osipparser2/internal.h>
 
+#include <stddef.h>
+
+#if !defined(WIN32) && !defined(_WIN32_WCE)
+#include <sys/uio.h>
+#endif
+
 #include <osipparser2/osip_port.h>
 #include <osipparser2/osip_parser.h>
+#include "parser.h"
 
 #define MIME_MAX_BOUNDARY_LEN 70
 
 extern const char *osip_protocol_version;
 
-static int strcat_simple_header(char **_string, size_t *malloc_size, char **_message, void *ptr_header, char *header_name, size_t size_of_header, int (*xxx_to_str)(void *, char **), char **next);
-static int strcat_headers_one_per_line(char **_string, size_t *malloc_size, char **_message, osip_list_t *headers, char *header, size_t size_of_header, int (*xxx_to_str)(void *, char **), char **next);
+/* known headers, in the order of osip_message_to_str */
+static const struct {
+  char header_name[30];
+  int header_length;
+  size_t offset; /* of the header (or of the list of headers) in osip_message_t */
+  int list;
+  int (*write)(const void *, __osip_writer_t *);
+  int (*to_str)(void *, char **); /* for headers without a write method */
+  int (*setheader)(osip_message_t *, const char *);
+} known_headers[] = {{"Via: ", 5, offsetof(osip_message_t, vias), 1, (int (*)(const void *, __osip_writer_t *)) & __osip_via_write, NULL, &osip_message_set_via},
+                     {"Record-Route: ", 14, offsetof(osip_message_t, record_routes), 1, (int (*)(const void *, __osip_writer_t *)) & __osip_from_write, NULL, &osip_message_set_record_route},
+                     {"Route: ", 7, offsetof(osip_message_t, routes), 1, (int (*)(const void *, __osip_writer_t *)) & __osip_from_write, NULL, &osip_message_set_route},
+                     {"From: ", 6, offsetof(osip_message_t, from), 0, (int (*)(const void *, __osip_writer_t *)) & __osip_from_write, NULL, &osip_message_set_from},
+                     {"To: ", 4, offsetof(osip_message_t, to), 0, (int (*)(const void *, __osip_writer_t *)) & __osip_from_write, NULL, &osip_message_set_to},
+                     {"Call-ID: ", 9, offsetof(osip_message_t, call_id), 0, (int (*)(const void *, __osip_writer_t *)) & __osip_call_id_write, NULL, &osip_message_set_call_id},
+                     {"CSeq: ", 6, offsetof(osip_message_t, cseq), 0, (int (*)(const void *, __osip_writer_t *)) & __osip_cseq_write, NULL, &osip_message_set_cseq},
+                     {"Contact: ", 9, offsetof(osip_message_t, contacts), 1, (int (*)(const void *, __osip_writer_t *)) & __osip_contact_write, NULL, &osip_message_set_contact},
+                     {"Authorization: ", 15, offsetof(osip_message_t, authorizations), 1, NULL, (int (*)(void *, char **)) & osip_authorization_to_str, &osip_message_set_authorization},
+                     {"WWW-Authenticate: ", 18, offsetof(osip_message_t, www_authenticates), 1, NULL, (int (*)(void *, char **)) & osip_www_authenticate_to_str, &osip_message_set_www_authenticate},
+                     {"Proxy-Authenticate: ", 20, offsetof(osip_message_t, proxy_authenticates), 1, NULL, (int (*)(void *, char **)) & osip_www_authenticate_to_str, &osip_message_set_proxy_authenticate},
+                     {"Proxy-Authorization: ", 21, offsetof(osip_message_t, proxy_authorizations), 1, NULL, (int (*)(void *, char **)) & osip_authorization_to_str, &osip_message_set_proxy_authorization},
+                     {"Call-Info: ", 11, offsetof(osip_message_t, call_infos), 1, (int (*)(const void *, __osip_writer_t *)) & __osip_call_info_write, NULL, &osip_message_set_call_info},
+                     {"Content-Type: ", 14, offsetof(osip_message_t, content_type), 0, (int (*)(const void *, __osip_writer_t *)) & __osip_content_type_write, NULL, &osip_message_set_content_type},
+                     {"Mime-Version: ", 14, offsetof(osip_message_t, mime_version), 0, (int (*)(const void *, __osip_writer_t *)) & __osip_content_length_write, NULL, &osip_message_set_mime_version},
+#ifndef MINISIZE
+                     {"Allow: ", 7, offsetof(osip_message_t, allows), 1, (int (*)(const void *, __osip_writer_t *)) & __osip_content_length_write, NULL, &osip_message_set_allow},
+                     {"Content-Encoding: ", 18, offsetof(osip_message_t, content_encodings), 1, (int (*)(const void *, __osip_writer_t *)) & __osip_content_length_write, NULL, &osip_message_set_content_encoding},
+                     {"Alert-Info: ", 12, offsetof(osip_message_t, alert_infos), 1, (int (*)(const void *, __osip_writer_t *)) & __osip_call_info_write, NULL, &osip_message_set_alert_info},
+                     {"Error-Info: ", 12, offsetof(osip_message_t, error_infos), 1, (int (*)(const void *, __osip_writer_t *)) & __osip_call_info_write, NULL, &osip_message_set_error_info},
+                     {"Accept: ", 8, offsetof(osip_message_t, accepts), 1, (int (*)(const void *, __osip_writer_t *)) & __osip_accept_write, NULL, &osip_message_set_accept},
+                     {"Accept-Encoding: ", 17, offsetof(osip_message_t, accept_encodings), 1, (int (*)(const void *, __osip_writer_t *)) & __osip_accept_encoding_write, NULL, &osip_message_set_accept_encoding},
+                     {"Accept-Language: ", 17, offsetof(osip_message_t, accept_languages), 1, (int (*)(const void *, __osip_writer_t *)) & __osip_accept_encoding_write, NULL, &osip_message_set_accept_language},
+                     {"Authentication-Info: ", 21, offsetof(osip_message_t, authentication_infos), 1, NULL, (int (*)(void *, char **)) & osip_authentication_info_to_str, &osip_message_set_authentication_info},
+                     {"Proxy-Authentication-Info: ", 27, offsetof(osip_message_t, proxy_authentication_infos), 1, NULL, (int (*)(void *, char **)) & osip_authentication_info_to_str, &osip_message_set_proxy_authentication_info},
+#endif
+                     {{'\0'}, 0, 0, 0, NULL, NULL, NULL}};
 
-static int __osip_message_startline_to_strreq(osip_message_t *sip, char **dest) {
-  const char *sip_version;
-  char *tmp;
-  char *rquri;
-  int i;
+/* index of the header stored by setheader in known_headers or -1 */
+int __osip_message_find_known_header(int (*setheader)(osip_message_t *, const char *)) {
+  int pos;
 
-  *dest = NULL;
+  for (pos = 0; known_headers[pos].header_name[0] != '\0'; pos++) {
+    if (known_headers[pos].setheader == setheader)
+      return pos;
+  }
 
-  if ((sip == NULL) || (sip->req_uri == NULL) || (sip->sip_method == NULL))
-    return OSIP_BADPARAMETER;
+  return -1;
+}
 
-  i = osip_uri_to_str(sip->req_uri, &rquri);
+void __osip_writer_init(__osip_writer_t *w, char *buf, size_t cap) {
+  w->buf = buf;
+  w->cap = (buf != NULL) ? cap : 0;
+  w->len = 0;
+}
 
-  if (i != 0)
-    return i;
+void __osip_writer_append(__osip_writer_t *w, const char *str, size_t len) {
+  if (w->len < w->cap)
+    memcpy(w->buf + w->len, str, (len < w->cap - w->len) ? len : w->cap - w->len);
 
-  if (sip->sip_version == NULL)
-    sip_version = osip_protocol_version;
+  w->len += len;
+}
 
-  else
-    sip_version = sip->sip_version;
+void __osip_writer_puts(__osip_writer_t *w, const char *str) {
+  __osip_writer_append(w, str, strlen(str));
+}
 
-  *dest = (char *) osip_malloc(strlen(sip->sip_method) + strlen(rquri) + strlen(sip_version) + 3);
+void __osip_writer_putc(__osip_writer_t *w, char c) {
+  if (w->len < w->cap)
+    w->buf[w->len] = c;
 
-  if (*dest == NULL) {
-    osip_free(rquri);
-    return OSIP_NOMEM;
+  w->len++;
+}
+
+/* ";name" or ";name=value" for each parameter */
+void __osip_writer_gen_params(__osip_writer_t *w, const osip_list_t *gen_params) {
+  osip_list_iterator_t it;
+  osip_generic_param_t *u_param = (osip_generic_param_t *) osip_list_get_first(gen_params, &it);
+
+  while (u_param != OSIP_SUCCESS) {
+    __osip_writer_putc(w, ';');
+    __osip_writer_puts(w, u_param->gname);
+
+    if (u_param->gvalue != NULL) {
+      __osip_writer_putc(w, '=');
+      __osip_writer_puts(w, u_param->gvalue);
+    }
+
+    u_param = (osip_generic_param_t *) osip_list_get_next(&it);
   }
+}
+
+/* i is the result of the write methods: the string is terminated
+   when there is room left and OSIP_NOMEM is returned when buf is too small */
+int __osip_writer_end(__osip_writer_t *w, int i, size_t *len) {
+  if (len != NULL)
+    *len = w->len;
+
+  if (i != OSIP_SUCCESS)
+    return i;
 
-  tmp = *dest;
+  if (w->len < w->cap)
+    w->buf[w->len] = '\0';
 
-  tmp = osip_str_append(tmp, sip->sip_method);
-  *tmp = ' ';
-  tmp++;
-  tmp = osip_str_append(tmp, rquri);
-  *tmp = ' ';
-  tmp++;
-  strcpy(tmp, sip_version);
+  else if (w->buf != NULL && w->len > w->cap)
+    return OSIP_NOMEM;
 
-  osip_free(rquri);
   return OSIP_SUCCESS;
 }
 
-static int __osip_message_startline_to_strresp(osip_message_t *sip, char **dest) {
-  char *tmp;
-  const char *sip_version;
-  char status_code[5];
-
-  *dest = NULL;
+int __osip_writer_to_buf(const void *element, int (*write)(const void *, __osip_writer_t *), char *buf, size_t cap, size_t *len) {
+  __osip_writer_t w;
 
-  if ((sip == NULL) || (sip->reason_phrase == NULL) || (sip->status_code < 100) || (sip->status_code > 699))
-    return OSIP_BADPARAMETER;
+  __osip_writer_init(&w, buf, cap);
+  return __osip_writer_end(&w, write(element, &w), len);
+}
 
-  if (sip->sip_version == NULL)
-    sip_version = osip_protocol_version;
+/* the length is computed first: the string is allocated once */
+int __osip_writer_to_str(const void *element, int (*write)(const void *, __osip_writer_t *), char **dest, size_t *len) {
+  __osip_writer_t w;
+  size_t size;
+  int i;
 
-  else
-    sip_version = sip->sip_version;
+  *dest = NULL;
+  __osip_writer_init(&w, NULL, 0);
+  i = write(element, &w);
 
-  sprintf(status_code, "%u", sip->status_code);
+  if (i != 0)
+    return i;
 
-  *dest = (char *) osip_malloc(strlen(sip_version) + 3 + strlen(sip->reason_phrase) + 4);
+  size = w.len + 1;
+  *dest = (char *) osip_malloc(size);
 
   if (*dest == NULL)
     return OSIP_NOMEM;
 
-  tmp = *dest;
-
-  tmp = osip_str_append(tmp, sip_version);
-  *tmp = ' ';
-  tmp++;
+  __osip_writer_init(&w, *dest, size);
+  write(element, &w);
+  (*dest)[w.len] = '\0';
 
-  tmp = osip_strn_append(tmp, status_code, 3);
-  *tmp = ' ';
-  tmp++;
-  strcpy(tmp, sip->reason_phrase);
+  if (len != NULL)
+    *len = w.len;
 
   return OSIP_SUCCESS;
 }
 
-static int __osip_message_startline_to_str(osip_message_t *sip, char **dest) {
-  if (sip->sip_method != NULL)
-    return __osip_message_startline_to_strreq(sip, dest);
+static int __osip_message_startline_write(osip_message_t *sip, __osip_writer_t *w) {
+  const char *sip_version;
+  char status_code[5];
 
-  if (sip->status_code != 0)
-    return __osip_message_startline_to_strresp(sip, dest);
+  if (sip->sip_version == NULL)
+    sip_version = osip_protocol_version;
+
+  else
+    sip_version = sip->sip_version;
+
+  if (sip->sip_method != NULL) {
+    if (sip->req_uri == NULL)
+      return OSIP_BADPARAMETER;
+
+    __osip_writer_puts(w, sip->sip_method);
+    __osip_writer_putc(w, ' ');
+
+    if (__osip_uri_write(sip->req_uri, w) != 0)
+      return OSIP_BADPARAMETER;
+
+    __osip_writer_putc(w, ' ');
+    __osip_writer_puts(w, sip_version);
+    return OSIP_SUCCESS;
+  }
+
+  if (sip->status_code != 0) {
+    if ((sip->reason_phrase == NULL) || (sip->status_code < 100) || (sip->status_code > 699))
+      return OSIP_BADPARAMETER;
+
+    sprintf(status_code, "%u", sip->status_code);
+    __osip_writer_puts(w, sip_version);
+    __osip_writer_putc(w, ' ');
+    __osip_writer_append(w, status_code, 3);
+    __osip_writer_putc(w, ' ');
+    __osip_writer_puts(w, sip->reason_phrase);
+    return OSIP_SUCCESS;
+  }
 
   OSIP_TRACE(osip_trace(__FILE__, __LINE__, TRACE_LEVEL1, NULL, "ERROR method has no value or status code is 0!\n"));
   return OSIP_BADPARAMETER; /* should never come here */
@@ -140,196 +240,248 @@ osip_uri_t *osip_message_get_uri(const osip_message_t *sip) {
   return sip->req_uri;
 }
 
-static int strcat_simple_header(char **_string, size_t *malloc_size, char **_message, void *ptr_header, char *header_name, size_t size_of_header, int (*xxx_to_str)(void *, char **), char **next) {
-  char *string;
-  char *message;
-  char *tmp;
+/* return values:
+   1: structure and buffer "message" are identical.
+   2: buffer "message" is not up to date with the structure info (call osip_message_to_str to update it).
+   -1 on error.
+ */
+int osip_message_get__property(const osip_message_t *sip) {
+  if (sip == NULL)
+    return OSIP_BADPARAMETER;
+
+  return sip->message_property;
+}
+
+int osip_message_force_update(osip_message_t *sip) {
+  if (sip == NULL)
+    return OSIP_BADPARAMETER;
+
+  sip->message_property = 2;
+  __osip_wire_free(sip); /* headers may have been modified in place */
+  return OSIP_SUCCESS;
+}
+
+int osip_message_force_update_header(osip_message_t *sip, const void *header) {
+  if (sip == NULL || header == NULL)
+    return OSIP_BADPARAMETER;
+
+  sip->message_property = 2;
+  __osip_wire_forget(sip, header); /* other headers keep their received line */
+  return OSIP_SUCCESS;
+}
+
+/* write "\r\n--boundary" of a multipart body in dest (MIME_MAX_BOUNDARY_LEN + 5 bytes)
+   or an empty string for other bodies */
+static int __osip_message_get_boundary(const osip_message_t *sip, char *dest) {
+  osip_generic_param_t *ct_param = NULL;
+  size_t len;
   int i;
 
-  string = *_string;
-  message = *_message;
+  dest[0] = '\0';
 
-  if (ptr_header != NULL) {
-    if (*malloc_size < message - string + 100 + size_of_header) {
-      /* take some memory in order to avoid using osip_realloc too often */
-      size_t size = message - string;
+  if (sip->content_type == NULL || sip->content_type->type == NULL || osip_strcasecmp(sip->content_type->type, "multipart"))
+    return OSIP_SUCCESS;
 
-      *malloc_size = message - string + size_of_header + 100;
-      string = osip_realloc(string, *malloc_size);
+  /* find the boundary */
+  i = osip_generic_param_get_byname((osip_list_t *) &sip->content_type->gen_params, "boundary", &ct_param);
 
-      if (string == NULL) {
-        osip_free(*_string); /* pointer for string */
-        *_string = NULL;
-        *_message = NULL;
-        return OSIP_NOMEM;
-      }
+  if (i < 0 || ct_param == NULL || ct_param->gvalue == NULL)
+    return OSIP_SUCCESS;
 
-      *_string = string;
-      message = string + size;
-    }
+  len = strlen(ct_param->gvalue);
 
-    message = osip_strn_append(message, header_name, size_of_header);
+  if (len > MIME_MAX_BOUNDARY_LEN)
+    return OSIP_SYNTAXERROR;
 
-    i = xxx_to_str(ptr_header, &tmp);
+  if (len == 1 && ct_param->gvalue[0] == '"') /* fixed Jan 10,2020: avoid a negative length copy if boundary contains only one quote */
+    return OSIP_SYNTAXERROR;
 
-    if (i != 0) {
-      *_string = string;
-      *_message = message;
-      *next = NULL;
-      return i;
-    }
+  if (len == 2 && ct_param->gvalue[0] == '"' && ct_param->gvalue[1] == '"') /* do not accept empty boundary */
+    return OSIP_SYNTAXERROR;
 
-    if (*malloc_size < message - string + strlen(tmp) + 100) {
-      size_t size = message - string;
+  osip_strncpy(dest, OSIP_CRLF, 2);
+  osip_strncpy(dest + 2, "--", 2);
 
-      *malloc_size = message - string + strlen(tmp) + 100;
-      string = osip_realloc(string, *malloc_size);
+  if (ct_param->gvalue[0] == '"' && ct_param->gvalue[len - 1] == '"')
+    osip_strncpy(dest + 4, ct_param->gvalue + 1, len - 2);
 
-      if (string == NULL) {
-        osip_free(*_string); /* pointer for string */
-        *_string = NULL;
-        *_message = NULL;
-        return OSIP_NOMEM;
-      }
+  else
+    osip_strncpy(dest + 4, ct_param->gvalue, len);
+
+  return OSIP_SUCCESS;
+}
 
-      *_string = string;
-      message = string + size;
+static int __osip_message_bodies_write(const osip_message_t *sip, __osip_writer_t *w, const char *boundary) {
+  osip_list_iterator_t it;
+  osip_body_t *body = (osip_body_t *) osip_list_get_first(&sip->bodies, &it);
+  int i;
+
+  while (body != OSIP_SUCCESS) {
+    if (boundary[0] != '\0') {
+      __osip_writer_puts(w, boundary);
+      __osip_writer_append(w, OSIP_CRLF, 2);
     }
 
-    message = osip_str_append(message, tmp);
-    osip_free(tmp);
-    message = osip_strn_append(message, OSIP_CRLF, 2);
+    i = __osip_body_write(body, w);
+
+    if (i != 0)
+      return i;
+
+    body = (osip_body_t *) osip_list_get_next(&it);
+  }
+
+  if (boundary[0] != '\0') {
+    __osip_writer_puts(w, boundary);
+    __osip_writer_append(w, "--", 2);
+    __osip_writer_append(w, OSIP_CRLF, 2);
   }
 
-  *_string = string;
-  *_message = message;
-  *next = message;
   return OSIP_SUCCESS;
 }
 
-static int strcat_headers_one_per_line(char **_string, size_t *malloc_size, char **_message, osip_list_t *headers, char *header, size_t size_of_header, int (*xxx_to_str)(void *, char **), char **next) {
-  char *string;
-  char *message;
+/* write one header line: headers without a write method are converted
+   with their to_str method */
+static int __osip_message_header_write(__osip_writer_t *w, const char *header_name, size_t header_length, void *header, int (*write)(const void *, __osip_writer_t *), int (*to_str)(void *, char **)) {
   char *tmp;
   int i;
-  osip_list_iterator_t it;
-  void *elt = osip_list_get_first(headers, &it);
-
-  string = *_string;
-  message = *_message;
 
-  while (elt != OSIP_SUCCESS) {
-    if (*malloc_size < message - string + 100 + size_of_header)
-    /* take some memory avoid to osip_realloc too much often */
-    {
-      /* should not happen often */
-      size_t size = message - string;
+  __osip_writer_append(w, header_name, header_length);
 
-      *malloc_size = message - string + size_of_header + 100;
-      string = osip_realloc(string, *malloc_size);
+  if (write != NULL)
+    i = write(header, w);
 
-      if (string == NULL) {
-        osip_free(*_string); /* pointer for string */
-        *_string = NULL;
-        *_message = NULL;
-        return OSIP_NOMEM;
-      }
+  else {
+    i = to_str(header, &tmp);
 
-      *_string = string;
-      message = string + size;
+    if (i == 0) {
+      __osip_writer_puts(w, tmp);
+      osip_free(tmp);
     }
+  }
 
-    osip_strncpy(message, header, size_of_header);
-    i = xxx_to_str(elt, &tmp);
+  if (i != 0)
+    return i;
 
-    if (i != 0) {
-      *_string = string;
-      *_message = message;
-      *next = NULL;
+  __osip_writer_append(w, OSIP_CRLF, 2);
+  return OSIP_SUCCESS;
+}
+
+static int _osip_message_write(osip_message_t *sip, __osip_writer_t *w, int sipfrag) {
+  char boundary[MIME_MAX_BOUNDARY_LEN + 5];
+  size_t start = w->len;
+  int pos;
+  int i;
+
+  /* add the first line of message */
+  i = __osip_message_startline_write(sip, w);
+
+  if (i != 0) {
+    if (!sipfrag)
       return i;
-    }
 
-    message = message + strlen(message);
+    /* A start-line isn't required for message/sipfrag parts. */
+    w->len = start;
 
-    if (*malloc_size < message - string + strlen(tmp) + 100) {
-      size_t size = message - string;
+  } else
+    __osip_writer_append(w, OSIP_CRLF, 2);
 
-      *malloc_size = message - string + strlen(tmp) + 100;
-      string = osip_realloc(string, *malloc_size);
+  for (pos = 0; known_headers[pos].header_name[0] != '\0'; pos++) {
+    void *slot = (char *) sip + known_headers[pos].offset;
 
-      if (string == NULL) {
-        osip_free(*_string); /* pointer for string */
-        *_string = NULL;
-        *_message = NULL;
-        return OSIP_NOMEM;
+    if (!known_headers[pos].list) {
+      if (*(void **) slot != NULL) {
+        i = __osip_message_header_write(w, known_headers[pos].header_name, known_headers[pos].header_length, *(void **) slot, known_headers[pos].write, known_headers[pos].to_str);
+
+        if (i != 0)
+          return i;
       }
 
-      *_string = string;
-      message = string + size;
+    } else {
+      osip_list_iterator_t it;
+      void *elt = osip_list_get_first((osip_list_t *) slot, &it);
+
+      while (elt != OSIP_SUCCESS) {
+        i = __osip_message_header_write(w, known_headers[pos].header_name, known_headers[pos].header_length, elt, known_headers[pos].write, known_headers[pos].to_str);
+
+        if (i != 0)
+          return i;
+
+        elt = osip_list_get_next(&it);
+      }
     }
+  }
+
+  {
+    osip_list_iterator_t it;
+    osip_header_t *header = (osip_header_t *) osip_list_get_first(&sip->headers, &it);
+
+    while (header != OSIP_SUCCESS) {
+      i = __osip_header_write(header, w);
 
-    message = osip_str_append(message, tmp);
-    osip_free(tmp);
-    message = osip_strn_append(message, OSIP_CRLF, 2);
-    elt = osip_list_get_next(&it);
+      if (i != 0)
+        return i;
+
+      __osip_writer_append(w, OSIP_CRLF, 2);
+      header = (osip_header_t *) osip_list_get_next(&it);
+    }
   }
 
-  *_string = string;
-  *_message = message;
-  *next = message;
-  return OSIP_SUCCESS;
-}
+  if (sipfrag && osip_list_eol(&sip->bodies, 0)) {
+    /* end of headers */
+    __osip_writer_append(w, OSIP_CRLF, 2);
+    return OSIP_SUCCESS; /* it's all done */
+  }
 
-/* return values:
-   1: structure and buffer "message" are identical.
-   2: buffer "message" is not up to date with the structure info (call osip_message_to_str to update it).
-   -1 on error.
- */
-int osip_message_get__property(const osip_message_t *sip) {
-  if (sip == NULL)
-    return OSIP_BADPARAMETER;
+  /* The Content-Length is always recalculated */
+  __osip_writer_append(w, "Content-Length: ", 16);
 
-  return sip->message_property;
-}
+  if (osip_list_eol(&sip->bodies, 0)) { /* no body */
+    __osip_writer_append(w, "0", 1);
+    __osip_writer_append(w, OSIP_CRLF, 2);
+    __osip_writer_append(w, OSIP_CRLF, 2);
+    return OSIP_SUCCESS; /* it's all done */
+  }
 
-int osip_message_force_update(osip_message_t *sip) {
-  if (sip == NULL)
-    return OSIP_BADPARAMETER;
+  i = __osip_message_get_boundary(sip, boundary);
 
-  sip->message_property = 2;
-  return OSIP_SUCCESS;
-}
+  if (i != 0)
+    return i;
 
-static int _osip_message_realloc(char **message, char **dest, size_t needed, size_t *malloc_size) {
-  size_t size = *message - *dest;
+  {
+    /* the bodies are measured before being written after the headers */
+    __osip_writer_t size;
+    char tmp[22];
 
-  if (*malloc_size < (size_t)(size + needed + 100)) {
-    *malloc_size = size + needed + 100;
-    *dest = osip_realloc(*dest, *malloc_size);
+    __osip_writer_init(&size, NULL, 0);
+    i = __osip_message_bodies_write(sip, &size, boundary);
 
-    if (*dest == NULL)
-      return OSIP_NOMEM;
+    if (i != 0)
+      return i;
+
+    /* BUG: p130 (rfc2543bis-04)
+       "No SP after last token or quoted string"
 
-    *message = *dest + size;
+       In fact, if extra spaces exist: the stack can't be used
+       to make user-agent that wants to make authentication...
+       This should be changed...
+     */
+    snprintf(tmp, sizeof(tmp), "%5u", (unsigned int) size.len);
+    __osip_writer_puts(w, tmp);
   }
 
-  return OSIP_SUCCESS;
+  __osip_writer_append(w, OSIP_CRLF, 2);
+
+  /* end of headers */
+  __osip_writer_append(w, OSIP_CRLF, 2);
+
+  return __osip_message_bodies_write(sip, w, boundary);
 }
 
 static int _osip_message_to_str(osip_message_t *sip, char **dest, size_t *message_length, int sipfrag) {
+  __osip_writer_t w;
   size_t malloc_size;
-  size_t total_length = 0;
-
-  /* Added at SIPit day1 */
-  char *start_of_bodies;
-  char *content_length_to_modify = NULL;
-
   char *message;
-  char *next;
-  char *tmp;
-  int pos;
   int i;
-  char *boundary = NULL;
 
   malloc_size = SIP_MESSAGE_MAX_LENGTH;
 
@@ -338,6 +490,9 @@ static int _osip_message_to_str(osip_message_t *sip, char **dest, size_t *messag
   if (sip == NULL)
     return OSIP_BADPARAMETER;
 
+  if (!osip_list_eol(&sip->lazy_headers, 0))
+    __osip_message_parse_lazy_headers(sip, NULL);
+
   {
     if (1 == osip_message_get__property(sip)) { /* message is already available in "message" */
 
@@ -358,397 +513,683 @@ static int _osip_message_to_str(osip_message_t *sip, char **dest, size_t *messag
       /* message should be rebuilt: delete the old one if exists. */
       osip_free(sip->message);
       sip->message = NULL;
+      __osip_message_cache_unref(sip->message_cache);
+      sip->message_cache = NULL;
     }
   }
 
-  message = (char *) osip_malloc(SIP_MESSAGE_MAX_LENGTH); /* ???? message could be > 4000  */
+  for (;;) {
+    message = (char *) osip_malloc(malloc_size);
 
-  if (message == NULL)
-    return OSIP_NOMEM;
+    if (message == NULL)
+      return OSIP_NOMEM;
 
-  *dest = message;
+    __osip_writer_init(&w, message, malloc_size);
+    i = _osip_message_write(sip, &w, sipfrag);
 
-  /* add the first line of message */
-  i = __osip_message_startline_to_str(sip, &tmp);
-
-  if (i != 0) {
-    if (!sipfrag) {
-      osip_free(*dest);
-      *dest = NULL;
+    if (i != 0) {
+      osip_free(message);
       return i;
     }
 
-    /* A start-line isn't required for message/sipfrag parts. */
+    if (w.len < malloc_size)
+      break;
 
-  } else {
-    size_t message_len = strlen(tmp);
+    /* the message is larger than expected: its exact length is known now */
+    osip_free(message);
+    malloc_size = w.len + 1;
+  }
 
-    if (_osip_message_realloc(&message, dest, message_len + 3, &malloc_size) < 0) {
-      osip_free(tmp);
-      *dest = NULL;
-      return OSIP_NOMEM;
-    }
+  message[w.len] = '\0';
+  *dest = message;
 
-    message = osip_str_append(message, tmp);
-    osip_free(tmp);
-    message = osip_strn_append(message, OSIP_CRLF, 2);
+  /* same remark as at the beginning of the method */
+  sip->message_property = 1;
+  sip->message = osip_malloc(w.len + 1);
+
+  if (sip->message != NULL) {
+    memcpy(sip->message, message, w.len + 1);
+    sip->message_length = w.len;
   }
 
-  {
-    struct to_str_table {
-      char header_name[30];
-      int header_length;
-      osip_list_t *header_list;
-      void *header_data;
-      int (*to_str)(void *, char **);
-    }
-#ifndef MINISIZE
-    table[25] =
+  if (message_length != NULL)
+    *message_length = w.len;
+
+  return OSIP_SUCCESS;
+}
+
+int osip_message_to_buf(osip_message_t *sip, char *buf, size_t cap, size_t *len) {
+  __osip_writer_t w;
+  int i = OSIP_SUCCESS;
+
+  if (sip == NULL)
+    return OSIP_BADPARAMETER;
+
+  if (!osip_list_eol(&sip->lazy_headers, 0))
+    __osip_message_parse_lazy_headers(sip, NULL);
+
+  __osip_writer_init(&w, buf, cap);
+
+  /* the "message" buffer is used when up to date but never updated here */
+  if (1 == osip_message_get__property(sip) && sip->message != NULL)
+    __osip_writer_append(&w, sip->message, sip->message_length);
+
+  else
+    i = _osip_message_write(sip, &w, 0);
+
+  return __osip_writer_end(&w, i, len);
+}
+
+int osip_message_to_str(osip_message_t *sip, char **dest, size_t *message_length) {
+  return _osip_message_to_str(sip, dest, message_length, 0);
+}
+
+/* the copy of the "message" buffer shared by the callers of
+   osip_message_get_wire and the received message are released with
+   the last reference, with the arena they were allocated from */
+typedef struct {
+  int ref;
+  void *arena;
+} msg_cache_t;
+
+#define MSG_CACHE(message) ((msg_cache_t *) ((char *) (message) - sizeof(msg_cache_t)))
+
+#if defined(OSIP_MONOTHREAD)
+#define msg_cache_add(ptr, val) (*(ptr) += (val))
+#elif defined(__ATOMIC_ACQ_REL)
+#define msg_cache_add(ptr, val) __atomic_add_fetch((ptr), (val), __ATOMIC_ACQ_REL)
+#elif defined(_MSC_VER)
+#include <windows.h>
+#define msg_cache_add(ptr, val) (InterlockedExchangeAdd((LONG volatile *) (ptr), (val)) + (val))
 #else
-    table[16] =
-#endif
-        {{"Via: ", 5, NULL, NULL, (int (*)(void *, char **)) & osip_via_to_str},
-         {"Record-Route: ", 14, NULL, NULL, (int (*)(void *, char **)) & osip_record_route_to_str},
-         {"Route: ", 7, NULL, NULL, (int (*)(void *, char **)) & osip_route_to_str},
-         {"From: ", 6, NULL, NULL, (int (*)(void *, char **)) & osip_from_to_str},
-         {"To: ", 4, NULL, NULL, (int (*)(void *, char **)) & osip_to_to_str},
-         {"Call-ID: ", 9, NULL, NULL, (int (*)(void *, char **)) & osip_call_id_to_str},
-         {"CSeq: ", 6, NULL, NULL, (int (*)(void *, char **)) & osip_cseq_to_str},
-         {"Contact: ", 9, NULL, NULL, (int (*)(void *, char **)) & osip_contact_to_str},
-         {"Authorization: ", 15, NULL, NULL, (int (*)(void *, char **)) & osip_authorization_to_str},
-         {"WWW-Authenticate: ", 18, NULL, NULL, (int (*)(void *, char **)) & osip_www_authenticate_to_str},
-         {"Proxy-Authenticate: ", 20, NULL, NULL, (int (*)(void *, char **)) & osip_www_authenticate_to_str},
-         {"Proxy-Authorization: ", 21, NULL, NULL, (int (*)(void *, char **)) & osip_authorization_to_str},
-         {"Call-Info: ", 11, NULL, NULL, (int (*)(void *, char **)) & osip_call_info_to_str},
-         {"Content-Type: ", 14, NULL, NULL, (int (*)(void *, char **)) & osip_content_type_to_str},
-         {"Mime-Version: ", 14, NULL, NULL, (int (*)(void *, char **)) & osip_content_length_to_str},
-#ifndef MINISIZE
-         {"Allow: ", 7, NULL, NULL, (int (*)(void *, char **)) & osip_allow_to_str},
-         {"Content-Encoding: ", 18, NULL, NULL, (int (*)(void *, char **)) & osip_content_encoding_to_str},
-         {"Alert-Info: ", 12, NULL, NULL, (int (*)(void *, char **)) & osip_call_info_to_str},
-         {"Error-Info: ", 12, NULL, NULL, (int (*)(void *, char **)) & osip_call_info_to_str},
-         {"Accept: ", 8, NULL, NULL, (int (*)(void *, char **)) & osip_accept_to_str},
-         {"Accept-Encoding: ", 17, NULL, NULL, (int (*)(void *, char **)) & osip_accept_encoding_to_str},
-         {"Accept-Language: ", 17, NULL, NULL, (int (*)(void *, char **)) & osip_accept_language_to_str},
-         {"Authentication-Info: ", 21, NULL, NULL, (int (*)(void *, char **)) & osip_authentication_info_to_str},
-         {"Proxy-Authentication-Info: ", 27, NULL, NULL, (int (*)(void *, char **)) & osip_authentication_info_to_str},
-#endif
-         {{'\0'}, 0, NULL, NULL, NULL}};
-    table[0].header_list = &sip->vias;
-    table[1].header_list = &sip->record_routes;
-    table[2].header_list = &sip->routes;
-    table[3].header_data = sip->from;
-    table[4].header_data = sip->to;
-    table[5].header_data = sip->call_id;
-    table[6].header_data = sip->cseq;
-    table[7].header_list = &sip->contacts;
-    table[8].header_list = &sip->authorizations;
-    table[9].header_list = &sip->www_authenticates;
-    table[10].header_list = &sip->proxy_authenticates;
-    table[11].header_list = &sip->proxy_authorizations;
-    table[12].header_list = &sip->call_infos;
-    table[13].header_data = sip->content_type;
-    table[14].header_data = sip->mime_version;
-#ifndef MINISIZE
-    table[15].header_list = &sip->allows;
-    table[16].header_list = &sip->content_encodings;
-    table[17].header_list = &sip->alert_infos;
-    table[18].header_list = &sip->error_infos;
-    table[19].header_list = &sip->accepts;
-    table[20].header_list = &sip->accept_encodings;
-    table[21].header_list = &sip->accept_languages;
-    table[22].header_list = &sip->authentication_infos;
-    table[23].header_list = &sip->proxy_authentication_infos;
+#define msg_cache_add(ptr, val) (*(ptr) += (val))
 #endif
 
-    pos = 0;
+char *__osip_message_cache_new(size_t length) {
+  msg_cache_t *cache = (msg_cache_t *) osip_malloc(sizeof(msg_cache_t) + length + 1);
 
-    while (table[pos].header_name[0] != '\0') {
-      if (table[13].header_list == NULL)
-        i = strcat_simple_header(dest, &malloc_size, &message, table[pos].header_data, table[pos].header_name, table[pos].header_length, ((int (*)(void *, char **)) table[pos].to_str), &next);
+  if (cache == NULL)
+    return NULL;
 
-      i = strcat_headers_one_per_line(dest, &malloc_size, &message, table[pos].header_list, table[pos].header_name, table[pos].header_length, ((int (*)(void *, char **)) table[pos].to_str), &next);
+  cache->ref = 1;
+  cache->arena = __osip_arena_get(cache);
 
-      if (i != 0) {
-        osip_free(*dest);
-        *dest = NULL;
-        return i;
-      }
+  if (cache->arena != NULL)
+    __osip_arena_ref(cache->arena);
 
-      message = next;
+  return (char *) (cache + 1);
+}
 
-      pos++;
-    }
-  }
+void __osip_message_cache_ref(const char *message) {
+  msg_cache_add(&MSG_CACHE(message)->ref, 1);
+}
 
-  {
-    osip_list_iterator_t it;
-    osip_header_t *header = (osip_header_t *) osip_list_get_first(&sip->headers, &it);
+void __osip_message_cache_unref(const char *message) {
+  msg_cache_t *cache;
+  void *arena;
 
-    while (header != OSIP_SUCCESS) {
-      size_t header_len = 0;
+  if (message == NULL)
+    return;
 
-      i = osip_header_to_str(header, &tmp);
+  cache = MSG_CACHE(message);
 
-      if (i != 0) {
-        osip_free(*dest);
-        *dest = NULL;
-        return i;
-      }
+  if (msg_cache_add(&cache->ref, -1) > 0)
+    return;
 
-      header_len = strlen(tmp);
+  arena = cache->arena;
+  osip_free(cache);
 
-      if (_osip_message_realloc(&message, dest, header_len + 3, &malloc_size) < 0) {
-        osip_free(tmp);
-        *dest = NULL;
-        return OSIP_NOMEM;
-      }
+  if (arena != NULL)
+    __osip_arena_unref(arena);
+}
 
-      message = osip_str_append(message, tmp);
-      osip_free(tmp);
-      message = osip_strn_append(message, OSIP_CRLF, 2);
+int osip_message_get_wire(osip_message_t *sip, const char **wire, size_t *length) {
+  __osip_writer_t w;
+  char *cache;
+  char *message;
+  int i;
 
-      header = (osip_header_t *) osip_list_get_next(&it);
-    }
-  }
+  if (sip == NULL || wire == NULL)
+    return OSIP_BADPARAMETER;
 
-  /* we have to create the body before adding the contentlength */
-  /* add enough lenght for "Content-Length: " */
+  *wire = NULL;
 
-  if (_osip_message_realloc(&message, dest, 16, &malloc_size) < 0)
-    return OSIP_NOMEM;
+  if (!osip_list_eol(&sip->lazy_headers, 0))
+    __osip_message_parse_lazy_headers(sip, NULL);
 
-  if (sipfrag && osip_list_eol(&sip->bodies, 0)) {
-    /* end of headers */
-    osip_strncpy(message, OSIP_CRLF, 2);
-    message = message + 2;
+  if (1 != osip_message_get__property(sip) || sip->message == NULL) {
+    /* the message is measured first: the buffer is written once */
+    __osip_writer_init(&w, NULL, 0);
+    i = _osip_message_write(sip, &w, 0);
+
+    if (i != 0)
+      return i;
 
-    /* same remark as at the beginning of the method */
+    cache = __osip_message_cache_new(w.len);
+
+    if (cache == NULL)
+      return OSIP_NOMEM;
+
+    __osip_writer_init(&w, cache, w.len + 1);
+    i = _osip_message_write(sip, &w, 0);
+    i = __osip_writer_end(&w, i, NULL);
+    message = (i == 0) ? (char *) osip_malloc(w.len + 1) : NULL;
+
+    if (message == NULL) {
+      __osip_message_cache_unref(cache);
+      return (i != 0) ? i : OSIP_NOMEM;
+    }
+
+    memcpy(message, cache, w.len + 1);
+    osip_free(sip->message);
+    sip->message = message;
+    sip->message_length = w.len;
     sip->message_property = 1;
-    sip->message = osip_strdup(*dest);
-    sip->message_length = message - *dest;
+    __osip_message_cache_unref(sip->message_cache);
+    sip->message_cache = cache;
 
-    if (message_length != NULL)
-      *message_length = message - *dest;
+  } else if (sip->message_cache == NULL) {
+    /* the "message" buffer is up to date: it is copied once */
+    cache = __osip_message_cache_new(sip->message_length);
 
-    return OSIP_SUCCESS; /* it's all done */
+    if (cache == NULL)
+      return OSIP_NOMEM;
+
+    memcpy(cache, sip->message, sip->message_length);
+    cache[sip->message_length] = '\0';
+    sip->message_cache = cache;
   }
 
-  osip_strncpy(message, "Content-Length: ", 16);
-  message = message + 16;
-
-  /* SIPit Day1
-     ALWAYS RECALCULATE?
-     if (sip->contentlength!=NULL)
-     {
-     i = osip_content_length_to_str(sip->contentlength, &tmp);
-     if (i!=0) {
-     osip_free(*dest);
-     *dest = NULL;
-     return i;
-     }
-     osip_strncpy(message,tmp,strlen(tmp));
-     osip_free(tmp);
-     }
-     else
-     { */
-  if (osip_list_eol(&sip->bodies, 0)) /* no body */
-    message = osip_strn_append(message, "0", 1);
+  __osip_message_cache_ref(sip->message_cache);
+  *wire = (const char *) sip->message_cache;
 
-  else {
-    /* BUG: p130 (rfc2543bis-04)
-       "No SP after last token or quoted string"
+  if (length != NULL)
+    *length = sip->message_length;
 
-       In fact, if extra spaces exist: the stack can't be used
-       to make user-agent that wants to make authentication...
-       This should be changed...
-     */
+  return OSIP_SUCCESS;
+}
+
+void osip_message_release_wire(const char *wire) {
+  __osip_message_cache_unref(wire);
+}
+
+int osip_message_to_str_sipfrag(osip_message_t *sip, char **dest, size_t *message_length) {
+  return _osip_message_to_str(sip, dest, message_length, 1);
+}
+
+#define WIRE_SPANS 24 /* spans allocated with the structure */
+
+/* one block: the structure and the first spans */
+static __osip_wire_t *__osip_wire_new(const char *buf, size_t length) {
+  __osip_wire_t *wire = (__osip_wire_t *) osip_malloc(sizeof(__osip_wire_t) + WIRE_SPANS * sizeof(__osip_wire_span_t));
+
+  if (wire == NULL)
+    return NULL;
+
+  wire->spans = (__osip_wire_span_t *) (wire + 1);
+  wire->nb_spans = 0;
+  wire->max_spans = WIRE_SPANS;
+  wire->next = 0;
+  wire->buf = buf;
+  wire->length = length;
+  return wire;
+}
 
-    content_length_to_modify = message;
-    message = osip_str_append(message, "     ");
+int __osip_wire_init(osip_message_t *sip, const char *buf, size_t length) {
+  char *copy;
+
+  __osip_wire_free(sip);
+
+  /* the received message is shared with the clones */
+  copy = __osip_message_cache_new(length);
+
+  if (copy == NULL)
+    return OSIP_NOMEM;
+
+  memcpy(copy, buf, length);
+  sip->wire = __osip_wire_new(copy, length);
+
+  if (sip->wire == NULL) {
+    __osip_message_cache_unref(copy);
+    return OSIP_NOMEM;
   }
 
-  /*  } */
+  return OSIP_SUCCESS;
+}
 
-  message = osip_strn_append(message, OSIP_CRLF, 2);
+void __osip_wire_free(osip_message_t *sip) {
+  __osip_wire_t *wire = (__osip_wire_t *) sip->wire;
 
-  /* end of headers */
-  message = osip_strn_append(message, OSIP_CRLF, 2);
+  if (wire == NULL)
+    return;
 
-  start_of_bodies = message;
-  total_length = start_of_bodies - *dest;
+  if (wire->spans != (__osip_wire_span_t *) (wire + 1))
+    osip_free(wire->spans);
 
-  if (osip_list_eol(&sip->bodies, 0)) {
-    /* same remark as at the beginning of the method */
-    sip->message_property = 1;
-    sip->message = osip_strdup(*dest);
-    sip->message_length = total_length;
+  __osip_message_cache_unref(wire->buf);
+  osip_free(wire);
+  sip->wire = NULL;
+}
 
-    if (message_length != NULL)
-      *message_length = total_length;
+/* known is an index in known_headers, WIRE_UNKNOWN_HEADERS or WIRE_LAZY_HEADERS */
+int __osip_wire_mark(osip_message_t *sip, int known, __osip_wire_mark_t *mark) {
+  mark->known = known;
+  mark->list = NULL;
+  mark->data = NULL;
+  mark->nb = 0;
 
-    return OSIP_SUCCESS; /* it's all done */
+  if (sip->wire == NULL)
+    return OSIP_UNDEFINED_ERROR;
+
+  if (known == WIRE_UNKNOWN_HEADERS)
+    mark->list = &sip->headers;
+
+  else if (known == WIRE_LAZY_HEADERS)
+    mark->list = &sip->lazy_headers;
+
+  else if (known >= 0 && known_headers[known].list)
+    mark->list = (osip_list_t *) ((char *) sip + known_headers[known].offset);
+
+  else if (known >= 0)
+    mark->data = (void **) ((char *) sip + known_headers[known].offset);
+
+  else
+    return OSIP_UNDEFINED_ERROR;
+
+  if (mark->list != NULL)
+    mark->nb = osip_list_size(mark->list);
+
+  else
+    mark->nb = (*mark->data != NULL);
+
+  return OSIP_SUCCESS;
+}
+
+/* the header stored since __osip_wire_mark or NULL */
+static const void *__osip_wire_new_header(const __osip_wire_mark_t *mark) {
+  if (mark->list != NULL)
+    return (osip_list_size(mark->list) == mark->nb + 1) ? osip_list_get(mark->list, mark->nb) : NULL;
+
+  if (mark->data != NULL && mark->nb == 0)
+    return *mark->data;
+
+  return NULL;
+}
+
+static void __osip_wire_append(__osip_wire_t *wire, const void *header, int known, size_t start, size_t end) {
+  if (wire->nb_spans == wire->max_spans) {
+    __osip_wire_span_t *spans = (__osip_wire_span_t *) osip_malloc(2 * wire->max_spans * sizeof(__osip_wire_span_t));
+
+    if (spans == NULL)
+      return; /* the header will be written from the structure */
+
+    memcpy(spans, wire->spans, wire->nb_spans * sizeof(__osip_wire_span_t));
+
+    if (wire->spans != (__osip_wire_span_t *) (wire + 1))
+      osip_free(wire->spans);
+
+    wire->spans = spans;
+    wire->max_spans *= 2;
   }
 
-  if (sip->content_type && sip->content_type->type && !osip_strcasecmp(sip->content_type->type, "multipart")) {
-    osip_generic_param_t *ct_param = NULL;
+  wire->spans[wire->nb_spans].header = header;
+  wire->spans[wire->nb_spans].known = known;
+  wire->spans[wire->nb_spans].start = start;
+  wire->spans[wire->nb_spans].end = end;
+  wire->nb_spans++;
+}
 
-    /* find the boundary */
-    i = osip_generic_param_get_byname(&sip->content_type->gen_params, "boundary", &ct_param);
+void __osip_wire_add(osip_message_t *sip, const __osip_wire_mark_t *mark, size_t start, size_t end) {
+  const void *header = __osip_wire_new_header(mark);
 
-    if ((i >= 0) && ct_param && ct_param->gvalue) {
-      size_t len = strlen(ct_param->gvalue);
+  if (sip->wire != NULL && header != NULL)
+    __osip_wire_append((__osip_wire_t *) sip->wire, header, mark->known, start, end);
+}
 
-      if (len > MIME_MAX_BOUNDARY_LEN) {
-        osip_free(*dest);
-        *dest = NULL;
-        return OSIP_SYNTAXERROR;
-      }
+/* header was cloned in copy: the clone has the same received line */
+static void __osip_wire_clone_header(osip_message_t *sip, __osip_wire_t *wire, int known, const void *header, const void *clone) {
+  const __osip_wire_span_t *span = __osip_wire_find(sip, known, header);
 
-      if (len == 1 && ct_param->gvalue[0] == '"') { /* fixed Jan 10,2020: avoid a negative length copy if boundary contains only one quote */
-        osip_free(*dest);
-        *dest = NULL;
-        return OSIP_SYNTAXERROR;
-      }
+  if (span != NULL && clone != NULL)
+    __osip_wire_append(wire, clone, known, span->start, span->end);
+}
 
-      if (len == 2 && ct_param->gvalue[0] == '"' && ct_param->gvalue[1] == '"') { /* do not accept empty boundary */
-        osip_free(*dest);
-        *dest = NULL;
-        return OSIP_SYNTAXERROR;
-      }
+void __osip_wire_clone(osip_message_t *sip, osip_message_t *copy) {
+  __osip_wire_t *wire = (__osip_wire_t *) sip->wire;
+  osip_list_iterator_t it;
+  osip_list_iterator_t it2;
+  void *elt;
+  void *elt2;
+  int pos;
 
-      boundary = osip_malloc(len + 5);
+  if (wire == NULL || wire->nb_spans == 0)
+    return;
 
-      if (boundary == NULL) {
-        osip_free(*dest);
-        *dest = NULL;
-        return OSIP_NOMEM;
+  __osip_wire_free(copy);
+  copy->wire = __osip_wire_new(wire->buf, wire->length);
+
+  if (copy->wire == NULL)
+    return; /* all headers will be written from the structure */
+
+  __osip_message_cache_ref(wire->buf);
+
+  /* both messages have the same headers in the same order */
+  for (pos = 0; known_headers[pos].header_name[0] != '\0'; pos++) {
+    void *slot = (char *) sip + known_headers[pos].offset;
+    void *slot2 = (char *) copy + known_headers[pos].offset;
+
+    if (!known_headers[pos].list) {
+      if (*(void **) slot != NULL)
+        __osip_wire_clone_header(sip, copy->wire, pos, *(void **) slot, *(void **) slot2);
+
+    } else {
+      elt2 = osip_list_get_first((osip_list_t *) slot2, &it2);
+
+      for (elt = osip_list_get_first((osip_list_t *) slot, &it); elt != OSIP_SUCCESS; elt = osip_list_get_next(&it)) {
+        __osip_wire_clone_header(sip, copy->wire, pos, elt, elt2);
+        elt2 = osip_list_get_next(&it2);
       }
+    }
+  }
 
-      osip_strncpy(boundary, OSIP_CRLF, 2);
-      osip_strncpy(boundary + 2, "--", 2);
+  elt2 = osip_list_get_first(&copy->headers, &it2);
+
+  for (elt = osip_list_get_first(&sip->headers, &it); elt != OSIP_SUCCESS; elt = osip_list_get_next(&it)) {
+    __osip_wire_clone_header(sip, copy->wire, WIRE_UNKNOWN_HEADERS, elt, elt2);
+    elt2 = osip_list_get_next(&it2);
+  }
+}
+
+static void __osip_wire_remove(__osip_wire_t *wire, __osip_wire_span_t *span) {
+  memmove(span, span + 1, (wire->spans + wire->nb_spans - span - 1) * sizeof(__osip_wire_span_t));
+  wire->nb_spans--;
+  wire->next = 0;
+}
 
-      if (ct_param->gvalue[0] == '"' && ct_param->gvalue[len - 1] == '"')
-        osip_strncpy(boundary + 4, ct_param->gvalue + 1, len - 2);
+/* header was parsed again (see osip_message_parse_lazy_headers) and is about to be released */
+void __osip_wire_move(osip_message_t *sip, const void *header, const __osip_wire_mark_t *mark) {
+  __osip_wire_span_t *span = (__osip_wire_span_t *) __osip_wire_find(sip, WIRE_LAZY_HEADERS, header);
 
-      else
-        osip_strncpy(boundary + 4, ct_param->gvalue, len);
+  if (span == NULL)
+    return;
+
+  span->header = __osip_wire_new_header(mark);
+  span->known = mark->known;
+
+  if (span->header == NULL)
+    __osip_wire_remove((__osip_wire_t *) sip->wire, span);
+}
+
+/* known must match too: a released header may have the address of
+   a header of another type */
+const __osip_wire_span_t *__osip_wire_find(osip_message_t *sip, int known, const void *header) {
+  __osip_wire_t *wire = (__osip_wire_t *) sip->wire;
+  int pos;
+  int i;
+
+  if (wire == NULL)
+    return NULL;
+
+  /* headers are mostly looked up in the order of the message */
+  for (i = 0, pos = wire->next; i < wire->nb_spans; i++, pos++) {
+    if (pos == wire->nb_spans)
+      pos = 0;
+
+    if (wire->spans[pos].header == header && wire->spans[pos].known == known) {
+      wire->next = pos + 1;
+      return &wire->spans[pos];
     }
   }
 
-  {
-    osip_list_iterator_t it;
-    osip_body_t *body = (osip_body_t *) osip_list_get_first(&sip->bodies, &it);
+  return NULL;
+}
 
-    while (body != OSIP_SUCCESS) {
-      size_t body_length;
+void __osip_wire_forget(osip_message_t *sip, const void *header) {
+  __osip_wire_t *wire = (__osip_wire_t *) sip->wire;
+  int pos;
 
-      if (boundary) {
-        /* Needs at most 77 bytes,
-           last realloc allocate at least 100 bytes extra */
-        message = osip_str_append(message, boundary);
-        message = osip_strn_append(message, OSIP_CRLF, 2);
-      }
+  if (wire == NULL)
+    return;
 
-      i = osip_body_to_str(body, &tmp, &body_length);
+  for (pos = wire->nb_spans - 1; pos >= 0; pos--) {
+    if (wire->spans[pos].header == header)
+      __osip_wire_remove(wire, &wire->spans[pos]);
+  }
+}
 
-      if (i != 0) {
-        osip_free(*dest);
-        *dest = NULL;
+#if !defined(WIN32) && !defined(_WIN32_WCE)
+
+/* entries of osip_message_to_iovec: parts of the received message
+   and parts written in the buffer of the caller */
+typedef struct {
+  struct iovec *iov;
+  int nb;
+  int max;
+  __osip_writer_t w;
+  size_t flushed; /* bytes of w already in iov */
+  int overflow;
+} msg_iovec_t;
+
+static void msg_iovec_push(msg_iovec_t *v, const char *base, size_t len) {
+  if (len == 0)
+    return;
+
+  if (v->nb > 0 && (const char *) v->iov[v->nb - 1].iov_base + v->iov[v->nb - 1].iov_len == base) {
+    v->iov[v->nb - 1].iov_len += len;
+    return;
+  }
 
-        if (boundary)
-          osip_free(boundary);
+  if (v->nb == v->max) {
+    v->overflow = 1;
+    return;
+  }
 
-        return i;
-      }
+  v->iov[v->nb].iov_base = (void *) base;
+  v->iov[v->nb].iov_len = len;
+  v->nb++;
+}
+
+/* add the bytes written in w since the last call */
+static void msg_iovec_flush(msg_iovec_t *v) {
+  if (v->w.len > v->w.cap) {
+    v->overflow = 1;
+    return;
+  }
+
+  msg_iovec_push(v, v->w.buf + v->flushed, v->w.len - v->flushed);
+  v->flushed = v->w.len;
+}
+
+/* the received line of a header not modified since parsing or NULL:
+   other headers (osip_header_t) are often modified in place, so their
+   name and value are compared with the line */
+static const char *__osip_wire_line(osip_message_t *sip, int known, const void *header, size_t *len) {
+  const __osip_wire_span_t *span = __osip_wire_find(sip, known, header);
+  const osip_header_t *h = (const osip_header_t *) header;
+  const char *line;
+  const char *end;
+  const char *p;
+  size_t n;
+
+  if (span == NULL)
+    return NULL;
+
+  line = ((__osip_wire_t *) sip->wire)->buf + span->start;
+  *len = span->end - span->start;
+
+  if (known != WIRE_UNKNOWN_HEADERS)
+    return line;
+
+  if (h->hname == NULL)
+    return NULL;
+
+  end = line + *len - 2; /* CRLF */
+  p = (const char *) memchr(line, ':', end - line);
+
+  if (p == NULL)
+    return NULL;
+
+  while (p > line && (p[-1] == ' ' || p[-1] == '\t'))
+    p--;
+
+  n = strlen(h->hname);
+
+  if ((size_t) (p - line) != n || osip_strncasecmp(line, h->hname, n) != 0)
+    return NULL;
+
+  p = (const char *) memchr(p, ':', end - p) + 1;
+
+  while (p < end && (*p == ' ' || *p == '\t'))
+    p++;
+
+  while (end > p && (end[-1] == ' ' || end[-1] == '\t'))
+    end--;
+
+  n = (h->hvalue != NULL) ? strlen(h->hvalue) : 0;
+
+  if ((size_t) (end - p) != n || (n > 0 && memcmp(p, h->hvalue, n) != 0))
+    return NULL;
+
+  return line;
+}
 
-      if (malloc_size < message - *dest + 100 + body_length) {
-        size_t size = message - *dest;
-        int offset_of_body;
-        int offset_content_length_to_modify = 0;
+static int msg_iovec_header(msg_iovec_t *v, osip_message_t *sip, int known, const char *header_name, size_t header_length, void *header, int (*write)(const void *, __osip_writer_t *), int (*to_str)(void *, char **)) {
+  size_t len;
+  const char *line = __osip_wire_line(sip, known, header, &len);
 
-        offset_of_body = (int) (start_of_bodies - *dest);
+  if (line == NULL)
+    return __osip_message_header_write(&v->w, header_name, header_length, header, write, to_str);
 
-        if (content_length_to_modify != NULL)
-          offset_content_length_to_modify = (int) (content_length_to_modify - *dest);
+  msg_iovec_flush(v);
+  msg_iovec_push(v, line, len);
+  return OSIP_SUCCESS;
+}
+
+int osip_message_to_iovec(osip_message_t *sip, struct iovec *iov, int *iovcnt, char *buf, size_t cap) {
+  char boundary[MIME_MAX_BOUNDARY_LEN + 5];
+  msg_iovec_t v;
+  int pos;
+  int i;
 
-        malloc_size = message - *dest + body_length + 100;
-        *dest = osip_realloc(*dest, malloc_size);
+  if (sip == NULL || iov == NULL || iovcnt == NULL)
+    return OSIP_BADPARAMETER;
 
-        if (*dest == NULL) {
-          osip_free(tmp); /* fixed 09/Jun/2005 */
+  if (!osip_list_eol(&sip->lazy_headers, 0))
+    __osip_message_parse_lazy_headers(sip, NULL);
 
-          if (boundary)
-            osip_free(boundary);
+  v.iov = iov;
+  v.nb = 0;
+  v.max = *iovcnt;
+  __osip_writer_init(&v.w, buf, cap);
+  v.flushed = 0;
+  v.overflow = 0;
 
-          return OSIP_NOMEM;
-        }
+  i = __osip_message_startline_write(sip, &v.w);
 
-        start_of_bodies = *dest + offset_of_body;
+  if (i != 0)
+    return i;
 
-        if (content_length_to_modify != NULL)
-          content_length_to_modify = *dest + offset_content_length_to_modify;
+  __osip_writer_append(&v.w, OSIP_CRLF, 2);
 
-        message = *dest + size;
+  for (pos = 0; known_headers[pos].header_name[0] != '\0'; pos++) {
+    void *slot = (char *) sip + known_headers[pos].offset;
+
+    if (!known_headers[pos].list) {
+      if (*(void **) slot != NULL) {
+        i = msg_iovec_header(&v, sip, pos, known_headers[pos].header_name, known_headers[pos].header_length, *(void **) slot, known_headers[pos].write, known_headers[pos].to_str);
+
+        if (i != 0)
+          return i;
       }
 
-      memcpy(message, tmp, body_length);
-      message[body_length] = '\0';
-      osip_free(tmp);
-      message = message + body_length;
+    } else {
+      osip_list_iterator_t it;
+      void *elt = osip_list_get_first((osip_list_t *) slot, &it);
 
-      body = (osip_body_t *) osip_list_get_next(&it);
+      while (elt != OSIP_SUCCESS) {
+        i = msg_iovec_header(&v, sip, pos, known_headers[pos].header_name, known_headers[pos].header_length, elt, known_headers[pos].write, known_headers[pos].to_str);
+
+        if (i != 0)
+          return i;
+
+        elt = osip_list_get_next(&it);
+      }
     }
   }
 
-  if (boundary) {
-    /* Needs at most 79 bytes,
-       last realloc allocate at least 100 bytes extra */
-    message = osip_str_append(message, boundary);
-    message = osip_strn_append(message, "--", 2);
-    message = osip_strn_append(message, OSIP_CRLF, 2);
+  {
+    osip_list_iterator_t it;
+    osip_header_t *header = (osip_header_t *) osip_list_get_first(&sip->headers, &it);
 
-    osip_free(boundary);
-    boundary = NULL;
-  }
+    while (header != OSIP_SUCCESS) {
+      i = msg_iovec_header(&v, sip, WIRE_UNKNOWN_HEADERS, "", 0, header, (int (*)(const void *, __osip_writer_t *)) & __osip_header_write, NULL);
 
-  if (content_length_to_modify == NULL) {
-    osip_free(*dest);
-    *dest = NULL;
-    return OSIP_SYNTAXERROR;
+      if (i != 0)
+        return i;
+
+      header = (osip_header_t *) osip_list_get_next(&it);
+    }
   }
 
-  /* we NOW have the length of bodies: */
-  {
-    size_t size = message - start_of_bodies;
-    char tmp2[15];
+  __osip_writer_append(&v.w, "Content-Length: ", 16);
 
-    total_length += size;
-    snprintf(tmp2, 15, "%i", (int) size);
-    /* do not use osip_strncpy here! */
-    memcpy(content_length_to_modify + 5 - strlen(tmp2), tmp2, strlen(tmp2));
-  }
+  if (osip_list_eol(&sip->bodies, 0)) { /* no body */
+    __osip_writer_append(&v.w, "0", 1);
+    __osip_writer_append(&v.w, OSIP_CRLF, 2);
+    __osip_writer_append(&v.w, OSIP_CRLF, 2);
 
-  /* same remark as at the beginning of the method */
-  sip->message_property = 1;
-  sip->message = osip_malloc(total_length + 1);
+  } else {
+    __osip_writer_t size;
+    osip_list_iterator_t it;
+    osip_body_t *body;
+    char tmp[22];
 
-  if (sip->message != NULL) {
-    memcpy(sip->message, *dest, total_length);
-    sip->message[total_length] = '\0';
-    sip->message_length = total_length;
+    i = __osip_message_get_boundary(sip, boundary);
+
+    if (i != 0)
+      return i;
+
+    __osip_writer_init(&size, NULL, 0);
+    i = __osip_message_bodies_write(sip, &size, boundary);
+
+    if (i != 0)
+      return i;
+
+    snprintf(tmp, sizeof(tmp), "%5u", (unsigned int) size.len);
+    __osip_writer_puts(&v.w, tmp);
+    __osip_writer_append(&v.w, OSIP_CRLF, 2);
+    __osip_writer_append(&v.w, OSIP_CRLF, 2);
+
+    /* the content of the bodies is never copied */
+    for (body = (osip_body_t *) osip_list_get_first(&sip->bodies, &it); body != OSIP_SUCCESS; body = (osip_body_t *) osip_list_get_next(&it)) {
+      if (boundary[0] != '\0') {
+        __osip_writer_puts(&v.w, boundary);
+        __osip_writer_append(&v.w, OSIP_CRLF, 2);
+      }
+
+      i = __osip_body_write_headers(body, &v.w);
+
+      if (i != 0)
+        return i;
 
-    if (message_length != NULL)
-      *message_length = total_length;
+      msg_iovec_flush(&v);
+      msg_iovec_push(&v, body->body, body->length);
+    }
+
+    if (boundary[0] != '\0') {
+      __osip_writer_puts(&v.w, boundary);
+      __osip_writer_append(&v.w, "--", 2);
+      __osip_writer_append(&v.w, OSIP_CRLF, 2);
+    }
   }
 
-  return OSIP_SUCCESS;
-}
+  msg_iovec_flush(&v);
 
-int osip_message_to_str(osip_message_t *sip, char **dest, size_t *message_length) {
-  return _osip_message_to_str(sip, dest, message_length, 0);
-}
+  if (v.overflow)
+    return OSIP_NOMEM;
 
-int osip_message_to_str_sipfrag(osip_message_t *sip, char **dest, size_t *message_length) {
-  return _osip_message_to_str(sip, dest, message_length, 1);
+  *iovcnt = v.nb;
+  return OSIP_SUCCESS;
 }
+
+#endif
@@ -26,22 +26,109 @@
 static __osip_message_config_t pconfig[NUMBER_OF_HEADERS];
 static __osip_message_config_commaseparated_t pconfig_commasep[NUMBER_OF_HEADERS_COMMASEPARATED];
 
-/* The size of the hash table seems large for a limited number of possible entries
- * The 'problem' is that the header name are too much alike for the osip_hash() function
- * which gives a poor deviation.
- * Anyway, this mechanism improves the search time (from binary seach (log(n)) to 1).
+/* Header names are resolved through one open addressing table holding both
+ * the known headers (pconfig) and the comma separated ones (pconfig_commasep).
+ * The hash folds the case of the name, so a raw, mixed-case, long or compact
+ * name is resolved to its index and comma flag without any copy. parser_init()
+ * picks the seed giving the fewest collisions: for the built-in names, this
+ * gives one probe per lookup.
  */
+#define HDR_LOOKUP_SIZE 1024 /* power of 2 */
+#define HDR_LOOKUP_SEEDS 1024
 
-#ifndef HASH_TABLE_SIZE
-#ifdef __amd64__
-#define HASH_TABLE_SIZE 150
-#else
-#define HASH_TABLE_SIZE                              \
-  150 /* set this to the hash table size, 150 is the \
-         first size where no conflicts occur */
-#endif
+typedef struct {
+  const char *hname;
+  short known; /* index in pconfig or -1 */
+  short comma; /* 1 if the header may hold comma separated values */
+} hdr_lookup_t;
+
+static hdr_lookup_t hdr_names[NUMBER_OF_HEADERS + NUMBER_OF_HEADERS_COMMASEPARATED];
+static int hdr_names_count;
+static short hdr_lookup_table[HDR_LOOKUP_SIZE]; /* indices to hdr_names, -1 -> no entry */
+static unsigned int hdr_lookup_seed;
+
+static unsigned int hdr_lookup_hash(const char *hname, unsigned int seed) {
+  unsigned int hash = 2166136261u ^ (seed * 2654435761u);
+  unsigned int c;
+
+  for (; *hname != '\0'; hname++) {
+    c = (unsigned char) *hname;
+
+    if (c >= 'A' && c <= 'Z')
+      c |= 0x20;
+
+    hash = (hash ^ c) * 16777619u;
+  }
+
+  return hash ^ (hash >> 15);
+}
+
+/* return the hdr_names index of hname or -1: *slot is the position where hname is or should be stored */
+static int hdr_lookup_find(const char *hname, unsigned int *slot) {
+  unsigned int pos = hdr_lookup_hash(hname, hdr_lookup_seed) & (HDR_LOOKUP_SIZE - 1);
+  int k;
+
+  for (;;) {
+    k = hdr_lookup_table[pos];
+
+    if (k < 0 || osip_strcasecmp(hdr_names[k].hname, hname) == 0) {
+      *slot = pos;
+      return k;
+    }
+
+    pos = (pos + 1) & (HDR_LOOKUP_SIZE - 1);
+  }
+}
+
+/* returns the number of names not stored at their home position */
+static int hdr_lookup_add(const char *hname, int known, int comma) {
+  unsigned int home = hdr_lookup_hash(hname, hdr_lookup_seed) & (HDR_LOOKUP_SIZE - 1);
+  unsigned int slot;
+  int k;
+
+  k = hdr_lookup_find(hname, &slot);
 
-static int hdr_ref_table[HASH_TABLE_SIZE]; /* the hashtable contains indices to the pconfig table    */
+  if (k >= 0) { /* long names may be listed twice (pconfig and pconfig_commasep) */
+    if (known >= 0)
+      hdr_names[k].known = known;
+
+    if (comma)
+      hdr_names[k].comma = 1;
+
+    return 0;
+  }
+
+  if (hdr_names_count >= (int) (sizeof(hdr_names) / sizeof(hdr_names[0])))
+    return -1;
+
+  k = hdr_names_count++;
+  hdr_names[k].hname = hname;
+  hdr_names[k].known = known;
+  hdr_names[k].comma = comma;
+  hdr_lookup_table[slot] = k;
+
+  return (slot == home) ? 0 : 1;
+}
+
+/* build the table with seed and return the number of collisions */
+static int hdr_lookup_build(unsigned int seed) {
+  int collisions = 0;
+  int i;
+
+  hdr_lookup_seed = seed;
+  hdr_names_count = 0;
+
+  for (i = 0; i < HDR_LOOKUP_SIZE; i++)
+    hdr_lookup_table[i] = -1; /* -1 -> no entry */
+
+  for (i = 0; i < NUMBER_OF_HEADERS; i++)
+    collisions += hdr_lookup_add(pconfig[i].hname, i, 0);
+
+  for (i = 0; i < NUMBER_OF_HEADERS_COMMASEPARATED && pconfig_commasep[i].hname[0] != '\0'; i++)
+    collisions += hdr_lookup_add(pconfig_commasep[i].hname, -1, 1);
+
+  return collisions;
+}
 
 /*
   list of compact header:
@@ -167,138 +254,203 @@ int parser_init(void) {
 #ifndef MINISIZE
   pconfig[i].hname = ACCEPT;
   pconfig[i].ignored_when_invalid = 1;
+  pconfig[i].lazy = 1;
+  pconfig[i].mask = OSIP_HEADER_MASK_ACCEPT;
   pconfig[i++].setheader = (&osip_message_set_accept);
   pconfig[i].hname = ACCEPT_ENCODING;
   pconfig[i].ignored_when_invalid = 1;
+  pconfig[i].lazy = 1;
+  pconfig[i].mask = OSIP_HEADER_MASK_ACCEPT_ENCODING;
   pconfig[i++].setheader = (&osip_message_set_accept_encoding);
   pconfig[i].hname = ACCEPT_LANGUAGE;
   pconfig[i].ignored_when_invalid = 1;
+  pconfig[i].lazy = 1;
+  pconfig[i].mask = OSIP_HEADER_MASK_ACCEPT_LANGUAGE;
   pconfig[i++].setheader = (&osip_message_set_accept_language);
   pconfig[i].hname = ALERT_INFO;
   pconfig[i].ignored_when_invalid = 1;
+  pconfig[i].lazy = 1;
+  pconfig[i].mask = OSIP_HEADER_MASK_ALERT_INFO;
   pconfig[i++].setheader = (&osip_message_set_alert_info);
   pconfig[i].hname = ALLOW;
   pconfig[i].ignored_when_invalid = 1;
+  pconfig[i].lazy = 1;
+  pconfig[i].mask = OSIP_HEADER_MASK_ALLOW;
   pconfig[i++].setheader = (&osip_message_set_allow);
   pconfig[i].hname = AUTHENTICATION_INFO;
   pconfig[i].ignored_when_invalid = 1;
+  pconfig[i].lazy = 1;
+  pconfig[i].mask = OSIP_HEADER_MASK_AUTHENTICATION_INFO;
   pconfig[i++].setheader = (&osip_message_set_authentication_info);
 #endif
   pconfig[i].hname = AUTHORIZATION;
   pconfig[i].ignored_when_invalid = 1;
+  pconfig[i].lazy = 1;
+  pconfig[i].mask = OSIP_HEADER_MASK_AUTHORIZATION;
   pconfig[i++].setheader = (&osip_message_set_authorization);
   pconfig[i].hname = CONTENT_TYPE_SHORT; /* "l" */
   pconfig[i].ignored_when_invalid = 0;
+  pconfig[i].lazy = 0;
+  pconfig[i].mask = OSIP_HEADER_MASK_CONTENT_TYPE;
   pconfig[i++].setheader = (&osip_message_set_content_type);
   pconfig[i].hname = CALL_ID;
   pconfig[i].ignored_when_invalid = 0;
+  pconfig[i].lazy = 0;
+  pconfig[i].mask = OSIP_HEADER_MASK_CALL_ID;
   pconfig[i++].setheader = (&osip_message_set_call_id);
 #ifndef MINISIZE
   pconfig[i].hname = CALL_INFO;
   pconfig[i].ignored_when_invalid = 1;
+  pconfig[i].lazy = 1;
+  pconfig[i].mask = OSIP_HEADER_MASK_CALL_INFO;
   pconfig[i++].setheader = (&osip_message_set_call_info);
 #endif
   pconfig[i].hname = CONTACT;
   pconfig[i].ignored_when_invalid = 0;
+  pconfig[i].lazy = 1;
+  pconfig[i].mask = OSIP_HEADER_MASK_CONTACT;
   pconfig[i++].setheader = (&osip_message_set_contact);
 #ifndef MINISIZE
   pconfig[i].hname = CONTENT_ENCODING;
   pconfig[i].ignored_when_invalid = 1;
+  pconfig[i].lazy = 1;
+  pconfig[i].mask = OSIP_HEADER_MASK_CONTENT_ENCODING;
   pconfig[i++].setheader = (&osip_message_set_content_encoding);
 #endif
   pconfig[i].hname = CONTENT_LENGTH;
   pconfig[i].ignored_when_invalid = 0;
+  pconfig[i].lazy = 0;
+  pconfig[i].mask = OSIP_HEADER_MASK_CONTENT_LENGTH;
   pconfig[i++].setheader = (&osip_message_set_content_length);
   pconfig[i].hname = CONTENT_TYPE;
   pconfig[i].ignored_when_invalid = 0;
+  pconfig[i].lazy = 0;
+  pconfig[i].mask = OSIP_HEADER_MASK_CONTENT_TYPE;
   pconfig[i++].setheader = (&osip_message_set_content_type);
   pconfig[i].hname = CSEQ;
   pconfig[i].ignored_when_invalid = 0;
+  pconfig[i].lazy = 0;
+  pconfig[i].mask = OSIP_HEADER_MASK_CSEQ;
   pconfig[i++].setheader = (&osip_message_set_cseq);
 #ifndef MINISIZE
   pconfig[i].hname = CONTENT_ENCODING_SHORT; /* "e" */
   pconfig[i].ignored_when_invalid = 1;
+  pconfig[i].lazy = 1;
+  pconfig[i].mask = OSIP_HEADER_MASK_CONTENT_ENCODING;
   pconfig[i++].setheader = (&osip_message_set_content_encoding);
   pconfig[i].hname = ERROR_INFO;
   pconfig[i].ignored_when_invalid = 1;
+  pconfig[i].lazy = 1;
+  pconfig[i].mask = OSIP_HEADER_MASK_ERROR_INFO;
   pconfig[i++].setheader = (&osip_message_set_error_info);
 #endif
   pconfig[i].hname = FROM_SHORT; /* "f" */
   pconfig[i].ignored_when_invalid = 0;
+  pconfig[i].lazy = 0;
+  pconfig[i].mask = OSIP_HEADER_MASK_FROM;
   pconfig[i++].setheader = (&osip_message_set_from);
   pconfig[i].hname = FROM;
   pconfig[i].ignored_when_invalid = 0;
+  pconfig[i].lazy = 0;
+  pconfig[i].mask = OSIP_HEADER_MASK_FROM;
   pconfig[i++].setheader = (&osip_message_set_from);
   pconfig[i].hname = CALL_ID_SHORT; /* "i" */
   pconfig[i].ignored_when_invalid = 0;
+  pconfig[i].lazy = 0;
+  pconfig[i].mask = OSIP_HEADER_MASK_CALL_ID;
   pconfig[i++].setheader = (&osip_message_set_call_id);
   pconfig[i].hname = CONTENT_LENGTH_SHORT; /* "l" */
   pconfig[i].ignored_when_invalid = 0;
+  pconfig[i].lazy = 0;
+  pconfig[i].mask = OSIP_HEADER_MASK_CONTENT_LENGTH;
   pconfig[i++].setheader = (&osip_message_set_content_length);
   pconfig[i].hname = CONTACT_SHORT; /* "m" */
   pconfig[i].ignored_when_invalid = 0;
+  pconfig[i].lazy = 1;
+  pconfig[i].mask = OSIP_HEADER_MASK_CONTACT;
   pconfig[i++].setheader = (&osip_message_set_contact);
   pconfig[i].hname = MIME_VERSION;
   pconfig[i].ignored_when_invalid = 1;
+  pconfig[i].lazy = 0;
+  pconfig[i].mask = OSIP_HEADER_MASK_MIME_VERSION;
   pconfig[i++].setheader = (&osip_message_set_mime_version);
   pconfig[i].hname = PROXY_AUTHENTICATE;
   pconfig[i].ignored_when_invalid = 1;
+  pconfig[i].lazy = 1;
+  pconfig[i].mask = OSIP_HEADER_MASK_PROXY_AUTHENTICATE;
   pconfig[i++].setheader = (&osip_message_set_proxy_authenticate);
 #ifndef MINISIZE
   pconfig[i].hname = PROXY_AUTHENTICATION_INFO;
   pconfig[i].ignored_when_invalid = 1;
+  pconfig[i].lazy = 1;
+  pconfig[i].mask = OSIP_HEADER_MASK_PROXY_AUTHENTICATION_INFO;
   pconfig[i++].setheader = (&osip_message_set_proxy_authentication_info);
 #endif
   pconfig[i].hname = PROXY_AUTHORIZATION;
   pconfig[i].ignored_when_invalid = 1;
+  pconfig[i].lazy = 1;
+  pconfig[i].mask = OSIP_HEADER_MASK_PROXY_AUTHORIZATION;
   pconfig[i++].setheader = (&osip_message_set_proxy_authorization);
   pconfig[i].hname = RECORD_ROUTE;
   pconfig[i].ignored_when_invalid = 1; /* best effort - but should be 0 */
+  pconfig[i].lazy = 0;
+  pconfig[i].mask = OSIP_HEADER_MASK_RECORD_ROUTE;
   pconfig[i++].setheader = (&osip_message_set_record_route);
   pconfig[i].hname = ROUTE;
   pconfig[i].ignored_when_invalid = 1; /* best effort - but should be 0 */
+  pconfig[i].lazy = 0;
+  pconfig[i].mask = OSIP_HEADER_MASK_ROUTE;
   pconfig[i++].setheader = (&osip_message_set_route);
   pconfig[i].hname = TO_SHORT;
   pconfig[i].ignored_when_invalid = 0;
+  pconfig[i].lazy = 0;
+  pconfig[i].mask = OSIP_HEADER_MASK_TO;
   pconfig[i++].setheader = (&osip_message_set_to);
   pconfig[i].hname = TO;
   pconfig[i].ignored_when_invalid = 0;
+  pconfig[i].lazy = 0;
+  pconfig[i].mask = OSIP_HEADER_MASK_TO;
   pconfig[i++].setheader = (&osip_message_set_to);
   pconfig[i].hname = VIA_SHORT;
   pconfig[i].ignored_when_invalid = 0;
+  pconfig[i].lazy = 0;
+  pconfig[i].mask = OSIP_HEADER_MASK_VIA;
   pconfig[i++].setheader = (&osip_message_set_via);
   pconfig[i].hname = VIA;
   pconfig[i].ignored_when_invalid = 0;
+  pconfig[i].lazy = 0;
+  pconfig[i].mask = OSIP_HEADER_MASK_VIA;
   pconfig[i++].setheader = (&osip_message_set_via);
   pconfig[i].hname = WWW_AUTHENTICATE;
   pconfig[i].ignored_when_invalid = 1;
+  pconfig[i].lazy = 1;
+  pconfig[i].mask = OSIP_HEADER_MASK_WWW_AUTHENTICATE;
   pconfig[i++].setheader = (&osip_message_set_www_authenticate);
 
-  /* build up hash table for fast header lookup */
+  /* where osip_message_to_str finds each header */
+  for (i = 0; i < NUMBER_OF_HEADERS; i++)
+    pconfig[i].known = __osip_message_find_known_header(pconfig[i].setheader);
 
-  /* initialize the table */
-  for (i = 0; i < HASH_TABLE_SIZE; i++) {
-    hdr_ref_table[i] = -1; /* -1 -> no entry */
-  }
-
-  for (i = 0; i < NUMBER_OF_HEADERS; i++) {
-    unsigned long hash;
+  /* build up hash table for fast header lookup: keep the first seed without collision */
+  {
+    unsigned int seed;
+    unsigned int best_seed = 0;
+    int best = -1;
 
-    /* calculate hash value using lower case */
-    /* Fixed: do not lower constant... osip_tolower( pconfig[i].hname ); */
-    hash = osip_hash(pconfig[i].hname);
-    hash = hash % HASH_TABLE_SIZE;
+    for (seed = 0; seed < HDR_LOOKUP_SEEDS && best != 0; seed++) {
+      i = hdr_lookup_build(seed);
 
-    if (hdr_ref_table[hash] == -1) {
-      /* store reference(index) to pconfig table */
-      hdr_ref_table[hash] = i;
+      if (i < 0)
+        return OSIP_UNDEFINED_ERROR;
 
-    } else {
-      /* oops, conflict!-> change the hash table or use another hash function size */
-
-      OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL, "conflict with current hashtable size\n"));
-      return OSIP_UNDEFINED_ERROR;
+      if (best < 0 || i < best) {
+        best = i;
+        best_seed = seed;
+      }
     }
+
+    if (best_seed != hdr_lookup_seed)
+      hdr_lookup_build(best_seed);
   }
 
   return OSIP_SUCCESS;
@@ -310,6 +462,10 @@ int parser_add_comma_separated_header(const char *hname) {
   for (i = 0; i < NUMBER_OF_HEADERS_COMMASEPARATED; i++) {
     if (pconfig_commasep[i].hname[0] == '\0') {
       snprintf(pconfig_commasep[i].hname, sizeof(pconfig_commasep[i].hname), "%s", hname);
+
+      if (hdr_lookup_add(pconfig_commasep[i].hname, -1, 1) < 0)
+        return OSIP_UNDEFINED_ERROR;
+
       return OSIP_SUCCESS;
     }
   }
@@ -317,40 +473,30 @@ int parser_add_comma_separated_header(const char *hname) {
   return OSIP_UNDEFINED_ERROR;
 }
 
-int __osip_message_is_header_comma_separated(const char *hname) {
-  int i;
+/* resolve a header name (any case, long or compact form): returns its index
+   in pconfig or -1 and sets *comma_separated when it is not NULL */
+int __osip_message_lookup_header(const char *hname, int *comma_separated) {
+  unsigned int slot;
+  int k;
 
-  for (i = 0; i < NUMBER_OF_HEADERS_COMMASEPARATED; i++) {
-    if (pconfig_commasep[i].hname[0] == '\0')
-      break;
+  k = hdr_lookup_find(hname, &slot);
 
-    if (osip_strcasecmp(pconfig_commasep[i].hname, hname) == 0)
-      return OSIP_SUCCESS;
-  }
+  if (comma_separated != NULL)
+    *comma_separated = (k >= 0) ? hdr_names[k].comma : 0;
 
-  return OSIP_UNDEFINED_ERROR;
+  return (k >= 0) ? hdr_names[k].known : -1;
 }
 
-/* improved look-up mechanism
-   precondition: hname is all lowercase */
-int __osip_message_is_known_header(const char *hname) {
-  unsigned long hash;
-  int result = -1;
-
-  int index;
-
-  hash = osip_hash(hname);
-  hash = hash % HASH_TABLE_SIZE;
-  index = hdr_ref_table[hash];
-
-  if ((index != -1) && (0 == strcmp(pconfig[index].hname, hname))) {
-    result = index;
-  }
+int __osip_message_is_header_comma_separated(const char *hname) {
+  int comma;
 
-  return result;
+  __osip_message_lookup_header(hname, &comma);
+  return comma ? OSIP_SUCCESS : OSIP_UNDEFINED_ERROR;
 }
 
-#endif
+int __osip_message_is_known_header(const char *hname) {
+  return __osip_message_lookup_header(hname, NULL);
+}
 
 /* This method calls the method that is able to parse the header */
 int __osip_message_call_method(int i, osip_message_t *dest, const char *hvalue) {
@@ -367,3 +513,55 @@ int __osip_message_call_method(int i, osip_message_t *dest, const char *hvalue)
 
   return err;
 }
+
+int __osip_message_get_known_header(int i) {
+  return pconfig[i].known;
+}
+
+int __osip_message_is_in_mask(int i, unsigned int mask) {
+  return (pconfig[i].mask & mask) != 0;
+}
+
+int __osip_message_is_lazy_header(int i) {
+#ifndef MINISIZE
+  return pconfig[i].lazy;
+#else
+  return 0; /* accessors are macros: nothing would parse them */
+#endif
+}
+
+/* parse the headers kept by osip_message_parse_lazy() that are handled by
+   setheader (or all of them when setheader is NULL) */
+int __osip_message_parse_lazy_headers(osip_message_t *sip, int (*setheader)(osip_message_t *, const char *)) {
+  osip_header_t *header;
+  __osip_wire_mark_t mark;
+  int property = sip->message_property;
+  int pos = 0;
+  int ret = OSIP_SUCCESS;
+  int i;
+
+  while (!osip_list_eol(&sip->lazy_headers, pos)) {
+    header = (osip_header_t *) osip_list_get(&sip->lazy_headers, pos);
+    i = __osip_message_is_known_header(header->hname);
+
+    if (i < 0 || (setheader != NULL && pconfig[i].setheader != setheader)) {
+      pos++;
+      continue;
+    }
+
+    osip_list_remove(&sip->lazy_headers, pos);
+    __osip_wire_mark(sip, pconfig[i].known, &mark);
+
+    /* invalid headers are dropped as they would have been by osip_message_parse */
+    if (__osip_message_call_method(i, sip, header->hvalue) != 0 && ret == OSIP_SUCCESS)
+      ret = OSIP_SYNTAXERROR;
+
+    /* the new header keeps the position of the line in the received message */
+    __osip_wire_move(sip, header, &mark);
+    osip_header_free(header);
+  }
+
+  /* the message itself is unchanged */
+  sip->message_property = property;
+  return ret;
+}
@@ -1146,6 +1146,263 @@ void osip_set_allocators(osip_malloc_func_t *malloc_func, osip_realloc_func_t *r
 
 #endif
 
+#if !defined(WIN32) && !defined(_WIN32_WCE) && !defined(MINISIZE) && (defined(OSIP_MONOTHREAD) || defined(__GNUC__))
+#define OSIP_ARENA
+#endif
+
+#ifdef OSIP_ARENA
+
+/*
+  Arena allocators: like the DEBUG_MEM facility, every block is
+  preceded by a header. It gives the arena owning the block (NULL
+  for a block of the heap) and the size of the block.
+ */
+
+#define OSIP_ARENA_ALIGN 16
+#define OSIP_ARENA_ROUND(S) (((S) + OSIP_ARENA_ALIGN - 1) & ~((size_t) OSIP_ARENA_ALIGN - 1))
+#define OSIP_ARENA_HEADER OSIP_ARENA_ROUND(sizeof(struct osip_arena_header))
+#define OSIP_ARENA_CHUNK OSIP_ARENA_ROUND(sizeof(struct osip_arena_chunk))
+#define OSIP_ARENA_CHUNK_SIZE 8192
+
+struct osip_arena_header {
+  osip_arena_t *arena;
+  size_t size;
+};
+
+struct osip_arena_chunk {
+  struct osip_arena_chunk *next;
+};
+
+struct osip_arena {
+  int ref; /* creator and messages allocated in the arena */
+  size_t chunk_size;
+  char *ptr; /* free space of the current chunk */
+  char *end;
+  struct osip_arena_chunk *chunks;
+};
+
+#ifdef OSIP_MONOTHREAD
+static osip_arena_t *osip_arena_current = NULL;
+#else
+static __thread osip_arena_t *osip_arena_current = NULL;
+#endif
+
+/* allocators wrapped by the arena allocators */
+static int osip_arena_installed = 0;
+static osip_malloc_func_t *osip_arena_malloc_func = 0;
+static osip_realloc_func_t *osip_arena_realloc_func = 0;
+static osip_free_func_t *osip_arena_free_func = 0;
+
+#define osip_arena_sys_malloc(S) (osip_arena_malloc_func ? osip_arena_malloc_func(S) : malloc(S))
+#define osip_arena_sys_realloc(P, S) (osip_arena_realloc_func ? osip_arena_realloc_func(P, S) : realloc(P, S))
+#define osip_arena_sys_free(P) (osip_arena_free_func ? osip_arena_free_func(P) : free(P))
+
+static void *__osip_arena_alloc(osip_arena_t *arena, size_t size) {
+  struct osip_arena_header *hdr;
+  struct osip_arena_chunk *chunk;
+  size_t need = OSIP_ARENA_HEADER + OSIP_ARENA_ROUND(size);
+
+  if (arena->ptr + need > arena->end) {
+    if (need > arena->chunk_size / 4) {
+      /* large block: use a chunk of its own and keep the current one */
+      chunk = (struct osip_arena_chunk *) osip_arena_sys_malloc(OSIP_ARENA_CHUNK + need);
+
+      if (chunk == NULL)
+        return NULL;
+
+      chunk->next = arena->chunks;
+      arena->chunks = chunk;
+      hdr = (struct osip_arena_header *) ((char *) chunk + OSIP_ARENA_CHUNK);
+      hdr->arena = arena;
+      hdr->size = size;
+      return (char *) hdr + OSIP_ARENA_HEADER;
+    }
+
+    chunk = (struct osip_arena_chunk *) osip_arena_sys_malloc(OSIP_ARENA_CHUNK + arena->chunk_size);
+
+    if (chunk == NULL)
+      return NULL;
+
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    arena->ptr = (char *) chunk + OSIP_ARENA_CHUNK;
+    arena->end = arena->ptr + arena->chunk_size;
+  }
+
+  hdr = (struct osip_arena_header *) arena->ptr;
+  arena->ptr += need;
+  hdr->arena = arena;
+  hdr->size = size;
+  return (char *) hdr + OSIP_ARENA_HEADER;
+}
+
+static void *osip_arena_malloc(size_t size) {
+  struct osip_arena_header *hdr;
+
+  if (osip_arena_current != NULL)
+    return __osip_arena_alloc(osip_arena_current, size);
+
+  hdr = (struct osip_arena_header *) osip_arena_sys_malloc(OSIP_ARENA_HEADER + size);
+
+  if (hdr == NULL)
+    return NULL;
+
+  hdr->arena = NULL;
+  hdr->size = size;
+  return (char *) hdr + OSIP_ARENA_HEADER;
+}
+
+static void *osip_arena_realloc(void *ptr, size_t size) {
+  struct osip_arena_header *hdr;
+  void *mem;
+
+  if (ptr == NULL)
+    return osip_arena_malloc(size);
+
+  hdr = (struct osip_arena_header *) ((char *) ptr - OSIP_ARENA_HEADER);
+
+  if (hdr->arena == NULL) {
+    hdr = (struct osip_arena_header *) osip_arena_sys_realloc(hdr, OSIP_ARENA_HEADER + size);
+
+    if (hdr == NULL)
+      return NULL;
+
+    hdr->size = size;
+    return (char *) hdr + OSIP_ARENA_HEADER;
+  }
+
+  if (size <= hdr->size)
+    return ptr;
+
+  /* the new block stays in the arena of the old one */
+  mem = __osip_arena_alloc(hdr->arena, size);
+
+  if (mem != NULL)
+    memcpy(mem, ptr, hdr->size);
+
+  return mem;
+}
+
+static void osip_arena_release(void *ptr) {
+  struct osip_arena_header *hdr = (struct osip_arena_header *) ((char *) ptr - OSIP_ARENA_HEADER);
+
+  /* blocks of an arena are released with the arena */
+  if (hdr->arena == NULL)
+    osip_arena_sys_free(hdr);
+}
+
+void osip_set_arena_allocators(void) {
+  if (osip_arena_installed)
+    return;
+
+  osip_arena_malloc_func = osip_malloc_func;
+  osip_arena_realloc_func = osip_realloc_func;
+  osip_arena_free_func = osip_free_func;
+  osip_set_allocators(osip_arena_malloc, osip_arena_realloc, osip_arena_release);
+  osip_arena_installed = 1;
+}
+
+int osip_arena_init(osip_arena_t **arena, size_t chunk_size) {
+  *arena = NULL;
+
+  if (!osip_arena_installed)
+    return OSIP_UNDEFINED_ERROR; /* osip_set_arena_allocators() is needed */
+
+  *arena = (osip_arena_t *) osip_arena_sys_malloc(sizeof(osip_arena_t));
+
+  if (*arena == NULL)
+    return OSIP_NOMEM;
+
+  (*arena)->ref = 1;
+  (*arena)->chunk_size = (chunk_size > 0) ? OSIP_ARENA_ROUND(chunk_size) : OSIP_ARENA_CHUNK_SIZE;
+  (*arena)->ptr = NULL;
+  (*arena)->end = NULL;
+  (*arena)->chunks = NULL;
+  return OSIP_SUCCESS;
+}
+
+void osip_arena_free(osip_arena_t *arena) {
+  struct osip_arena_chunk *chunk;
+  int ref;
+
+  if (arena == NULL)
+    return;
+
+#ifdef OSIP_MONOTHREAD
+  ref = --arena->ref;
+#else
+  ref = __atomic_sub_fetch(&arena->ref, 1, __ATOMIC_ACQ_REL);
+#endif
+
+  if (ref > 0)
+    return;
+
+  while (arena->chunks != NULL) {
+    chunk = arena->chunks;
+    arena->chunks = chunk->next;
+    osip_arena_sys_free(chunk);
+  }
+
+  osip_arena_sys_free(arena);
+}
+
+osip_arena_t *osip_arena_set_current(osip_arena_t *arena) {
+  osip_arena_t *prev = osip_arena_current;
+
+  osip_arena_current = arena;
+  return prev;
+}
+
+void *__osip_arena_get(const void *ptr) {
+  if (!osip_arena_installed || ptr == NULL)
+    return NULL;
+
+  return ((const struct osip_arena_header *) ((const char *) ptr - OSIP_ARENA_HEADER))->arena;
+}
+
+void __osip_arena_ref(void *arena) {
+#ifdef OSIP_MONOTHREAD
+  ((osip_arena_t *) arena)->ref++;
+#else
+  __atomic_add_fetch(&((osip_arena_t *) arena)->ref, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+void __osip_arena_unref(void *arena) {
+  osip_arena_free((osip_arena_t *) arena);
+}
+
+#else
+
+#if !defined(WIN32) && !defined(_WIN32_WCE) && !defined(MINISIZE)
+void osip_set_arena_allocators(void) {
+}
+
+int osip_arena_init(osip_arena_t **arena, size_t chunk_size) {
+  *arena = NULL;
+  return OSIP_UNDEFINED_ERROR; /* no thread local storage */
+}
+
+void osip_arena_free(osip_arena_t *arena) {
+}
+
+osip_arena_t *osip_arena_set_current(osip_arena_t *arena) {
+  return NULL;
+}
+#endif
+
+void *__osip_arena_get(const void *ptr) {
+  return NULL;
+}
+
+void __osip_arena_ref(void *arena) {
+}
+
+void __osip_arena_unref(void *arena) {
+}
+
+#endif
+
 #if defined(__VXWORKS_OS__)
 
 typedef struct {
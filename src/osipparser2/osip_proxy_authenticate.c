@@ -22,6 +22,7 @@
 #include <osipparser2/osip_port.h>
 #include <osipparser2/osip_message.h>
 #include <osipparser2/osip_parser.h>
+#include "parser.h"
 
 /* fills the proxy-authenticate header of message.               */
 /* INPUT :  char *hvalue | value of header.   */
@@ -60,6 +61,9 @@ int osip_message_get_proxy_authenticate(const osip_message_t *sip, int pos, osip
 
   *dest = NULL;
 
+  if (!osip_list_eol(&sip->lazy_headers, 0))
+    __osip_message_parse_lazy_headers((osip_message_t *) sip, &osip_message_set_proxy_authenticate);
+
   if (osip_list_size(&sip->proxy_authenticates) <= pos)
     return OSIP_UNDEFINED_ERROR; /* does not exist */
 
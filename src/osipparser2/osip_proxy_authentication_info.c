@@ -22,6 +22,7 @@
 #include <osipparser2/osip_port.h>
 #include <osipparser2/osip_message.h>
 #include <osipparser2/osip_parser.h>
+#include "parser.h"
 
 #ifndef MINISIZE
 
@@ -62,6 +63,9 @@ int osip_message_get_proxy_authentication_info(const osip_message_t *sip, int po
 
   *dest = NULL;
 
+  if (!osip_list_eol(&sip->lazy_headers, 0))
+    __osip_message_parse_lazy_headers((osip_message_t *) sip, &osip_message_set_proxy_authentication_info);
+
   if (osip_list_size(&sip->proxy_authentication_infos) <= pos)
     return OSIP_UNDEFINED_ERROR; /* does not exist */
 
@@ -22,6 +22,7 @@
 #include <osipparser2/osip_port.h>
 #include <osipparser2/osip_message.h>
 #include <osipparser2/osip_parser.h>
+#include "parser.h"
 
 #ifndef MINISIZE
 int osip_record_route_init(osip_record_route_t **record_route) {
@@ -84,72 +85,8 @@ int osip_record_route_parse(osip_record_route_t *record_route, const char *hvalu
 /* INPUT : osip_record_route_t *record_route | record_route header.  */
 /* returns -1 on error. */
 int osip_record_route_to_str(const osip_record_route_t *record_route, char **dest) {
-  char *url;
-  char *buf;
-  int i;
-  size_t len;
-
-  *dest = NULL;
-
-  if ((record_route == NULL) || (record_route->url == NULL))
-    return OSIP_BADPARAMETER;
-
-  i = osip_uri_to_str(record_route->url, &url);
-
-  if (i != 0)
-    return i;
-
-  if (record_route->displayname == NULL)
-    len = strlen(url) + 5;
-
-  else
-    len = strlen(url) + strlen(record_route->displayname) + 5;
-
-  buf = (char *) osip_malloc(len);
-
-  if (buf == NULL) {
-    osip_free(url);
-    return OSIP_NOMEM;
-  }
-
-  /* route and record-route always use brackets */
-  if (record_route->displayname != NULL)
-    sprintf(buf, "%s <%s>", record_route->displayname, url);
-
-  else
-    sprintf(buf, "<%s>", url);
-
-  osip_free(url);
-
-  {
-    size_t plen;
-    char *tmp;
-    osip_list_iterator_t it;
-    osip_generic_param_t *u_param = (osip_generic_param_t *) osip_list_get_first(&record_route->gen_params, &it);
-
-    while (u_param != OSIP_SUCCESS) {
-      if (u_param->gvalue == NULL)
-        plen = strlen(u_param->gname) + 2;
-
-      else
-        plen = strlen(u_param->gname) + strlen(u_param->gvalue) + 3;
-
-      len = len + plen;
-      buf = (char *) osip_realloc(buf, len);
-      tmp = buf;
-      tmp = tmp + strlen(tmp);
-
-      if (u_param->gvalue == NULL)
-        snprintf(tmp, len - (tmp - buf), ";%s", u_param->gname);
-
-      else
-        snprintf(tmp, len - (tmp - buf), ";%s=%s", u_param->gname, u_param->gvalue);
-
-      u_param = (osip_generic_param_t *) osip_list_get_next(&it);
-    }
-  }
-  *dest = buf;
-  return OSIP_SUCCESS;
+  /* route and record-route always use brackets, like from */
+  return __osip_writer_to_str(record_route, (int (*)(const void *, __osip_writer_t *)) & __osip_from_write, dest, NULL);
 }
 
 /* deallocates a osip_record_route_t structure.  */
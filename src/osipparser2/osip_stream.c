@@ -0,0 +1,324 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <osipparser2/internal.h>
+
+#include <limits.h>
+
+#include <osipparser2/osip_port.h>
+#include <osipparser2/osip_message.h>
+
+/* Messages received on a stream transport are framed with the
+   Content-Length header (rfc3261 18.3). The parser keeps the received
+   bytes in one buffer and remembers where it stopped: headers are
+   examined line by line as they arrive and the body is only counted.
+
+   Between messages, CRLF sequences are keep-alives (rfc5626 3.5.1):
+   CRLFCRLF is a ping, a single CRLF is a pong. */
+
+#define STREAM_IDLE 0    /* between messages */
+#define STREAM_HEADERS 1 /* in the start line or headers */
+#define STREAM_BODY 2    /* waiting for content_length bytes */
+#define STREAM_ERROR 3   /* framing is lost */
+
+struct osip_stream {
+  char *buf;
+  size_t size;  /* size of buf */
+  size_t start; /* first byte of the current message */
+  size_t end;   /* end of received bytes */
+  size_t scan;  /* next byte to examine */
+  size_t line;  /* first byte of the current header line */
+  size_t body;  /* first byte of the body */
+  size_t content_length;
+  int state;
+  int crlf;      /* a CRLF was received between messages */
+  int crlf_pong; /* ...and was already reported as a pong */
+  int pings;
+  int pongs;
+};
+
+int osip_stream_init(osip_stream_t **stream, size_t max_size) {
+  if (stream == NULL)
+    return OSIP_BADPARAMETER;
+
+  *stream = (osip_stream_t *) osip_malloc(sizeof(osip_stream_t));
+
+  if (*stream == NULL)
+    return OSIP_NOMEM;
+
+  memset(*stream, 0, sizeof(osip_stream_t));
+  (*stream)->size = (max_size > 0) ? max_size : SIP_MESSAGE_MAX_LENGTH;
+  (*stream)->buf = (char *) osip_malloc((*stream)->size);
+
+  if ((*stream)->buf == NULL) {
+    osip_free(*stream);
+    *stream = NULL;
+    return OSIP_NOMEM;
+  }
+
+  return OSIP_SUCCESS;
+}
+
+void osip_stream_free(osip_stream_t *stream) {
+  if (stream == NULL)
+    return;
+
+  osip_free(stream->buf);
+  osip_free(stream);
+}
+
+int osip_stream_feed(osip_stream_t *stream, const char *buf, size_t length) {
+  if (stream == NULL || buf == NULL)
+    return OSIP_BADPARAMETER;
+
+  if (stream->state == STREAM_ERROR)
+    return OSIP_SYNTAXERROR;
+
+  /* move the current message to the beginning of the buffer */
+  if (stream->start > 0 && stream->size - stream->end < length) {
+    memmove(stream->buf, stream->buf + stream->start, stream->end - stream->start);
+    stream->end -= stream->start;
+    stream->scan -= stream->start;
+    stream->line = (stream->line > stream->start) ? stream->line - stream->start : 0;
+    stream->body = (stream->body > stream->start) ? stream->body - stream->start : 0;
+    stream->start = 0;
+  }
+
+  if (length > stream->size - stream->end)
+    length = stream->size - stream->end;
+
+  if (length > INT_MAX)
+    length = INT_MAX;
+
+  memcpy(stream->buf + stream->end, buf, length);
+  stream->end += length;
+  return (int) length;
+}
+
+/* returns 1 and sets *content_length when the line is a Content-Length header,
+   0 for another line and -1 for an invalid value */
+static int stream_content_length(const char *line, size_t len, size_t max, size_t *content_length) {
+  size_t i = 0;
+  size_t value = 0;
+
+  while (i < len && line[i] != ':' && line[i] != ' ' && line[i] != '\t')
+    i++;
+
+  if (!(i == 14 && osip_strncasecmp(line, "content-length", 14) == 0) && !(i == 1 && (line[0] == 'l' || line[0] == 'L')))
+    return 0;
+
+  while (i < len && (line[i] == ' ' || line[i] == '\t'))
+    i++;
+
+  if (i == len || line[i] != ':')
+    return 0;
+
+  i++;
+
+  while (i < len && (line[i] == ' ' || line[i] == '\t'))
+    i++;
+
+  if (i == len || line[i] < '0' || line[i] > '9')
+    return -1;
+
+  while (i < len && line[i] >= '0' && line[i] <= '9') {
+    value = value * 10 + (line[i] - '0');
+
+    if (value > max)
+      return -1;
+
+    i++;
+  }
+
+  while (i < len && (line[i] == ' ' || line[i] == '\t'))
+    i++;
+
+  if (i != len)
+    return -1;
+
+  *content_length = value;
+  return 1;
+}
+
+/* skip keep-alives: returns 0 when a message starts at stream->scan */
+static int stream_skip_keepalive(osip_stream_t *stream) {
+  char c;
+
+  while (stream->scan < stream->end) {
+    c = stream->buf[stream->scan];
+
+    if (c == '\r') { /* CR of a CRLF */
+      stream->scan++;
+      continue;
+    }
+
+    if (c != '\n') {
+      if (stream->crlf && !stream->crlf_pong)
+        stream->pongs++;
+
+      stream->crlf = 0;
+      stream->crlf_pong = 0;
+      return 0;
+    }
+
+    stream->scan++;
+
+    if (stream->crlf) {
+      stream->pings++;
+      stream->crlf = 0;
+      stream->crlf_pong = 0;
+
+    } else
+      stream->crlf = 1;
+  }
+
+  stream->start = stream->scan;
+  return -1;
+}
+
+int osip_stream_get_frame(osip_stream_t *stream, const char **frame, size_t *length) {
+  const char *eol;
+  size_t len;
+  int i;
+
+  if (stream == NULL || frame == NULL || length == NULL)
+    return OSIP_BADPARAMETER;
+
+  if (stream->state == STREAM_ERROR)
+    return OSIP_SYNTAXERROR;
+
+  if (stream->state == STREAM_IDLE) {
+    if (stream_skip_keepalive(stream) != 0)
+      return OSIP_NOTFOUND;
+
+    stream->start = stream->scan;
+    stream->line = stream->scan;
+    stream->content_length = 0; /* missing Content-Length: no body */
+    stream->state = STREAM_HEADERS;
+  }
+
+  while (stream->state == STREAM_HEADERS) {
+    eol = (const char *) memchr(stream->buf + stream->scan, '\n', stream->end - stream->scan);
+
+    if (eol == NULL) {
+      stream->scan = stream->end;
+
+      if (stream->end - stream->start == stream->size) {
+        OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL, "headers of message larger than %u bytes\n", (unsigned int) stream->size));
+        stream->state = STREAM_ERROR;
+        return OSIP_SYNTAXERROR;
+      }
+
+      return OSIP_NOTFOUND;
+    }
+
+    stream->scan = eol - stream->buf + 1;
+    len = eol - (stream->buf + stream->line);
+
+    if (len > 0 && stream->buf[stream->line + len - 1] == '\r')
+      len--;
+
+    if (len == 0) { /* empty line: end of headers */
+      stream->body = stream->scan;
+      stream->state = STREAM_BODY;
+      break;
+    }
+
+    i = stream_content_length(stream->buf + stream->line, len, stream->size, &stream->content_length);
+
+    if (i < 0) {
+      OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL, "invalid Content-Length in stream\n"));
+      stream->state = STREAM_ERROR;
+      return OSIP_SYNTAXERROR;
+    }
+
+    stream->line = stream->scan;
+  }
+
+  if (stream->body - stream->start + stream->content_length > stream->size) {
+    OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL, "message larger than %u bytes\n", (unsigned int) stream->size));
+    stream->state = STREAM_ERROR;
+    return OSIP_SYNTAXERROR;
+  }
+
+  if (stream->end - stream->body < stream->content_length)
+    return OSIP_NOTFOUND;
+
+  *frame = stream->buf + stream->start;
+  *length = stream->body + stream->content_length - stream->start;
+  stream->start += *length;
+  stream->scan = stream->start;
+  stream->state = STREAM_IDLE;
+  return OSIP_SUCCESS;
+}
+
+int osip_stream_get_message(osip_stream_t *stream, osip_message_t **sip) {
+  const char *frame;
+  size_t length;
+  int i;
+
+  if (sip == NULL)
+    return OSIP_BADPARAMETER;
+
+  *sip = NULL;
+  i = osip_stream_get_frame(stream, &frame, &length);
+
+  if (i != OSIP_SUCCESS)
+    return i;
+
+  i = osip_message_init(sip);
+
+  if (i != OSIP_SUCCESS)
+    return i;
+
+  i = osip_message_parse(*sip, frame, length);
+
+  if (i != OSIP_SUCCESS) {
+    osip_message_free(*sip);
+    *sip = NULL;
+    return i;
+  }
+
+  return OSIP_SUCCESS;
+}
+
+int osip_stream_get_keepalive(osip_stream_t *stream, int *pings, int *pongs) {
+  if (stream == NULL)
+    return OSIP_BADPARAMETER;
+
+  if (stream->state == STREAM_IDLE)
+    stream_skip_keepalive(stream);
+
+  /* a CRLF alone at the end of the received bytes is a pong
+     (or the first half of a ping, also reported once completed) */
+  if (stream->state == STREAM_IDLE && stream->crlf && !stream->crlf_pong && stream->scan == stream->end) {
+    stream->pongs++;
+    stream->crlf_pong = 1;
+  }
+
+  if (pings != NULL)
+    *pings = stream->pings;
+
+  if (pongs != NULL)
+    *pongs = stream->pongs;
+
+  stream->pings = 0;
+  stream->pongs = 0;
+  return OSIP_SUCCESS;
+}
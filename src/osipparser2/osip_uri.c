@@ -21,6 +21,7 @@
 
 #include <osipparser2/osip_port.h>
 #include <osipparser2/osip_message.h>
+#include "parser.h"
 
 #define osip_is_alpha(in) ((in >= 'a' && in <= 'z') || (in >= 'A' && in <= 'Z'))
 
@@ -560,228 +561,6 @@ int osip_uri_parse_params(osip_uri_t *url, const char *params) {
   return OSIP_SUCCESS;
 }
 
-int osip_uri_to_str(const osip_uri_t *url, char **dest) {
-  char *buf;
-  size_t len;
-  size_t plen;
-  char *tmp;
-  const char *scheme;
-
-  *dest = NULL;
-
-  if (url == NULL)
-    return OSIP_BADPARAMETER;
-
-  if (url->host == NULL && url->string == NULL)
-    return OSIP_BADPARAMETER;
-
-  if (url->scheme == NULL && url->string != NULL)
-    return OSIP_BADPARAMETER;
-
-  if (url->string == NULL && url->scheme == NULL)
-    scheme = "sip"; /* default is sipurl */
-  else
-    scheme = url->scheme;
-
-  if (url->string != NULL) {
-    buf = (char *) osip_malloc(strlen(scheme) + strlen(url->string) + 3);
-
-    if (buf == NULL)
-      return OSIP_NOMEM;
-
-    *dest = buf;
-    sprintf(buf, "%s:", scheme);
-    buf = buf + strlen(scheme) + 1;
-    sprintf(buf, "%s", url->string);
-    return OSIP_SUCCESS;
-  }
-
-  len = strlen(scheme) + 1 + strlen(url->host) + 5;
-
-  if (url->username != NULL)
-    len = len + (strlen(url->username) * 3) + 1; /* count escaped char */
-
-  if (url->password != NULL)
-    len = len + (strlen(url->password) * 3) + 1;
-
-  if (url->port != NULL)
-    len = len + strlen(url->port) + 3;
-
-  buf = (char *) osip_malloc(len);
-
-  if (buf == NULL)
-    return OSIP_NOMEM;
-
-  tmp = buf;
-
-  sprintf(tmp, "%s:", scheme);
-  tmp = tmp + strlen(tmp);
-
-  if (url->username != NULL) {
-    char *tmp2 = __osip_uri_escape_userinfo(url->username);
-
-    if (tmp2 == NULL) {
-      osip_free(buf);
-      return OSIP_NOMEM;
-    }
-
-    sprintf(tmp, "%s", tmp2);
-    osip_free(tmp2);
-    tmp = tmp + strlen(tmp);
-  }
-
-  if ((url->password != NULL) && (url->username != NULL)) { /* be sure that when a password is given, a username is also given */
-    char *tmp2 = __osip_uri_escape_password(url->password);
-
-    if (tmp2 == NULL) {
-      osip_free(buf);
-      return OSIP_NOMEM;
-    }
-
-    sprintf(tmp, ":%s", tmp2);
-    osip_free(tmp2);
-    tmp = tmp + strlen(tmp);
-  }
-
-  if (url->username != NULL) { /* we add a '@' only when username is present... */
-    sprintf(tmp, "@");
-    tmp++;
-  }
-
-  if (strchr(url->host, ':') != NULL) {
-    sprintf(tmp, "[%s]", url->host);
-    tmp = tmp + strlen(tmp);
-
-  } else {
-    sprintf(tmp, "%s", url->host);
-    tmp = tmp + strlen(tmp);
-  }
-
-  if (url->port != NULL) {
-    sprintf(tmp, ":%s", url->port);
-    tmp = tmp + strlen(tmp);
-  }
-
-  {
-    osip_list_iterator_t it;
-    osip_uri_param_t *u_param = (osip_uri_param_t *) osip_list_get_first(&url->url_params, &it);
-
-    while (u_param != OSIP_SUCCESS) {
-      char *tmp1;
-      char *tmp2 = NULL;
-      char *previous_buf;
-
-      if (osip_strcasecmp(u_param->gname, "x-obr") == 0 || osip_strcasecmp(u_param->gname, "x-obp") == 0) {
-        /* x-obr and x-obp are internal params used by exosip: they must not appear in messages */
-        u_param = (osip_uri_param_t *) osip_list_get_next(&it);
-        continue;
-      }
-
-      tmp1 = __osip_uri_escape_uri_param(u_param->gname);
-
-      if (tmp1 == NULL) {
-        osip_free(buf);
-        return OSIP_SYNTAXERROR;
-      }
-
-      if (u_param->gvalue == NULL)
-        plen = strlen(tmp1) + 2;
-
-      else {
-        tmp2 = __osip_uri_escape_uri_param(u_param->gvalue);
-
-        if (tmp2 == NULL) {
-          osip_free(tmp1);
-          osip_free(buf);
-          return OSIP_SYNTAXERROR;
-        }
-
-        plen = strlen(tmp1) + strlen(tmp2) + 3;
-      }
-
-      len = len + plen;
-      previous_buf = buf;
-      buf = (char *) osip_realloc(buf, len);
-
-      if (buf == NULL) {
-        osip_free(previous_buf);
-        osip_free(tmp1);
-        osip_free(tmp2);
-        return OSIP_NOMEM;
-      }
-
-      tmp = buf;
-      tmp = tmp + strlen(tmp);
-
-      if (u_param->gvalue == NULL)
-        sprintf(tmp, ";%s", tmp1);
-
-      else {
-        sprintf(tmp, ";%s=%s", tmp1, tmp2);
-        osip_free(tmp2);
-      }
-
-      osip_free(tmp1);
-      u_param = (osip_uri_param_t *) osip_list_get_next(&it);
-    }
-  }
-
-  {
-    osip_list_iterator_t it;
-    osip_uri_header_t *u_header = (osip_uri_header_t *) osip_list_get_first(&url->url_headers, &it);
-
-    while (u_header != OSIP_SUCCESS) {
-      char *tmp1;
-      char *tmp2;
-      char *previous_buf;
-
-      tmp1 = __osip_uri_escape_header_param(u_header->gname);
-
-      if (tmp1 == NULL) {
-        osip_free(buf);
-        return OSIP_SYNTAXERROR;
-      }
-
-      tmp2 = __osip_uri_escape_header_param(u_header->gvalue);
-
-      if (tmp2 == NULL) {
-        osip_free(tmp1);
-        osip_free(buf);
-        return OSIP_SYNTAXERROR;
-      }
-
-      plen = strlen(tmp1) + strlen(tmp2) + 4;
-
-      len = len + plen;
-      previous_buf = buf;
-      buf = (char *) osip_realloc(buf, len);
-
-      if (buf == NULL) {
-        osip_free(previous_buf);
-        osip_free(tmp1);
-        osip_free(tmp2);
-        return OSIP_NOMEM;
-      }
-
-      tmp = buf;
-      tmp = tmp + strlen(tmp);
-
-      if (it.pos == 0)
-        snprintf(tmp, len - (tmp - buf), "?%s=%s", tmp1, tmp2);
-
-      else
-        snprintf(tmp, len - (tmp - buf), "&%s=%s", tmp1, tmp2);
-
-      osip_free(tmp1);
-      osip_free(tmp2);
-      u_header = (osip_uri_header_t *) osip_list_get_next(&it);
-    }
-  }
-
-  *dest = buf;
-  return OSIP_SUCCESS;
-}
-
 void osip_uri_free(osip_uri_t *url) {
   if (url == NULL)
     return;
@@ -1080,6 +859,122 @@ char *__osip_uri_escape_header_param(char *string) {
   return __osip_uri_escape_nonascii_and_nondef(string, header_param_def);
 }
 
+/* write string, escaping the characters that are neither alphanumeric nor in def */
+static void __osip_uri_write_escaped(__osip_writer_t *w, const char *string, const char *def) {
+  static const char hex[] = "0123456789ABCDEF";
+  const char *start = string;
+  unsigned char in;
+
+  for (; *string != '\0'; string++) {
+    in = (unsigned char) *string;
+
+    if (osip_is_alphanum(in) || strchr(def, in) != NULL)
+      continue;
+
+    /* encode it */
+    __osip_writer_append(w, start, string - start);
+    __osip_writer_putc(w, '%');
+    __osip_writer_putc(w, hex[in >> 4]);
+    __osip_writer_putc(w, hex[in & 0x0f]);
+    start = string + 1;
+  }
+
+  __osip_writer_append(w, start, string - start);
+}
+
+int __osip_uri_write(const osip_uri_t *url, __osip_writer_t *w) {
+  const char *scheme;
+
+  if (url == NULL)
+    return OSIP_BADPARAMETER;
+
+  if (url->host == NULL && url->string == NULL)
+    return OSIP_BADPARAMETER;
+
+  if (url->scheme == NULL && url->string != NULL)
+    return OSIP_BADPARAMETER;
+
+  if (url->string == NULL && url->scheme == NULL)
+    scheme = "sip"; /* default is sipurl */
+  else
+    scheme = url->scheme;
+
+  __osip_writer_puts(w, scheme);
+  __osip_writer_putc(w, ':');
+
+  if (url->string != NULL) {
+    __osip_writer_puts(w, url->string);
+    return OSIP_SUCCESS;
+  }
+
+  if (url->username != NULL)
+    __osip_uri_write_escaped(w, url->username, userinfo_def);
+
+  if ((url->password != NULL) && (url->username != NULL)) { /* be sure that when a password is given, a username is also given */
+    __osip_writer_putc(w, ':');
+    __osip_uri_write_escaped(w, url->password, password_def);
+  }
+
+  if (url->username != NULL) /* we add a '@' only when username is present... */
+    __osip_writer_putc(w, '@');
+
+  if (strchr(url->host, ':') != NULL) {
+    __osip_writer_putc(w, '[');
+    __osip_writer_puts(w, url->host);
+    __osip_writer_putc(w, ']');
+
+  } else
+    __osip_writer_puts(w, url->host);
+
+  if (url->port != NULL) {
+    __osip_writer_putc(w, ':');
+    __osip_writer_puts(w, url->port);
+  }
+
+  {
+    osip_list_iterator_t it;
+    osip_uri_param_t *u_param = (osip_uri_param_t *) osip_list_get_first(&url->url_params, &it);
+
+    while (u_param != OSIP_SUCCESS) {
+      /* x-obr and x-obp are internal params used by exosip: they must not appear in messages */
+      if (osip_strcasecmp(u_param->gname, "x-obr") != 0 && osip_strcasecmp(u_param->gname, "x-obp") != 0) {
+        __osip_writer_putc(w, ';');
+        __osip_uri_write_escaped(w, u_param->gname, uri_param_def);
+
+        if (u_param->gvalue != NULL) {
+          __osip_writer_putc(w, '=');
+          __osip_uri_write_escaped(w, u_param->gvalue, uri_param_def);
+        }
+      }
+
+      u_param = (osip_uri_param_t *) osip_list_get_next(&it);
+    }
+  }
+
+  {
+    osip_list_iterator_t it;
+    osip_uri_header_t *u_header = (osip_uri_header_t *) osip_list_get_first(&url->url_headers, &it);
+
+    while (u_header != OSIP_SUCCESS) {
+      __osip_writer_putc(w, (it.pos == 0) ? '?' : '&');
+      __osip_uri_write_escaped(w, u_header->gname, header_param_def);
+      __osip_writer_putc(w, '=');
+      __osip_uri_write_escaped(w, u_header->gvalue, header_param_def);
+      u_header = (osip_uri_header_t *) osip_list_get_next(&it);
+    }
+  }
+
+  return OSIP_SUCCESS;
+}
+
+int osip_uri_to_str(const osip_uri_t *url, char **dest) {
+  return __osip_writer_to_str(url, (int (*)(const void *, __osip_writer_t *)) & __osip_uri_write, dest, NULL);
+}
+
+int osip_uri_to_buf(const osip_uri_t *url, char *buf, size_t cap, size_t *len) {
+  return __osip_writer_to_buf(url, (int (*)(const void *, __osip_writer_t *)) & __osip_uri_write, buf, cap, len);
+}
+
 void __osip_uri_unescape(char *string) {
   size_t alloc = strlen(string) + 1;
   unsigned char in;
@@ -309,81 +309,48 @@ int osip_via_parse(osip_via_t *via, const char *hvalue) {
 /* returns the via header as a string. */
 /* INPUT : osip_via_t via* | via header.    */
 /* returns null on error. */
-int osip_via_to_str(const osip_via_t *via, char **dest) {
-  char *buf;
-  size_t len;
-  size_t plen;
-  char *tmp;
-
-  *dest = NULL;
-
+int __osip_via_write(const osip_via_t *via, __osip_writer_t *w) {
   if ((via == NULL) || (via->host == NULL) || (via->version == NULL) || (via->protocol == NULL))
     return OSIP_BADPARAMETER;
 
-  len = strlen(via->version) + 1 + strlen(via->protocol) + 1 + 3 + 2; /* sip/xxx/xxx */
-  len = len + strlen(via->host) + 3 + 1;
-
-  if (via->port != NULL)
-    len = len + strlen(via->port) + 2;
-
-  buf = (char *) osip_malloc(len);
-
-  if (buf == NULL)
-    return OSIP_NOMEM;
+  __osip_writer_append(w, "SIP/", 4);
+  __osip_writer_puts(w, via->version);
+  __osip_writer_putc(w, '/');
+  __osip_writer_puts(w, via->protocol);
+  __osip_writer_putc(w, ' ');
 
   if (strchr(via->host, ':') != NULL) {
-    if (via->port == NULL)
-      sprintf(buf, "SIP/%s/%s [%s]", via->version, via->protocol, via->host);
+    __osip_writer_putc(w, '[');
+    __osip_writer_puts(w, via->host);
+    __osip_writer_putc(w, ']');
 
-    else
-      sprintf(buf, "SIP/%s/%s [%s]:%s", via->version, via->protocol, via->host, via->port);
-
-  } else {
-    if (via->port == NULL)
-      sprintf(buf, "SIP/%s/%s %s", via->version, via->protocol, via->host);
+  } else
+    __osip_writer_puts(w, via->host);
 
-    else
-      sprintf(buf, "SIP/%s/%s %s:%s", via->version, via->protocol, via->host, via->port);
+  if (via->port != NULL) {
+    __osip_writer_putc(w, ':');
+    __osip_writer_puts(w, via->port);
   }
 
-  {
-    osip_list_iterator_t it;
-    osip_generic_param_t *u_param = (osip_generic_param_t *) osip_list_get_first(&via->via_params, &it);
-
-    while (u_param != OSIP_SUCCESS) {
-      if (u_param->gvalue == NULL)
-        plen = strlen(u_param->gname) + 2;
-
-      else
-        plen = strlen(u_param->gname) + strlen(u_param->gvalue) + 3;
-
-      len = len + plen;
-      buf = (char *) osip_realloc(buf, len);
-      tmp = buf;
-      tmp = tmp + strlen(tmp);
-
-      if (u_param->gvalue == NULL)
-        sprintf(tmp, ";%s", u_param->gname);
-
-      else
-        sprintf(tmp, ";%s=%s", u_param->gname, u_param->gvalue);
-
-      u_param = (osip_generic_param_t *) osip_list_get_next(&it);
-    }
-  }
+  __osip_writer_gen_params(w, &via->via_params);
 
   if (via->comment != NULL) {
-    len = len + strlen(via->comment) + 4;
-    buf = (char *) osip_realloc(buf, len);
-    tmp = buf;
-    tmp = tmp + strlen(tmp);
-    snprintf(tmp, len - (tmp - buf), " (%s)", via->comment);
+    __osip_writer_append(w, " (", 2);
+    __osip_writer_puts(w, via->comment);
+    __osip_writer_putc(w, ')');
   }
 
-  *dest = buf;
   return OSIP_SUCCESS;
 }
 
+int osip_via_to_str(const osip_via_t *via, char **dest) {
+  return __osip_writer_to_str(via, (int (*)(const void *, __osip_writer_t *)) & __osip_via_write, dest, NULL);
+}
+
+int osip_via_to_buf(const osip_via_t *via, char *buf, size_t cap, size_t *len) {
+  return __osip_writer_to_buf(via, (int (*)(const void *, __osip_writer_t *)) & __osip_via_write, buf, cap, len);
+}
+
 void via_set_version(osip_via_t *via, char *version) {
   via->version = version;
 }
@@ -443,6 +443,9 @@ int osip_message_get_www_authenticate(const osip_message_t *sip, int pos, osip_w
 
   *dest = NULL;
 
+  if (!osip_list_eol(&sip->lazy_headers, 0))
+    __osip_message_parse_lazy_headers((osip_message_t *) sip, &osip_message_set_www_authenticate);
+
   if (osip_list_size(&sip->www_authenticates) <= pos)
     return OSIP_UNDEFINED_ERROR; /* does not exist */
 
@@ -37,6 +37,9 @@ typedef struct ___osip_message_config_t {
   char *hname;
   int (*setheader)(osip_message_t *, const char *);
   int ignored_when_invalid;
+  int lazy;          /* may be kept unparsed by osip_message_parse_lazy */
+  unsigned int mask; /* OSIP_HEADER_MASK_* bit for osip_message_parse_with_mask */
+  int known;         /* index in the known headers of osip_message_to_str or -1 */
 } __osip_message_config_t;
 
 typedef struct ___osip_message_config_commaseparated_t {
@@ -44,8 +47,90 @@ typedef struct ___osip_message_config_commaseparated_t {
 } __osip_message_config_commaseparated_t;
 
 int __osip_message_call_method(int i, osip_message_t *dest, const char *hvalue);
+int __osip_message_is_in_mask(int i, unsigned int mask);
+int __osip_message_is_lazy_header(int i);
+int __osip_message_parse_lazy_headers(osip_message_t *sip, int (*setheader)(osip_message_t *, const char *));
+int __osip_message_lookup_header(const char *hname, int *comma_separated);
 int __osip_message_is_header_comma_separated(const char *hname);
 int __osip_message_is_known_header(const char *hname);
+int __osip_message_get_known_header(int i);
+
+/* output buffer of the *_to_buf and *_to_str methods: len counts all the
+   bytes written, including the ones that did not fit in buf (like snprintf) */
+typedef struct ___osip_writer_t {
+  char *buf;
+  size_t cap;
+  size_t len;
+} __osip_writer_t;
+
+void __osip_writer_init(__osip_writer_t *w, char *buf, size_t cap);
+void __osip_writer_append(__osip_writer_t *w, const char *str, size_t len);
+void __osip_writer_puts(__osip_writer_t *w, const char *str);
+void __osip_writer_putc(__osip_writer_t *w, char c);
+void __osip_writer_gen_params(__osip_writer_t *w, const osip_list_t *gen_params);
+int __osip_writer_end(__osip_writer_t *w, int i, size_t *len);
+int __osip_writer_to_buf(const void *element, int (*write)(const void *, __osip_writer_t *), char *buf, size_t cap, size_t *len);
+int __osip_writer_to_str(const void *element, int (*write)(const void *, __osip_writer_t *), char **dest, size_t *len);
+
+int __osip_uri_write(const osip_uri_t *url, __osip_writer_t *w);
+int __osip_from_write(const osip_from_t *from, __osip_writer_t *w);
+int __osip_contact_write(const osip_contact_t *contact, __osip_writer_t *w);
+int __osip_via_write(const osip_via_t *via, __osip_writer_t *w);
+int __osip_call_id_write(const osip_call_id_t *callid, __osip_writer_t *w);
+int __osip_cseq_write(const osip_cseq_t *cseq, __osip_writer_t *w);
+int __osip_content_type_write(const osip_content_type_t *content_type, __osip_writer_t *w);
+int __osip_content_length_write(const osip_content_length_t *cl, __osip_writer_t *w);
+int __osip_header_write(const osip_header_t *header, __osip_writer_t *w);
+int __osip_call_info_write(const osip_call_info_t *call_info, __osip_writer_t *w);
+int __osip_accept_write(const osip_accept_t *accept, __osip_writer_t *w);
+int __osip_accept_encoding_write(const osip_accept_encoding_t *accept_encoding, __osip_writer_t *w);
+int __osip_body_write_headers(const osip_body_t *body, __osip_writer_t *w);
+int __osip_body_write(const osip_body_t *body, __osip_writer_t *w);
+
+int __osip_message_find_known_header(int (*setheader)(osip_message_t *, const char *));
+
+/* reference counted buffers: message_cache of osip_message_t (see osip_message_get_wire) and the received message */
+char *__osip_message_cache_new(size_t length);
+void __osip_message_cache_ref(const char *message);
+void __osip_message_cache_unref(const char *message);
+
+/* the received message is kept with the position of the headers parsed
+   alone on their line: see osip_message_to_iovec */
+typedef struct ___osip_wire_span_t {
+  const void *header; /* parsed element */
+  int known;          /* where it is stored: see __osip_wire_mark */
+  size_t start;       /* first byte of its line */
+  size_t end;         /* after the CRLF of its line */
+} __osip_wire_span_t;
+
+typedef struct ___osip_wire_t {
+  const char *buf; /* copy of the received message, shared with the clones */
+  size_t length;
+  __osip_wire_span_t *spans; /* mostly in the order of the look-ups */
+  int nb_spans;
+  int max_spans;
+  int next; /* where the next look-up starts */
+} __osip_wire_t;
+
+#define WIRE_UNKNOWN_HEADERS -2 /* osip_message_t headers list */
+#define WIRE_LAZY_HEADERS -3    /* osip_message_t lazy_headers list */
+
+/* where a header is about to be stored: see __osip_wire_add */
+typedef struct ___osip_wire_mark_t {
+  int known;
+  osip_list_t *list;
+  void **data;
+  int nb;
+} __osip_wire_mark_t;
+
+int __osip_wire_init(osip_message_t *sip, const char *buf, size_t length);
+void __osip_wire_free(osip_message_t *sip);
+int __osip_wire_mark(osip_message_t *sip, int known, __osip_wire_mark_t *mark);
+void __osip_wire_add(osip_message_t *sip, const __osip_wire_mark_t *mark, size_t start, size_t end);
+void __osip_wire_move(osip_message_t *sip, const void *header, const __osip_wire_mark_t *mark);
+const __osip_wire_span_t *__osip_wire_find(osip_message_t *sip, int known, const void *header);
+void __osip_wire_forget(osip_message_t *sip, const void *header);
+void __osip_wire_clone(osip_message_t *sip, osip_message_t *copy);
 
 int __osip_find_next_occurence(const char *str, const char *buf, const char **index_of_str, const char *end_of_buf);
 int __osip_find_next_crlf(const char *start_of_header, const char **end_of_header);
@@ -0,0 +1,168 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osipparser2/internal.h>
+#include <osipparser2/osip_port.h>
+#include <osipparser2/osip_parser.h>
+
+/* parse the messages of the res directory with and without an arena:
+   messages built in an arena, modified outside of it, cloned and
+   released after the arena must give the same result as messages
+   allocated on the heap. */
+
+static void modify_message(osip_message_t *sip) {
+  int i;
+
+  for (i = 0; i < 20; i++)
+    osip_message_set_header(sip, "X-Test", "value");
+
+  osip_message_set_via(sip, "SIP/2.0/UDP 10.0.0.1:5060;branch=z9hG4bKxyz");
+}
+
+static int test_arena(const char *filename, const char *msg, size_t length, size_t chunk_size) {
+  osip_message_t *heap;
+  osip_message_t *in_arena;
+  osip_message_t *clone;
+  osip_arena_t *arena;
+  osip_arena_t *previous;
+  char *result[3] = {NULL, NULL, NULL};
+  size_t len;
+  int failed = 0;
+  int i;
+  int j;
+
+  osip_message_init(&heap);
+  i = osip_message_parse(heap, msg, length);
+
+  if (osip_arena_init(&arena, chunk_size) != OSIP_SUCCESS) {
+    osip_message_free(heap);
+    return -1;
+  }
+
+  /* the message keeps the arena after osip_arena_free */
+  previous = osip_arena_set_current(arena);
+  osip_message_init(&in_arena);
+  j = osip_message_parse(in_arena, msg, length);
+  modify_message(in_arena);
+  osip_arena_set_current(previous);
+  osip_arena_free(arena);
+
+  if (i != j) {
+    fprintf(stdout, "tarena: %s: parsed with %i instead of %i\n", filename, j, i);
+    osip_message_free(heap);
+    osip_message_free(in_arena);
+    return -1;
+  }
+
+  if (i != OSIP_SUCCESS) {
+    osip_message_free(heap);
+    osip_message_free(in_arena);
+    return 0;
+  }
+
+  modify_message(heap);
+
+  /* heap memory attached to a message of the arena */
+  osip_message_set_header(heap, "X-Out", "1");
+  osip_message_set_header(in_arena, "X-Out", "1");
+
+  osip_message_to_str(heap, &result[0], &len);
+  osip_message_to_str(in_arena, &result[1], &len);
+
+  if (osip_message_clone(in_arena, &clone) == OSIP_SUCCESS) {
+    /* the clone does not depend on the arena */
+    osip_message_free(in_arena);
+    in_arena = NULL;
+    osip_message_to_str(clone, &result[2], &len);
+    osip_message_free(clone);
+  }
+
+  if (result[0] == NULL || result[1] == NULL || result[2] == NULL || strcmp(result[0], result[1]) != 0 || strcmp(result[0], result[2]) != 0) {
+    fprintf(stdout, "tarena: %s: message of the arena differs (chunks of %i bytes)\n", filename, (int) chunk_size);
+    failed = -1;
+  }
+
+  for (i = 0; i < 3; i++)
+    osip_free(result[i]);
+
+  osip_message_free(heap);
+
+  if (in_arena != NULL)
+    osip_message_free(in_arena);
+
+  return failed;
+}
+
+static char *read_message(const char *filename, size_t *length) {
+  FILE *file;
+  char *msg;
+
+  file = fopen(filename, "r");
+
+  if (file == NULL)
+    return NULL;
+
+  msg = (char *) osip_malloc(100000); /* msg are under 100000 */
+  *length = fread(msg, 1, 99999, file);
+  msg[*length] = '\0';
+  fclose(file);
+  return msg;
+}
+
+int main(int argc, char **argv) {
+  char filename[1024];
+  char *msg;
+  size_t length;
+  int tested = 0;
+  int failed = 0;
+  int i;
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: ./tarena res_directory\n");
+    exit(1);
+  }
+
+  osip_set_arena_allocators();
+  parser_init();
+
+  for (i = 0;; i++) {
+    snprintf(filename, sizeof(filename), "%s/sip%i", argv[1], i);
+    msg = read_message(filename, &length);
+
+    if (msg == NULL)
+      break;
+
+    /* default chunks, and small chunks for large allocations */
+    if (test_arena(filename, msg, length, 0) < 0)
+      failed++;
+
+    if (test_arena(filename, msg, length, 256) < 0)
+      failed++;
+
+    tested++;
+    osip_free(msg);
+  }
+
+  fprintf(stdout, "tarena: %i messages, %i failed\n", tested, failed);
+  return (tested == 0 || failed != 0) ? 1 : 0;
+}
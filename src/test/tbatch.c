@@ -0,0 +1,183 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osip2/internal.h>
+#include <osip2/osip.h>
+
+/* parse batches of messages of the res directory with osip_parse_batch
+   (and osip_executor_parse_batch): each event is the event given by
+   osip_parse for the same message. */
+
+#define MAX_MESSAGES 256
+#define NB_ROUNDS 50
+
+static const char *bufs[MAX_MESSAGES];
+static size_t lengths[MAX_MESSAGES];
+
+#ifndef OSIP_MONOTHREAD
+static osip_executor_t *executor;
+#endif
+
+static int compare_events(int index, osip_event_t *expected, osip_event_t *evt) {
+  char *result[2] = {NULL, NULL};
+  size_t length;
+  int failed = 0;
+
+  if ((expected == NULL) != (evt == NULL)) {
+    fprintf(stdout, "tbatch: message %i: parsed differently\n", index);
+    return -1;
+  }
+
+  if (expected == NULL)
+    return 0;
+
+  osip_message_to_str(expected->sip, &result[0], &length);
+  osip_message_to_str(evt->sip, &result[1], &length);
+
+  if (expected->type != evt->type || result[0] == NULL || result[1] == NULL || strcmp(result[0], result[1]) != 0) {
+    fprintf(stdout, "tbatch: message %i: event differs\n", index);
+    failed = -1;
+  }
+
+  osip_free(result[0]);
+  osip_free(result[1]);
+  return failed;
+}
+
+static int test_batch(int count) {
+  osip_event_t *events[MAX_MESSAGES];
+  osip_event_t *events2[MAX_MESSAGES];
+  int failed = 0;
+  int nb_events;
+  int i;
+
+  nb_events = osip_parse_batch(bufs, lengths, count, events);
+
+#ifndef OSIP_MONOTHREAD
+
+  if (osip_executor_parse_batch(executor, bufs, lengths, count, events2) != nb_events) {
+    fprintf(stdout, "tbatch: executor created a different number of events\n");
+    failed++;
+  }
+
+#else
+
+  for (i = 0; i < count; i++)
+    events2[i] = osip_parse(bufs[i], lengths[i]);
+
+#endif
+
+  for (i = 0; i < count; i++) {
+    osip_event_t *expected = osip_parse(bufs[i], lengths[i]);
+
+    if (compare_events(i, expected, events[i]) < 0 || compare_events(i, expected, events2[i]) < 0)
+      failed++;
+
+    if (expected != NULL)
+      nb_events--;
+
+    osip_event_free(expected);
+    osip_event_free(events[i]);
+    osip_event_free(events2[i]);
+  }
+
+  if (nb_events != 0) {
+    fprintf(stdout, "tbatch: wrong number of events for %i messages\n", count);
+    failed++;
+  }
+
+  return failed;
+}
+
+static char *read_message(const char *filename, size_t *length) {
+  FILE *file;
+  char *msg;
+
+  file = fopen(filename, "r");
+
+  if (file == NULL)
+    return NULL;
+
+  msg = (char *) osip_malloc(100000); /* msg are under 100000 */
+  *length = fread(msg, 1, 99999, file);
+  msg[*length] = '\0';
+  fclose(file);
+  return msg;
+}
+
+int main(int argc, char **argv) {
+  osip_t *osip;
+  char filename[1024];
+  int nb_messages;
+  int failed = 0;
+  int round;
+  int i;
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: ./tbatch res_directory\n");
+    exit(1);
+  }
+
+  if (osip_init(&osip) != OSIP_SUCCESS)
+    return 1;
+
+  for (nb_messages = 0; nb_messages < MAX_MESSAGES; nb_messages++) {
+    char *msg;
+
+    snprintf(filename, sizeof(filename), "%s/sip%i", argv[1], nb_messages);
+    msg = read_message(filename, &lengths[nb_messages]);
+
+    if (msg == NULL)
+      break;
+
+    bufs[nb_messages] = msg;
+  }
+
+#ifndef OSIP_MONOTHREAD
+
+  if (osip_executor_init(&executor, osip, 4) != OSIP_SUCCESS) {
+    fprintf(stdout, "tbatch: cannot start the executor\n");
+    failed++;
+  }
+
+#endif
+
+  /* batches of any size, including empty ones */
+  for (round = 0; round < NB_ROUNDS && failed == 0; round++)
+    failed += test_batch((round * 7) % (nb_messages + 1));
+
+#ifndef OSIP_MONOTHREAD
+
+  if (executor != NULL)
+    osip_executor_free(executor);
+
+#endif
+
+  for (i = 0; i < nb_messages; i++)
+    osip_free((char *) bufs[i]);
+
+  osip_release(osip);
+
+  fprintf(stdout, "tbatch: %i messages, %i failed\n", nb_messages, failed);
+  return (nb_messages == 0 || failed != 0) ? 1 : 0;
+}
@@ -0,0 +1,308 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <sys/uio.h>
+
+#include <osipparser2/internal.h>
+#include <osipparser2/osip_port.h>
+#include <osipparser2/osip_parser.h>
+
+/* clone the messages of the res directory (also with CRLF line ends)
+   with osip_message_clone and osip_message_clone_with_wire: clones give
+   the same message, keep their modifications and share the received
+   message without sharing modifications. */
+
+#define MAX_IOVEC 256
+
+static char scratch[200000];
+
+/* the message given by osip_message_to_iovec and the number of bytes
+   pointing to the received message */
+static char *iovec_to_str(osip_message_t *sip, size_t *shared) {
+  struct iovec iov[MAX_IOVEC];
+  char *dest;
+  size_t length = 0;
+  int iovcnt = MAX_IOVEC;
+  int i;
+
+  *shared = 0;
+
+  if (osip_message_to_iovec(sip, iov, &iovcnt, scratch, sizeof(scratch)) != OSIP_SUCCESS)
+    return NULL;
+
+  for (i = 0; i < iovcnt; i++)
+    length += iov[i].iov_len;
+
+  dest = (char *) osip_malloc(length + 1);
+  length = 0;
+
+  for (i = 0; i < iovcnt; i++) {
+    memcpy(dest + length, iov[i].iov_base, iov[i].iov_len);
+    length += iov[i].iov_len;
+
+    if ((char *) iov[i].iov_base < scratch || (char *) iov[i].iov_base >= scratch + sizeof(scratch))
+      *shared += iov[i].iov_len;
+  }
+
+  dest[length] = '\0';
+  return dest;
+}
+
+/* modify the first Via and the first unknown header */
+static int modify_message(osip_message_t *sip, int report) {
+  osip_via_t *via = (osip_via_t *) osip_list_get(&sip->vias, 0);
+  osip_header_t *header = (osip_header_t *) osip_list_get(&sip->headers, 0);
+  int modified = 0;
+
+  if (via != NULL) {
+    osip_via_param_add(via, osip_strdup("xedit"), osip_strdup("1"));
+
+    if (report)
+      osip_message_force_update_header(sip, via);
+
+    modified |= 1;
+  }
+
+  if (header != NULL) {
+    osip_free(header->hvalue);
+    header->hvalue = osip_strdup("edited-value");
+
+    if (report)
+      osip_message_force_update_header(sip, header);
+
+    modified |= 2;
+  }
+
+  return modified;
+}
+
+static int is_modified(const char *str, int modified) {
+  if (str == NULL)
+    return 0;
+
+  if ((modified & 1) && strstr(str, "xedit=1") == NULL)
+    return 0;
+
+  if ((modified & 2) && strstr(str, "edited-value") == NULL)
+    return 0;
+
+  return 1;
+}
+
+static int test_clone(const char *filename, osip_message_t *sip) {
+  osip_message_t *clone;
+  char *result[2] = {NULL, NULL};
+  char *iov_result;
+  size_t length[2];
+  size_t shared;
+  int failed = 0;
+  int modified;
+
+  /* a plain clone does not keep the received message */
+  osip_message_clone(sip, &clone);
+
+  if (clone->wire != NULL) {
+    fprintf(stdout, "tclone: %s: received message kept by a plain clone\n", filename);
+    failed = -1;
+  }
+
+  osip_message_to_str(sip, &result[0], &length[0]);
+  osip_message_to_str(clone, &result[1], &length[1]);
+
+  if (result[0] == NULL || result[1] == NULL || length[0] != length[1] || memcmp(result[0], result[1], length[0]) != 0) {
+    fprintf(stdout, "tclone: %s: clone differs\n", filename);
+    failed = -1;
+  }
+
+  osip_free(result[0]);
+  osip_free(result[1]);
+  osip_message_free(clone);
+
+  /* the clone also copies the buffer of osip_message_to_str */
+  osip_message_clone(sip, &clone);
+  modified = modify_message(clone, 0);
+  osip_message_force_update(clone);
+
+  result[1] = NULL;
+  iov_result = iovec_to_str(clone, &shared);
+  osip_message_to_str(clone, &result[1], &length[1]);
+
+  if (!is_modified(result[1], modified) || !is_modified(iov_result, modified)) {
+    fprintf(stdout, "tclone: %s: modification of a clone lost\n", filename);
+    failed = -1;
+  }
+
+  osip_free(iov_result);
+  osip_free(result[1]);
+  osip_message_free(clone);
+  return failed;
+}
+
+static int test_clone_with_wire(const char *filename, osip_message_t *sip) {
+  osip_message_t *clone;
+  osip_message_t *clone2;
+  char *result[2];
+  char *str = NULL;
+  size_t shared[2];
+  size_t length;
+  int failed = 0;
+  int modified;
+
+  /* the clone gives the same buffers and outlives the original */
+  osip_message_clone_with_wire(sip, &clone);
+  result[0] = iovec_to_str(sip, &shared[0]);
+  result[1] = iovec_to_str(clone, &shared[1]);
+
+  if (result[0] == NULL || result[1] == NULL || strcmp(result[0], result[1]) != 0 || shared[0] != shared[1]) {
+    fprintf(stdout, "tclone: %s: clone with wire differs\n", filename);
+    failed = -1;
+  }
+
+  osip_free(result[0]);
+  osip_free(result[1]);
+  osip_message_free(sip);
+
+  osip_message_clone_with_wire(clone, &clone2);
+  modified = modify_message(clone, 1);
+  result[0] = iovec_to_str(clone, &shared[0]);
+  osip_message_to_str(clone, &str, &length);
+
+  if (!is_modified(result[0], modified) || !is_modified(str, modified)) {
+    fprintf(stdout, "tclone: %s: modification of a clone with wire lost\n", filename);
+    failed = -1;
+  }
+
+  osip_free(result[0]);
+  osip_free(str);
+  osip_message_free(clone);
+
+  /* modifications are not shared with the other clones */
+  result[1] = iovec_to_str(clone2, &shared[1]);
+
+  if (result[1] == NULL || strstr(result[1], "xedit=1") != NULL || strstr(result[1], "edited-value") != NULL) {
+    fprintf(stdout, "tclone: %s: modification shared between clones\n", filename);
+    failed = -1;
+  }
+
+  osip_free(result[1]);
+  osip_message_free(clone2);
+  return failed;
+}
+
+static int test_message(const char *filename, const char *msg, size_t length) {
+  osip_message_t *sip;
+  int failed = 0;
+
+  osip_message_init(&sip);
+
+  if (osip_message_parse_with_wire(sip, msg, length, 0) != OSIP_SUCCESS) {
+    osip_message_free(sip);
+    return 0;
+  }
+
+  if (test_clone(filename, sip) < 0)
+    failed = -1;
+
+  /* sip is released by test_clone_with_wire */
+  if (test_clone_with_wire(filename, sip) < 0)
+    failed = -1;
+
+  return failed;
+}
+
+/* same message with CRLF line ends */
+static char *to_crlf(const char *msg, size_t *length) {
+  char *dest = (char *) osip_malloc(2 * *length + 1);
+  size_t k;
+  size_t n = 0;
+
+  for (k = 0; k < *length; k++) {
+    if (msg[k] == '\n' && (k == 0 || msg[k - 1] != '\r'))
+      dest[n++] = '\r';
+
+    dest[n++] = msg[k];
+  }
+
+  dest[n] = '\0';
+  *length = n;
+  return dest;
+}
+
+static char *read_message(const char *filename, size_t *length) {
+  FILE *file;
+  char *msg;
+
+  file = fopen(filename, "r");
+
+  if (file == NULL)
+    return NULL;
+
+  msg = (char *) osip_malloc(100000); /* msg are under 100000 */
+  *length = fread(msg, 1, 99999, file);
+  msg[*length] = '\0';
+  fclose(file);
+  return msg;
+}
+
+int main(int argc, char **argv) {
+  char filename[1024];
+  char *msg;
+  char *crlf;
+  size_t length;
+  int tested = 0;
+  int failed = 0;
+  int i;
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: ./tclone res_directory\n");
+    exit(1);
+  }
+
+  parser_init();
+
+  for (i = 0;; i++) {
+    snprintf(filename, sizeof(filename), "%s/sip%i", argv[1], i);
+    msg = read_message(filename, &length);
+
+    if (msg == NULL)
+      break;
+
+    if (test_message(filename, msg, length) < 0)
+      failed++;
+
+    else {
+      crlf = to_crlf(msg, &length);
+
+      if (test_message(filename, crlf, length) < 0)
+        failed++;
+
+      osip_free(crlf);
+    }
+
+    tested++;
+    osip_free(msg);
+  }
+
+  fprintf(stdout, "tclone: %i messages, %i failed\n", tested, failed);
+  return (tested == 0 || failed != 0) ? 1 : 0;
+}
@@ -0,0 +1,305 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osipparser2/internal.h>
+#include <osipparser2/osip_port.h>
+#include <osipparser2/osip_parser.h>
+
+#if !defined(WIN32) && !defined(_WIN32_WCE)
+#include <sys/uio.h>
+#endif
+
+/* parse the messages of the res directory, modify them in place and
+   check the modifications are found in the serialized message. */
+
+#define EDIT_TAG "edit-tag"
+#define EDIT_RECEIVED "192.0.2.7"
+#define EDIT_USERNAME "edituser"
+#define EDIT_HVALUE "edited-value"
+
+static int edit_message(osip_message_t *sip, int report) {
+  osip_generic_param_t *tag = NULL;
+  osip_via_t *via;
+  osip_header_t *header;
+  int edits = 0;
+
+  if (sip->to != NULL) {
+    osip_to_get_tag(sip->to, &tag);
+
+    if (tag != NULL) {
+      osip_free(tag->gvalue);
+      tag->gvalue = osip_strdup(EDIT_TAG);
+
+    } else
+      osip_to_set_tag(sip->to, osip_strdup(EDIT_TAG));
+
+    if (report)
+      osip_message_force_update_header(sip, sip->to);
+
+    edits |= 1;
+  }
+
+  via = (osip_via_t *) osip_list_get(&sip->vias, 0);
+
+  if (via != NULL) {
+    osip_via_set_received(via, osip_strdup(EDIT_RECEIVED));
+
+    if (report)
+      osip_message_force_update_header(sip, via);
+
+    edits |= 2;
+  }
+
+  if (sip->from != NULL && sip->from->url != NULL && sip->from->url->host != NULL && sip->from->url->username != NULL) {
+    osip_free(sip->from->url->username);
+    osip_uri_set_username(sip->from->url, osip_strdup(EDIT_USERNAME));
+
+    if (report)
+      osip_message_force_update_header(sip, sip->from);
+
+    edits |= 4;
+  }
+
+  header = (osip_header_t *) osip_list_get(&sip->headers, 0);
+
+  if (header != NULL) {
+    osip_free(header->hvalue);
+    header->hvalue = osip_strdup(EDIT_HVALUE);
+
+    if (report)
+      osip_message_force_update_header(sip, header);
+
+    edits |= 8;
+  }
+
+  return edits;
+}
+
+static int check_edits(const char *name, const char *what, const char *msg, size_t length, int edits) {
+  osip_message_t *sip;
+  osip_generic_param_t *tag = NULL;
+  int i;
+
+  if ((edits & 1) && strstr(msg, EDIT_TAG) == NULL) {
+    fprintf(stdout, "%s: %s: To tag lost\n", name, what);
+    return -1;
+  }
+
+  if ((edits & 2) && strstr(msg, EDIT_RECEIVED) == NULL) {
+    fprintf(stdout, "%s: %s: Via received lost\n", name, what);
+    return -1;
+  }
+
+  if ((edits & 4) && strstr(msg, EDIT_USERNAME) == NULL) {
+    fprintf(stdout, "%s: %s: From username lost\n", name, what);
+    return -1;
+  }
+
+  if ((edits & 8) && strstr(msg, EDIT_HVALUE) == NULL) {
+    fprintf(stdout, "%s: %s: header value lost\n", name, what);
+    return -1;
+  }
+
+  /* the result is a valid message with the modified To */
+  osip_message_init(&sip);
+  i = osip_message_parse(sip, msg, length);
+
+  if (i == OSIP_SUCCESS && (edits & 1)) {
+    osip_to_get_tag(sip->to, &tag);
+
+    if (tag == NULL || tag->gvalue == NULL || strcmp(tag->gvalue, EDIT_TAG) != 0)
+      i = OSIP_SYNTAXERROR;
+  }
+
+  osip_message_free(sip);
+
+  if (i != OSIP_SUCCESS) {
+    fprintf(stdout, "%s: %s: cannot parse the result again\n", name, what);
+    return -1;
+  }
+
+  return OSIP_SUCCESS;
+}
+
+static int test_edit(const char *name, const char *buf, size_t length, int wire) {
+  osip_message_t *sip;
+  char *dest = NULL;
+  char *dest2;
+  size_t dest_length;
+  size_t dest2_length;
+  int edits;
+  int i;
+
+  osip_message_init(&sip);
+
+  if (wire)
+    i = osip_message_parse_with_wire(sip, buf, length, 0);
+
+  else
+    i = osip_message_parse(sip, buf, length);
+
+  if (i != OSIP_SUCCESS) {
+    osip_message_free(sip);
+    return 1; /* not a valid message: nothing to edit */
+  }
+
+  /* osip_message_to_str and osip_message_to_buf need no report */
+  edits = edit_message(sip, 0);
+
+  i = osip_message_to_str(sip, &dest, &dest_length);
+
+  if (i != OSIP_SUCCESS) {
+    fprintf(stdout, "%s: osip_message_to_str failed\n", name);
+    osip_message_free(sip);
+    return -1;
+  }
+
+  i = check_edits(name, wire ? "to_str (wire)" : "to_str", dest, dest_length, edits);
+
+  if (i == OSIP_SUCCESS) {
+    osip_message_to_buf(sip, NULL, 0, &dest2_length);
+    dest2 = (char *) osip_malloc(dest2_length + 1);
+    i = osip_message_to_buf(sip, dest2, dest2_length + 1, &dest2_length);
+
+    if (i != OSIP_SUCCESS || dest2_length != dest_length || memcmp(dest, dest2, dest_length) != 0) {
+      fprintf(stdout, "%s: osip_message_to_buf differs from osip_message_to_str\n", name);
+      i = -1;
+    }
+
+    osip_free(dest2);
+  }
+
+  osip_free(dest);
+  osip_message_free(sip);
+  return i;
+}
+
+#if !defined(WIN32) && !defined(_WIN32_WCE)
+static int test_edit_iovec(const char *name, const char *buf, size_t length) {
+  osip_message_t *sip;
+  struct iovec iov[256];
+  int iovcnt = 256;
+  char *hbuf;
+  char *dest;
+  size_t dest_length = 0;
+  int edits;
+  int pos;
+  int i;
+
+  osip_message_init(&sip);
+  i = osip_message_parse_with_wire(sip, buf, length, 0);
+
+  if (i != OSIP_SUCCESS) {
+    osip_message_free(sip);
+    return 1;
+  }
+
+  edits = edit_message(sip, 1);
+
+  hbuf = (char *) osip_malloc(length + 4096);
+  i = osip_message_to_iovec(sip, iov, &iovcnt, hbuf, length + 4096);
+
+  if (i != OSIP_SUCCESS) {
+    fprintf(stdout, "%s: osip_message_to_iovec failed\n", name);
+    osip_free(hbuf);
+    osip_message_free(sip);
+    return -1;
+  }
+
+  for (pos = 0; pos < iovcnt; pos++)
+    dest_length += iov[pos].iov_len;
+
+  dest = (char *) osip_malloc(dest_length + 1);
+  dest_length = 0;
+
+  for (pos = 0; pos < iovcnt; pos++) {
+    memcpy(dest + dest_length, iov[pos].iov_base, iov[pos].iov_len);
+    dest_length += iov[pos].iov_len;
+  }
+
+  dest[dest_length] = '\0';
+
+  i = check_edits(name, "to_iovec", dest, dest_length, edits);
+
+  osip_free(dest);
+  osip_free(hbuf);
+  osip_message_free(sip);
+  return i;
+}
+#endif
+
+static char *read_message(const char *filename, size_t *length) {
+  FILE *file;
+  char *msg;
+
+  file = fopen(filename, "r");
+
+  if (file == NULL)
+    return NULL;
+
+  msg = (char *) osip_malloc(100000); /* msg are under 100000 */
+  *length = fread(msg, 1, 99999, file);
+  msg[*length] = '\0';
+  fclose(file);
+  return msg;
+}
+
+int main(int argc, char **argv) {
+  char filename[1024];
+  char *msg;
+  size_t length;
+  int tested = 0;
+  int failed = 0;
+  int i;
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: ./tedit res_directory\n");
+    exit(1);
+  }
+
+  parser_init();
+
+  for (i = 0;; i++) {
+    snprintf(filename, sizeof(filename), "%s/sip%i", argv[1], i);
+    msg = read_message(filename, &length);
+
+    if (msg == NULL)
+      break;
+
+    if (test_edit(filename, msg, length, 0) < 0)
+      failed++;
+
+    if (test_edit(filename, msg, length, 1) < 0)
+      failed++;
+
+#if !defined(WIN32) && !defined(_WIN32_WCE)
+    if (test_edit_iovec(filename, msg, length) < 0)
+      failed++;
+#endif
+    tested++;
+    osip_free(msg);
+  }
+
+  fprintf(stdout, "tedit: %i messages, %i failed\n", tested, failed);
+  return (tested == 0 || failed != 0) ? 1 : 0;
+}
@@ -0,0 +1,178 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osipparser2/internal.h>
+#include <osipparser2/osip_port.h>
+#include <osipparser2/osip_parser.h>
+
+#include "parser.h"
+
+/* check the search of line ends: CR, LF and NUL at every offset and
+   alignment, random lines compared to a byte per byte search, and
+   folded headers at every offset of a message. */
+
+/* byte per byte version of __osip_find_next_crlf */
+static int find_next_crlf(const char *start_of_header, const char **end_of_header) {
+  const char *soh = start_of_header;
+
+  *end_of_header = NULL;
+
+  while ('\r' != *soh && '\n' != *soh) {
+    if ('\0' == *soh)
+      return OSIP_SYNTAXERROR;
+
+    soh++;
+  }
+
+  if ('\r' == soh[0] && '\n' == soh[1])
+    soh++;
+
+  if (' ' == soh[1] || '\t' == soh[1])
+    return -2;
+
+  *end_of_header = soh + 1;
+  return OSIP_SUCCESS;
+}
+
+static int compare(const char *buf, const char *description) {
+  const char *end1;
+  const char *end2;
+  int i = __osip_find_next_crlf(buf, &end1);
+  int j = find_next_crlf(buf, &end2);
+
+  if (i == j && end1 == end2)
+    return 0;
+
+  fprintf(stdout, "teol: %s: %i instead of %i\n", description, i, j);
+  return 1;
+}
+
+static int test_offsets(void) {
+  static const char *ends[] = {"\r\n", "\r", "\n", "", "\r\n ", "\n\t"};
+  char buf[160];
+  int failed = 0;
+  int align;
+  int offset;
+  int k;
+
+  for (align = 0; align < 16; align++) {
+    for (offset = 0; offset < 100; offset++) {
+      for (k = 0; k < 6; k++) {
+        char *p = buf + align;
+
+        memset(p, 'a', offset);
+        strcpy(p + offset, ends[k]);
+        strcat(p + offset, "b");
+
+        if (ends[k][0] == '\0')
+          p[offset] = '\0';
+
+        failed += compare(p, "line end at every offset");
+      }
+    }
+  }
+
+  return failed;
+}
+
+static int test_random(void) {
+  static const char alphabet[] = "ab:\r\n \t";
+  char buf[100];
+  int failed = 0;
+  int step;
+
+  for (step = 0; step < 200000 && failed < 10; step++) {
+    int length = rand() % 80;
+    int k;
+
+    for (k = 0; k < length; k++)
+      buf[k] = alphabet[rand() % 7];
+
+    buf[length] = '\0';
+    failed += compare(buf + (length ? rand() % (length + 1) : 0), "random line");
+  }
+
+  return failed;
+}
+
+/* a folded header gives the same value as a header on one line */
+static int test_folding(void) {
+  static const char *format = "OPTIONS sip:bob@b.com SIP/2.0\r\nVia: SIP/2.0/UDP h1.com;branch=z9hG4bK1\r\nCall-ID: c1@h1.com\r\nX-%s: %s%s%s\r\nCSeq: 1 OPTIONS\r\nContent-Length: 0\r\n\r\n";
+  static const char *folds[] = {"\r\n ", "\r\n\t", "\n ", "\r\n \t  "};
+  char name[64];
+  char value[64];
+  char buf[512];
+  int failed = 0;
+  int length;
+  int k;
+
+  for (length = 0; length < 40; length++) {
+    for (k = 0; k < 4; k++) {
+      osip_message_t *sip;
+      osip_header_t *header = NULL;
+
+      memset(name, 'n', length + 1);
+      name[length + 1] = '\0';
+      memset(value, 'v', length);
+      value[length] = '\0';
+      snprintf(buf, sizeof(buf), format, name, value, folds[k], "end");
+
+      osip_message_init(&sip);
+
+      if (osip_message_parse(sip, buf, strlen(buf)) != OSIP_SUCCESS || sip->cseq == NULL) {
+        fprintf(stdout, "teol: folded header not parsed\n");
+        failed++;
+
+      } else {
+        char hname[80];
+
+        /* unknown headers are stored lowercase */
+        snprintf(hname, sizeof(hname), "x-%s", name);
+        osip_message_header_get_byname(sip, hname, 0, &header);
+
+        if (header == NULL || header->hvalue == NULL || strncmp(header->hvalue, value, length) != 0 || strcmp(header->hvalue + strlen(header->hvalue) - 3, "end") != 0) {
+          fprintf(stdout, "teol: wrong value for a folded header (%i bytes)\n", length);
+          failed++;
+        }
+      }
+
+      osip_message_free(sip);
+    }
+  }
+
+  return failed;
+}
+
+int main(int argc, char **argv) {
+  int failed = 0;
+
+  srand(1);
+  parser_init();
+
+  failed += test_offsets();
+  failed += test_random();
+  failed += test_folding();
+
+  fprintf(stdout, "teol: %s\n", failed ? "FAILED" : "OK");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,221 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osip2/internal.h>
+#include <osip2/osip.h>
+#include <osip2/osip_mt.h>
+
+/* check osip_executor_t: events added by several threads are all
+   processed, in order, and the events of a transaction are never
+   processed by two threads at the same time. Transactions are freed
+   from the kill callback, in the threads of the executor. */
+
+#define NB_TRANSACTIONS 500
+#define NB_PRODUCERS 4
+#define NB_WORKERS 4
+
+static const char *request_format = "OPTIONS sip:bob@b.com SIP/2.0\r\nVia: SIP/2.0/TCP h1.com;branch=z9hG4bK%i\r\nFrom: <sip:a@a.com>;tag=%i\r\nTo: <sip:bob@b.com>\r\nCall-ID: c%i@h1.com\r\nCSeq: 1 OPTIONS\r\nContent-Length: 0\r\n\r\n";
+static const char *response_format = "SIP/2.0 %i OK\r\nVia: SIP/2.0/TCP h1.com;branch=z9hG4bK%i\r\nFrom: <sip:a@a.com>;tag=%i\r\nTo: <sip:bob@b.com>;tag=x\r\nCall-ID: c%i@h1.com\r\nCSeq: 1 OPTIONS\r\nContent-Length: 0\r\n\r\n";
+
+static osip_transaction_t *transactions[NB_TRANSACTIONS];
+static int inside[NB_TRANSACTIONS];
+static int nb_1xx[NB_TRANSACTIONS];
+static int nb_2xx[NB_TRANSACTIONS];
+static int nb_killed;
+static int nb_concurrent;
+static int nb_disordered;
+static struct osip_mutex *mutex;
+
+static int transaction_index(osip_transaction_t *tr) {
+  return (int) (long) osip_transaction_get_your_instance(tr);
+}
+
+static void enter(int i) {
+  osip_mutex_lock(mutex);
+
+  if (inside[i]++ != 0)
+    nb_concurrent++;
+
+  osip_mutex_unlock(mutex);
+
+  /* give other threads a chance to run the same transaction */
+  osip_usleep(20);
+}
+
+static void leave(int i) {
+  osip_mutex_lock(mutex);
+  inside[i]--;
+  osip_mutex_unlock(mutex);
+}
+
+static int cb_send_message(osip_transaction_t *tr, osip_message_t *sip, char *host, int port, int out_socket) {
+  return OSIP_SUCCESS;
+}
+
+static void cb_rcv1xx(int type, osip_transaction_t *tr, osip_message_t *sip) {
+  int i = transaction_index(tr);
+
+  enter(i);
+
+  if (nb_2xx[i] != 0)
+    nb_disordered++;
+
+  nb_1xx[i]++;
+  leave(i);
+}
+
+static void cb_rcv2xx(int type, osip_transaction_t *tr, osip_message_t *sip) {
+  int i = transaction_index(tr);
+
+  enter(i);
+
+  if (nb_1xx[i] != 3)
+    nb_disordered++;
+
+  nb_2xx[i]++;
+  leave(i);
+}
+
+static void cb_killed(int type, osip_transaction_t *tr) {
+  int i = transaction_index(tr);
+
+  enter(i);
+  leave(i);
+
+  osip_mutex_lock(mutex);
+  nb_killed++;
+  osip_mutex_unlock(mutex);
+
+  osip_transaction_free(tr);
+}
+
+static int get_killed(void) {
+  int i;
+
+  osip_mutex_lock(mutex);
+  i = nb_killed;
+  osip_mutex_unlock(mutex);
+  return i;
+}
+
+/* three 1xx and a 2xx for each transaction of this producer */
+static void *producer(void *arg) {
+  int i;
+
+  for (i = (int) (long) arg; i < NB_TRANSACTIONS; i += NB_PRODUCERS) {
+    int k;
+
+    for (k = 0; k < 4; k++) {
+      char buf[1024];
+
+      snprintf(buf, sizeof(buf), response_format, k < 3 ? 180 : 200, i, i, i);
+      osip_transaction_add_event(transactions[i], osip_parse(buf, strlen(buf)));
+    }
+  }
+
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  struct osip_thread *producers[NB_PRODUCERS];
+  osip_executor_t *executor;
+  osip_t *osip;
+  int failed = 0;
+  int loops;
+  int i;
+
+  mutex = osip_mutex_init();
+
+  if (mutex == NULL || osip_init(&osip) != OSIP_SUCCESS)
+    return 1;
+
+  osip_set_cb_send_message(osip, &cb_send_message);
+  osip_set_message_callback(osip, OSIP_NICT_STATUS_1XX_RECEIVED, &cb_rcv1xx);
+  osip_set_message_callback(osip, OSIP_NICT_STATUS_2XX_RECEIVED, &cb_rcv2xx);
+  osip_set_kill_transaction_callback(osip, OSIP_NICT_KILL_TRANSACTION, &cb_killed);
+
+  for (i = 0; i < NB_TRANSACTIONS; i++) {
+    osip_message_t *sip;
+    char buf[1024];
+
+    snprintf(buf, sizeof(buf), request_format, i, i, i);
+    osip_message_init(&sip);
+    osip_message_parse(sip, buf, strlen(buf));
+
+    if (osip_transaction_init(&transactions[i], NICT, osip, sip) != OSIP_SUCCESS) {
+      fprintf(stdout, "texec: cannot create transaction %i\n", i);
+      osip_message_free(sip);
+      osip_release(osip);
+      return 1;
+    }
+
+    osip_transaction_set_your_instance(transactions[i], (void *) (long) i);
+    osip_transaction_add_event(transactions[i], osip_new_outgoing_sipmessage(sip));
+  }
+
+  /* the requests are queued before the executor starts */
+  if (osip_executor_init(&executor, osip, NB_WORKERS) != OSIP_SUCCESS) {
+    fprintf(stdout, "texec: cannot start the executor\n");
+    osip_release(osip);
+    return 1;
+  }
+
+  for (i = 0; i < NB_PRODUCERS; i++)
+    producers[i] = osip_thread_create(20000, &producer, (void *) (long) i);
+
+  for (i = 0; i < NB_PRODUCERS; i++) {
+    osip_thread_join(producers[i]);
+    osip_free(producers[i]);
+  }
+
+  /* over TCP, timer K fires at once and kills the transactions */
+  for (loops = 0; get_killed() < NB_TRANSACTIONS && loops < 5000; loops++) {
+    osip_timers_nict_execute(osip);
+    osip_usleep(1000);
+  }
+
+  osip_executor_free(executor);
+
+  if (nb_killed != NB_TRANSACTIONS) {
+    fprintf(stdout, "texec: %i transactions killed instead of %i\n", nb_killed, NB_TRANSACTIONS);
+    failed++;
+  }
+
+  for (i = 0; i < NB_TRANSACTIONS; i++) {
+    if (nb_1xx[i] != 3 || nb_2xx[i] != 1) {
+      fprintf(stdout, "texec: transaction %i: %i 1xx and %i 2xx\n", i, nb_1xx[i], nb_2xx[i]);
+      failed++;
+    }
+  }
+
+  if (nb_concurrent != 0 || nb_disordered != 0) {
+    fprintf(stdout, "texec: %i events processed concurrently and %i out of order\n", nb_concurrent, nb_disordered);
+    failed++;
+  }
+
+  osip_release(osip);
+  osip_mutex_destroy(mutex);
+
+  fprintf(stdout, "texec: %s\n", failed ? "FAILED" : "OK");
+  return failed ? 1 : 0;
+}
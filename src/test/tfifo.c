@@ -0,0 +1,236 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <stddef.h>
+
+#include <osip2/internal.h>
+#include <osip2/osip.h>
+#include <osip2/osip_fifo.h>
+#include <osip2/osip_mt.h>
+
+/* check osip_fifo_t against a model, and with several threads
+   (in both modes: see osip_fifo_init_lockfree). */
+
+#define MODEL_SIZE 4096
+#define NB_THREADS 4
+#define NB_ELEMENTS 100000
+
+/* circular buffer: elements are added at the end and inserted at the beginning */
+static int test_model(void) {
+  static long model[3 * MODEL_SIZE];
+  int first = MODEL_SIZE;
+  int last = MODEL_SIZE;
+  osip_fifo_t *ff;
+  long value = 1;
+  int failed = 0;
+  int step;
+
+  ff = (osip_fifo_t *) osip_malloc(sizeof(osip_fifo_t));
+  osip_fifo_init(ff);
+
+  for (step = 0; step < 200000 && failed == 0; step++) {
+    int op = rand() % 10;
+
+    if (op < 4) {
+      osip_fifo_add(ff, (void *) value);
+      model[last++] = value++;
+
+    } else if (op < 5) {
+      osip_fifo_insert(ff, (void *) value);
+      model[--first] = value++;
+
+    } else {
+      long element = (long) osip_fifo_tryget(ff);
+      long expected = (first < last) ? model[first++] : 0;
+
+      if (element != expected) {
+        fprintf(stdout, "tfifo: got %li instead of %li\n", element, expected);
+        failed++;
+      }
+    }
+
+    if (osip_fifo_size(ff) != last - first) {
+      fprintf(stdout, "tfifo: size %i instead of %i\n", osip_fifo_size(ff), last - first);
+      failed++;
+    }
+
+    /* empty the fifo before the model overflows */
+    if (first < 100 || last > 3 * MODEL_SIZE - 100) {
+      while (first < last && failed == 0) {
+        if ((long) osip_fifo_tryget(ff) != model[first++])
+          failed++;
+      }
+
+      first = last = MODEL_SIZE;
+    }
+  }
+
+  osip_fifo_free(ff);
+  return failed;
+}
+
+#ifndef OSIP_MONOTHREAD
+static osip_fifo_t *shared_fifo;
+static long totals[NB_THREADS];
+
+static void *producer(void *arg) {
+  long i;
+
+  for (i = 1; i <= NB_ELEMENTS; i++)
+    osip_fifo_add(shared_fifo, (void *) i);
+
+  return NULL;
+}
+
+static void *consumer(void *arg) {
+  long *total = (long *) arg;
+  long i;
+
+  for (i = 0; i < NB_ELEMENTS; i++)
+    *total += (long) osip_fifo_get(shared_fifo);
+
+  return NULL;
+}
+
+/* consumers block in osip_fifo_get until producers add elements */
+static int test_threads(void) {
+  struct osip_thread *producers[NB_THREADS];
+  struct osip_thread *consumers[NB_THREADS];
+  long total = 0;
+  int i;
+
+  shared_fifo = (osip_fifo_t *) osip_malloc(sizeof(osip_fifo_t));
+  osip_fifo_init(shared_fifo);
+
+  for (i = 0; i < NB_THREADS; i++)
+    consumers[i] = osip_thread_create(20000, &consumer, &totals[i]);
+
+  for (i = 0; i < NB_THREADS; i++)
+    producers[i] = osip_thread_create(20000, &producer, NULL);
+
+  for (i = 0; i < NB_THREADS; i++) {
+    osip_thread_join(producers[i]);
+    osip_free(producers[i]);
+    osip_thread_join(consumers[i]);
+    osip_free(consumers[i]);
+    total += totals[i];
+  }
+
+  if (total != (long) NB_THREADS * NB_ELEMENTS * (NB_ELEMENTS + 1) / 2 || osip_fifo_size(shared_fifo) != 0) {
+    fprintf(stdout, "tfifo: elements lost with %i threads\n", NB_THREADS);
+    osip_fifo_free(shared_fifo);
+    return 1;
+  }
+
+  osip_fifo_free(shared_fifo);
+  return 0;
+}
+
+typedef struct {
+  long value;
+  void *link;
+} lockfree_element_t;
+
+static lockfree_element_t lockfree_elements[NB_THREADS][NB_ELEMENTS];
+
+static void *lockfree_producer(void *arg) {
+  long thread = (long) arg;
+  long i;
+
+  for (i = 0; i < NB_ELEMENTS; i++) {
+    lockfree_elements[thread][i].value = thread * NB_ELEMENTS + i;
+    osip_fifo_add(shared_fifo, &lockfree_elements[thread][i]);
+  }
+
+  return NULL;
+}
+
+/* several writers and one reader: the elements of each writer are
+   received in order, with a blocking or a non blocking reader */
+static int test_lockfree(int blocking) {
+  struct osip_thread *producers[NB_THREADS];
+  long last[NB_THREADS];
+  int failed = 0;
+  long n;
+  int i;
+
+  shared_fifo = (osip_fifo_t *) osip_malloc(sizeof(osip_fifo_t));
+  osip_fifo_init_lockfree(shared_fifo, (int) offsetof(lockfree_element_t, link));
+
+  for (i = 0; i < NB_THREADS; i++) {
+    last[i] = -1;
+    producers[i] = osip_thread_create(20000, &lockfree_producer, (void *) (long) i);
+  }
+
+  for (n = 0; n < (long) NB_THREADS * NB_ELEMENTS && failed == 0;) {
+    lockfree_element_t *element = (lockfree_element_t *) (blocking ? osip_fifo_get(shared_fifo) : osip_fifo_tryget(shared_fifo));
+    long thread;
+
+    if (element == NULL) {
+      if (blocking)
+        failed++;
+
+      continue;
+    }
+
+    thread = element->value / NB_ELEMENTS;
+
+    if (element->value % NB_ELEMENTS != last[thread] + 1) {
+      fprintf(stdout, "tfifo: element %li received after %li\n", element->value % NB_ELEMENTS, last[thread]);
+      failed++;
+    }
+
+    last[thread] = element->value % NB_ELEMENTS;
+    n++;
+  }
+
+  for (i = 0; i < NB_THREADS; i++) {
+    osip_thread_join(producers[i]);
+    osip_free(producers[i]);
+  }
+
+  if (osip_fifo_tryget(shared_fifo) != NULL || osip_fifo_size(shared_fifo) != 0) {
+    fprintf(stdout, "tfifo: lock-free fifo not empty\n");
+    failed++;
+  }
+
+  osip_fifo_free(shared_fifo);
+  return failed;
+}
+#endif
+
+int main(int argc, char **argv) {
+  int failed = 0;
+
+  srand(7);
+
+  failed += test_model();
+#ifndef OSIP_MONOTHREAD
+  failed += test_threads();
+  failed += test_lockfree(1);
+  failed += test_lockfree(0);
+#endif
+
+  fprintf(stdout, "tfifo: %s\n", failed ? "FAILED" : "OK");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,226 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osip2/internal.h>
+#include <osip2/osip.h>
+
+#include "fsm.h"
+
+extern osip_statemachine_t ict_fsm;
+extern osip_statemachine_t ist_fsm;
+extern osip_statemachine_t nict_fsm;
+extern osip_statemachine_t nist_fsm;
+
+/* check the dispatch tables of the statemachines: each entry is the
+   first transition defined for its state and event type, and
+   transactions go through their states as with the transitions. */
+
+static const char *invite = "INVITE sip:bob@b.com SIP/2.0\r\nVia: SIP/2.0/UDP h1.com;branch=z9hG4bK1\r\nFrom: <sip:a@a.com>;tag=1\r\nTo: <sip:bob@b.com>\r\nCall-ID: c1@h1.com\r\nCSeq: 1 INVITE\r\nContent-Length: 0\r\n\r\n";
+static const char *options = "OPTIONS sip:bob@b.com SIP/2.0\r\nVia: SIP/2.0/UDP h1.com;branch=z9hG4bK2\r\nFrom: <sip:a@a.com>;tag=2\r\nTo: <sip:bob@b.com>\r\nCall-ID: c2@h1.com\r\nCSeq: 1 OPTIONS\r\nContent-Length: 0\r\n\r\n";
+static const char *response_format = "SIP/2.0 %i OK\r\nVia: SIP/2.0/UDP h1.com;branch=z9hG4bK%i\r\nFrom: <sip:a@a.com>;tag=%i\r\nTo: <sip:bob@b.com>;tag=x\r\nCall-ID: c%i@h1.com\r\nCSeq: 1 %s\r\nContent-Length: 0\r\n\r\n";
+
+static int nb_callbacks[OSIP_MESSAGE_CALLBACK_COUNT];
+static int nb_sent;
+
+static int cb_send_message(osip_transaction_t *tr, osip_message_t *sip, char *host, int port, int out_socket) {
+  nb_sent++;
+  return OSIP_SUCCESS;
+}
+
+static void cb_message(int type, osip_transaction_t *tr, osip_message_t *sip) {
+  nb_callbacks[type]++;
+}
+
+static int check_table(const char *name, osip_statemachine_t *statemachine) {
+  transition_t *transition;
+  int failed = 0;
+  int state;
+  int type;
+
+  if (statemachine->loaded == 0) {
+    fprintf(stdout, "tfsm: %s: dispatch table not built\n", name);
+    return 1;
+  }
+
+  for (state = 0; state < OSIP_FSM_NB_STATES; state++) {
+    for (type = 0; type < OSIP_FSM_NB_TYPES; type++) {
+      void (*method)(void *, void *) = NULL;
+
+      for (transition = statemachine->transitions; transition != NULL; transition = transition->next) {
+        if ((int) transition->state == state && (int) transition->type == type) {
+          method = transition->method;
+          break;
+        }
+      }
+
+      if (statemachine->methods[state][type] != method) {
+        fprintf(stdout, "tfsm: %s: wrong method for state %i and event %i\n", name, state, type);
+        failed++;
+      }
+    }
+  }
+
+  return failed;
+}
+
+static osip_event_t *new_response(int code, int i, const char *method) {
+  char buf[1024];
+
+  snprintf(buf, sizeof(buf), response_format, code, i, i, i, method);
+  return osip_parse(buf, strlen(buf));
+}
+
+static int check_state(const char *step, osip_transaction_t *tr, state_t state) {
+  if (tr->state == state)
+    return 0;
+
+  fprintf(stdout, "tfsm: %s: state %i instead of %i\n", step, tr->state, state);
+  return 1;
+}
+
+static int check_count(const char *step, int type, int expected) {
+  if (nb_callbacks[type] == expected)
+    return 0;
+
+  fprintf(stdout, "tfsm: %s: callback %i called %i times instead of %i\n", step, type, nb_callbacks[type], expected);
+  return 1;
+}
+
+/* INVITE, 180, 486 and the 486 again */
+static int test_ict(osip_t *osip) {
+  osip_transaction_t *ict;
+  osip_message_t *sip;
+  osip_event_t *evt;
+  int failed = 0;
+
+  osip_message_init(&sip);
+  osip_message_parse(sip, invite, strlen(invite));
+  evt = osip_new_outgoing_sipmessage(sip);
+  ict = osip_create_transaction(osip, evt);
+
+  if (ict == NULL) {
+    osip_message_free(sip);
+    osip_free(evt);
+    return 1;
+  }
+
+  osip_transaction_add_event(ict, evt);
+  osip_ict_execute(osip);
+  failed += check_state("INVITE sent", ict, ICT_CALLING);
+  failed += check_count("INVITE sent", OSIP_ICT_INVITE_SENT, 1);
+
+  osip_transaction_add_event(ict, new_response(180, 1, "INVITE"));
+  osip_ict_execute(osip);
+  failed += check_state("180 received", ict, ICT_PROCEEDING);
+  failed += check_count("180 received", OSIP_ICT_STATUS_1XX_RECEIVED, 1);
+
+  osip_transaction_add_event(ict, new_response(486, 1, "INVITE"));
+  osip_ict_execute(osip);
+  failed += check_state("486 received", ict, ICT_COMPLETED);
+  failed += check_count("486 received", OSIP_ICT_STATUS_4XX_RECEIVED, 1);
+  failed += check_count("486 received", OSIP_ICT_ACK_SENT, 1);
+
+  /* no transition for a 1xx in the completed state: discarded */
+  osip_transaction_add_event(ict, new_response(180, 1, "INVITE"));
+  osip_ict_execute(osip);
+  failed += check_state("late 180 received", ict, ICT_COMPLETED);
+  failed += check_count("late 180 received", OSIP_ICT_STATUS_1XX_RECEIVED, 1);
+
+  osip_transaction_add_event(ict, new_response(486, 1, "INVITE"));
+  osip_ict_execute(osip);
+  failed += check_state("486 received again", ict, ICT_COMPLETED);
+  failed += check_count("486 received again", OSIP_ICT_STATUS_3456XX_RECEIVED_AGAIN, 1);
+  failed += check_count("486 received again", OSIP_ICT_ACK_SENT_AGAIN, 1);
+
+  osip_transaction_free(ict);
+  return failed;
+}
+
+/* OPTIONS, 200 and the OPTIONS again */
+static int test_nist(osip_t *osip) {
+  osip_transaction_t *nist;
+  osip_event_t *evt;
+  int failed = 0;
+
+  evt = osip_parse(options, strlen(options));
+  nist = osip_create_transaction(osip, evt);
+
+  if (nist == NULL) {
+    osip_event_free(evt);
+    return 1;
+  }
+
+  osip_transaction_add_event(nist, evt);
+  osip_nist_execute(osip);
+  failed += check_state("OPTIONS received", nist, NIST_TRYING);
+  failed += check_count("OPTIONS received", OSIP_NIST_OPTIONS_RECEIVED, 1);
+
+  evt = new_response(200, 2, "OPTIONS");
+  evt->type = SND_STATUS_2XX;
+  osip_transaction_add_event(nist, evt);
+  osip_nist_execute(osip);
+  failed += check_state("200 sent", nist, NIST_COMPLETED);
+  failed += check_count("200 sent", OSIP_NIST_STATUS_2XX_SENT, 1);
+
+  evt = osip_parse(options, strlen(options));
+  osip_transaction_add_event(nist, evt);
+  osip_nist_execute(osip);
+  failed += check_state("OPTIONS received again", nist, NIST_COMPLETED);
+  failed += check_count("OPTIONS received again", OSIP_NIST_STATUS_2XX_SENT_AGAIN, 1);
+
+  osip_transaction_free(nist);
+  return failed;
+}
+
+int main(int argc, char **argv) {
+  osip_t *osip;
+  int failed = 0;
+  int i;
+
+  /* the dispatch tables are built by osip_init */
+  if (osip_init(&osip) != OSIP_SUCCESS)
+    return 1;
+
+  failed += check_table("ict", &ict_fsm);
+  failed += check_table("ist", &ist_fsm);
+  failed += check_table("nict", &nict_fsm);
+  failed += check_table("nist", &nist_fsm);
+
+  osip_set_cb_send_message(osip, &cb_send_message);
+
+  for (i = 0; i < OSIP_MESSAGE_CALLBACK_COUNT; i++)
+    osip_set_message_callback(osip, i, &cb_message);
+
+  failed += test_ict(osip);
+  failed += test_nist(osip);
+
+  if (nb_sent != 5) {
+    fprintf(stdout, "tfsm: %i messages sent instead of 5\n", nb_sent);
+    failed++;
+  }
+
+  osip_release(osip);
+
+  fprintf(stdout, "tfsm: %s\n", failed ? "FAILED" : "OK");
+  return failed ? 1 : 0;
+}
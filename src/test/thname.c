@@ -0,0 +1,151 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osipparser2/internal.h>
+#include <osipparser2/osip_port.h>
+#include <osipparser2/osip_parser.h>
+
+#include "parser.h"
+
+/* check the resolution of header names: any case, long and compact
+   forms, comma separated headers, unknown names close to known ones
+   and headers added with parser_add_comma_separated_header. */
+
+typedef struct {
+  const char *hname;
+  int known;
+  int comma;
+} hname_test_t;
+
+static const hname_test_t names[] = {
+    {"Via", 1, 1},          {"v", 1, 1},           {"Call-ID", 1, 0},          {"i", 1, 0},         {"Contact", 1, 1}, {"m", 1, 1},        {"Content-Length", 1, 0}, {"l", 1, 0},
+    {"Content-Type", 1, 0}, {"c", 1, 0},           {"From", 1, 0},             {"f", 1, 0},         {"To", 1, 0},      {"t", 1, 0},        {"CSeq", 1, 0},           {"Route", 1, 1},
+    {"Record-Route", 1, 1}, {"Allow", 1, 1},       {"WWW-Authenticate", 1, 0}, {"Supported", 0, 1}, {"k", 0, 1},       {"Subject", 0, 0},  {"Vias", 0, 0},           {"Vi", 0, 0},
+    {"Via ", 0, 0},         {"Call-I", 0, 0},      {"X-Foo", 0, 0},            {"", 0, 0},          {"Cont", 0, 0},    {"Contact-X", 0, 0}};
+
+/* same name with a random case */
+static void random_case(const char *hname, char *dest) {
+  for (; *hname != '\0'; hname++, dest++) {
+    *dest = *hname;
+
+    if (rand() % 2)
+      *dest = (char) ((*dest >= 'a' && *dest <= 'z') ? *dest - 32 : (*dest >= 'A' && *dest <= 'Z') ? *dest + 32 : *dest);
+  }
+
+  *dest = '\0';
+}
+
+static int test_names(void) {
+  int failed = 0;
+  size_t i;
+
+  for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    int index;
+    int comma;
+    int k;
+
+    index = __osip_message_lookup_header(names[i].hname, &comma);
+
+    if ((index >= 0) != names[i].known || comma != names[i].comma) {
+      fprintf(stdout, "thname: \"%s\": index %i, comma %i\n", names[i].hname, index, comma);
+      failed++;
+      continue;
+    }
+
+    for (k = 0; k < 20; k++) {
+      char hname[64];
+      int comma2;
+
+      random_case(names[i].hname, hname);
+
+      if (__osip_message_lookup_header(hname, &comma2) != index || comma2 != comma) {
+        fprintf(stdout, "thname: \"%s\" not resolved as \"%s\"\n", hname, names[i].hname);
+        failed++;
+      }
+    }
+
+    if ((__osip_message_is_header_comma_separated(names[i].hname) == OSIP_SUCCESS) != comma || __osip_message_is_known_header(names[i].hname) != index) {
+      fprintf(stdout, "thname: \"%s\" resolved differently\n", names[i].hname);
+      failed++;
+    }
+  }
+
+  return failed;
+}
+
+static int test_message(void) {
+  const char *msg = "INVITE sip:a@b.com SIP/2.0\r\nVIA: SIP/2.0/UDP h1.com;branch=z9hG4bK1, SIP/2.0/UDP h2.com\r\nX-FOO: a, b\r\nX-Bar: c, d\r\nCALL-id: c1\r\nl: 0\r\n\r\n";
+  osip_message_t *sip;
+  osip_header_t *header;
+  int failed = 0;
+  int comma;
+
+  if (__osip_message_lookup_header("X-Foo", &comma) != -1 || comma != 0) {
+    fprintf(stdout, "thname: X-Foo already comma separated\n");
+    failed++;
+  }
+
+  parser_add_comma_separated_header("X-Foo");
+
+  if (__osip_message_lookup_header("x-FOO", &comma) != -1 || comma != 1) {
+    fprintf(stdout, "thname: X-Foo not comma separated\n");
+    failed++;
+  }
+
+  osip_message_init(&sip);
+
+  if (osip_message_parse(sip, msg, strlen(msg)) != OSIP_SUCCESS) {
+    fprintf(stdout, "thname: cannot parse the message\n");
+    osip_message_free(sip);
+    return failed + 1;
+  }
+
+  if (osip_list_size(&sip->vias) != 2 || sip->call_id == NULL || sip->content_length == NULL) {
+    fprintf(stdout, "thname: known headers not decoded\n");
+    failed++;
+  }
+
+  /* x-foo is split, x-bar is not */
+  header = (osip_header_t *) osip_list_get(&sip->headers, 0);
+
+  if (osip_list_size(&sip->headers) != 3 || strcmp(header->hname, "x-foo") != 0 || strcmp(header->hvalue, "a") != 0) {
+    fprintf(stdout, "thname: unknown headers not stored as expected\n");
+    failed++;
+  }
+
+  osip_message_free(sip);
+  return failed;
+}
+
+int main(int argc, char **argv) {
+  int failed = 0;
+
+  srand(5);
+  parser_init();
+
+  failed += test_names();
+  failed += test_message();
+
+  fprintf(stdout, "thname: %s\n", failed ? "FAILED" : "OK");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,263 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <stdarg.h>
+
+#include <osip2/internal.h>
+#include <osip2/osip.h>
+
+#include "xixt.h"
+
+/* check the transaction index: the transactions found with the index
+   must be the ones found by the matching rules of rfc3261 (a linear
+   scan of a copy of the list of transactions). */
+
+#define NB_ELEMENTS 1000
+#define NB_TRANSACTIONS 400
+#define NB_LOOKUPS 4000
+
+static const char *request_format = "%s sip:bob@b.com SIP/2.0\r\nVia: SIP/2.0/UDP %s;branch=%s\r\nFrom: <sip:a@a.com>;tag=%s\r\nTo: <sip:bob@b.com>%s\r\nCall-ID: %s\r\nCSeq: %i %s\r\nContent-Length: 0\r\n\r\n";
+static const char *response_format = "SIP/2.0 200 OK\r\nVia: SIP/2.0/UDP %s;branch=%s\r\nFrom: <sip:a@a.com>;tag=%s\r\nTo: <sip:bob@b.com>;tag=x\r\nCall-ID: %s\r\nCSeq: %i %s\r\nContent-Length: 0\r\n\r\n";
+static const char *methods[] = {"INVITE", "OPTIONS", "CANCEL", "BYE"};
+
+static int cb_send_message(osip_transaction_t *tr, osip_message_t *sip, char *host, int port, int out_socket) {
+  return OSIP_SUCCESS;
+}
+
+static int test_index(void) {
+  static int model[NB_ELEMENTS]; /* key of each element, or -1 */
+  osip_index_t *index;
+  int failed = 0;
+  int step;
+  int i;
+
+  if (__osip_index_init(&index) != OSIP_SUCCESS)
+    return -1;
+
+  for (i = 0; i < NB_ELEMENTS; i++)
+    model[i] = -1;
+
+  /* few keys: many elements share the same key */
+  for (step = 0; step < 50000; step++) {
+    int elt = rand() % NB_ELEMENTS;
+    int key = rand() % 300;
+
+    if (model[elt] == -1) {
+      __osip_index_add(index, (unsigned long) key, &model[elt]);
+      model[elt] = key;
+
+    } else if (rand() % 2 == 0) {
+      __osip_index_remove(index, (unsigned long) model[elt], &model[elt]);
+      model[elt] = -1;
+    }
+
+    if (step % 100 == 0) {
+      int expected = 0;
+      int found = 0;
+      int pos = -1;
+      int *element;
+
+      for (i = 0; i < NB_ELEMENTS; i++) {
+        if (model[i] == key)
+          expected++;
+      }
+
+      while ((element = (int *) __osip_index_find(index, (unsigned long) key, &pos)) != NULL) {
+        if (*element != key)
+          failed++;
+
+        found++;
+      }
+
+      if (found != expected)
+        failed++;
+    }
+  }
+
+  __osip_index_free(index);
+
+  if (failed != 0)
+    fprintf(stdout, "tindex: __osip_index_find does not return the elements of a key\n");
+
+  return failed;
+}
+
+static osip_message_t *build_message(const char *format, ...) {
+  osip_message_t *sip;
+  char buf[2048];
+  va_list args;
+
+  va_start(args, format);
+  vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+
+  osip_message_init(&sip);
+
+  if (osip_message_parse(sip, buf, strlen(buf)) != OSIP_SUCCESS) {
+    osip_message_free(sip);
+    return NULL;
+  }
+
+  return sip;
+}
+
+/* same search without the index */
+static osip_transaction_t *linear_find(osip_list_t *transactions, osip_event_t *evt) {
+  osip_transaction_t *transaction;
+  osip_list_t copy;
+  int pos;
+
+  osip_list_init(&copy);
+
+  for (pos = 0; pos < osip_list_size(transactions); pos++)
+    osip_list_add(&copy, osip_list_get(transactions, pos), -1);
+
+  transaction = osip_transaction_find(&copy, evt);
+  osip_list_special_free(&copy, NULL);
+  return transaction;
+}
+
+static void build_key(int k, char *branch, char *callid, char *tag, int compliant) {
+  snprintf(branch, 64, "%s%i", compliant ? "z9hG4bK" : "abc", k / 16);
+  snprintf(callid, 64, "cid%i", k / 16);
+  snprintf(tag, 32, "t%i", k / 16);
+}
+
+static int test_transactions(void) {
+  static osip_transaction_t *transactions[NB_TRANSACTIONS];
+  osip_t *osip;
+  int failed = 0;
+  int i;
+
+  if (osip_init(&osip) != OSIP_SUCCESS)
+    return -1;
+
+  osip_set_cb_send_message(osip, &cb_send_message);
+
+  /* rfc3261 and rfc2543 transactions with the same Call-ID for 16 of them */
+  for (i = 0; i < NB_TRANSACTIONS; i++) {
+    char branch[64], callid[64], tag[32];
+    const char *method = methods[i % 4];
+    int server = (i / 4) % 2;
+    osip_message_t *sip;
+
+    build_key(i, branch, callid, tag, (i / 8) % 3 != 0);
+    sip = build_message(request_format, method, (i % 5) ? "h1.com:5060" : "h1.com", branch, tag, "", callid, 1 + (i % 4 == 2 ? 0 : i % 7), method);
+
+    if (sip == NULL || osip_transaction_init(&transactions[i], server ? (i % 4 == 0 ? IST : NIST) : (i % 4 == 0 ? ICT : NICT), osip, sip) != OSIP_SUCCESS) {
+      fprintf(stdout, "tindex: cannot create transaction %i\n", i);
+      osip_message_free(sip);
+      osip_release(osip);
+      return -1;
+    }
+
+    osip_message_free(sip);
+  }
+
+  for (i = 0; i < NB_LOOKUPS; i++) {
+    char branch[64], callid[64], tag[32];
+    const char *method = methods[rand() % 4];
+    int kind = rand() % 6;
+    osip_event_t evt;
+    osip_list_t *transactions_list;
+    osip_transaction_t *found;
+
+    build_key(rand() % NB_TRANSACTIONS, branch, callid, tag, rand() % 3);
+
+    if (rand() % 10 == 0)
+      strcat(callid, "x"); /* unknown Call-ID */
+
+    memset(&evt, 0, sizeof(evt));
+
+    if (kind == 0)
+      method = "ACK";
+
+    if (kind <= 2) { /* received requests */
+      evt.sip = build_message(request_format, method, (rand() % 2) ? "h1.com:5060" : "h1.com", branch, tag, (rand() % 2) ? ";tag=x" : "", callid, 1 + rand() % 7, method);
+      evt.type = (strcmp(method, "INVITE") == 0 || kind == 0) ? RCV_REQINVITE : RCV_REQUEST;
+      transactions_list = (evt.type == RCV_REQINVITE) ? &osip->osip_ist_transactions : &osip->osip_nist_transactions;
+
+    } else if (kind <= 4) { /* received responses */
+      evt.sip = build_message(response_format, "h1.com", branch, tag, callid, 1 + rand() % 7, method);
+      evt.type = RCV_STATUS_2XX;
+      transactions_list = (strcmp(method, "INVITE") == 0) ? &osip->osip_ict_transactions : &osip->osip_nict_transactions;
+
+    } else { /* outgoing messages: found with their transactionid */
+      evt.sip = build_message(request_format, method, "h1.com", branch, tag, "", callid, 1, method);
+      evt.type = SND_REQINVITE;
+      evt.transactionid = 1 + rand() % (NB_TRANSACTIONS + 5);
+      transactions_list = (strcmp(method, "INVITE") == 0) ? &osip->osip_ict_transactions : &osip->osip_nict_transactions;
+    }
+
+    if (evt.sip == NULL) {
+      failed++;
+      continue;
+    }
+
+    found = osip_transaction_find(transactions_list, &evt);
+
+    if (found != linear_find(transactions_list, &evt)) {
+      fprintf(stdout, "tindex: wrong transaction found (event type %i, Call-ID %s)\n", evt.type, callid);
+      failed++;
+    }
+
+    osip_message_free(evt.sip);
+  }
+
+  /* released transactions are removed from the index */
+  for (i = 0; i < NB_TRANSACTIONS; i += 2)
+    osip_transaction_free(transactions[i]);
+
+  for (i = 0; i < NB_TRANSACTIONS; i++) {
+    osip_event_t evt;
+    osip_list_t *transactions_list;
+
+    memset(&evt, 0, sizeof(evt));
+    evt.type = SND_REQUEST;
+    evt.transactionid = i + 1;
+    transactions_list = (i % 4 == 0) ? &osip->osip_ict_transactions : &osip->osip_nict_transactions;
+
+    if (osip_transaction_find(transactions_list, &evt) != linear_find(transactions_list, &evt)) {
+      fprintf(stdout, "tindex: released transaction %i still found\n", i + 1);
+      failed++;
+    }
+  }
+
+  for (i = 1; i < NB_TRANSACTIONS; i += 2)
+    osip_transaction_free(transactions[i]);
+
+  osip_release(osip);
+  return failed;
+}
+
+int main(int argc, char **argv) {
+  int failed = 0;
+
+  srand(1);
+
+  failed += test_index();
+  failed += test_transactions();
+
+  fprintf(stdout, "tindex: %s\n", failed ? "FAILED" : "OK");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,211 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osipparser2/internal.h>
+#include <osipparser2/osip_port.h>
+#include <osipparser2/osip_parser.h>
+
+/* check that header names and values terminated in place in the copy
+   of the message are the ones of the message: values with commas are
+   split only for headers allowing several values (and not inside
+   quotes or URIs), and nothing refers to the buffer given to the
+   parser. */
+
+static const char *message =
+    "INVITE sip:bob@b.com SIP/2.0\r\n"
+    "Via: SIP/2.0/UDP h1.com;branch=z9hG4bK1 , SIP/2.0/TCP h2.com;branch=z9hG4bK2\r\n"
+    "From: \"A, B\" <sip:a@a.com>;tag=1\r\n"
+    "To: <sip:bob@b.com>\r\n"
+    "Call-ID: c1@h1.com\r\n"
+    "CSeq: 1 INVITE\r\n"
+    "Contact: \"Doe, J\" <sip:j@x.com;p=a,b>, <sip:k@y.com>\r\n"
+    "Route: <sip:r1.com;lr>,<sip:r2.com;lr>\r\n"
+    "Allow: INVITE,,ACK ,BYE\r\n"
+    "X-Custom: one, two\r\n"
+    "Subject:\r\n"
+    "Content-Length: 0\r\n"
+    "\r\n";
+
+/* value of the nth header with this name (or NULL) */
+static int check_header(osip_message_t *sip, const char *name, int nth, const char *value) {
+  osip_header_t *header = NULL;
+  int pos = -1;
+  int i;
+
+  for (i = 0; i <= nth; i++) {
+    pos = osip_message_header_get_byname(sip, name, pos + 1, &header);
+
+    if (pos < 0)
+      break;
+  }
+
+  if (header == NULL && value == NULL)
+    return 0;
+
+  if (header == NULL || value == NULL || header->hvalue == NULL || strcmp(header->hvalue, value) != 0 || strcmp(header->hname, name) != 0) {
+    fprintf(stdout, "tinplace: wrong value for header %s %i\n", name, nth);
+    return 1;
+  }
+
+  return 0;
+}
+
+static int check_allow(osip_message_t *sip, int pos, const char *value) {
+  osip_allow_t *allow = NULL;
+
+  osip_message_get_allow(sip, pos, &allow);
+
+  if (allow == NULL && value == NULL)
+    return 0;
+
+  if (allow == NULL || value == NULL || allow->value == NULL || strcmp(allow->value, value) != 0) {
+    fprintf(stdout, "tinplace: wrong value for Allow header %i\n", pos);
+    return 1;
+  }
+
+  return 0;
+}
+
+static int check_message(osip_message_t *sip) {
+  osip_contact_t *contact = NULL;
+  osip_route_t *route = NULL;
+  osip_via_t *via = NULL;
+  osip_header_t *subject = NULL;
+  int failed = 0;
+
+  if (osip_list_size(&sip->vias) != 2 || osip_message_get_via(sip, 1, &via) < 0 || strcmp(via->host, "h2.com") != 0 || strcmp(via->protocol, "TCP") != 0) {
+    fprintf(stdout, "tinplace: wrong Via headers\n");
+    failed++;
+  }
+
+  if (sip->from == NULL || sip->from->displayname == NULL || strcmp(sip->from->displayname, "\"A, B\"") != 0) {
+    fprintf(stdout, "tinplace: wrong From header\n");
+    failed++;
+  }
+
+  if (osip_list_size(&sip->contacts) != 2 || osip_message_get_contact(sip, 0, &contact) < 0 || contact->displayname == NULL || strcmp(contact->displayname, "\"Doe, J\"") != 0 || strcmp(contact->url->host, "x.com") != 0) {
+    fprintf(stdout, "tinplace: wrong Contact headers\n");
+    failed++;
+
+  } else if (osip_message_get_contact(sip, 1, &contact) < 0 || strcmp(contact->url->host, "y.com") != 0) {
+    fprintf(stdout, "tinplace: wrong second Contact header\n");
+    failed++;
+  }
+
+  if (osip_list_size(&sip->routes) != 2 || osip_message_get_route(sip, 1, &route) < 0 || strcmp(route->url->host, "r2.com") != 0) {
+    fprintf(stdout, "tinplace: wrong Route headers\n");
+    failed++;
+  }
+
+  /* empty values are skipped */
+  failed += check_allow(sip, 0, "INVITE");
+  failed += check_allow(sip, 1, "ACK");
+  failed += check_allow(sip, 2, "BYE");
+
+  /* unknown headers are not split */
+  failed += check_header(sip, "x-custom", 0, "one, two");
+  failed += check_header(sip, "x-custom", 1, NULL);
+
+  osip_message_header_get_byname(sip, "subject", 0, &subject);
+
+  /* written again as "Subject: " */
+  if (subject == NULL || (subject->hvalue != NULL && subject->hvalue[0] != '\0')) {
+    fprintf(stdout, "tinplace: wrong empty Subject header\n");
+    failed++;
+  }
+
+  return failed;
+}
+
+int main(int argc, char **argv) {
+  osip_message_t *sip;
+  osip_message_t *clone;
+  char *buf;
+  char *dest;
+  size_t length;
+  char hname[] = "Allow";
+  char hvalue[] = "INFO, UPDATE";
+  int failed = 0;
+
+  parser_init();
+
+  buf = osip_strdup(message);
+  osip_message_init(&sip);
+
+  if (osip_message_parse(sip, buf, strlen(buf)) != OSIP_SUCCESS) {
+    fprintf(stdout, "tinplace: cannot parse the message\n");
+    return 1;
+  }
+
+  /* the buffer given to the parser is not used anymore */
+  memset(buf, 'x', strlen(buf));
+  osip_free(buf);
+
+  failed += check_message(sip);
+
+  if (osip_message_clone(sip, &clone) != OSIP_SUCCESS) {
+    fprintf(stdout, "tinplace: cannot clone the message\n");
+    failed++;
+
+  } else {
+    failed += check_message(clone);
+    osip_message_free(clone);
+  }
+
+  /* the value given to osip_message_set_multiple_header is not modified */
+  osip_message_set_multiple_header(sip, hname, hvalue);
+
+  if (strcmp(hvalue, "INFO, UPDATE") != 0) {
+    fprintf(stdout, "tinplace: value modified by osip_message_set_multiple_header\n");
+    failed++;
+  }
+
+  failed += check_allow(sip, 3, "INFO");
+  failed += check_allow(sip, 4, "UPDATE");
+
+  /* the message written again is parsed to the same headers */
+  if (osip_message_to_str(sip, &dest, &length) != OSIP_SUCCESS) {
+    fprintf(stdout, "tinplace: cannot write the message\n");
+    failed++;
+
+  } else {
+    osip_message_t *copy;
+
+    osip_message_init(&copy);
+
+    if (osip_message_parse(copy, dest, length) != OSIP_SUCCESS) {
+      fprintf(stdout, "tinplace: cannot parse the message written again\n");
+      failed++;
+
+    } else
+      failed += check_message(copy);
+
+    osip_message_free(copy);
+    osip_free(dest);
+  }
+
+  osip_message_free(sip);
+
+  fprintf(stdout, "tinplace: %s\n", failed ? "FAILED" : "OK");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,368 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <sys/uio.h>
+
+#include <osipparser2/internal.h>
+#include <osipparser2/osip_port.h>
+#include <osipparser2/osip_parser.h>
+
+/* serialize the messages of the res directory with osip_message_to_iovec,
+   after osip_message_parse_with_wire and after modifications: the buffers
+   give the message of osip_message_to_str once parsed again. Also check
+   the received lines of unchanged headers are sent as received. */
+
+#define MAX_IOVEC 256
+
+static char scratch[65536];
+
+/* the message parsed and serialized again */
+static char *reparse(const char *buf, size_t length) {
+  osip_message_t *sip;
+  char *dest = NULL;
+
+  osip_message_init(&sip);
+
+  if (osip_message_parse(sip, buf, length) == OSIP_SUCCESS)
+    osip_message_to_str(sip, &dest, &length);
+
+  osip_message_free(sip);
+  return dest;
+}
+
+/* the buffers of osip_message_to_iovec and the number of bytes
+   pointing to the received message */
+static char *iovec_flatten(osip_message_t *sip, size_t *shared) {
+  struct iovec iov[MAX_IOVEC];
+  char *flat;
+  size_t length = 0;
+  int iovcnt = MAX_IOVEC;
+  int i;
+
+  *shared = 0;
+
+  if (osip_message_to_iovec(sip, iov, &iovcnt, scratch, sizeof(scratch)) != OSIP_SUCCESS)
+    return NULL;
+
+  for (i = 0; i < iovcnt; i++)
+    length += iov[i].iov_len;
+
+  flat = (char *) osip_malloc(length + 1);
+  length = 0;
+
+  for (i = 0; i < iovcnt; i++) {
+    memcpy(flat + length, iov[i].iov_base, iov[i].iov_len);
+    length += iov[i].iov_len;
+
+    if ((char *) iov[i].iov_base < scratch || (char *) iov[i].iov_base >= scratch + sizeof(scratch))
+      *shared += iov[i].iov_len;
+  }
+
+  flat[length] = '\0';
+  return flat;
+}
+
+static int test_spans(void) {
+  static const char *msg = "OPTIONS sip:bob@b.com SIP/2.0\r\nVia:   SIP/2.0/UDP h1.com;branch=z9hG4bK1\r\nto:    <sip:bob@b.com>;tag=x\r\nFrom: <sip:a@a.com>;tag=1\r\nCall-ID: c1@h1.com\r\nCSeq:  1   OPTIONS\r\nX-Odd :  value  \r\nContent-Length: 0\r\n\r\n";
+  static const char *lines[] = {"Via:   SIP/2.0/UDP h1.com;branch=z9hG4bK1\r\n", "to:    <sip:bob@b.com>;tag=x\r\n", "CSeq:  1   OPTIONS\r\n", "X-Odd :  value  \r\n"};
+  osip_message_t *sip;
+  osip_header_t *header = NULL;
+  char *flat;
+  char *str = NULL;
+  size_t shared;
+  size_t length;
+  size_t received = 0;
+  int failed = 0;
+  int k;
+
+  osip_message_init(&sip);
+
+  if (osip_message_parse_with_wire(sip, msg, strlen(msg), 0) != OSIP_SUCCESS) {
+    fprintf(stdout, "tiovec: cannot parse the message\n");
+    osip_message_free(sip);
+    return 1;
+  }
+
+  /* unchanged headers are sent as received */
+  flat = iovec_flatten(sip, &shared);
+
+  for (k = 0; k < 4; k++) {
+    received += strlen(lines[k]);
+
+    if (flat == NULL || strstr(flat, lines[k]) == NULL) {
+      fprintf(stdout, "tiovec: received line %i not sent as received\n", k);
+      failed++;
+    }
+  }
+
+  if (shared < received) {
+    fprintf(stdout, "tiovec: received lines copied in the buffer\n");
+    failed++;
+  }
+
+  osip_free(flat);
+
+  /* osip_message_to_str writes all headers from the structures */
+  osip_message_to_str(sip, &str, &length);
+
+  if (str == NULL || strstr(str, lines[1]) != NULL || strstr(str, lines[2]) != NULL) {
+    fprintf(stdout, "tiovec: received line found in osip_message_to_str\n");
+    failed++;
+  }
+
+  osip_free(str);
+
+  /* a reported header and a modified other header are written again */
+  osip_message_force_update_header(sip, sip->to);
+  osip_message_header_get_byname(sip, "x-odd", 0, &header);
+
+  if (header != NULL) {
+    osip_free(header->hvalue);
+    header->hvalue = osip_strdup("other");
+  }
+
+  flat = iovec_flatten(sip, &shared);
+
+  if (flat == NULL || strstr(flat, lines[1]) != NULL || strstr(flat, "\r\nTo: <sip:bob@b.com>;tag=x\r\n") == NULL) {
+    fprintf(stdout, "tiovec: reported header not written again\n");
+    failed++;
+  }
+
+  if (flat == NULL || strstr(flat, lines[3]) != NULL || strstr(flat, "-odd: other\r\n") == NULL) {
+    fprintf(stdout, "tiovec: modified header not written again\n");
+    failed++;
+  }
+
+  if (flat == NULL || strstr(flat, lines[0]) == NULL || strstr(flat, lines[2]) == NULL) {
+    fprintf(stdout, "tiovec: received line of an unchanged header lost\n");
+    failed++;
+  }
+
+  osip_free(flat);
+  osip_message_free(sip);
+
+  /* nothing is kept by osip_message_parse */
+  osip_message_init(&sip);
+  osip_message_parse(sip, msg, strlen(msg));
+  flat = iovec_flatten(sip, &shared);
+
+  if (flat == NULL || shared != 0 || strstr(flat, lines[2]) != NULL) {
+    fprintf(stdout, "tiovec: received line kept without osip_message_parse_with_wire\n");
+    failed++;
+  }
+
+  osip_free(flat);
+  osip_message_free(sip);
+  return failed;
+}
+
+static char *iovec_to_str(osip_message_t *sip, int *iovcnt) {
+  struct iovec iov[MAX_IOVEC];
+  char *flat;
+  char *dest;
+  size_t length = 0;
+  int i;
+
+  *iovcnt = MAX_IOVEC;
+
+  if (osip_message_to_iovec(sip, iov, iovcnt, scratch, sizeof(scratch)) != OSIP_SUCCESS)
+    return NULL;
+
+  for (i = 0; i < *iovcnt; i++)
+    length += iov[i].iov_len;
+
+  flat = (char *) osip_malloc(length + 1);
+  length = 0;
+
+  for (i = 0; i < *iovcnt; i++) {
+    memcpy(flat + length, iov[i].iov_base, iov[i].iov_len);
+    length += iov[i].iov_len;
+  }
+
+  flat[length] = '\0';
+  dest = reparse(flat, length);
+  osip_free(flat);
+  return dest;
+}
+
+/* a new Via, the first Route removed and Max-Forwards modified */
+static void modify_message(osip_message_t *sip) {
+  osip_via_t *via;
+  osip_route_t *route;
+  osip_header_t *max_forwards = NULL;
+
+  osip_message_fix_last_via_header(sip, "192.0.2.99", 5099);
+
+  if (osip_via_init(&via) == OSIP_SUCCESS) {
+    if (osip_via_parse(via, "SIP/2.0/UDP 192.0.2.1:5060;branch=z9hG4bKnew") == OSIP_SUCCESS)
+      osip_list_add(&sip->vias, via, 0);
+
+    else
+      osip_via_free(via);
+  }
+
+  route = (osip_route_t *) osip_list_get(&sip->routes, 0);
+
+  if (route != NULL) {
+    osip_list_remove(&sip->routes, 0);
+    osip_route_free(route);
+  }
+
+  osip_message_header_get_byname(sip, "max-forwards", 0, &max_forwards);
+
+  if (max_forwards != NULL) {
+    osip_free(max_forwards->hvalue);
+    max_forwards->hvalue = osip_strdup("69");
+    osip_message_force_update(sip);
+  }
+}
+
+static int test_iovec(const char *filename, const char *msg, size_t length, int mode) {
+  osip_message_t *sip;
+  struct iovec iov[MAX_IOVEC];
+  char *result[2] = {NULL, NULL};
+  char *str = NULL;
+  size_t str_length;
+  int failed = 0;
+  int iovcnt;
+  int i;
+
+  osip_message_init(&sip);
+
+  if (osip_message_parse_with_wire(sip, msg, length, mode == 1) != OSIP_SUCCESS) {
+    osip_message_free(sip);
+    return 0;
+  }
+
+  if (mode == 2)
+    modify_message(sip);
+
+  if (osip_message_to_str(sip, &str, &str_length) == OSIP_SUCCESS)
+    result[0] = reparse(str, str_length);
+
+  osip_free(str);
+
+  result[1] = iovec_to_str(sip, &iovcnt);
+
+  if (result[0] == NULL || result[1] == NULL || strcmp(result[0], result[1]) != 0) {
+    fprintf(stdout, "tiovec: %s: message differs (mode %i)\n", filename, mode);
+    failed = -1;
+  }
+
+  /* too few buffers or a too small buffer are reported */
+  i = 1;
+
+  if (result[1] != NULL && iovcnt > 1 && osip_message_to_iovec(sip, iov, &i, scratch, sizeof(scratch)) != OSIP_NOMEM) {
+    fprintf(stdout, "tiovec: %s: too few buffers not reported\n", filename);
+    failed = -1;
+  }
+
+  i = MAX_IOVEC;
+
+  if (osip_message_to_iovec(sip, iov, &i, scratch, 4) != OSIP_NOMEM) {
+    fprintf(stdout, "tiovec: %s: too small buffer not reported\n", filename);
+    failed = -1;
+  }
+
+  osip_free(result[0]);
+  osip_free(result[1]);
+  osip_message_free(sip);
+  return failed;
+}
+
+/* folded headers are sent as received and not as written by osip_message_to_str */
+static int is_folded(const char *msg) {
+  const char *end = strstr(msg, "\r\n\r\n");
+  const char *fold;
+
+  for (fold = strstr(msg, "\r\n"); fold != NULL && fold != end; fold = strstr(fold + 2, "\r\n")) {
+    if (fold[2] == ' ' || fold[2] == '\t')
+      return 1;
+  }
+
+  return 0;
+}
+
+static char *read_message(const char *filename, size_t *length) {
+  FILE *file;
+  char *msg;
+
+  file = fopen(filename, "r");
+
+  if (file == NULL)
+    return NULL;
+
+  msg = (char *) osip_malloc(100000); /* msg are under 100000 */
+  *length = fread(msg, 1, 99999, file);
+  msg[*length] = '\0';
+  fclose(file);
+  return msg;
+}
+
+int main(int argc, char **argv) {
+  char filename[1024];
+  char *msg;
+  size_t length;
+  int tested = 0;
+  int failed = 0;
+  int i;
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: ./tiovec res_directory\n");
+    exit(1);
+  }
+
+  parser_init();
+
+  if (test_spans() != 0)
+    failed++;
+
+  for (i = 0;; i++) {
+    int mode;
+
+    snprintf(filename, sizeof(filename), "%s/sip%i", argv[1], i);
+    msg = read_message(filename, &length);
+
+    if (msg == NULL)
+      break;
+
+    if (is_folded(msg)) {
+      osip_free(msg);
+      continue;
+    }
+
+    /* parsed, parsed in lazy mode, parsed and modified */
+    for (mode = 0; mode < 3; mode++) {
+      if (test_iovec(filename, msg, length, mode) < 0) {
+        failed++;
+        break;
+      }
+    }
+
+    tested++;
+    osip_free(msg);
+  }
+
+  fprintf(stdout, "tiovec: %i messages, %i failed\n", tested, failed);
+  return (tested == 0 || failed != 0) ? 1 : 0;
+}
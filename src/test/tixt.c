@@ -0,0 +1,170 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osip2/internal.h>
+#include <osip2/osip.h>
+#include <osip2/osip_dialog.h>
+
+/* check the retransmissions of 2xx: an ACK stops the retransmissions
+   of its dialog only, retransmissions stopped from the dialog are not
+   sent anymore and the others are sent when osip_timers_gettimeout
+   tells to wake up. */
+
+#define NB_DIALOGS 300
+
+static const char *invite_format = "INVITE sip:bob@b.com SIP/2.0\r\nVia: SIP/2.0/UDP h1.com;branch=z9hG4bK%i\r\nFrom: <sip:a@a.com>;tag=f%i\r\nTo: <sip:bob@b.com>\r\nCall-ID: c%i@h1.com\r\nCSeq: %i INVITE\r\nContact: <sip:a@h1.com>\r\nContent-Length: 0\r\n\r\n";
+static const char *response_format = "SIP/2.0 200 OK\r\nVia: SIP/2.0/UDP h1.com;branch=z9hG4bK%i\r\nFrom: <sip:a@a.com>;tag=f%i\r\nTo: <sip:bob@b.com>;tag=t%i\r\nCall-ID: c%i@h1.com\r\nCSeq: %i INVITE\r\nContact: <sip:b@b.com>\r\nContent-Length: 0\r\n\r\n";
+static const char *ack_format = "ACK sip:b@b.com SIP/2.0\r\nVia: SIP/2.0/UDP h1.com;branch=z9hG4bKa%i\r\nFrom: <sip:a@a.com>;tag=f%i\r\nTo: <sip:bob@b.com>;tag=t%i\r\nCall-ID: c%i@h1.com\r\nCSeq: %i ACK\r\nContent-Length: 0\r\n\r\n";
+
+static osip_dialog_t *dialogs[NB_DIALOGS];
+static int nb_sent[NB_DIALOGS];
+
+static int cb_send_message(osip_transaction_t *tr, osip_message_t *sip, char *host, int port, int out_socket) {
+  nb_sent[atoi(sip->call_id->number + 1)]++;
+  return OSIP_SUCCESS;
+}
+
+static osip_message_t *build_message(const char *format, int i, int cseq) {
+  osip_message_t *sip;
+  char buf[2048];
+
+  snprintf(buf, sizeof(buf), format, i, i, i, i, cseq);
+  osip_message_init(&sip);
+  osip_message_parse(sip, buf, strlen(buf));
+  return sip;
+}
+
+static osip_dialog_t *stop_with_ack(osip_t *osip, int i, int cseq) {
+  osip_message_t *ack = build_message(ack_format, i, cseq);
+  osip_dialog_t *dialog = osip_stop_200ok_retransmissions(osip, ack);
+
+  osip_message_free(ack);
+  return dialog;
+}
+
+static long elapsed_ms(struct timeval *start) {
+  struct timeval now;
+
+  osip_gettimeofday(&now, NULL);
+  return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_usec - start->tv_usec) / 1000;
+}
+
+static int test_retransmissions(int nb_shards) {
+  struct timeval start;
+  osip_t *osip;
+  int nb_wakeups = 0;
+  int failed = 0;
+  int i;
+
+  if (nb_shards > 0)
+    i = osip_init_sharded(&osip, nb_shards);
+
+  else
+    i = osip_init(&osip);
+
+  if (i != OSIP_SUCCESS)
+    return 1;
+
+  osip_set_cb_send_message(osip, &cb_send_message);
+  memset(nb_sent, 0, sizeof(nb_sent));
+
+  for (i = 0; i < NB_DIALOGS; i++) {
+    osip_message_t *invite = build_message(invite_format, i, 1 + i % 3);
+    osip_message_t *response = build_message(response_format, i, 1 + i % 3);
+
+    osip_dialog_init_as_uas(&dialogs[i], invite, response);
+    osip_start_200ok_retransmissions(osip, dialogs[i], response, -1);
+    osip_message_free(invite);
+    osip_message_free(response);
+  }
+
+  osip_gettimeofday(&start, NULL);
+
+  /* an ACK with another CSeq does not match */
+  if (stop_with_ack(osip, 5, 7) != NULL) {
+    fprintf(stdout, "tixt: %i shards: ACK with a wrong CSeq matched\n", nb_shards);
+    failed++;
+  }
+
+  /* stop a third with an ACK and a third from the dialog */
+  for (i = 0; i < NB_DIALOGS; i++) {
+    if (i % 3 == 0 && stop_with_ack(osip, i, 1 + i % 3) != dialogs[i]) {
+      fprintf(stdout, "tixt: %i shards: ACK %i not matched\n", nb_shards, i);
+      failed++;
+
+    } else if (i % 3 == 1)
+      osip_stop_retransmissions_from_dialog(osip, dialogs[i]);
+  }
+
+  /* once stopped, an ACK does not match anymore */
+  if (stop_with_ack(osip, 0, 1) != NULL || stop_with_ack(osip, 1, 2) != NULL) {
+    fprintf(stdout, "tixt: %i shards: ACK matched after the end of the retransmissions\n", nb_shards);
+    failed++;
+  }
+
+  /* the first retransmission is sent after T1 */
+  while (elapsed_ms(&start) < 700) {
+    struct timeval timeout;
+
+    osip_timers_gettimeout(osip, &timeout);
+
+    if (timeout.tv_sec > 0 || timeout.tv_usec > 100000)
+      timeout.tv_usec = 100000;
+
+    osip_usleep((int) timeout.tv_usec);
+    osip_retransmissions_execute(osip);
+    nb_wakeups++;
+  }
+
+  for (i = 0; i < NB_DIALOGS; i++) {
+    if (nb_sent[i] != (i % 3 == 2 ? 1 : 0)) {
+      fprintf(stdout, "tixt: %i shards: %i retransmissions for dialog %i\n", nb_shards, nb_sent[i], i);
+      failed++;
+      break;
+    }
+  }
+
+  /* a few wake up per retransmission (not one per ms) */
+  if (nb_wakeups > 50) {
+    fprintf(stdout, "tixt: %i shards: %i wake up in 700ms\n", nb_shards, nb_wakeups);
+    failed++;
+  }
+
+  for (i = 0; i < NB_DIALOGS; i++) {
+    osip_stop_retransmissions_from_dialog(osip, dialogs[i]);
+    osip_dialog_free(dialogs[i]);
+  }
+
+  osip_release(osip);
+  return failed;
+}
+
+int main(int argc, char **argv) {
+  int failed = 0;
+
+  failed += test_retransmissions(0);
+  failed += test_retransmissions(3);
+
+  fprintf(stdout, "tixt: %s\n", failed ? "FAILED" : "OK");
+  return failed ? 1 : 0;
+}
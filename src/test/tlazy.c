@@ -0,0 +1,186 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osipparser2/internal.h>
+#include <osipparser2/osip_port.h>
+#include <osipparser2/osip_parser.h>
+
+/* parse the messages of the res directory with osip_message_parse and
+   osip_message_parse_lazy: accessors of lazy headers, clones and
+   serialized messages must give the same result. */
+
+static int count_contacts(osip_message_t *sip) {
+  osip_contact_t *contact;
+  int pos = 0;
+
+  while (osip_message_get_contact(sip, pos, &contact) >= 0)
+    pos++;
+
+  return pos;
+}
+
+static int count_authorizations(osip_message_t *sip) {
+  osip_authorization_t *authorization;
+  int pos = 0;
+
+  while (osip_message_get_authorization(sip, pos, &authorization) >= 0)
+    pos++;
+
+  return pos;
+}
+
+static int compare_messages(const char *filename, const char *name, osip_message_t *sip, osip_message_t *lazy) {
+  char *result[2] = {NULL, NULL};
+  size_t length;
+  int failed = 0;
+
+  osip_message_force_update(sip);
+  osip_message_force_update(lazy);
+  osip_message_to_str(sip, &result[0], &length);
+  osip_message_to_str(lazy, &result[1], &length);
+
+  if (result[0] == NULL || result[1] == NULL || strcmp(result[0], result[1]) != 0) {
+    fprintf(stdout, "tlazy: %s: %s differs\n", filename, name);
+    failed = -1;
+  }
+
+  osip_free(result[0]);
+  osip_free(result[1]);
+  return failed;
+}
+
+static int test_lazy(const char *filename, const char *msg, size_t length, int *nb_lazy) {
+  osip_message_t *sip;
+  osip_message_t *lazy;
+  osip_message_t *untouched;
+  osip_message_t *clone;
+  int failed = 0;
+  int i;
+
+  osip_message_init(&sip);
+  osip_message_init(&lazy);
+  osip_message_init(&untouched);
+
+  i = osip_message_parse(sip, msg, length);
+
+  if (i != OSIP_SUCCESS) {
+    osip_message_free(sip);
+    osip_message_free(lazy);
+    osip_message_free(untouched);
+    return 0;
+  }
+
+  if (osip_message_parse_lazy(lazy, msg, length) != OSIP_SUCCESS || osip_message_parse_lazy(untouched, msg, length) != OSIP_SUCCESS) {
+    fprintf(stdout, "tlazy: %s: not parsed in lazy mode\n", filename);
+    osip_message_free(sip);
+    osip_message_free(lazy);
+    osip_message_free(untouched);
+    return -1;
+  }
+
+  if (osip_list_size(&lazy->lazy_headers) > 0)
+    (*nb_lazy)++;
+
+  /* headers are parsed by their accessors */
+  if (count_contacts(sip) != count_contacts(lazy) || count_authorizations(sip) != count_authorizations(lazy)) {
+    fprintf(stdout, "tlazy: %s: lazy headers not found by their accessors\n", filename);
+    failed = -1;
+  }
+
+  /* clones parse the remaining headers */
+  if (osip_message_clone(lazy, &clone) != OSIP_SUCCESS) {
+    fprintf(stdout, "tlazy: %s: cannot clone\n", filename);
+    failed = -1;
+
+  } else {
+    if (compare_messages(filename, "clone", sip, clone) < 0)
+      failed = -1;
+
+    osip_message_free(clone);
+  }
+
+  if (compare_messages(filename, "message", sip, lazy) < 0)
+    failed = -1;
+
+  osip_message_free(sip);
+  osip_message_free(lazy);
+
+  /* freed without parsing its lazy headers */
+  osip_message_free(untouched);
+  return failed;
+}
+
+static char *read_message(const char *filename, size_t *length) {
+  FILE *file;
+  char *msg;
+
+  file = fopen(filename, "r");
+
+  if (file == NULL)
+    return NULL;
+
+  msg = (char *) osip_malloc(100000); /* msg are under 100000 */
+  *length = fread(msg, 1, 99999, file);
+  msg[*length] = '\0';
+  fclose(file);
+  return msg;
+}
+
+int main(int argc, char **argv) {
+  char filename[1024];
+  char *msg;
+  size_t length;
+  int nb_lazy = 0;
+  int tested = 0;
+  int failed = 0;
+  int i;
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: ./tlazy res_directory\n");
+    exit(1);
+  }
+
+  parser_init();
+
+  for (i = 0;; i++) {
+    snprintf(filename, sizeof(filename), "%s/sip%i", argv[1], i);
+    msg = read_message(filename, &length);
+
+    if (msg == NULL)
+      break;
+
+    if (test_lazy(filename, msg, length, &nb_lazy) < 0)
+      failed++;
+
+    tested++;
+    osip_free(msg);
+  }
+
+  if (nb_lazy == 0) {
+    fprintf(stdout, "tlazy: no lazy header found\n");
+    failed++;
+  }
+
+  fprintf(stdout, "tlazy: %i messages, %i with lazy headers, %i failed\n", tested, nb_lazy, failed);
+  return (tested == 0 || failed != 0) ? 1 : 0;
+}
@@ -0,0 +1,168 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osipparser2/internal.h>
+#include <osipparser2/osip_port.h>
+#include <osipparser2/osip_list.h>
+
+/* check osip_list_t against a model: elements are added at any
+   position or at the end, removed by position or with an iterator,
+   and the list grows beyond its inline storage and shrinks back. */
+
+#define MODEL_SIZE 1000
+
+static long model[MODEL_SIZE];
+static int nb_model;
+
+static int clone_element(void *src, void **dst) {
+  *dst = src;
+  return OSIP_SUCCESS;
+}
+
+static int check_list(const osip_list_t *li) {
+  osip_list_iterator_t it;
+  void *element;
+  int i = 0;
+
+  if (osip_list_size(li) != nb_model) {
+    fprintf(stdout, "tlist: size %i instead of %i\n", osip_list_size(li), nb_model);
+    return 1;
+  }
+
+  for (element = osip_list_get_first(li, &it); osip_list_iterator_has_elem(it); element = osip_list_get_next(&it), i++) {
+    if (i >= nb_model || (long) element != model[i]) {
+      fprintf(stdout, "tlist: wrong element at position %i\n", i);
+      return 1;
+    }
+  }
+
+  if (i != nb_model || !osip_list_eol(li, nb_model) || (nb_model > 0 && osip_list_eol(li, nb_model - 1))) {
+    fprintf(stdout, "tlist: end of list not at position %i\n", nb_model);
+    return 1;
+  }
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  osip_list_t li;
+  int failed = 0;
+  int step;
+  int k;
+
+  srand(3);
+  osip_list_init(&li);
+
+  for (step = 0; step < 300000 && failed == 0; step++) {
+    int op = rand() % 7;
+    long value = rand();
+
+    if (op <= 2 && nb_model < MODEL_SIZE) {
+      int pos = (rand() % 4 == 0) ? -1 : rand() % (nb_model + 2);
+      int p = (pos == -1 || pos >= nb_model) ? nb_model : pos;
+
+      osip_list_add(&li, (void *) value, pos);
+
+      for (k = nb_model; k > p; k--)
+        model[k] = model[k - 1];
+
+      model[p] = value;
+      nb_model++;
+
+    } else if (op == 3 && nb_model > 0) {
+      int p = rand() % nb_model;
+
+      osip_list_remove(&li, p);
+
+      for (k = p; k < nb_model - 1; k++)
+        model[k] = model[k + 1];
+
+      nb_model--;
+
+    } else if (op == 4 && nb_model > 0) {
+      osip_list_iterator_t it;
+      int p = rand() % nb_model;
+      int i = 0;
+
+      osip_list_get_first(&li, &it);
+
+      while (osip_list_iterator_has_elem(it) && i < p) {
+        osip_list_get_next(&it);
+        i++;
+      }
+
+      osip_list_iterator_remove(&it);
+
+      for (k = p; k < nb_model - 1; k++)
+        model[k] = model[k + 1];
+
+      nb_model--;
+
+    } else if (op == 5 && rand() % 50 == 0) {
+      osip_list_special_free(&li, NULL);
+      nb_model = 0;
+    }
+
+    if (osip_list_size(&li) != nb_model) {
+      fprintf(stdout, "tlist: size %i instead of %i\n", osip_list_size(&li), nb_model);
+      failed++;
+
+    } else if (nb_model > 0 && (long) osip_list_get(&li, nb_model - 1) != model[nb_model - 1]) {
+      fprintf(stdout, "tlist: wrong last element\n");
+      failed++;
+
+    } else if (nb_model > 0) {
+      int p = rand() % nb_model;
+
+      if ((long) osip_list_get(&li, p) != model[p]) {
+        fprintf(stdout, "tlist: wrong element at position %i\n", p);
+        failed++;
+      }
+    }
+
+    if (osip_list_get(&li, nb_model) != NULL || osip_list_get(&li, -1) != NULL) {
+      fprintf(stdout, "tlist: element found out of the list\n");
+      failed++;
+    }
+
+    if (step % 1000 == 0) {
+      osip_list_t copy;
+
+      failed += check_list(&li);
+      osip_list_init(&copy);
+
+      if (osip_list_clone(&li, &copy, &clone_element) != OSIP_SUCCESS)
+        failed++;
+
+      else {
+        failed += check_list(&copy);
+        osip_list_special_free(&copy, NULL);
+      }
+    }
+  }
+
+  osip_list_special_free(&li, NULL);
+
+  fprintf(stdout, "tlist: %s\n", failed ? "FAILED" : "OK");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,144 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osipparser2/internal.h>
+#include <osipparser2/osip_port.h>
+#include <osipparser2/osip_parser.h>
+
+/* parse the messages of the res directory with osip_message_parse_with_mask:
+   headers outside of the mask are kept as unknown headers and the
+   serialized message, parsed again, is the same message. */
+
+#define TEST_MASK (OSIP_HEADER_MASK_VIA | OSIP_HEADER_MASK_CALL_ID | OSIP_HEADER_MASK_CSEQ)
+
+static int to_str(osip_message_t *sip, char **dest) {
+  size_t length;
+
+  *dest = NULL;
+  osip_message_force_update(sip);
+  return osip_message_to_str(sip, dest, &length);
+}
+
+static int test_mask(const char *filename, const char *msg, size_t length) {
+  osip_message_t *sip;
+  osip_message_t *masked;
+  osip_message_t *reparsed;
+  char *result[3] = {NULL, NULL, NULL};
+  int failed = 0;
+  int i;
+  int j;
+
+  osip_message_init(&sip);
+  osip_message_init(&masked);
+  i = osip_message_parse(sip, msg, length);
+  j = osip_message_parse_with_mask(masked, msg, length, TEST_MASK);
+
+  if (i != OSIP_SUCCESS) {
+    osip_message_free(sip);
+    osip_message_free(masked);
+    return 0;
+  }
+
+  if (j != OSIP_SUCCESS) {
+    fprintf(stdout, "tmask: %s: parsed with %i\n", filename, j);
+    osip_message_free(sip);
+    osip_message_free(masked);
+    return -1;
+  }
+
+  if (osip_list_size(&masked->contacts) != 0 || masked->from != NULL || masked->to != NULL) {
+    fprintf(stdout, "tmask: %s: header outside of the mask decoded\n", filename);
+    failed = -1;
+  }
+
+  if (osip_list_size(&masked->vias) != osip_list_size(&sip->vias) || (sip->cseq != NULL && masked->cseq == NULL) || (sip->call_id != NULL && masked->call_id == NULL)) {
+    fprintf(stdout, "tmask: %s: header of the mask not decoded\n", filename);
+    failed = -1;
+  }
+
+  to_str(sip, &result[0]);
+  to_str(masked, &result[1]);
+  osip_message_init(&reparsed);
+
+  if (result[1] == NULL || osip_message_parse(reparsed, result[1], strlen(result[1])) != OSIP_SUCCESS || to_str(reparsed, &result[2]) != OSIP_SUCCESS || result[0] == NULL || strcmp(result[0], result[2]) != 0) {
+    fprintf(stdout, "tmask: %s: message parsed again differs\n", filename);
+    failed = -1;
+  }
+
+  for (i = 0; i < 3; i++)
+    osip_free(result[i]);
+
+  osip_message_free(reparsed);
+  osip_message_free(sip);
+  osip_message_free(masked);
+  return failed;
+}
+
+static char *read_message(const char *filename, size_t *length) {
+  FILE *file;
+  char *msg;
+
+  file = fopen(filename, "r");
+
+  if (file == NULL)
+    return NULL;
+
+  msg = (char *) osip_malloc(100000); /* msg are under 100000 */
+  *length = fread(msg, 1, 99999, file);
+  msg[*length] = '\0';
+  fclose(file);
+  return msg;
+}
+
+int main(int argc, char **argv) {
+  char filename[1024];
+  char *msg;
+  size_t length;
+  int tested = 0;
+  int failed = 0;
+  int i;
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: ./tmask res_directory\n");
+    exit(1);
+  }
+
+  parser_init();
+
+  for (i = 0;; i++) {
+    snprintf(filename, sizeof(filename), "%s/sip%i", argv[1], i);
+    msg = read_message(filename, &length);
+
+    if (msg == NULL)
+      break;
+
+    if (test_mask(filename, msg, length) < 0)
+      failed++;
+
+    tested++;
+    osip_free(msg);
+  }
+
+  fprintf(stdout, "tmask: %i messages, %i failed\n", tested, failed);
+  return (tested == 0 || failed != 0) ? 1 : 0;
+}
@@ -0,0 +1,206 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osip2/internal.h>
+#include <osip2/osip.h>
+
+#include "xixt.h"
+
+/* check the list of transactions with pending events: a transaction
+   is queued once whatever the number of its events, osip_*_execute
+   only visits the queued transactions and processes all their events,
+   events added directly in the fifo of a transaction are processed too,
+   and a released transaction leaves the list. */
+
+#define NB_TRANSACTIONS 1000
+
+static const char *request_format = "OPTIONS sip:bob@b.com SIP/2.0\r\nVia: SIP/2.0/UDP h1.com;branch=z9hG4bK%i\r\nFrom: <sip:a@a.com>;tag=%i\r\nTo: <sip:bob@b.com>\r\nCall-ID: c%i@h1.com\r\nCSeq: 1 OPTIONS\r\nContent-Length: 0\r\n\r\n";
+static const char *response_format = "SIP/2.0 %i OK\r\nVia: SIP/2.0/UDP h1.com;branch=z9hG4bK%i\r\nFrom: <sip:a@a.com>;tag=%i\r\nTo: <sip:bob@b.com>;tag=x\r\nCall-ID: c%i@h1.com\r\nCSeq: 1 OPTIONS\r\nContent-Length: 0\r\n\r\n";
+
+static osip_transaction_t *transactions[NB_TRANSACTIONS];
+static int nb_sent[NB_TRANSACTIONS];
+static int nb_1xx[NB_TRANSACTIONS];
+static int nb_2xx[NB_TRANSACTIONS];
+
+static int transaction_index(osip_transaction_t *tr) {
+  return (int) (long) osip_transaction_get_your_instance(tr);
+}
+
+static int cb_send_message(osip_transaction_t *tr, osip_message_t *sip, char *host, int port, int out_socket) {
+  nb_sent[transaction_index(tr)]++;
+  return OSIP_SUCCESS;
+}
+
+static void cb_rcv1xx(int type, osip_transaction_t *tr, osip_message_t *sip) {
+  nb_1xx[transaction_index(tr)]++;
+}
+
+static void cb_rcv2xx(int type, osip_transaction_t *tr, osip_message_t *sip) {
+  nb_2xx[transaction_index(tr)]++;
+}
+
+static int ready_size(osip_t *osip) {
+  return ((osip_ready_t *) osip->osip_nict_ready)->nb_elt;
+}
+
+static int add_response(osip_t *osip, int code, int i) {
+  osip_event_t *evt;
+  char buf[1024];
+
+  snprintf(buf, sizeof(buf), response_format, code, i, i, i);
+  evt = osip_parse(buf, strlen(buf));
+
+  if (osip_find_transaction_and_add_event(osip, evt) != OSIP_SUCCESS) {
+    osip_event_free(evt);
+    return -1;
+  }
+
+  return OSIP_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+  osip_t *osip;
+  int failed = 0;
+  int i;
+
+  if (osip_init(&osip) != OSIP_SUCCESS)
+    return 1;
+
+  osip_set_cb_send_message(osip, &cb_send_message);
+  osip_set_message_callback(osip, OSIP_NICT_STATUS_1XX_RECEIVED, &cb_rcv1xx);
+  osip_set_message_callback(osip, OSIP_NICT_STATUS_2XX_RECEIVED, &cb_rcv2xx);
+
+  for (i = 0; i < NB_TRANSACTIONS; i++) {
+    osip_message_t *sip;
+    osip_event_t *evt;
+    char buf[1024];
+
+    snprintf(buf, sizeof(buf), request_format, i, i, i);
+    osip_message_init(&sip);
+    osip_message_parse(sip, buf, strlen(buf));
+    evt = osip_new_outgoing_sipmessage(sip);
+    transactions[i] = osip_create_transaction(osip, evt);
+
+    if (transactions[i] == NULL) {
+      fprintf(stdout, "tready: cannot create transaction %i\n", i);
+      osip_release(osip);
+      return 1;
+    }
+
+    osip_transaction_set_your_instance(transactions[i], (void *) (long) i);
+    osip_transaction_add_event(transactions[i], evt);
+  }
+
+  if (ready_size(osip) != NB_TRANSACTIONS) {
+    fprintf(stdout, "tready: %i transactions queued instead of %i\n", ready_size(osip), NB_TRANSACTIONS);
+    failed++;
+  }
+
+  osip_nict_execute(osip);
+
+  if (ready_size(osip) != 0) {
+    fprintf(stdout, "tready: %i transactions still queued\n", ready_size(osip));
+    failed++;
+  }
+
+  /* a few transactions receive several responses: they are queued once */
+  for (i = 0; i < NB_TRANSACTIONS; i += 10) {
+    if (add_response(osip, 180, i) != OSIP_SUCCESS || add_response(osip, 183, i) != OSIP_SUCCESS || add_response(osip, 200, i) != OSIP_SUCCESS) {
+      fprintf(stdout, "tready: no transaction found for response %i\n", i);
+      failed++;
+    }
+  }
+
+  if (ready_size(osip) != NB_TRANSACTIONS / 10) {
+    fprintf(stdout, "tready: %i transactions queued instead of %i\n", ready_size(osip), NB_TRANSACTIONS / 10);
+    failed++;
+  }
+
+  osip_nict_execute(osip);
+
+  for (i = 0; i < NB_TRANSACTIONS; i++) {
+    int expected = (i % 10 == 0) ? 1 : 0;
+
+    if (nb_sent[i] != 1 || nb_1xx[i] != 2 * expected || nb_2xx[i] != expected) {
+      fprintf(stdout, "tready: transaction %i: %i requests, %i 1xx and %i 2xx\n", i, nb_sent[i], nb_1xx[i], nb_2xx[i]);
+      failed++;
+    }
+  }
+
+  /* a released transaction is removed from the list */
+  for (i = 1; i < NB_TRANSACTIONS; i += 10)
+    add_response(osip, 200, i);
+
+  for (i = 1; i < NB_TRANSACTIONS; i += 20) {
+    osip_transaction_free(transactions[i]);
+    transactions[i] = NULL;
+  }
+
+  if (ready_size(osip) != NB_TRANSACTIONS / 20) {
+    fprintf(stdout, "tready: %i transactions queued instead of %i\n", ready_size(osip), NB_TRANSACTIONS / 20);
+    failed++;
+  }
+
+  osip_nict_execute(osip);
+
+  for (i = 1; i < NB_TRANSACTIONS; i += 10) {
+    int expected = (i % 20 == 1) ? 0 : 1;
+
+    if (nb_2xx[i] != expected) {
+      fprintf(stdout, "tready: transaction %i: %i 2xx instead of %i\n", i, nb_2xx[i], expected);
+      failed++;
+    }
+  }
+
+  /* events added with osip_fifo_add queue the transaction too */
+  for (i = 2; i < NB_TRANSACTIONS; i += 10) {
+    char buf[1024];
+
+    snprintf(buf, sizeof(buf), response_format, 200, i, i, i);
+    osip_fifo_add(transactions[i]->transactionff, osip_parse(buf, strlen(buf)));
+  }
+
+  if (ready_size(osip) != NB_TRANSACTIONS / 10) {
+    fprintf(stdout, "tready: %i transactions queued by osip_fifo_add instead of %i\n", ready_size(osip), NB_TRANSACTIONS / 10);
+    failed++;
+  }
+
+  osip_nict_execute(osip);
+
+  for (i = 2; i < NB_TRANSACTIONS; i += 10) {
+    if (nb_2xx[i] != 1) {
+      fprintf(stdout, "tready: transaction %i: event added with osip_fifo_add not processed\n", i);
+      failed++;
+    }
+  }
+
+  for (i = 0; i < NB_TRANSACTIONS; i++) {
+    if (transactions[i] != NULL)
+      osip_transaction_free(transactions[i]);
+  }
+
+  osip_release(osip);
+
+  fprintf(stdout, "tready: %s\n", failed ? "FAILED" : "OK");
+  return failed ? 1 : 0;
+}
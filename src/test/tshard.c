@@ -0,0 +1,171 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osip2/internal.h>
+#include <osip2/osip.h>
+
+/* check a sharded osip_t: transactions are created in the shard of
+   their Call-ID, the responses are found in this shard and each shard
+   only processes its own transactions. */
+
+#define NB_SHARDS 4
+#define NB_TRANSACTIONS 200
+
+static const char *request_format = "OPTIONS sip:bob@b.com SIP/2.0\r\nVia: SIP/2.0/UDP h1.com;branch=z9hG4bK%i\r\nFrom: <sip:a@a.com>;tag=%i\r\nTo: <sip:bob@b.com>\r\nCall-ID: c%i@h1.com\r\nCSeq: 1 OPTIONS\r\nContent-Length: 0\r\n\r\n";
+static const char *response_format = "SIP/2.0 200 OK\r\nVia: SIP/2.0/UDP h1.com;branch=z9hG4bK%i\r\nFrom: <sip:a@a.com>;tag=%i\r\nTo: <sip:bob@b.com>;tag=x\r\nCall-ID: c%i@h1.com\r\nCSeq: 1 OPTIONS\r\nContent-Length: 0\r\n\r\n";
+
+static osip_transaction_t *transactions[NB_TRANSACTIONS];
+static int nb_sent;
+static int nb_received[NB_TRANSACTIONS];
+
+static int cb_send_message(osip_transaction_t *tr, osip_message_t *sip, char *host, int port, int out_socket) {
+  nb_sent++;
+  return OSIP_SUCCESS;
+}
+
+static void cb_rcv2xx(int type, osip_transaction_t *tr, osip_message_t *sip) {
+  nb_received[(int) (long) osip_transaction_get_your_instance(tr)]++;
+}
+
+static int shard_index(osip_t *osip, osip_t *shard) {
+  int i;
+
+  for (i = 0; i < osip_get_shard_count(osip); i++) {
+    if (osip_get_shard(osip, i) == shard)
+      return i;
+  }
+
+  return -1;
+}
+
+int main(int argc, char **argv) {
+  osip_t *osip;
+  int used[NB_SHARDS];
+  int failed = 0;
+  int shard;
+  int i;
+
+  if (osip_init_sharded(&osip, NB_SHARDS) != OSIP_SUCCESS)
+    return 1;
+
+  /* callbacks set on the osip_t are used by its shards */
+  osip_set_cb_send_message(osip, &cb_send_message);
+  osip_set_message_callback(osip, OSIP_NICT_STATUS_2XX_RECEIVED, &cb_rcv2xx);
+
+  if (osip_get_shard_count(osip) != NB_SHARDS) {
+    fprintf(stdout, "tshard: %i shards instead of %i\n", osip_get_shard_count(osip), NB_SHARDS);
+    failed++;
+  }
+
+  memset(used, 0, sizeof(used));
+
+  for (i = 0; i < NB_TRANSACTIONS; i++) {
+    osip_message_t *sip;
+    osip_event_t *evt;
+    char buf[1024];
+
+    snprintf(buf, sizeof(buf), request_format, i, i, i);
+    osip_message_init(&sip);
+    osip_message_parse(sip, buf, strlen(buf));
+    evt = osip_new_outgoing_sipmessage(sip);
+    transactions[i] = osip_create_transaction(osip, evt);
+
+    if (transactions[i] == NULL) {
+      fprintf(stdout, "tshard: cannot create transaction %i\n", i);
+      osip_release(osip);
+      return 1;
+    }
+
+    osip_transaction_set_your_instance(transactions[i], (void *) (long) i);
+
+    shard = shard_index(osip, transactions[i]->config);
+
+    if (shard < 0 || transactions[i]->config != osip_select_shard(osip, sip)) {
+      fprintf(stdout, "tshard: transaction %i not in the shard of its Call-ID\n", i);
+      failed++;
+
+    } else
+      used[shard]++;
+
+    osip_transaction_add_event(transactions[i], evt);
+  }
+
+  for (shard = 0; shard < NB_SHARDS; shard++) {
+    if (used[shard] == 0) {
+      fprintf(stdout, "tshard: shard %i not used\n", shard);
+      failed++;
+    }
+  }
+
+  /* the osip_t processes the events of all shards */
+  osip_nict_execute(osip);
+
+  if (nb_sent != NB_TRANSACTIONS) {
+    fprintf(stdout, "tshard: %i requests sent instead of %i\n", nb_sent, NB_TRANSACTIONS);
+    failed++;
+  }
+
+  /* the responses are found in the shard of their transaction */
+  for (i = 0; i < NB_TRANSACTIONS; i++) {
+    osip_event_t *evt;
+    char buf[1024];
+
+    snprintf(buf, sizeof(buf), response_format, i, i, i);
+    evt = osip_parse(buf, strlen(buf));
+
+    if (osip_find_transaction_and_add_event(osip, evt) != OSIP_SUCCESS) {
+      fprintf(stdout, "tshard: no transaction found for response %i\n", i);
+      osip_event_free(evt);
+      failed++;
+    }
+  }
+
+  /* a shard only processes its own transactions */
+  osip_nict_execute(osip_get_shard(osip, 0));
+
+  for (i = 0; i < NB_TRANSACTIONS; i++) {
+    int expected = (transactions[i]->config == osip_get_shard(osip, 0)) ? 1 : 0;
+
+    if (nb_received[i] != expected) {
+      fprintf(stdout, "tshard: response %i processed %i times by shard 0\n", i, nb_received[i]);
+      failed++;
+    }
+  }
+
+  for (shard = 1; shard < NB_SHARDS; shard++)
+    osip_nict_execute(osip_get_shard(osip, shard));
+
+  for (i = 0; i < NB_TRANSACTIONS; i++) {
+    if (nb_received[i] != 1) {
+      fprintf(stdout, "tshard: response %i processed %i times\n", i, nb_received[i]);
+      failed++;
+    }
+
+    osip_transaction_free(transactions[i]);
+  }
+
+  osip_release(osip);
+
+  fprintf(stdout, "tshard: %s\n", failed ? "FAILED" : "OK");
+  return failed ? 1 : 0;
+}
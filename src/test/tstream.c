@@ -0,0 +1,251 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osipparser2/internal.h>
+#include <osipparser2/osip_port.h>
+#include <osipparser2/osip_parser.h>
+
+/* check osip_stream_t: messages and keep-alives fed in chunks of any
+   size are found again, and malformed or oversized messages are
+   reported as errors. */
+
+#define NB_ROUNDS 100
+#define NB_MESSAGES 20
+
+static const char *message_format = "MESSAGE sip:b@h1.com SIP/2.0\r\nVia: SIP/2.0/TCP h1.com;branch=z9hG4bK%i\r\nFrom: <sip:a@h1.com>;tag=1\r\nTo: <sip:b@h1.com>\r\nCall-ID: %i-%i\r\nCSeq: 1 MESSAGE\r\n%s%i\r\nContent-Type: text/plain\r\n\r\n";
+static const char *content_lengths[] = {"Content-Length: ", "content-length:", "l: ", "CONTENT-LENGTH :  "};
+
+static char input[NB_MESSAGES * 1024];
+static const char *frames[NB_MESSAGES];
+static size_t frame_lengths[NB_MESSAGES];
+static int body_lengths[NB_MESSAGES];
+
+/* messages with bodies, some of them after a keep-alive */
+static size_t build_input(int round, int *nb_pings) {
+  size_t length = 0;
+  int n;
+
+  *nb_pings = 0;
+
+  for (n = 0; n < NB_MESSAGES; n++) {
+    int body_length = rand() % 500;
+    int k;
+
+    if (rand() % 3 == 0) {
+      memcpy(input + length, "\r\n\r\n", 4);
+      length += 4;
+      (*nb_pings)++;
+    }
+
+    frames[n] = input + length;
+    length += sprintf(input + length, message_format, n, round, n, content_lengths[rand() % 4], body_length);
+
+    /* line ends in the body are not line ends of headers */
+    for (k = 0; k < body_length; k++)
+      input[length++] = (k % 37 == 5) ? '\n' : (char) ('a' + k % 26);
+
+    frame_lengths[n] = input + length - frames[n];
+    body_lengths[n] = body_length;
+  }
+
+  return length;
+}
+
+static int test_round(int round) {
+  osip_stream_t *stream;
+  size_t length;
+  size_t offset = 0;
+  int nb_pings;
+  int pings = 0;
+  int found = 0;
+  int failed = 0;
+  int i;
+
+  srand(round);
+  length = build_input(round, &nb_pings);
+
+  if (osip_stream_init(&stream, (round % 2) ? 2000 : 0) != OSIP_SUCCESS)
+    return 1;
+
+  while (failed == 0) {
+    if (offset < length) {
+      size_t chunk = 1 + rand() % ((round % 3 == 0) ? 3 : 700);
+
+      if (chunk > length - offset)
+        chunk = length - offset;
+
+      i = osip_stream_feed(stream, input + offset, chunk);
+
+      if (i < 0) {
+        fprintf(stdout, "tstream: round %i: osip_stream_feed returned %i\n", round, i);
+        failed++;
+        break;
+      }
+
+      offset += i;
+    }
+
+    for (;;) {
+      const char *frame;
+      size_t frame_length;
+      int ping;
+      int pong;
+
+      /* messages are read as frames or as parsed messages */
+      if (found < NB_MESSAGES && rand() % 2) {
+        osip_message_t *sip;
+
+        i = osip_stream_get_message(stream, &sip);
+
+        if (i == OSIP_SUCCESS) {
+          if (sip->call_id == NULL || osip_list_size(&sip->bodies) != (body_lengths[found] > 0 ? 1 : 0)) {
+            fprintf(stdout, "tstream: round %i: message %i not parsed\n", round, found);
+            failed++;
+          }
+
+          osip_message_free(sip);
+        }
+
+      } else {
+        i = osip_stream_get_frame(stream, &frame, &frame_length);
+
+        if (i == OSIP_SUCCESS && (found >= NB_MESSAGES || frame_length != frame_lengths[found] || memcmp(frame, frames[found], frame_length) != 0)) {
+          fprintf(stdout, "tstream: round %i: message %i differs\n", round, found);
+          failed++;
+        }
+      }
+
+      if (i == OSIP_NOTFOUND)
+        break;
+
+      if (i != OSIP_SUCCESS) {
+        fprintf(stdout, "tstream: round %i: message %i not found (%i)\n", round, found, i);
+        failed++;
+        break;
+      }
+
+      found++;
+      osip_stream_get_keepalive(stream, &ping, &pong);
+      pings += ping;
+    }
+
+    if (offset == length)
+      break;
+  }
+
+  if (failed == 0 && found != NB_MESSAGES) {
+    fprintf(stdout, "tstream: round %i: %i messages instead of %i\n", round, found, NB_MESSAGES);
+    failed++;
+  }
+
+  if (failed == 0 && pings != nb_pings) {
+    fprintf(stdout, "tstream: round %i: %i keep-alives instead of %i\n", round, pings, nb_pings);
+    failed++;
+  }
+
+  osip_stream_free(stream);
+  return failed;
+}
+
+static int test_errors(void) {
+  osip_stream_t *stream;
+  const char *frame;
+  size_t frame_length;
+  char big[400];
+  int failed = 0;
+  int ping;
+  int pong;
+
+  /* a CRLF is a pong, CRLFCRLF is a ping even when split */
+  osip_stream_init(&stream, 300);
+  osip_stream_feed(stream, "\r\n", 2);
+  osip_stream_get_keepalive(stream, &ping, &pong);
+
+  if (ping != 0 || pong != 1) {
+    fprintf(stdout, "tstream: pong not found\n");
+    failed++;
+  }
+
+  osip_stream_feed(stream, "\r\n", 2);
+  osip_stream_get_keepalive(stream, &ping, &pong);
+
+  if (ping != 1 || pong != 0) {
+    fprintf(stdout, "tstream: split ping not found\n");
+    failed++;
+  }
+
+  /* message larger than the maximum size */
+  osip_stream_feed(stream, "\r\nOPTIONS sip:a SIP/2.0\r\nl: 1000\r\n\r\n", 36);
+
+  if (osip_stream_get_frame(stream, &frame, &frame_length) != OSIP_SYNTAXERROR) {
+    fprintf(stdout, "tstream: oversized message not reported\n");
+    failed++;
+  }
+
+  osip_stream_get_keepalive(stream, &ping, &pong);
+
+  if (pong != 1) {
+    fprintf(stdout, "tstream: pong before a message not found\n");
+    failed++;
+  }
+
+  osip_stream_free(stream);
+
+  /* invalid Content-Length */
+  osip_stream_init(&stream, 300);
+  osip_stream_feed(stream, "OPTIONS sip:a SIP/2.0\r\nContent-Length: x\r\n\r\n", 44);
+
+  if (osip_stream_get_frame(stream, &frame, &frame_length) != OSIP_SYNTAXERROR) {
+    fprintf(stdout, "tstream: invalid Content-Length not reported\n");
+    failed++;
+  }
+
+  osip_stream_free(stream);
+
+  /* no end of headers within the maximum size */
+  osip_stream_init(&stream, 100);
+  memset(big, 'a', sizeof(big));
+
+  if (osip_stream_feed(stream, big, sizeof(big)) != 100 || osip_stream_get_frame(stream, &frame, &frame_length) != OSIP_SYNTAXERROR) {
+    fprintf(stdout, "tstream: headers larger than the maximum size not reported\n");
+    failed++;
+  }
+
+  osip_stream_free(stream);
+  return failed;
+}
+
+int main(int argc, char **argv) {
+  int failed = 0;
+  int round;
+
+  parser_init();
+
+  for (round = 0; round < NB_ROUNDS; round++)
+    failed += test_round(round);
+
+  failed += test_errors();
+
+  fprintf(stdout, "tstream: %s\n", failed ? "FAILED" : "OK");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,173 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osip2/internal.h>
+#include <osip2/osip.h>
+
+#include "xixt.h"
+
+/* check osip_timers_gettimeout and __osip_wheel_next. */
+
+static const char *invite = "INVITE sip:bob@b.com SIP/2.0\r\nVia: SIP/2.0/UDP h1.com;branch=z9hG4bK%i\r\nFrom: <sip:a@a.com>;tag=1\r\nTo: <sip:bob@b.com>\r\nCall-ID: c%i@h1.com\r\nCSeq: 1 INVITE\r\nContent-Length: 0\r\n\r\n";
+
+static int cb_send_message(osip_transaction_t *tr, osip_message_t *sip, char *host, int port, int out_socket) {
+  return OSIP_SUCCESS;
+}
+
+static void tick_to_timeval(unsigned long tick, struct timeval *tv) {
+  tv->tv_sec = (long) (tick / 1000);
+  tv->tv_usec = (long) (tick % 1000) * 1000;
+}
+
+/* the wheel reaches the start of the level 1 slot of an entry before
+   this slot is processed: the entry must still be reported */
+static int test_wheel_boundary(void) {
+  osip_wheel_t *wheel;
+  osip_timer_entry_t entry;
+  struct timeval now;
+  struct timeval expire;
+  struct timeval next;
+  unsigned long tick;
+  unsigned long boundary;
+  int failed = 0;
+
+  if (__osip_wheel_init(&wheel) != OSIP_SUCCESS)
+    return 1;
+
+  memset(&entry, 0, sizeof(entry));
+  osip_gettimeofday(&now, NULL);
+  tick = (unsigned long) now.tv_sec * 1000 + (unsigned long) now.tv_usec / 1000;
+
+  /* 100ms later: placed in level 1 */
+  tick_to_timeval(tick + 100, &expire);
+  entry.element = &entry;
+  __osip_wheel_add(wheel, &entry, &expire);
+
+  /* process the ticks up to the start of the slot of the entry */
+  boundary = ((tick + 100) >> 6) << 6;
+  tick_to_timeval(boundary - 1, &now);
+
+  if (__osip_wheel_expire(wheel, &now) != NULL) {
+    fprintf(stdout, "ttimeout: entry expired before the boundary\n");
+    failed++;
+  }
+
+  if (__osip_wheel_next(wheel, &now, &next) != OSIP_SUCCESS) {
+    fprintf(stdout, "ttimeout: entry at the start of a slot not reported\n");
+    failed++;
+
+  } else if (osip_timercmp(&next, &expire, >)) {
+    fprintf(stdout, "ttimeout: entry at the start of a slot reported too late\n");
+    failed++;
+  }
+
+  if (__osip_wheel_expire(wheel, &expire) != &entry) {
+    fprintf(stdout, "ttimeout: entry not expired\n");
+    failed++;
+  }
+
+  __osip_wheel_free(wheel);
+  return failed;
+}
+
+static int test_gettimeout(int nb_shards) {
+  osip_t *osip;
+  osip_transaction_t *transactions[20];
+  struct timeval timeout;
+  int failed = 0;
+  int i;
+
+  if (nb_shards > 0)
+    i = osip_init_sharded(&osip, nb_shards);
+
+  else
+    i = osip_init(&osip);
+
+  if (i != OSIP_SUCCESS)
+    return 1;
+
+  osip_set_cb_send_message(osip, &cb_send_message);
+
+  /* no transaction: nothing to wake up for */
+  osip_timers_gettimeout(osip, &timeout);
+
+  if (timeout.tv_sec < 3600) {
+    fprintf(stdout, "ttimeout: %i shards: timeout of %li s without transaction\n", nb_shards, (long) timeout.tv_sec);
+    failed++;
+  }
+
+  for (i = 0; i < 20; i++) {
+    osip_message_t *sip;
+    osip_event_t *evt;
+    char buf[1024];
+
+    snprintf(buf, sizeof(buf), invite, i, i);
+    osip_message_init(&sip);
+    osip_message_parse(sip, buf, strlen(buf));
+    evt = osip_new_outgoing_sipmessage(sip);
+    transactions[i] = osip_create_transaction(osip, evt);
+
+    if (transactions[i] == NULL) {
+      osip_message_free(sip);
+      osip_free(evt);
+      osip_release(osip);
+      return 1;
+    }
+
+    osip_transaction_add_event(transactions[i], evt);
+  }
+
+  /* pending events are processed immediately */
+  osip_timers_gettimeout(osip, &timeout);
+
+  if (timeout.tv_sec != 0 || timeout.tv_usec != 0) {
+    fprintf(stdout, "ttimeout: %i shards: pending events not reported\n", nb_shards);
+    failed++;
+  }
+
+  /* INVITE sent over UDP: timer A fires after 500ms (rounded up to the next 1ms tick) */
+  osip_ict_execute(osip);
+  osip_timers_gettimeout(osip, &timeout);
+
+  if (timeout.tv_sec != 0 || timeout.tv_usec > 501000 || timeout.tv_usec < 300000) {
+    fprintf(stdout, "ttimeout: %i shards: timeout of %li.%06li s instead of timer A\n", nb_shards, (long) timeout.tv_sec, (long) timeout.tv_usec);
+    failed++;
+  }
+
+  for (i = 0; i < 20; i++)
+    osip_transaction_free(transactions[i]);
+
+  osip_release(osip);
+  return failed;
+}
+
+int main(int argc, char **argv) {
+  int failed = 0;
+
+  failed += test_wheel_boundary();
+  failed += test_gettimeout(0);
+  failed += test_gettimeout(3);
+
+  fprintf(stdout, "ttimeout: %s\n", failed ? "FAILED" : "OK");
+  return failed ? 1 : 0;
+}
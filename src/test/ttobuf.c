@@ -0,0 +1,216 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osipparser2/internal.h>
+#include <osipparser2/osip_port.h>
+#include <osipparser2/osip_parser.h>
+
+/* serialize the messages of the res directory with osip_message_to_buf
+   and the osip_*_to_buf of headers: the result is the one of the
+   osip_*_to_str, and a small buffer gives the required length. */
+
+static char element_buf[65536];
+
+/* compare the results of osip_X_to_str and osip_X_to_buf for one element */
+static int compare_element(const char *filename, const char *name, int i, char *str, int j, size_t needed, int k, size_t length, int l, size_t small_length) {
+  int failed = 0;
+
+  if (i != j || (i == OSIP_SUCCESS && (k != OSIP_SUCCESS || needed != strlen(str) || length != needed || strcmp(str, element_buf) != 0))) {
+    fprintf(stdout, "ttobuf: %s: %s differs\n", filename, name);
+    failed = -1;
+
+  } else if (i == OSIP_SUCCESS && needed > 2 && (l != OSIP_NOMEM || small_length != needed)) {
+    fprintf(stdout, "ttobuf: %s: %s in a small buffer\n", filename, name);
+    failed = -1;
+  }
+
+  osip_free(str);
+  return failed;
+}
+
+#define CHECK_ELEMENT(name, element, to_str, to_buf)                                                                                                   \
+  do {                                                                                                                                                 \
+    char *str = NULL;                                                                                                                                  \
+    char small[2];                                                                                                                                     \
+    size_t needed = 0;                                                                                                                                 \
+    size_t length = 0;                                                                                                                                 \
+    size_t small_length = 0;                                                                                                                           \
+    int i = to_str(element, &str);                                                                                                                     \
+    int j = to_buf(element, NULL, 0, &needed);                                                                                                         \
+    int k = to_buf(element, element_buf, sizeof(element_buf), &length);                                                                                \
+    int l = to_buf(element, small, sizeof(small), &small_length);                                                                                      \
+                                                                                                                                                       \
+    if (compare_element(filename, name, i, str, j, needed, k, length, l, small_length) < 0)                                                            \
+      failed = -1;                                                                                                                                     \
+  } while (0)
+
+static int test_headers(const char *filename, osip_message_t *sip) {
+  osip_list_iterator_t it;
+  void *element;
+  int failed = 0;
+
+  if (sip->req_uri != NULL)
+    CHECK_ELEMENT("uri", sip->req_uri, osip_uri_to_str, osip_uri_to_buf);
+
+  if (sip->from != NULL)
+    CHECK_ELEMENT("from", sip->from, osip_from_to_str, osip_from_to_buf);
+
+  if (sip->to != NULL)
+    CHECK_ELEMENT("to", sip->to, osip_to_to_str, osip_from_to_buf);
+
+  if (sip->call_id != NULL)
+    CHECK_ELEMENT("call-id", sip->call_id, osip_call_id_to_str, osip_call_id_to_buf);
+
+  if (sip->cseq != NULL)
+    CHECK_ELEMENT("cseq", sip->cseq, osip_cseq_to_str, osip_cseq_to_buf);
+
+  if (sip->content_type != NULL)
+    CHECK_ELEMENT("content-type", sip->content_type, osip_content_type_to_str, osip_content_type_to_buf);
+
+  for (element = osip_list_get_first(&sip->vias, &it); element != NULL; element = osip_list_get_next(&it))
+    CHECK_ELEMENT("via", (osip_via_t *) element, osip_via_to_str, osip_via_to_buf);
+
+  for (element = osip_list_get_first(&sip->contacts, &it); element != NULL; element = osip_list_get_next(&it))
+    CHECK_ELEMENT("contact", (osip_contact_t *) element, osip_contact_to_str, osip_contact_to_buf);
+
+  for (element = osip_list_get_first(&sip->headers, &it); element != NULL; element = osip_list_get_next(&it))
+    CHECK_ELEMENT("header", (osip_header_t *) element, osip_header_to_str, osip_header_to_buf);
+
+  return failed;
+}
+
+static int test_to_buf(const char *filename, const char *msg, size_t length) {
+  osip_message_t *sip;
+  osip_message_t *serialized;
+  char *result = NULL;
+  char *buf;
+  size_t result_length;
+  size_t needed;
+  size_t buf_length;
+  int failed = 0;
+  int i;
+
+  osip_message_init(&sip);
+
+  if (osip_message_parse(sip, msg, length) != OSIP_SUCCESS) {
+    osip_message_free(sip);
+    return 0;
+  }
+
+  /* one message is serialized with osip_message_to_str first */
+  osip_message_init(&serialized);
+  osip_message_parse(serialized, msg, length);
+  osip_message_force_update(sip);
+  osip_message_force_update(serialized);
+
+  i = osip_message_to_str(serialized, &result, &result_length);
+
+  if (i != osip_message_to_buf(sip, NULL, 0, &needed) || (i == OSIP_SUCCESS && needed != result_length)) {
+    fprintf(stdout, "ttobuf: %s: wrong length required\n", filename);
+    failed = -1;
+
+  } else if (i == OSIP_SUCCESS) {
+    buf = (char *) osip_malloc(needed + 1);
+
+    if (osip_message_to_buf(sip, buf, needed + 1, &buf_length) != OSIP_SUCCESS || buf_length != result_length || memcmp(buf, result, result_length) != 0 || buf[result_length] != '\0') {
+      fprintf(stdout, "ttobuf: %s: message differs\n", filename);
+      failed = -1;
+    }
+
+    /* no room is needed for the final NUL */
+    if (osip_message_to_buf(sip, buf, needed, &buf_length) != OSIP_SUCCESS || memcmp(buf, result, result_length) != 0) {
+      fprintf(stdout, "ttobuf: %s: message differs in a buffer of the exact size\n", filename);
+      failed = -1;
+    }
+
+    if (osip_message_to_buf(sip, buf, needed - 1, &buf_length) != OSIP_NOMEM || buf_length != result_length) {
+      fprintf(stdout, "ttobuf: %s: wrong length required by a small buffer\n", filename);
+      failed = -1;
+    }
+
+    /* the message already serialized is copied */
+    if (osip_message_to_buf(serialized, buf, needed + 1, &buf_length) != OSIP_SUCCESS || buf_length != result_length || memcmp(buf, result, result_length) != 0) {
+      fprintf(stdout, "ttobuf: %s: serialized message differs\n", filename);
+      failed = -1;
+    }
+
+    osip_free(buf);
+  }
+
+  if (test_headers(filename, sip) < 0)
+    failed = -1;
+
+  osip_free(result);
+  osip_message_free(sip);
+  osip_message_free(serialized);
+  return failed;
+}
+
+static char *read_message(const char *filename, size_t *length) {
+  FILE *file;
+  char *msg;
+
+  file = fopen(filename, "r");
+
+  if (file == NULL)
+    return NULL;
+
+  msg = (char *) osip_malloc(100000); /* msg are under 100000 */
+  *length = fread(msg, 1, 99999, file);
+  msg[*length] = '\0';
+  fclose(file);
+  return msg;
+}
+
+int main(int argc, char **argv) {
+  char filename[1024];
+  char *msg;
+  size_t length;
+  int tested = 0;
+  int failed = 0;
+  int i;
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: ./ttobuf res_directory\n");
+    exit(1);
+  }
+
+  parser_init();
+
+  for (i = 0;; i++) {
+    snprintf(filename, sizeof(filename), "%s/sip%i", argv[1], i);
+    msg = read_message(filename, &length);
+
+    if (msg == NULL)
+      break;
+
+    if (test_to_buf(filename, msg, length) < 0)
+      failed++;
+
+    tested++;
+    osip_free(msg);
+  }
+
+  fprintf(stdout, "ttobuf: %i messages, %i failed\n", tested, failed);
+  return (tested == 0 || failed != 0) ? 1 : 0;
+}
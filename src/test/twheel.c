@@ -0,0 +1,179 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osip2/internal.h>
+#include <osip2/osip.h>
+
+#include "xixt.h"
+
+/* check the timer wheel against a model with a simulated clock:
+   entries are added, removed and expired with delays from a few ms
+   to several hours. An entry must never expire early or be missed,
+   and __osip_wheel_next must not report an expiration later than the
+   first one. */
+
+#define NB_ENTRIES 2000
+#define NB_STEPS 100000
+
+static osip_timer_entry_t entries[NB_ENTRIES];
+static struct timeval expires[NB_ENTRIES];
+static int scheduled[NB_ENTRIES];
+
+static long long to_ms(const struct timeval *tv) {
+  return tv->tv_sec * 1000LL + tv->tv_usec / 1000;
+}
+
+static void add_ms(struct timeval *tv, long ms) {
+  tv->tv_sec += ms / 1000;
+  tv->tv_usec += (ms % 1000) * 1000;
+
+  if (tv->tv_usec >= 1000000) {
+    tv->tv_sec++;
+    tv->tv_usec -= 1000000;
+  }
+}
+
+/* first expiration of the model, rounded up to the ms (or -1) */
+static long long model_next(void) {
+  long long next = -1;
+  int i;
+
+  for (i = 0; i < NB_ENTRIES; i++) {
+    long long expire;
+
+    if (!scheduled[i])
+      continue;
+
+    expire = expires[i].tv_sec * 1000LL + (expires[i].tv_usec + 999) / 1000;
+
+    if (next < 0 || expire < next)
+      next = expire;
+  }
+
+  return next;
+}
+
+static int check_expired(osip_wheel_t *wheel, struct timeval *now) {
+  osip_timer_entry_t *entry;
+  int failed = 0;
+  int i;
+
+  entry = __osip_wheel_expire(wheel, now);
+
+  while (entry != NULL) {
+    osip_timer_entry_t *next = entry->next;
+    int k = (int) (entry - entries);
+
+    if (!scheduled[k]) {
+      fprintf(stdout, "twheel: entry %i expired but not scheduled\n", k);
+      failed++;
+    }
+
+    if (osip_timercmp(&expires[k], now, >)) {
+      fprintf(stdout, "twheel: entry %i expired early (%lld > %lld)\n", k, to_ms(&expires[k]), to_ms(now));
+      failed++;
+    }
+
+    scheduled[k] = 0;
+    entry = next;
+  }
+
+  /* entries due before the previous ms must have expired */
+  for (i = 0; i < NB_ENTRIES; i++) {
+    if (scheduled[i] && to_ms(&expires[i]) + 1 <= to_ms(now)) {
+      fprintf(stdout, "twheel: entry %i missed (%lld <= %lld)\n", i, to_ms(&expires[i]), to_ms(now));
+      __osip_wheel_remove(wheel, &entries[i]);
+      scheduled[i] = 0;
+      failed++;
+    }
+  }
+
+  return failed;
+}
+
+static int check_next(osip_wheel_t *wheel, struct timeval *now) {
+  struct timeval next;
+  long long expected = model_next();
+  int i = __osip_wheel_next(wheel, now, &next);
+
+  if ((i == OSIP_SUCCESS) != (expected >= 0)) {
+    fprintf(stdout, "twheel: __osip_wheel_next returned %i with %s entries\n", i, expected >= 0 ? "some" : "no");
+    return 1;
+  }
+
+  if (i == OSIP_SUCCESS && to_ms(&next) > expected && to_ms(&next) > to_ms(now) + 1) {
+    fprintf(stdout, "twheel: next expiration too late (%lld > %lld)\n", to_ms(&next), expected);
+    return 1;
+  }
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  osip_wheel_t *wheel;
+  struct timeval now;
+  int failed = 0;
+  int step;
+
+  srand(3);
+
+  if (__osip_wheel_init(&wheel) != OSIP_SUCCESS)
+    return 1;
+
+  osip_gettimeofday(&now, NULL);
+
+  for (step = 0; step < NB_STEPS && failed < 10; step++) {
+    int op = rand() % 10;
+    int i = rand() % NB_ENTRIES;
+
+    if (op < 4) { /* schedule (or schedule again) */
+      long delay = (rand() % 8 == 0) ? (long) (rand() % 40000000) : rand() % 40000;
+
+      expires[i] = now;
+      add_ms(&expires[i], delay);
+
+      if (rand() % 20 == 0)
+        expires[i].tv_sec -= 3; /* already expired */
+
+      entries[i].element = &entries[i];
+      __osip_wheel_add(wheel, &entries[i], &expires[i]);
+      scheduled[i] = 1;
+
+    } else if (op < 5) {
+      __osip_wheel_remove(wheel, &entries[i]);
+      scheduled[i] = 0;
+
+    } else {
+      add_ms(&now, (rand() % 50 == 0) ? rand() % 3000000 : rand() % 100);
+      failed += check_expired(wheel, &now);
+    }
+
+    if (step % 10 == 0)
+      failed += check_next(wheel, &now);
+  }
+
+  __osip_wheel_free(wheel);
+
+  fprintf(stdout, "twheel: %s\n", failed ? "FAILED" : "OK");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,207 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001-2020 Aymeric MOIZARD amoizard@antisip.com
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <osipparser2/internal.h>
+#include <osipparser2/osip_port.h>
+#include <osipparser2/osip_parser.h>
+
+/* get the messages of the res directory with osip_message_get_wire:
+   the buffer is the one of osip_message_to_str, shared until the
+   message changes, and valid until released even after the message
+   or its arena is released. */
+
+static int test_clone(const char *filename, osip_message_t *sip, const char *wire, size_t wire_length) {
+  osip_message_t *clone;
+  const char *wire2;
+  const char *wire3;
+  size_t length;
+  int failed = 0;
+
+  if (osip_message_clone(sip, &clone) != OSIP_SUCCESS)
+    return -1;
+
+  /* a clone has its own buffer */
+  if (osip_message_get_wire(clone, &wire2, &length) != OSIP_SUCCESS || wire2 == wire || length != wire_length || memcmp(wire2, wire, wire_length) != 0) {
+    fprintf(stdout, "twire: %s: wrong buffer for a clone\n", filename);
+    failed = -1;
+
+  } else
+    osip_message_release_wire(wire2);
+
+  osip_message_set_header(clone, "X-Wire", "1");
+
+  if (osip_message_get_wire(clone, &wire3, &length) != OSIP_SUCCESS || wire3 == wire || strstr(wire3, "X-Wire: 1") == NULL) {
+    fprintf(stdout, "twire: %s: modification not found\n", filename);
+    osip_message_free(clone);
+    return -1;
+  }
+
+  /* the message member stays a string allocated with osip_malloc */
+  osip_free(clone->message);
+  clone->message = osip_strdup("x");
+  clone->message_length = 1;
+  clone->message_property = 2;
+
+  if (osip_message_get_wire(clone, &wire2, &length) != OSIP_SUCCESS || strstr(wire2, "X-Wire: 1") == NULL) {
+    fprintf(stdout, "twire: %s: message member not replaced\n", filename);
+    failed = -1;
+
+  } else
+    osip_message_release_wire(wire2);
+
+  osip_message_free(clone);
+
+  if (strstr(wire3, "X-Wire: 1") == NULL) {
+    fprintf(stdout, "twire: %s: buffer of a clone released too early\n", filename);
+    failed = -1;
+  }
+
+  osip_message_release_wire(wire3);
+  return failed;
+}
+
+static int test_wire(const char *filename, const char *msg, size_t length) {
+  osip_message_t *sip;
+  osip_arena_t *arena;
+  osip_arena_t *previous;
+  const char *wire;
+  const char *wire2;
+  char *result = NULL;
+  char *copy;
+  size_t result_length;
+  size_t wire_length;
+  size_t length2;
+  int failed = 0;
+
+  osip_message_init(&sip);
+
+  if (osip_message_parse(sip, msg, length) != OSIP_SUCCESS) {
+    osip_message_free(sip);
+    return 0;
+  }
+
+  if (osip_message_get_wire(sip, &wire, &wire_length) != OSIP_SUCCESS) {
+    fprintf(stdout, "twire: %s: no buffer\n", filename);
+    osip_message_free(sip);
+    return -1;
+  }
+
+  osip_message_to_str(sip, &result, &result_length);
+
+  if (result == NULL || result_length != wire_length || memcmp(result, wire, wire_length) != 0 || wire[wire_length] != '\0') {
+    fprintf(stdout, "twire: %s: buffer differs\n", filename);
+    failed = -1;
+  }
+
+  /* an unmodified message gives the same buffer */
+  if (osip_message_get_wire(sip, &wire2, &length2) != OSIP_SUCCESS || wire2 != wire) {
+    fprintf(stdout, "twire: %s: buffer not shared\n", filename);
+    failed = -1;
+
+  } else
+    osip_message_release_wire(wire2);
+
+  if (test_clone(filename, sip, wire, wire_length) < 0)
+    failed = -1;
+
+  /* the buffer outlives the message */
+  copy = osip_strdup(wire);
+  osip_message_free(sip);
+
+  if (strcmp(copy, wire) != 0) {
+    fprintf(stdout, "twire: %s: buffer released with the message\n", filename);
+    failed = -1;
+  }
+
+  osip_free(copy);
+  osip_message_release_wire(wire);
+
+  /* and the arena of the message */
+  osip_arena_init(&arena, 0);
+  previous = osip_arena_set_current(arena);
+  osip_message_init(&sip);
+  osip_message_parse(sip, msg, length);
+  osip_message_get_wire(sip, &wire, &wire_length);
+  osip_arena_set_current(previous);
+  osip_arena_free(arena);
+  osip_message_free(sip);
+
+  if (result == NULL || wire_length != result_length || memcmp(wire, result, wire_length) != 0) {
+    fprintf(stdout, "twire: %s: buffer released with the arena\n", filename);
+    failed = -1;
+  }
+
+  osip_message_release_wire(wire);
+  osip_free(result);
+  return failed;
+}
+
+static char *read_message(const char *filename, size_t *length) {
+  FILE *file;
+  char *msg;
+
+  file = fopen(filename, "r");
+
+  if (file == NULL)
+    return NULL;
+
+  msg = (char *) osip_malloc(100000); /* msg are under 100000 */
+  *length = fread(msg, 1, 99999, file);
+  msg[*length] = '\0';
+  fclose(file);
+  return msg;
+}
+
+int main(int argc, char **argv) {
+  char filename[1024];
+  char *msg;
+  size_t length;
+  int tested = 0;
+  int failed = 0;
+  int i;
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: ./twire res_directory\n");
+    exit(1);
+  }
+
+  osip_set_arena_allocators();
+  parser_init();
+
+  for (i = 0;; i++) {
+    snprintf(filename, sizeof(filename), "%s/sip%i", argv[1], i);
+    msg = read_message(filename, &length);
+
+    if (msg == NULL)
+      break;
+
+    if (test_wire(filename, msg, length) < 0)
+      failed++;
+
+    tested++;
+    osip_free(msg);
+  }
+
+  fprintf(stdout, "twire: %i messages, %i failed\n", tested, failed);
+  return (tested == 0 || failed != 0) ? 1 : 0;
+}